@@ -8,14 +8,20 @@ extern "C" {
 #endif
 
 #include "main.h"
+#include "stream_proto.h"
 
 // --- 用户可配置宏定义 ---
 
 // ** 数据采集参数 **
-#define CHANNELS_PER_SAMPLE     8       // ADC每次自动扫描的通道数
-#define SAMPLES_PER_CHANNEL     1024    // 每个通道采集的样本数
+#define CHANNELS_PER_SAMPLE     STREAM_CHANNELS         // ADC每次自动扫描的通道数 (线路格式, 见 stream_proto.h)
+#define SAMPLES_PER_CHANNEL     STREAM_FRAMES_PER_BLOCK // 每个通道采集的样本数
 // 每个乒乓缓冲区的总样本数 (注意：类型现在是uint16_t)
 #define PING_PONG_BUFFER_SIZE   (CHANNELS_PER_SAMPLE * SAMPLES_PER_CHANNEL)
+#define ADC_SAMPLE_RATE_HZ      STREAM_SAMPLE_RATE_HZ   // TIM2触发频率 (见 tim.c)
+// 填满一个乒乓缓冲区的时间
+#define BLOCK_PERIOD_MS         STREAM_BLOCK_PERIOD_MS
+// 每块最多记录的采样时钟缺口数 (位置随订阅包头发给接收端, 见 StreamGapExt)
+#define ADC_GAP_TABLE_SIZE      16
 
 // ** 网络参数 **
 #define DEST_IP_ADDR0           192
@@ -24,22 +30,94 @@ extern "C" {
 #define DEST_IP_ADDR3           100
 #define DEST_PORT               5001
 
-// ** UDP包净荷大小 **
-#define UDP_PAYLOAD_SIZE        1440    // bytes
+// ** UDP包净荷大小 ** (主机基准可在编译时用 -DUDP_PAYLOAD_SIZE=1024 覆盖)
+#ifndef UDP_PAYLOAD_SIZE
+#define UDP_PAYLOAD_SIZE        STREAM_UDP_CHUNK_SIZE   // bytes (PC端工具按默认值解析原始流)
+#endif
+
+// ** 数据流模式 **
+#define STREAM_MODE_UDP         0       // UDP/IP发送至 DEST_IP_ADDR:DEST_PORT (默认)
+#define STREAM_MODE_RAW_ETH     1       // 自定义EtherType的二层帧，仅用于专用的点对点采集网络
+#define STREAM_MODE             STREAM_MODE_UDP
+
+// ** 二层模式参数 **
+// PC接收网卡的MAC地址; 在专用点对点链路上也可直接使用广播地址
+#define RAW_ETH_DEST_MAC        { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF }
+#define RAW_ETH_PAYLOAD_SIZE    STREAM_L2_CHUNK_SIZE    // bytes, 8字节流包头 + 1488 = 1496 <= 1500 (MTU)
+
+// 每个网络包携带的最大采样数据字节数
+#if STREAM_MODE == STREAM_MODE_RAW_ETH
+#define STREAM_CHUNK_SIZE       RAW_ETH_PAYLOAD_SIZE
+#else
+#define STREAM_CHUNK_SIZE       UDP_PAYLOAD_SIZE
+#endif
+
+// ** 数据面快速通道 **
+// 1: 目的MAC解析完成后，绕过LwIP直接填写以太网发送描述符 (见 eth_fastpath.c)
+// 0: 始终使用 pbuf_alloc + udp_send 标准路径
+#ifndef USE_ETH_FASTPATH
+#define USE_ETH_FASTPATH        1
+#endif
+
+// ** 信用流控 ** (接收端通过控制端口授予包窗口后生效，见 stream_ctrl.c)
+// 信用不足以发送一整块时的处理策略:
+#define STREAM_CREDIT_POLICY_BUFFER     0   // 暂缓发送当前块，另一乒乓缓冲区也满后由采集端整块丢弃; 所有订阅者一起等待
+#define STREAM_CREDIT_POLICY_DECIMATE   1   // 本块对该订阅者加倍抽取直到信用足够，仍不够则跳过 (原始格式订阅者直接跳过)
+#define STREAM_CREDIT_POLICY_DROP       2   // 本块对该订阅者整块跳过
+#define STREAM_CREDIT_POLICY            STREAM_CREDIT_POLICY_DECIMATE
+#define STREAM_CREDIT_TIMEOUT_MS        5000    // 超过此时间无授予则退出流控，恢复无条件发送
+
+// ** 背压调速 ** (见 stream_governor.c)
+// 1: 发送跟不上采集时逐级加倍带包头订阅流的抽取因子，而不是整块丢弃; 链路恢复后逐级恢复
+#ifndef USE_STREAM_GOVERNOR
+#define USE_STREAM_GOVERNOR             1
+#endif
+// 0: 无包头的默认PC流不参与调速，始终全速发送; 发送跟不上时只能由 SPI1_DMA_RX_Callback 整块丢弃，
+//    所有订阅者同时丢失该块。
+// 1: 默认PC流也参与调速。它无法通知抽取因子的变化，而 wave_rx 和 README 的接收程序按16384字节的
+//    整块重组，因此级别L下每 2^L 块只发送一块。流中没有任何标记，旧接收程序无法区分跳过和丢失，
+//    过载期间默认PC丢失的块比不调速时更多 (governor_sim raw step: 543块，不调速为339块)，
+//    换来带包头订阅者的采集端丢块减少 (339 -> 33)。跳过的块数见遥测 raw_blocks_skipped。
+//    只在带包头的订阅者比默认PC更重要时开启。
+#ifndef STREAM_GOV_SKIP_RAW
+#define STREAM_GOV_SKIP_RAW             0
+#endif
+
+// --- 采集与发送统计 (遥测读取) ---
+typedef struct {
+    uint32_t blocks_acquired;   // 已采满的块数, 含被丢弃的块 (即当前采集块序号)
+    uint32_t tim2_skips;        // TIM2触发时DMA仍忙而跳过的采样数
+    uint32_t spi_overruns;
+    uint32_t spi_dma_errors;
+    uint32_t lost_ticks;        // 没有产生样本的TIM2周期数 (跳过 + SPI过载 + DMA错误, 含中止后丢弃的半帧和重同步帧; 只由TIM2中断写入)
+    uint32_t pbuf_failures;
+    uint32_t send_errors;       // udp_sendto 失败次数
+    uint16_t tim2_lat_max;      // TIM2中断入口时的计数值 (即入口延迟, 定时器周期)
+    uint32_t tim2_lat_hist[STREAM_TELEM_LAT_BINS];
+    uint32_t pp_fill_peak;      // 一块发送完成时另一块已采集的最大样本数 (乒乓余量), 丢块时记为块长; 只由发送端写入
+} AdcProc_Stats;
 
 // --- 对外暴露的函数 ---
 void ADC_Processing_Init(void);
 void ADC_Processing_Start(void);
 void ADC_Processing_Task(void);
+uint8_t ADC_Processing_Pending(void);
 
 // --- 中断回调函数 ---
 void SPI1_DMA_RX_Callback(void);
 void SPI1_DMA_Error_Callback(void);
+void SPI1_Abort_Callback(void);
+void ADC_Processing_TxCompleteCallback(void);
 
 // --- 全局变量声明 ---
 extern volatile uint8_t g_dma_busy_flag;
 extern volatile uint8_t g_start_acquisition_flag;
 extern volatile uint32_t g_udp_packets_sent_count;
+extern volatile uint32_t g_sample_count;
+extern volatile uint32_t g_lost_ticks_at_trigger;
+extern volatile uint32_t g_lost_ticks_posted;
+extern volatile uint32_t g_lost_ticks_folded;    // stm32f4xx_it.c
+extern volatile AdcProc_Stats g_adc_stats;
 
 #ifdef __cplusplus
 }
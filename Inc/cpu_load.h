@@ -0,0 +1,57 @@
+// Core/Inc/cpu_load.h
+
+#ifndef INC_CPU_LOAD_H_
+#define INC_CPU_LOAD_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#ifndef HOST_BUILD
+#include "main.h"
+#endif
+
+// ** 用户可配置 **
+#define CPU_LOAD_USE_WFI        0       // 1: 一轮主循环没有待处理的工作时执行WFI，直到下一个中断
+#define CPU_LOAD_WINDOW_MS      100     // 负载统计窗口; 报告值为各窗口的滑动平均 (权重1/4)
+#define CPU_LOAD_WORK_MARGIN    200     // 比该段的空转耗时多出这么多周期才算做了有效工作
+#define CPU_LOAD_HOST_HZ        168000000U
+
+// --- 主循环中的各段 (按调用顺序) ---
+typedef enum {
+    CPU_SUB_LWIP = 0,       // MX_LWIP_Process
+    CPU_SUB_ADC,            // ADC_Processing_Task (采集启动与数据发送)
+    CPU_SUB_TELEM,          // Telemetry_Poll
+    CPU_SUB_LOG,            // Log_Process 及串口状态块
+    CPU_SUB_COUNT
+} CpuSubsystem;
+
+// --- 统计 ---
+typedef struct {
+    uint32_t passes;                        // 主循环轮数
+    uint32_t idle_passes;                   // 其中各段都只是空转查询的轮数
+    uint32_t sleeps;                        // WFI次数
+    uint16_t load_permille;                 // 滑动平均负载 (有效工作时间 / 总时间)
+    uint16_t sub_permille[CPU_SUB_COUNT];   // 各段的滑动平均负载
+} CpuLoad_Stats;
+
+// --- 对外暴露的函数 ---
+// 只能在主循环中调用。每段结束时调用 CpuLoad_Account，一轮结束时调用 CpuLoad_EndPass
+void CpuLoad_Init(void);
+void CpuLoad_Account(uint32_t sub);
+void CpuLoad_EndPass(void);
+void CpuLoad_Sleep(void);
+const CpuLoad_Stats *CpuLoad_GetStats(void);
+
+#ifdef HOST_BUILD
+// 主机测试程序提供的模拟时钟 (CPU_LOAD_HOST_HZ 下的周期数) 和WFI
+uint64_t CpuLoad_HostCycles(void);
+void     CpuLoad_HostWfi(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_CPU_LOAD_H_ */
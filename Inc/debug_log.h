@@ -7,16 +7,55 @@ extern "C" {
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdint.h>
 
 // --- û ---
-#define LOG_BUFFER_SIZE 128 // ־ԸҪ
+#ifndef LOG_RING_WORDS
+#define LOG_RING_WORDS      1024    // ־λ (32λ֣Ϊ2); ÿ¼ռ 3 +  
+#endif
+#define LOG_MAX_ARGS        8       // ÿ־ֵ֧Ĳ
+#define LOG_OUTPUT_BINARY   0       // 1: Log_Process Ƽ¼PC Tools/log_decode.c ELFʽ
+#define LOG_BENCHMARK       0       // 1: ʱÿ־õ (Log_Benchmark)
+
+// ϱʱ HOST_BUILD: ʹC11ԭӲ LDREX/STREXʱȡ CLOCK_MONOTONIC
+
+// --- ־ (ÿͳƶ) ---
+#define LOG_LEVEL_ERROR     0
+#define LOG_LEVEL_WARN      1
+#define LOG_LEVEL_INFO      2
+#define LOG_LEVEL_DEBUG     3
+#define LOG_LEVEL_COUNT     4
 
 // --- ־¼ ---
+// κжȼѭͬʱ (߶)
+// ־ֻ¼ʽַָ롢ʱԭʼ32λʽƳٵ Log_Process
+// ע:
+//  - 32λڵָ (֧ float/double/uint64_t)
+//  - %s ַָ; ʱ ( ip4addr_ntoa ķֵ) ǰѱ
+#define Log_Error(format, ...)  Log_Write(LOG_LEVEL_ERROR, (format), LOG_NARGS(__VA_ARGS__), ##__VA_ARGS__)
+#define Log_Warn(format, ...)   Log_Write(LOG_LEVEL_WARN,  (format), LOG_NARGS(__VA_ARGS__), ##__VA_ARGS__)
+#define Log_Info(format, ...)   Log_Write(LOG_LEVEL_INFO,  (format), LOG_NARGS(__VA_ARGS__), ##__VA_ARGS__)
+#define Log_Debug1(format, ...) Log_Write(LOG_LEVEL_DEBUG, (format), LOG_NARGS(__VA_ARGS__), ##__VA_ARGS__)
 
 // жϻʱеĴе
-// ǳ죬ֻǽһַָ뻺
+// ǳ죬ֻǽһַָ뻺 (ԭʽ)
 void Log_Debug(const char* message);
-void Log_Debug1(const char *format, ...);
+
+void Log_Write(uint32_t level, const char *format, uint32_t nargs, ...);
+
+//  (0 ~ LOG_MAX_ARGS)
+#define LOG_NARGS(...)  LOG_NARGS_(_, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_NARGS_(_0, a1, a2, a3, a4, a5, a6, a7, a8, n, ...) n
+
+// ӵһ¼
+typedef struct {
+    uint32_t    level;
+    uint32_t    plain;      // 1:  Log_Debugformat ԭ
+    const char *format;
+    uint32_t    timestamp;  // ms
+    uint32_t    nargs;
+    uint32_t    args[LOG_MAX_ARGS];
+} LogRecord;
 
 
 // --- ϵͳɺ ---
@@ -28,6 +67,22 @@ void Log_Init(void);
 //  main  while(1) ѭг
 void Log_Process(void);
 
+// ȡһɵļ¼ (Ψһ; Log_Process ڲʹ)޼¼ʱ0
+int Log_Pop(LogRecord *rec);
+
+// 򻺳ļ¼
+uint32_t Log_GetDropped(uint32_t level);
+
+// ߹۲쵽Ķռ (32λ)
+uint32_t Log_GetHighWater(void);
+
+// Ƿδȡߵļ¼ (ѭжܷWFI)
+int Log_Pending(void);
+
+#if LOG_BENCHMARK
+void Log_Benchmark(void);
+#endif
+
 
 #ifdef __cplusplus
 }
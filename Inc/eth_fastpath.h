@@ -0,0 +1,54 @@
+// Core/Inc/eth_fastpath.h
+
+#ifndef INC_ETH_FASTPATH_H_
+#define INC_ETH_FASTPATH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+#include "lwip/udp.h"
+#include "lwip/err.h"
+
+// --- 帧格式常量 ---
+#define ETH_FAST_ETH_HDR_LEN    14      // 目的MAC + 源MAC + EtherType
+#define ETH_FAST_IP_HDR_LEN     20      // IPv4首部 (无选项)
+#define ETH_FAST_UDP_HDR_LEN    8       // UDP首部
+#define ETH_FAST_HDR_LEN        (ETH_FAST_ETH_HDR_LEN + ETH_FAST_IP_HDR_LEN + ETH_FAST_UDP_HDR_LEN) // 42字节
+
+// ** ARP刷新周期 **
+// 快速通道不经过 etharp_output，LwIP不会自动续期ARP表项，因此需要周期性主动查询
+#define ETH_FAST_ARP_REFRESH_MS 30000
+
+// --- 预构建的UDP帧头模板 ---
+typedef struct {
+    struct udp_pcb *pcb;                    // 提供源端口、TOS和TTL的UDP控制块
+    ip_addr_t dest_ip;                      // 目的IP (可为组播地址)
+    uint16_t dest_port;                     // 目的端口
+    uint8_t  hdr[ETH_FAST_HDR_LEN];         // 以太网/IP/UDP首部模板，校验和字段保持为0
+    uint16_t ip_id;                         // 下一个IP标识
+    uint8_t  ready;                         // 1: 目的MAC已解析，模板可用
+    uint32_t last_refresh_tick;             // 上一次主动ARP查询的时间
+} EthFast_Template;
+
+// --- 对外暴露的函数 ---
+void  EthFast_Init(EthFast_Template *tpl, struct udp_pcb *pcb,
+                   const ip_addr_t *dest_ip, uint16_t dest_port);
+void  EthFast_Poll(EthFast_Template *tpl);
+err_t EthFast_SendUdp(EthFast_Template *tpl, const void *hdr, uint16_t hdr_len,
+                      const void *payload, uint16_t len);
+err_t EthFast_SendRaw(const uint8_t *dst_mac, uint16_t ethertype,
+                      const void *hdr, uint16_t hdr_len,
+                      const void *payload, uint16_t len);
+
+static inline uint8_t EthFast_IsReady(const EthFast_Template *tpl)
+{
+    return tpl->ready;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_ETH_FASTPATH_H_ */
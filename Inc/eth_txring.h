@@ -0,0 +1,42 @@
+// Core/Inc/eth_txring.h
+
+#ifndef INC_ETH_TXRING_H_
+#define INC_ETH_TXRING_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+
+// ** 以太网中断优先级 **
+// 低于TIM2(0)、DMA2(1)和SPI1(1,1)，发送完成中断不会影响采集时序
+#define ETH_IRQ_PRIORITY        3
+
+// ** 发送环互斥 **
+// 发送完成中断会直接续发数据，因此主循环中所有可能访问发送描述符环的代码
+// (MX_LWIP_Process、数据发送、LwIP控制面发送)都必须在屏蔽以太网中断的情况下执行
+#define ETH_TX_LOCK()           NVIC_DisableIRQ(ETH_IRQn)
+#define ETH_TX_UNLOCK()         NVIC_EnableIRQ(ETH_IRQn)
+
+// --- 发送环占用统计 ---
+typedef struct {
+    uint32_t tx_complete_irqs;                  // 发送完成中断次数
+    uint32_t ring_full_events;                  // 发送前发现环已满的次数
+    uint8_t  max_in_flight;                     // 同时归DMA所有的最大描述符数
+    uint32_t occupancy_hist[ETH_TXBUFNB + 1];   // 每次发送前归DMA所有的描述符数的直方图
+} EthTxRing_Stats;
+
+extern volatile EthTxRing_Stats g_eth_tx_stats;
+
+// --- 对外暴露的函数 ---
+void    EthTxRing_Init(void);
+void    ETH_IRQHandler(void);   // 中断向量, 定义在 eth_txring.c 而不是CubeMX生成的 stm32f4xx_it.c
+uint8_t EthTxRing_InFlight(void);
+uint8_t EthTxRing_RecordOccupancy(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_ETH_TXRING_H_ */
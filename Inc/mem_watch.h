@@ -0,0 +1,42 @@
+// Core/Inc/mem_watch.h
+
+#ifndef INC_MEM_WATCH_H_
+#define INC_MEM_WATCH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+
+// ** 用户可配置 **
+#define MEM_WATCH_STACK_PATTERN 0xC5C5C5C5U // 栈涂色值
+#define MEM_WATCH_PAINT_GUARD   64          // 涂色时当前栈指针以下保留不涂的字节数
+#define MEM_WATCH_UNKNOWN       0xFFFFU     // 16位字段: 固件未启用对应的LwIP统计
+
+// --- 内存高水位 (上电以来) ---
+// LwIP的堆和内存池统计需要在 lwipopts.h 中打开 LWIP_STATS / MEM_STATS / MEMP_STATS，
+// 否则对应字段为0 (32位) 或 MEM_WATCH_UNKNOWN (16位)
+typedef struct {
+    uint32_t stack_size;            // 主栈涂色区大小 (_Min_Stack_Size, 字节)
+    uint32_t stack_peak;            // 涂色区中被写过的最大深度; 等于 stack_size 时栈可能已越界
+    uint32_t heap_size;             // LwIP堆 (MEM_SIZE)
+    uint32_t heap_peak;             // LwIP堆的最大占用
+    uint16_t pbuf_pool_size;        // PBUF_POOL_SIZE
+    uint16_t pbuf_pool_min_free;    // PBUF_POOL 的最少剩余
+    uint16_t memp_min_free;         // 其余各 memp 池中的最少剩余
+    uint8_t  memp_min_pool;         // 该池在 memp_t 中的序号
+    uint32_t mem_errors;            // 堆和各内存池的分配失败次数合计
+} MemWatch_Stats;
+
+// --- 对外暴露的函数 ---
+// MemWatch_Init 在 main 的最开始调用 (涂色之前已用到的深度不会被统计)
+void MemWatch_Init(void);
+void MemWatch_Update(void);
+const MemWatch_Stats *MemWatch_GetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_MEM_WATCH_H_ */
@@ -0,0 +1,79 @@
+// Core/Inc/profile.h
+
+#ifndef INC_PROFILE_H_
+#define INC_PROFILE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "stream_proto.h"
+#ifdef HOST_BUILD
+#include <time.h>
+#else
+#include "main.h"
+#endif
+
+// ** 用户可配置 **
+#ifndef USE_PROFILING
+#define USE_PROFILING       0           // 1: 统计各代码段的耗时周期数; 0: PROF_* 宏展开为空
+#endif
+#define PROF_CPU_HZ         168000000U  // 主机上把 CLOCK_MONOTONIC 换算为该频率下的周期数
+
+// --- 被测代码段 ---
+typedef enum {
+    PROF_TIM2_IRQ = 0,      // TIM2_IRQHandler (采样触发)
+    PROF_SPI_RX_CB,         // SPI1_DMA_RX_Callback (每个样本)
+    PROF_ADC_TASK,          // ADC_Processing_Task (含其中的发送)
+    PROF_SEND_UDP,          // SendWaveformDataViaUDP (主循环和发送完成中断两处调用)
+    PROF_REGION_COUNT
+} ProfRegion;
+
+typedef char prof_region_count_check[(PROF_REGION_COUNT == STREAM_PROF_REGIONS) ? 1 : -1];
+
+// --- 单个代码段的统计 ---
+// 耗时直方图: 第0格 <32 周期, 第i格 [2^(i+4), 2^(i+5)), 最后一格含更长的耗时
+typedef struct {
+    uint32_t count;
+    uint32_t min_cycles;        // 上次 Profile_ResetMinMax 以来
+    uint32_t max_cycles;
+    uint64_t total_cycles;      // 累计，除以 count 得平均值
+    uint32_t hist[STREAM_PROF_BINS];
+} Profile_Stats;
+
+// --- 周期计数器 ---
+static inline uint32_t Profile_Now(void)
+{
+#ifdef HOST_BUILD
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec) * (PROF_CPU_HZ / 1000000U) / 1000U);
+#else
+    return DWT->CYCCNT;
+#endif
+}
+
+// --- 测量宏 ---
+// 用法: PROF_BEGIN(PROF_SEND_UDP); ... PROF_END(PROF_SEND_UDP);  须在同一作用域内成对使用。
+// 测得的是墙钟周期数，包含期间被更高优先级中断占用的时间。
+#if USE_PROFILING
+#define PROF_BEGIN(region)  uint32_t prof_start_##region = Profile_Now()
+#define PROF_END(region)    Profile_Record((region), Profile_Now() - prof_start_##region)
+#else
+#define PROF_BEGIN(region)  do { } while (0)
+#define PROF_END(region)    do { } while (0)
+#endif
+
+// --- 对外暴露的函数 ---
+void Profile_Init(void);
+void Profile_Record(uint32_t region, uint32_t cycles);
+void Profile_ResetMinMax(void);
+void Profile_Snapshot(StreamProfile *report);
+void Profile_Print(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_PROFILE_H_ */
@@ -216,8 +216,18 @@
 /* Definition of the Ethernet driver buffers size and count */
 #define ETH_RX_BUF_SIZE                ETH_MAX_PACKET_SIZE /* buffer size for receive               */
 #define ETH_TX_BUF_SIZE                ETH_MAX_PACKET_SIZE /* buffer size for transmit              */
+/* Descriptor ring depths can be overridden from the build (-DETH_TXBUFNB=16U). The Tx/Rx
+   buffers (Tx_Buff/Rx_Buff in ethernetif.c) must fit ETH_DMA_BUF_BUDGET bytes of SRAM;
+   this is checked at compile time in eth_txring.c */
+#ifndef ETH_RXBUFNB
 #define ETH_RXBUFNB                    4U       /* 4 Rx buffers of size ETH_RX_BUF_SIZE  */
-#define ETH_TXBUFNB                    4U       /* 4 Tx buffers of size ETH_TX_BUF_SIZE  */
+#endif
+#ifndef ETH_TXBUFNB
+#define ETH_TXBUFNB                    8U       /* 8 Tx buffers of size ETH_TX_BUF_SIZE  */
+#endif
+#ifndef ETH_DMA_BUF_BUDGET
+#define ETH_DMA_BUF_BUDGET             (20U * 1024U) /* SRAM reserved for Tx + Rx DMA buffers */
+#endif
 
 /* Section 2: PHY configuration section */
 
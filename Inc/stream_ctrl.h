@@ -0,0 +1,89 @@
+// Core/Inc/stream_ctrl.h
+
+#ifndef INC_STREAM_CTRL_H_
+#define INC_STREAM_CTRL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+#include "adc_processing.h"
+#include "eth_fastpath.h"
+#include "lwip/udp.h"
+
+// 默认PC是否有可用信用 (未启用流控时恒为1)
+extern volatile uint8_t g_pc_ready_for_data;
+
+// ** 订阅表容量 ** (含默认PC)
+#define STREAM_MAX_SUBSCRIBERS  4
+
+// ** 订阅目的地址 **
+// 任何主机都能向控制端口发请求，允许任意目的地址时，一个小请求就能让板子向第三方持续发送
+// 约0.4MB/s的数据流 (反射放大)。默认只接受请求方自己的源地址 (端口不限)。
+// 源地址仍可伪造，只在受控的采集网络中放宽。
+#define STREAM_DEST_POLICY_SELF         0   // 只能是请求的源地址
+#define STREAM_DEST_POLICY_MULTICAST    1   // 另外允许组播地址 (stream_sub_tool rx 的组播组)
+#define STREAM_DEST_POLICY_ANY          2   // 任意地址 (stream_sub_tool sub 代他人订阅)
+#ifndef STREAM_DEST_POLICY
+#define STREAM_DEST_POLICY              STREAM_DEST_POLICY_SELF
+#endif
+
+// --- 订阅者 ---
+// req_* 由控制端口修改，在下一个乒乓块开始时 (StreamCtrl_Commit) 才生效，
+// 保证一个块内各订阅者的数据连续
+typedef struct {
+    ip_addr_t ip;                   // 目的地址 (可为组播地址)
+    uint16_t  port;
+    uint8_t   raw;                  // 1: 无包头的原始格式 (默认PC)
+    uint8_t   active;               // 当前块是否发送
+    uint8_t   channel_mask;
+    uint8_t   decimation;
+    uint8_t   req_active;
+    uint8_t   req_channel_mask;
+    uint8_t   req_decimation;
+    uint32_t  seq;                  // 下一个包序号
+    uint32_t  send_errors;          // 被丢弃的包数 (非暂时性错误)
+    uint8_t   credit_enabled;       // 1: 处于信用流控状态
+    uint32_t  credit_limit;         // 只发送 seq < credit_limit 的包
+    uint32_t  last_grant_tick;      // 上一次收到授予的时间
+    uint32_t  blocks_dropped;       // 因信用不足或调速 (STREAM_GOV_SKIP_RAW) 被跳过的块数
+    uint8_t   block_decimation;     // 当前块实际使用的抽取因子 (含调速和信用降级)
+    uint8_t   rate_changed;         // 1: 当前块的抽取因子与上一块不同
+    uint8_t   timestamps;           // 1: 数据包带 StreamTimeExt (STREAM_SUB_OPT_TIME)
+#if USE_ETH_FASTPATH
+    EthFast_Template tpl;
+#endif
+} StreamSubscriber;
+
+// --- 相同通道子集和抽取因子的订阅者组成一组，每个包只组装一次 ---
+typedef struct {
+    uint8_t  channel_mask;
+    uint8_t  decimation;
+    uint8_t  raw;
+    uint8_t  frame_bytes;           // 每帧字节数 = 通道数 * 2
+    uint16_t frames;                // 每块(抽取后)的帧数
+    uint16_t frames_per_packet;
+    uint16_t packets;               // 每块的包数
+    uint8_t  n_members;
+    uint8_t  members[STREAM_MAX_SUBSCRIBERS];   // 订阅表下标
+} StreamGroup;
+
+// --- 对外暴露的函数 ---
+void StreamCtrl_Init(struct udp_pcb *data_pcb, const ip_addr_t *default_ip, uint16_t default_port);
+void StreamCtrl_Poll(void);
+uint8_t StreamCtrl_Commit(uint8_t gov_level, uint8_t raw_send);
+uint8_t StreamCtrl_RawActive(void);
+uint32_t StreamCtrl_RawBlocksSkipped(void);
+
+uint8_t            StreamCtrl_GroupCount(void);
+const StreamGroup *StreamCtrl_Group(uint8_t idx);
+StreamSubscriber  *StreamCtrl_Subscriber(uint8_t idx);
+uint16_t           StreamCtrl_Assemble(const StreamGroup *grp, const uint16_t *block, uint16_t packet,
+                                       const uint8_t **payload);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_STREAM_CTRL_H_ */
@@ -0,0 +1,60 @@
+// Core/Inc/stream_governor.h
+//
+// 背压调速器。只依赖 <stdint.h>，时间由调用方传入，
+// 可直接在Linux主机上编译 (见 Tools/governor_sim.c)。
+
+#ifndef INC_STREAM_GOVERNOR_H_
+#define INC_STREAM_GOVERNOR_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// ** 调速参数 **
+#define STREAM_GOV_MAX_LEVEL        4       // 最多降到 1/16 速率 (抽取因子 x16)
+#define STREAM_GOV_HIGH_PCT         75      // 一块从就绪到发送环排空的耗时超过块周期的此比例则降一级
+#define STREAM_GOV_LOW_PCT          30      // 连续 STREAM_GOV_RECOVER_BLOCKS 块低于此比例则升一级
+                                            // (须小于 HIGH/2，否则升级后立即又会降级)
+#define STREAM_GOV_RECOVER_BLOCKS   16
+#define STREAM_GOV_FAIL_LIMIT       8       // 一块内pbuf/udp_send失败达到此次数也视为拥塞
+
+// 采集中断 (DMA2, 优先级1) 可以抢占发送完成中断和主循环，只写标为 [采集] 的计数，
+// 其余字段只在发送一侧 (以太网中断或屏蔽以太网中断的主循环) 读写，
+// 发送一侧在 StreamGov_BlockStart / StreamGov_TxDrained 中处理新增的计数
+typedef struct {
+    uint8_t  level;             // 当前级别: 抽取因子额外乘以 2^level
+    uint8_t  pending_down;      // 采集端已丢块，下次评估时无条件降级
+    uint8_t  awaiting_drain;    // 当前块已全部交给发送环，等待环排空后评估
+    uint8_t  calm_blocks;       // 连续低负载的块数
+    uint8_t  last_util_pct;     // 上一块从就绪到发送环排空的耗时 / 块周期
+    uint8_t  window;            // 评估窗口的块数: 默认PC流参与调速时为 2^level，否则为1
+    uint8_t  window_done;       // 窗口内已评估的块数
+    uint32_t window_util;       // 窗口内各块负载之和 (%)
+    uint32_t block_period_ms;
+    uint32_t ready_tick;        // 当前块交给发送任务的时间
+    uint32_t fail_count;        // 当前块的发送失败次数
+    uint32_t steps_down;
+    uint32_t steps_up;
+    volatile uint32_t blocks_ready;     // [采集] 交给发送任务的块数
+    volatile uint32_t ready_tick_post;  // [采集] 最近一块交给发送任务的时间 (先于 blocks_ready 写入)
+    volatile uint32_t blocks_dropped;   // [采集] 采集端整块丢弃的次数
+    uint32_t ready_seen;        // 已处理的 blocks_ready
+    uint32_t dropped_seen;      // 已处理的 blocks_dropped
+} StreamGov;
+
+// --- 对外暴露的函数 ---
+void    StreamGov_Init(StreamGov *gov, uint32_t block_period_ms);
+void    StreamGov_BlockReady(StreamGov *gov, uint32_t now_ms);
+void    StreamGov_BlockDropped(StreamGov *gov);
+uint8_t StreamGov_BlockStart(StreamGov *gov, uint8_t raw_governed, uint8_t *raw_send);
+void    StreamGov_SendFailed(StreamGov *gov);
+void    StreamGov_BlockSent(StreamGov *gov);
+void    StreamGov_TxDrained(StreamGov *gov, uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_STREAM_GOVERNOR_H_ */
@@ -0,0 +1,296 @@
+// Core/Inc/stream_proto.h
+//
+// 固件与PC端工具(Tools/)共用的波形数据流线路格式和控制端口协议定义。
+// 本文件只依赖 <stdint.h>，可直接在Linux主机上编译。
+
+#ifndef INC_STREAM_PROTO_H_
+#define INC_STREAM_PROTO_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// ** 数据块 **
+// 采集按乒乓块发送: 每块 STREAM_FRAMES_PER_BLOCK 帧，每帧按通道0~7交织 (uint16_t, 小端)。
+// 固件的 CHANNELS_PER_SAMPLE / SAMPLES_PER_CHANNEL / UDP_PAYLOAD_SIZE / RAW_ETH_PAYLOAD_SIZE /
+// ADC_SAMPLE_RATE_HZ / BLOCK_PERIOD_MS 由这里定义，PC端工具直接使用这些常量，不另行声明。
+#define STREAM_CHANNELS         8       // 每帧通道数 (ADS8688自动扫描)
+#define STREAM_FRAMES_PER_BLOCK 1024    // 每块帧数 (每通道样本数)
+#define STREAM_BLOCK_SAMPLES    (STREAM_CHANNELS * STREAM_FRAMES_PER_BLOCK)
+#define STREAM_BLOCK_BYTES      (STREAM_BLOCK_SAMPLES * 2)
+#define STREAM_SAMPLE_RATE_HZ   210000  // 标称的TIM2触发频率 (每秒转换数, 各通道之和; 见 tim.c)
+#define STREAM_BLOCK_PERIOD_MS  ((uint32_t)STREAM_BLOCK_SAMPLES * 1000U / STREAM_SAMPLE_RATE_HZ) // 一块的时长 (取整, 39)
+// UDP包的最大净荷: 默认PC的无包头原始流把一块切成 11 x 1440 + 544 字节
+#define STREAM_UDP_CHUNK_SIZE   1440
+#define STREAM_UDP_PACKETS_PER_BLOCK ((STREAM_BLOCK_BYTES + STREAM_UDP_CHUNK_SIZE - 1) / STREAM_UDP_CHUNK_SIZE)
+#define STREAM_UDP_LAST_CHUNK_SIZE   (STREAM_BLOCK_BYTES - (STREAM_UDP_PACKETS_PER_BLOCK - 1) * STREAM_UDP_CHUNK_SIZE)
+// 二层帧的最大净荷: 8字节流包头 + 1488 = 1496 <= 1500 (MTU)
+#define STREAM_L2_CHUNK_SIZE    1488
+
+// ** 原始以太网(二层)模式 **
+// 0x88B5 为IEEE 802保留的本地实验用EtherType，只适用于专用的点对点采集网络
+#define STREAM_ETHERTYPE        0x88B5
+#define STREAM_PROTO_VERSION    1
+
+// 标志位
+#define STREAM_FLAG_BLOCK_END   0x01    // 本包是一个乒乓块的最后一包
+#define STREAM_FLAG_RATE_CHANGE 0x02    // 本块的抽取因子与该订阅者的上一块不同 (块内每包都置位)
+#define STREAM_FLAG_GAP         0x04    // 本包覆盖的样本中有采样时钟缺口 (见 StreamGapExt)
+#define STREAM_FLAG_TIME        0x08    // 包头之后带 StreamTimeExt (订阅时请求 STREAM_SUB_OPT_TIME)
+
+// --- 二层模式的最小包头 (紧跟在14字节以太网首部之后) ---
+// 所有多字节字段为小端序，与采样数据一致
+typedef struct __attribute__((packed)) {
+    uint8_t  version;       // STREAM_PROTO_VERSION
+    uint8_t  flags;         // STREAM_FLAG_*
+    uint16_t seq;           // 包序号，每包+1，回绕
+    uint16_t block;         // 采集块序号，回绕; 跳变表示整块被丢弃
+    uint16_t offset;        // 本包负载在块内的字节偏移
+} StreamL2Header;           // 8字节
+
+// ** UDP订阅流 **
+// 通过控制端口订阅的目的地址收到带包头的数据包；默认PC(DEST_IP_ADDR:DEST_PORT)
+// 仍收到无包头的原始数据，与原有接收程序兼容
+#define STREAM_UDP_MAGIC        0x5AA5
+
+// --- 订阅流包头 (UDP负载的开头) ---
+// 负载为若干采样帧，每帧按通道号升序包含 channel_mask 中的各通道 (uint16_t, 小端)
+typedef struct __attribute__((packed)) {
+    uint16_t magic;         // STREAM_UDP_MAGIC
+    uint8_t  version;       // STREAM_PROTO_VERSION
+    uint8_t  flags;         // STREAM_FLAG_*
+    uint32_t seq;           // 本订阅者的包序号，每包+1
+    uint32_t block;         // 采集块序号; 跳变表示整块被丢弃(采集背压或信用不足)
+    uint16_t frame_offset;  // 本包第一帧在(抽取后)块内的帧序号
+    uint8_t  channel_mask;  // bit n = 通道n
+    uint8_t  decimation;    // 抽取因子: 每 decimation 帧取1帧
+} StreamUdpHeader;          // 16字节
+
+// --- 采样时钟缺口 ---
+// TIM2触发时上一次SPI传输尚未完成(或SPI过载/DMA出错)，该时钟周期没有产生样本，
+// 之后的样本按时间顺延，接收端按固定采样率插值的时间戳会偏移。
+// 置 STREAM_FLAG_GAP 的UDP订阅包在包头之后、负载之前带一个 StreamGapExt，列出本包覆盖的
+// 原始样本范围 [frame_offset*decimation*8, (frame_offset+帧数)*decimation*8) 内的缺口。
+// 样本序号按块内未抽取的交织顺序计 (帧 * 8 + 通道)，与订阅的通道和抽取因子无关。
+// 二层包头没有空间携带缺口表，二层模式下只置标志位。
+#define STREAM_GAP_MAX          3
+
+typedef struct __attribute__((packed)) {
+    uint16_t sample;        // 缺口后的第一个样本在块内的序号
+    uint16_t missed;        // 该样本之前缺失的采样时钟数 (饱和于0xFFFF)
+} StreamGap;
+
+typedef struct __attribute__((packed)) {
+    uint8_t  count;         // 列出的缺口数 (0 ~ STREAM_GAP_MAX)
+    uint8_t  overflow;      // 1: 本包范围内还有未列出的缺口 (固件每块最多记录 ADC_GAP_TABLE_SIZE 个)
+    uint16_t missed_total;  // 已知位于本包范围内的缺失采样时钟总数, 含未列出的 (饱和于0xFFFF)
+    StreamGap gap[STREAM_GAP_MAX];
+} StreamGapExt;             // 16字节
+
+// --- 时间戳 ---
+// 以 STREAM_SUB_OPT_TIME 订阅的接收端在包头之后收到 StreamTimeExt (STREAM_FLAG_TIME)。
+// 时间为板子时钟的64位微秒计数，与PC时钟的偏差和频差由 STREAM_CMD_TIME 交换估计。
+// 块内原始样本 s (交织序号, 0 ~ 块长-1) 的采集时刻约为 block_start_us + s * block_span_us / (块长-1)。
+// 两种扩展同时存在时缺口表在前; 固件为不超过MTU，带缺口表的包不带时间戳。
+typedef struct __attribute__((packed)) {
+    uint64_t block_start_us;    // 块内第一个样本的SPI/DMA完成时刻
+    uint32_t block_span_us;     // 第一个到最后一个样本的时间
+    uint32_t handoff_us;        // 本包交给以太网 (快速通道或LwIP) 的时刻, 相对 block_start_us
+} StreamTimeExt;            // 16字节
+
+// ** 控制端口 **
+// 请求和应答均为单个UDP包; 应答发回请求的源地址和端口
+#define STREAM_CTRL_PORT        5002
+
+#define STREAM_CMD_SUBSCRIBE    0x01    // 新增订阅; 目的地址已存在时更新其通道和抽取因子
+#define STREAM_CMD_UNSUBSCRIBE  0x02
+#define STREAM_CMD_LIST         0x03    // 应答后随 count 个 StreamSubInfo
+#define STREAM_CMD_CREDIT       0x04    // StreamCtrlCredit, 无应答
+#define STREAM_CMD_TIME         0x05    // StreamCtrlTime, 应答 StreamCtrlTimeReply
+#define STREAM_CMD_REPLY        0x80    // 应答的cmd = 请求的cmd | STREAM_CMD_REPLY
+
+#define STREAM_STATUS_OK            0
+#define STREAM_STATUS_BAD_ARG       1   // 通道掩码为0、抽取因子不是2的幂、对无包头的默认PC表项请求子集/抽取/时间戳等
+#define STREAM_STATUS_FULL          2   // 订阅表已满
+#define STREAM_STATUS_NOT_FOUND     3
+#define STREAM_STATUS_UNSUPPORTED   4   // 未知命令，或二层模式下不支持订阅
+#define STREAM_STATUS_DENIED        5   // 目的地址不是请求的源地址 (固件的 STREAM_DEST_POLICY)
+
+#define STREAM_SUB_OPT_TIME     0x01    // 订阅选项: 数据包带 StreamTimeExt
+
+typedef struct __attribute__((packed)) {
+    uint8_t  cmd;           // STREAM_CMD_*
+    uint8_t  channel_mask;
+    uint8_t  decimation;
+    uint8_t  options;       // STREAM_SUB_OPT_* (订阅时有效，其余命令为0)
+    uint8_t  dest_ip[4];    // 0.0.0.0 表示使用请求的源地址; 其他地址和组播地址须固件允许 (STREAM_DEST_POLICY)
+    uint16_t dest_port;     // 0 表示使用请求的源端口
+} StreamCtrlRequest;        // 10字节
+
+// --- 信用授予 ---
+// 授予的是累计上限而不是增量，授予包丢失或重复都不会使窗口错乱，接收端只需周期性重发。
+// 订阅者收到第一个授予后进入流控状态; STREAM_CREDIT_TIMEOUT_MS 内无授予则退出流控
+typedef struct __attribute__((packed)) {
+    uint8_t  cmd;           // STREAM_CMD_CREDIT
+    uint8_t  reserved[3];
+    uint8_t  dest_ip[4];    // 订阅的目的地址，含义同 StreamCtrlRequest
+    uint16_t dest_port;
+    uint32_t seq_limit;     // 固件只发送 seq < seq_limit 的包
+} StreamCtrlCredit;         // 14字节
+
+typedef struct __attribute__((packed)) {
+    uint8_t  cmd;
+    uint8_t  status;        // STREAM_STATUS_*
+    uint8_t  count;         // 后随的 StreamSubInfo 个数
+    uint8_t  reserved;
+} StreamCtrlReply;          // 4字节
+
+// --- 时钟偏差交换 ---
+// PC在 t1 (PC时钟) 发出请求，板子在控制端口回调开始时记下 t2、发送应答前记下 t3 (板子时钟)，
+// PC在 t4 收到应答。偏差 = ((t2 - t1) + (t3 - t4)) / 2，误差不超过 (t4 - t1 - (t3 - t2)) / 2;
+// PC取往返时间最短的若干次交换拟合偏差和频差。t2 含主循环轮询LwIP的延迟，最短往返的样本中最小。
+typedef struct __attribute__((packed)) {
+    uint8_t  cmd;           // STREAM_CMD_TIME
+    uint8_t  reserved[3];
+    uint64_t t1;            // PC发送时刻, 原样返回 (单位由PC决定)
+} StreamCtrlTime;           // 12字节
+
+typedef struct __attribute__((packed)) {
+    uint8_t  cmd;           // STREAM_CMD_TIME | STREAM_CMD_REPLY
+    uint8_t  status;
+    uint8_t  reserved[2];
+    uint64_t t1;
+    uint64_t t2_us;         // 板子收到请求的时刻
+    uint64_t t3_us;         // 板子发出应答的时刻
+} StreamCtrlTimeReply;      // 28字节
+
+#define STREAM_SUB_FLAG_RAW     0x01    // 无包头的原始格式 (默认PC)
+#define STREAM_SUB_FLAG_CREDIT  0x02    // 处于信用流控状态
+#define STREAM_SUB_FLAG_TIME    0x04    // 数据包带时间戳
+
+typedef struct __attribute__((packed)) {
+    uint8_t  dest_ip[4];
+    uint16_t dest_port;
+    uint8_t  channel_mask;
+    uint8_t  decimation;
+    uint8_t  flags;         // STREAM_SUB_FLAG_*
+    uint8_t  reserved[3];
+    uint32_t seq;           // 下一个包序号
+    uint32_t seq_limit;     // 当前信用上限 (流控状态下有效)
+    uint32_t blocks_dropped;// 因信用不足被跳过的块数
+} StreamSubInfo;            // 24字节
+
+// ** 遥测 **
+// 固件每 TELEMETRY_PERIOD_MS 发送一个 StreamTelemetry，默认发往 DEST_IP_ADDR:STREAM_TELEM_PORT;
+// 发往固件 STREAM_TELEM_PORT 的 StreamTelemRegister 把目的地址改为该包的源地址和端口。
+// 不带 STREAM_TELEM_REG_MAGIC 的包被忽略，源地址须为默认PC (除非固件的 TELEMETRY_REG_POLICY 放开)。
+// 计数器为上电以来的累计值 (回绕)，接收端按差值计算速率; 标注"本周期"的字段每包重新统计
+#define STREAM_TELEM_PORT       5004
+#define STREAM_TELEM_MAGIC      0x54E1
+#define STREAM_TELEM_REG_MAGIC  0x54E2
+#define STREAM_TELEM_VERSION    4
+#define STREAM_TELEM_CPU_UNKNOWN 0xFFFF
+// TIM2中断入口延迟直方图 (单位: 定时器周期, 1/84MHz): 第0格 <8, 第i格 [2^(i+2), 2^(i+3)), 最后一格 >=512
+#define STREAM_TELEM_LAT_BINS   8
+// 主循环单轮耗时直方图 (us): 第i格 [2^i, 2^(i+1))，第0格含0，最后一格含更长的停顿
+#define STREAM_TELEM_LOOP_BINS  16
+// 主循环各段: LwIP, 采集与发送, 遥测, 日志
+#define STREAM_TELEM_CPU_SUBS   4
+// 内存高水位中的16位字段: 固件未启用对应的LwIP统计
+#define STREAM_TELEM_MEM_UNKNOWN 0xFFFF
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;             // STREAM_TELEM_MAGIC
+    uint8_t  version;           // STREAM_TELEM_VERSION
+    uint8_t  reserved;
+    uint32_t seq;               // 遥测包序号
+    uint32_t uptime_ms;
+    // 采集
+    uint32_t samples;           // 已采集的采样点总数 (含被丢弃块中的)
+    uint32_t blocks_acquired;   // 已采满的块数 (含被丢弃的块)
+    uint32_t blocks_dropped;    // 采集端整块丢弃的块数
+    uint32_t tim2_skips;        // TIM2触发时上一次SPI传输仍未完成而跳过的采样
+    uint32_t spi_overruns;
+    uint32_t spi_dma_errors;
+    // 发送
+    uint32_t packets_sent;
+    uint32_t pbuf_failures;     // pbuf_alloc 失败
+    uint32_t send_errors;       // udp_sendto 失败
+    uint32_t eth_ring_full;     // 发送前发现以太网发送环已满
+    uint32_t eth_tx_irqs;
+    // 队列
+    uint8_t  eth_ring_depth;    // ETH_TXBUFNB
+    uint8_t  eth_ring_max;      // 发送环峰值占用
+    uint8_t  gov_level;         // 背压调速级别
+    uint8_t  gov_util_pct;      // 上一块发送耗时占块周期的比例
+    uint16_t log_ring_max;      // 日志环峰值占用 (32位字)
+    uint16_t console_max;       // 串口输出缓冲区峰值占用 (字节)
+    uint32_t log_dropped;       // 各级别合计
+    uint32_t console_dropped;   // 字节
+    // 负载与延迟
+    uint16_t cpu_load_permille; // 主循环有效工作时间占比 (滑动平均); STREAM_TELEM_CPU_UNKNOWN 表示未测量
+    uint16_t tim2_lat_max;      // TIM2中断入口延迟最大值 (定时器周期)
+    uint32_t loop_max_us;       // 本周期主循环单轮最长耗时
+    uint32_t tim2_lat_hist[STREAM_TELEM_LAT_BINS];
+    uint32_t loop_hist[STREAM_TELEM_LOOP_BINS];
+    // 主循环负载 (版本2)
+    uint16_t cpu_sub_permille[STREAM_TELEM_CPU_SUBS];
+    uint32_t loop_passes;       // 主循环轮数
+    uint32_t loop_idle_passes;  // 其中只做了空转查询的轮数
+    // 内存高水位 (版本3, 上电以来)
+    uint32_t stack_size;        // 主栈涂色区大小 (字节)
+    uint32_t stack_peak;        // 最大栈深度; 等于 stack_size 时栈可能已越界
+    uint32_t lwip_heap_size;    // 未启用 MEM_STATS 时为0
+    uint32_t lwip_heap_peak;
+    uint16_t pbuf_pool_size;    // 以下三项未启用 MEMP_STATS 时为 STREAM_TELEM_MEM_UNKNOWN
+    uint16_t pbuf_pool_min_free;
+    uint16_t memp_min_free;     // 其余各 memp 池中的最少剩余
+    uint8_t  memp_min_pool;     // 该池在固件 memp_t 中的序号
+    uint8_t  reserved2;
+    uint32_t mem_errors;        // LwIP堆和内存池分配失败合计
+    uint16_t log_ring_words;    // 日志环容量 (与 log_ring_max 对照)
+    uint16_t pp_block_samples;  // 乒乓缓冲块长
+    uint32_t pp_fill_peak;      // 一块发送完成时下一块已采集的最大样本数; 等于块长表示发生过丢块
+    // 调速 (版本4)
+    uint32_t raw_blocks_skipped; // 无包头的默认PC流被调速整块跳过的块数 (STREAM_GOV_SKIP_RAW，流中没有标记)
+} StreamTelemetry;              // 232字节
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;             // STREAM_TELEM_REG_MAGIC
+    uint8_t  version;           // 接收端理解的 STREAM_TELEM_VERSION (固件不检查)
+    uint8_t  reserved;
+} StreamTelemRegister;          // 4字节
+
+// ** 代码段耗时报告 **
+// 固件启用 USE_PROFILING 时，每个遥测包之后在同一端口再发一个 StreamProfile。
+// count/total_cycles/hist 为累计值; min/max 为本周期的值 (本周期没有执行时 count 不变, min 为 0xFFFFFFFF)
+#define STREAM_PROF_MAGIC       0x50F1
+#define STREAM_PROF_VERSION     1
+#define STREAM_PROF_REGIONS     4   // TIM2中断, SPI接收回调, ADC_Processing_Task, SendWaveformDataViaUDP
+#define STREAM_PROF_BINS        16  // 第0格 <32 周期, 第i格 [2^(i+4), 2^(i+5))
+
+typedef struct __attribute__((packed)) {
+    uint32_t count;
+    uint32_t min_cycles;
+    uint32_t max_cycles;
+    uint64_t total_cycles;
+    uint32_t hist[STREAM_PROF_BINS];
+} StreamProfileRegion;          // 84字节
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;             // STREAM_PROF_MAGIC
+    uint8_t  version;           // STREAM_PROF_VERSION
+    uint8_t  n_regions;         // STREAM_PROF_REGIONS
+    uint32_t seq;               // 与同一周期的遥测包序号相同
+    uint32_t cpu_hz;            // 周期计数器频率
+    uint32_t sample_rate_hz;    // 采样率 (每个样本的周期预算 = cpu_hz / sample_rate_hz)
+    StreamProfileRegion region[STREAM_PROF_REGIONS];
+} StreamProfile;                // 352字节
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_STREAM_PROTO_H_ */
@@ -0,0 +1,34 @@
+// Core/Inc/telemetry.h
+
+#ifndef INC_TELEMETRY_H_
+#define INC_TELEMETRY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+#include "stream_proto.h"
+
+// ** 用户可配置 **
+#define TELEMETRY_PERIOD_MS     1000    // 遥测包发送周期
+#define TELEMETRY_UART_STATUS   0       // 1: 同时在串口输出原来的文本状态块 (每5秒)
+
+// 遥测登记 (StreamTelemRegister) 接受哪些源地址
+#define TELEMETRY_REG_DEFAULT_PC    0   // 只接受默认PC (DEST_IP_ADDR)，端口不限
+#define TELEMETRY_REG_ANY           1   // 任意源地址 (仍须带 STREAM_TELEM_REG_MAGIC)
+#ifndef TELEMETRY_REG_POLICY
+#define TELEMETRY_REG_POLICY        TELEMETRY_REG_DEFAULT_PC
+#endif
+
+// --- 对外暴露的函数 ---
+void Telemetry_Init(void);
+void Telemetry_LoopTick(void);
+void Telemetry_Poll(void);
+const StreamTelemetry *Telemetry_Last(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_TELEMETRY_H_ */
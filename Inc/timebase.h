@@ -0,0 +1,56 @@
+// Core/Inc/timebase.h
+
+#ifndef INC_TIMEBASE_H_
+#define INC_TIMEBASE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#ifdef HOST_BUILD
+#include <time.h>
+#else
+#include "main.h"
+#endif
+
+// --- 64位微秒时间戳 (板子时钟) ---
+// HAL毫秒计数 + SysTick当前计数值，毫秒计数回绕时 SysTick_Handler 递增高32位，不会回绕。
+// 任何优先级的中断和主循环中都可调用; SysTick优先级最低，调用时其中断可能尚未执行，
+// 由 PENDSTSET 判断计数器是否已经回绕。精度取决于系统时钟 (HSI约1%)，PC端须估计频差。
+#ifndef HOST_BUILD
+extern volatile uint32_t g_timebase_ms_hi;  // 毫秒计数的高32位 (stm32f4xx_it.c)
+#endif
+
+static inline uint64_t Timebase_NowUs(void)
+{
+#ifdef HOST_BUILD
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000U + (uint64_t)ts.tv_nsec / 1000U;
+#else
+    uint32_t hi, ms, val, pending;
+    uint64_t ms64;
+
+    do {
+        hi      = g_timebase_ms_hi;
+        ms      = HAL_GetTick();
+        val     = SysTick->VAL;
+        pending = SCB->ICSR & SCB_ICSR_PENDSTSET_Msk;
+    } while (ms != HAL_GetTick() || hi != g_timebase_ms_hi);
+
+    ms64 = ((uint64_t)hi << 32) | ms;
+    // 读 VAL 之前已回绕 (VAL 接近重装值) 但中断尚未执行
+    if (pending && val > (SysTick->LOAD >> 1))
+    {
+        ms64++;
+    }
+    return ms64 * 1000U + (SysTick->LOAD - val) / (SystemCoreClock / 1000000U);
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_TIMEBASE_H_ */
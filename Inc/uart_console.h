@@ -0,0 +1,39 @@
+// Core/Inc/uart_console.h
+
+#ifndef INC_UART_CONSOLE_H_
+#define INC_UART_CONSOLE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "main.h"
+
+// ** 用户可配置 **
+#define USE_UART_DMA_CONSOLE        1       // 0: fputc 恢复为逐字符阻塞发送 (用于对比主循环停顿)
+#define UART_CONSOLE_BUF_SIZE       2048    // 输出环形缓冲区大小 (字节，须为2的幂)
+#define UART_CONSOLE_IRQ_PRIORITY   4       // 低于以太网(3)，串口输出不会推迟数据发送
+
+// --- 控制台统计 ---
+typedef struct {
+    uint32_t bytes_dropped;     // 缓冲区满时丢弃的字节数
+    uint32_t dma_transfers;     // 启动的DMA传输次数
+    uint32_t dma_errors;        // DMA传输错误次数
+    uint16_t max_used;          // 缓冲区最大占用 (字节)
+} UartConsole_Stats;
+
+extern volatile UartConsole_Stats g_console_stats;
+
+// --- 对外暴露的函数 ---
+// 只能在主循环中调用 Putc/Write (单生产者)，DMA中断是唯一的消费者
+void     UartConsole_Init(void);
+void     UartConsole_Putc(uint8_t ch);
+uint16_t UartConsole_Write(const uint8_t *data, uint16_t len);
+void     UartConsole_DmaIRQHandler(void);
+void     DMA2_Stream7_IRQHandler(void);  // 中断向量, 定义在 uart_console.c 而不是CubeMX生成的 stm32f4xx_it.c
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_UART_CONSOLE_H_ */
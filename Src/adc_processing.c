@@ -17,6 +17,20 @@
  * 4. 将SRAM中转缓冲区内的数据打包成UDP包，交给LwIP发送。
  * 5. LwIP从SRAM中获取数据，因此以太网DMA可以正常访问并执行**硬件校验和卸载**。
  * 6. 循环此过程，直到CCMRAM中的整个大缓冲区被发送完毕。
+ * - **多目的地址**: 默认PC之外的接收端可通过控制端口订阅通道子集和抽取因子
+ * (见 stream_ctrl.c)。相同子集的订阅者共用一次组装，块内按组、包、成员的顺序发送。
+ * - **背压调速**: 发送跟不上时由调速器逐级提高带包头订阅流的抽取因子，
+ * 代替整块丢弃 (见 stream_governor.c)。
+ * - **采样时钟缺口**: 没有产生样本的TIM2周期 (DMA仍忙、SPI过载、DMA错误) 计入 lost_ticks。
+ * lost_ticks 只由TIM2中断写入，本文件的采集回调把它们的计数累加到 g_lost_ticks_posted，
+ * 由TIM2中断在下一个周期并入。TIM2中断接受一次触发时记下当时的 lost_ticks，该样本存入时把与上一个样本之间的差值
+ * 记入该块的缺口表 (DMA忙而跳过的周期都发生在正在传输的样本之后，只能计入下一个样本之前)，
+ * 发送时放进覆盖该样本的订阅包 (STREAM_FLAG_GAP + StreamGapExt)，接收端据此插入空值或修正时间戳。
+ * - **时间戳**: 每块记下第一个样本和最后一个样本存入的时刻 (64位微秒, 见 timebase.h)，
+ * 以 STREAM_SUB_OPT_TIME 订阅的接收端在每包中收到这两个时刻和本包交给以太网的时刻
+ * (STREAM_FLAG_TIME + StreamTimeExt)，PC端据此统计从采集到到达的延迟 (Tools/latency_rx.c)。
+ * - **二层模式** (`STREAM_MODE_RAW_ETH`): 不经过IP/UDP，每个数据块带8字节的
+ * 流包头(`StreamL2Header`)以自定义EtherType直接发出，LwIP只保留控制面。
  ******************************************************************************
  */
 
@@ -26,6 +40,13 @@
 #include <string.h>
 #include "main.h"
 #include "debug_log.h"
+#include "eth_fastpath.h"
+#include "eth_txring.h"
+#include "profile.h"
+#include "stream_ctrl.h"
+#include "stream_governor.h"
+#include "stream_proto.h"
+#include "timebase.h"
 
 // 包含所有必需的头文件
 #include "lwip/udp.h"
@@ -44,11 +65,57 @@
 // --- 网络相关 ---
 static struct udp_pcb *g_upcb;          // 全局UDP控制块
 static ip_addr_t g_dest_ip_addr;        // 目标PC的IP地址
+#if STREAM_MODE == STREAM_MODE_RAW_ETH
+static const uint8_t g_raw_dest_mac[6] = RAW_ETH_DEST_MAC;
+#endif
+static uint32_t g_stream_block = 0;     // 当前发送块的采集块序号 (乒乓切换时在采集中断中设置)
+StreamGov g_stream_gov;                 // 背压调速器 (状态报告中读取)
+
+// --- 当前乒乓块的发送进度 (发送可在主循环和发送完成中断之间多次续发) ---
+static struct {
+    uint8_t  started;                   // 1: 当前块已开始发送
+    uint8_t  group;                     // 当前组
+    uint16_t packet;                    // 组内当前包
+    uint8_t  member;                    // 当前包下一个要发送的组成员
+    uint16_t len;                       // 当前包负载字节数, 0表示尚未组装
+    const uint8_t *payload;             // 当前包负载
+} g_tx;
+
+// 订阅流包头 + 可选的缺口表或时间戳, 作为一段连续的包头发送
+// 两者都适用时只带缺口表 (时间戳可由相邻的包得到)
+typedef struct __attribute__((packed)) {
+    StreamUdpHeader hdr;
+    union {
+        StreamGapExt  gaps;
+        StreamTimeExt time;
+    };
+} StreamUdpHeaderExt;
 
 // --- 【核心】SRAM中的UDP发送中转缓冲区 ---
 // 此缓冲区位于主SRAM，以太网DMA可以访问它。
 // CPU负责将数据从CCMRAM拷贝到这里。
-static uint8_t udp_tx_sram_staging_buf[UDP_PAYLOAD_SIZE] __attribute__((aligned(4)));
+static uint8_t udp_tx_sram_staging_buf[sizeof(StreamUdpHeaderExt) + UDP_PAYLOAD_SIZE] __attribute__((aligned(4)));
+
+// 带扩展包头的订阅包不能超过以太网MTU (IP首部20 + UDP首部8)
+typedef char stream_ext_mtu_check[(20 + 8 + sizeof(StreamUdpHeaderExt) + UDP_PAYLOAD_SIZE <= 1500) ? 1 : -1];
+
+// --- 每个乒乓块的采样时钟缺口表 (采集中断写入，发送时读取) ---
+typedef struct {
+    uint16_t  count;
+    uint8_t   overflow;                 // 1: 表满后又出现了缺口
+    StreamGap gap[ADC_GAP_TABLE_SIZE];  // 按样本序号递增
+} AdcGapTable;
+
+static AdcGapTable g_gaps[2];
+static uint32_t g_lost_ticks_seen;      // 已记入缺口表的 lost_ticks
+
+// --- 乒乓余量: pp_fill_peak 只由发送端写入，采集回调只登记丢块次数 ---
+static volatile uint32_t g_pp_drops_posted; // 采集回调登记的丢块次数 (自由增长)
+static uint32_t g_pp_drops_seen;            // 发送端已并入 pp_fill_peak 的丢块次数
+
+// --- 各乒乓块的采集时刻 (板子时钟, 见 timebase.h) ---
+static uint64_t g_block_start_us[2];    // 第一个样本存入的时刻
+static uint32_t g_block_span_us[2];     // 第一个到最后一个样本
 
 // --- 乒乓数据双缓冲 (位于CCMRAM) ---
 // 使用 `__attribute__((section(".ccmram")))` 将其放入CCMRAM
@@ -61,16 +128,33 @@ static uint16_t g_adc_ping_pong_buffer[2][PING_PONG_BUFFER_SIZE];	//创建了两
 volatile uint8_t  g_start_acquisition_flag = 0;   // 定时器触发的采集请求标志
 volatile uint8_t  g_dma_busy_flag = 0;            // DMA忙标志，防止重入
 volatile uint32_t g_sample_count = 0;             // 当前缓冲区的采样点计数
+volatile uint32_t g_lost_ticks_at_trigger = 0;    // 触发当前传输时的 lost_ticks (TIM2中断写入)
+volatile uint32_t g_lost_ticks_posted = 0;        // 采集回调登记的缺失周期 (自由增长, TIM2中断并入 lost_ticks)
 volatile uint8_t  g_acquisition_buffer_idx = 0;   // 当前正在被DMA填充的缓冲区索引 (0或1)
 volatile int8_t   g_process_buffer_idx = -1;      // 当前需要被发送的缓冲区索引 (-1表示无)
 volatile uint32_t g_udp_packets_sent_count = 0;   // UDP数据包发送总数计数器
+volatile AdcProc_Stats g_adc_stats;               // 采集与发送统计 (遥测读取)
 
 // --- DMA相关 ---
 static uint8_t g_dma_tx_buffer[4] = {0x00, 0x00, 0x00, 0x00};
 static uint8_t g_dma_rx_buffer[4] = {0};
 
+// --- SPI传输中止后的通道重同步 (见 SPI1_Abort_Callback) ---
+#define ADC_RESYNC_IDLE     0
+#define ADC_RESYNC_PENDING  1   // 下一次传输发送 AUTO_RST
+#define ADC_RESYNC_ACTIVE   2   // 发送 AUTO_RST 的传输进行中，其结果丢弃
+static volatile uint8_t g_resync_state = ADC_RESYNC_IDLE;
+
 /* Private function prototypes -----------------------------------------------*/
-static void SendWaveformDataViaUDP(void);
+static void SendWaveformDataViaUDP(uint8_t from_isr);
+static void RecordGap(AdcGapTable *t, uint32_t sample, uint32_t missed);
+#if STREAM_MODE == STREAM_MODE_RAW_ETH
+static uint8_t HasGap(const StreamGroup *grp, uint16_t frame_offset, uint16_t len);
+#else
+static uint8_t FillGapExt(const StreamGroup *grp, uint16_t frame_offset, uint16_t len, StreamGapExt *ext);
+#endif
+static err_t SendChunk(StreamSubscriber *sub, const StreamGroup *grp, const uint8_t *data, uint16_t len,
+                       uint16_t frame_offset, uint8_t flags, uint8_t from_isr);
 
 /* Public functions ----------------------------------------------------------*/
 
@@ -81,16 +165,16 @@ void ADC_Processing_Init(void)
 {
     // 1. 初始化ADC芯片
     ADS8688_Device_Init(CS1_PORT, CS1_PIN);
-    Log_Debug("OK: ADS8688 Initialized.");
+    Log_Info("OK: ADS8688 Initialized.");
 
     // 2. 初始化UDP
-    Log_Debug("INFO: Initializing UDP...");
+    Log_Info("INFO: Initializing UDP...");
 
     // 创建一个新的UDP控制块(PCB)
     g_upcb = udp_new();
     if (g_upcb == NULL)
     {
-        Log_Debug("!!! ERROR: udp_new() failed. System halted.");
+        Log_Error("!!! ERROR: udp_new() failed. System halted.");
         while(1); // 严重错误，停机
     }
 
@@ -102,12 +186,20 @@ void ADC_Processing_Init(void)
     err_t err = udp_connect(g_upcb, &g_dest_ip_addr, DEST_PORT);
     if (err != ERR_OK)
     {
-        Log_Debug1("!!! ERROR: udp_connect() failed with err=%d. System halted.", err);
+        Log_Error("!!! ERROR: udp_connect() failed with err=%d. System halted.", err);
         while(1); // 严重错误，停机
     }
 
-    Log_Debug1("OK: UDP configured. Target: %s:%d", ip4addr_ntoa(&g_dest_ip_addr), DEST_PORT);
-    Log_Debug("------------------------------------");
+    Log_Info("OK: UDP configured. Target: %d.%d.%d.%d:%d", ip4_addr1_16(&g_dest_ip_addr),
+             ip4_addr2_16(&g_dest_ip_addr), ip4_addr3_16(&g_dest_ip_addr), ip4_addr4_16(&g_dest_ip_addr), DEST_PORT);
+
+    // 3. 订阅表 (默认PC为表项0) 和控制端口
+    StreamCtrl_Init(g_upcb, &g_dest_ip_addr, DEST_PORT);
+    StreamGov_Init(&g_stream_gov, BLOCK_PERIOD_MS);
+
+    // 4. 使能以太网发送完成中断，描述符释放后立即续发
+    EthTxRing_Init();
+    Log_Info("------------------------------------");
 }
 
 /**
@@ -115,7 +207,7 @@ void ADC_Processing_Init(void)
  */
 void ADC_Processing_Start(void)
 {
-    Log_Debug("INFO: Starting ADC acquisition timer (TIM2)...");
+    Log_Info("INFO: Starting ADC acquisition timer (TIM2)...");
     LL_TIM_EnableCounter(TIM2);
 }
 
@@ -125,6 +217,8 @@ void ADC_Processing_Start(void)
  */
 void ADC_Processing_Task(void)
 {
+    PROF_BEGIN(PROF_ADC_TASK);
+
     // --- 任务1: 处理定时器触发的DMA采集请求 ---
     if (g_start_acquisition_flag)
     {
@@ -146,6 +240,14 @@ void ADC_Processing_Task(void)
         LL_DMA_SetPeriphAddress(DMA2, LL_DMA_STREAM_3, (uint32_t)&(SPI1->DR));
         LL_DMA_SetMemoryAddress(DMA2, LL_DMA_STREAM_3, (uint32_t)g_dma_tx_buffer);
 
+        // 上一次传输被中止: 本次发送 AUTO_RST，下一帧从第一个通道开始
+        if (g_resync_state == ADC_RESYNC_PENDING)
+        {
+            g_dma_tx_buffer[0] = (uint8_t)(CMD_AUTO_RST >> 8);
+            g_dma_tx_buffer[1] = (uint8_t)CMD_AUTO_RST;
+            g_resync_state = ADC_RESYNC_ACTIVE;
+        }
+
         // 3. 清除可能存在的旧中断标志位
         LL_DMA_ClearFlag_TC0(DMA2);
         LL_DMA_ClearFlag_TE0(DMA2);
@@ -174,11 +276,35 @@ void ADC_Processing_Task(void)
         // Log_Debug("DEBUG: Started one DMA acquisition."); // 可选的调试输出
     }
 
+    ETH_TX_LOCK();  // ARP查询会经LwIP发送
+    StreamCtrl_Poll();
+    ETH_TX_UNLOCK();
+
     // --- 任务2: 检查是否有已满的缓冲区需要通过UDP发送 ---
+    // 发送完成中断也会续发同一个缓冲区，这里须屏蔽以太网中断
     if (g_process_buffer_idx != -1)
     {
-        SendWaveformDataViaUDP();
+        ETH_TX_LOCK();
+        // 屏蔽之前发送完成中断可能已发完这一块，须在屏蔽后再检查
+        if (g_process_buffer_idx != -1)
+        {
+            PROF_BEGIN(PROF_SEND_UDP);
+            SendWaveformDataViaUDP(0);
+            PROF_END(PROF_SEND_UDP);
+        }
+        ETH_TX_UNLOCK();
     }
+
+    PROF_END(PROF_ADC_TASK);
+}
+
+/**
+ * @brief 是否有等待主循环处理的采集请求或待发送的缓冲区
+ * @note  主循环在关中断后调用，返回0时才可进入WFI
+ */
+uint8_t ADC_Processing_Pending(void)
+{
+    return (g_start_acquisition_flag || g_process_buffer_idx != -1) ? 1U : 0U;
 }
 
 /**
@@ -186,12 +312,38 @@ void ADC_Processing_Task(void)
  */
 void SPI1_DMA_RX_Callback(void)
 {
+    PROF_BEGIN(PROF_SPI_RX_CB);
+
     LL_GPIO_SetOutputPin(CS1_PORT, CS1_PIN); // 结束本次SPI通信
 
+    // 重同步帧: 转换结果属于中止前排定的通道，不存
+    if (g_resync_state == ADC_RESYNC_ACTIVE)
+    {
+        g_dma_tx_buffer[0] = 0x00; // 恢复 NO_OP
+        g_dma_tx_buffer[1] = 0x00;
+        g_resync_state = ADC_RESYNC_IDLE;
+        g_lost_ticks_posted++;
+        g_dma_busy_flag = 0;
+        PROF_END(PROF_SPI_RX_CB);
+        return;
+    }
+
     // 从DMA缓冲区中提取16位ADC原始值
     uint16_t adc_raw_value = ((uint16_t)g_dma_rx_buffer[2] << 8) | (g_dma_rx_buffer[3]);
 
+    // 上一个样本与本样本的触发之间有TIM2周期没有产生样本: 本样本之前是一个缺口
+    uint32_t lost_ticks = g_lost_ticks_at_trigger;
+    if (lost_ticks != g_lost_ticks_seen)
+    {
+        RecordGap(&g_gaps[g_acquisition_buffer_idx], g_sample_count, lost_ticks - g_lost_ticks_seen);
+        g_lost_ticks_seen = lost_ticks;
+    }
+
     // 将采集到的数据存入当前活动的乒乓缓冲区
+    if (g_sample_count == 0)
+    {
+        g_block_start_us[g_acquisition_buffer_idx] = Timebase_NowUs();
+    }
     g_adc_ping_pong_buffer[g_acquisition_buffer_idx][g_sample_count] = adc_raw_value;
 
     g_sample_count++;
@@ -199,26 +351,40 @@ void SPI1_DMA_RX_Callback(void)
     // 检查当前缓冲区是否已满
     if (g_sample_count >= PING_PONG_BUFFER_SIZE)
     {
+        g_block_span_us[g_acquisition_buffer_idx] =
+            (uint32_t)(Timebase_NowUs() - g_block_start_us[g_acquisition_buffer_idx]);
+
         // 如果另一个缓冲区当前空闲（即上次的数据已发送完毕）
         if (g_process_buffer_idx == -1)
         {
             // --- 乒乓切换 ---
+            g_stream_block = g_adc_stats.blocks_acquired; // 被丢弃的块不占用发送，接收端看到块序号跳变
+            StreamGov_BlockReady(&g_stream_gov, HAL_GetTick());
             g_process_buffer_idx = g_acquisition_buffer_idx;  // 将刚填满的缓冲区标记为“待处理”
             g_acquisition_buffer_idx = !g_acquisition_buffer_idx; // 切换到另一个缓冲区进行下一次采集
             g_sample_count = 0; // 重置新缓冲区的采样计数器
+            g_gaps[g_acquisition_buffer_idx].count = 0;
+            g_gaps[g_acquisition_buffer_idx].overflow = 0;
 
-            Log_Debug1("INFO: Buffer %d full. Swapping to buffer %d. Ready to send.", g_process_buffer_idx, g_acquisition_buffer_idx);
+            Log_Info("INFO: Buffer %d full. Swapping to buffer %d. Ready to send.", g_process_buffer_idx, g_acquisition_buffer_idx);
         }
         else
         {
             // 网络拥堵或处理速度跟不上采集速度，一个缓冲区的数据被丢弃
             // 这种背压机制可以防止系统崩溃
-            Log_Debug("!!! WARNING: Network backpressure! Dropping one full buffer.");
+            Log_Warn("!!! WARNING: Network backpressure! Dropping one full buffer.");
+            g_pp_drops_posted++;   // 由发送端把 pp_fill_peak 记为块长，本中断不与其读改写竞争
+            StreamGov_BlockDropped(&g_stream_gov); // 下一块起降低发送速率
             g_sample_count = 0; // 丢弃数据，直接在当前缓冲区重新开始采集
+            g_gaps[g_acquisition_buffer_idx].count = 0;
+            g_gaps[g_acquisition_buffer_idx].overflow = 0;
         }
+        g_adc_stats.blocks_acquired++;
     }
 
     g_dma_busy_flag = 0; // 清除DMA忙标志，允许下一次定时器中断触发采集
+
+    PROF_END(PROF_SPI_RX_CB);
 }
 
 
@@ -227,61 +393,340 @@ void SPI1_DMA_RX_Callback(void)
  */
 void SPI1_DMA_Error_Callback(void)
 {
-    Log_Debug("!!! FATAL: SPI/DMA Transfer Error Occurred!");
+    Log_Error("!!! FATAL: SPI/DMA Transfer Error Occurred!");
+    g_adc_stats.spi_dma_errors++;
+    SPI1_Abort_Callback();
+}
+
+/**
+ * @brief SPI传输被中止后的恢复 (SPI1过载中断和DMA错误回调中调用)
+ * @details 中止前若已发出16个时钟，ADS8688已译码NO_OP并前进到下一个通道，而本样本没有存入，
+ * 此后每个样本都会错一个通道。无法得知中止在第几个时钟，因此总是:
+ * 1. 丢弃当前块中未完成的一帧 (回退到帧首)，这些样本连同本周期记为帧首处的缺口;
+ * 2. 下一次传输发送 AUTO_RST 并丢弃其结果，之后的帧从第一个通道开始。
+ */
+void SPI1_Abort_Callback(void)
+{
     LL_GPIO_SetOutputPin(CS1_PORT, CS1_PIN);
+
+    if (g_resync_state == ADC_RESYNC_ACTIVE)
+    {
+        g_resync_state = ADC_RESYNC_PENDING; // 重同步帧本身被中止，下一次重发
+    }
+    else
+    {
+        AdcGapTable *t = &g_gaps[g_acquisition_buffer_idx];
+        uint32_t frame_start = g_sample_count - g_sample_count % CHANNELS_PER_SAMPLE;
+
+        // 帧内已记录的缺口随样本一起回退，重新计入帧首的缺口
+        while (t->count > 0 && t->gap[t->count - 1].sample >= frame_start)
+        {
+            t->count--;
+            g_lost_ticks_seen -= t->gap[t->count].missed;
+        }
+        g_lost_ticks_posted += g_sample_count - frame_start;
+        g_sample_count = frame_start;
+        g_resync_state = ADC_RESYNC_PENDING;
+    }
+    g_lost_ticks_posted++;      // 本次触发没有产生样本
+
+    // 将DMA忙标志清零，这样定时器中断就可以触发下一次采集尝试
     g_dma_busy_flag = 0;
-    // 这里可以加入更复杂的错误恢复机制
 }
 
 
 /**
- * @brief 将一个完整的数据缓冲区通过UDP分片发送出去
- * @details 采用 CPU搬运(memcpy) + LwIP标准pbuf发送 的模式
+ * @brief 以太网发送完成回调 (在ETH中断中被调用)
+ * @details 描述符一释放就立即续发当前缓冲区，不必等待主循环的下一轮。
+ * 中断中不能调用LwIP，因此只使用快速通道/二层通道；主循环访问发送环时会屏蔽此中断。
  */
-static void SendWaveformDataViaUDP(void)
+void ADC_Processing_TxCompleteCallback(void)
 {
-    uint8_t* ccm_buffer_ptr = (uint8_t*)g_adc_ping_pong_buffer[g_process_buffer_idx];
-    // **关键修改**: 计算总字节数时使用sizeof(uint32_t)
-    const uint32_t total_bytes_to_send = PING_PONG_BUFFER_SIZE * sizeof(uint16_t);
-    static uint32_t bytes_sent_from_current_buffer = 0; // 跟踪当前大缓冲区的发送进度
-
-    // 检查是否是新的发送任务
-    if (bytes_sent_from_current_buffer == 0) {
-         Log_Debug1("INFO: Starting to send buffer %d (%u bytes) via UDP...", g_process_buffer_idx, total_bytes_to_send);
+    if (g_stream_gov.awaiting_drain && EthTxRing_InFlight() == 0)
+    {
+        StreamGov_TxDrained(&g_stream_gov, HAL_GetTick());
     }
+    if (g_process_buffer_idx != -1)
+    {
+        PROF_BEGIN(PROF_SEND_UDP);
+        SendWaveformDataViaUDP(1);
+        PROF_END(PROF_SEND_UDP);
+    }
+}
 
-    // 在一次函数调用中，尝试尽可能多地发送数据，直到LwIP的缓冲区满
-    while(bytes_sent_from_current_buffer < total_bytes_to_send)
+/**
+ * @brief 将一个完整的数据缓冲区分片发送给所有订阅者
+ * @details 按 组 -> 包 -> 组成员 的顺序发送，每个包只组装一次。
+ * 发送环满时返回，由发送完成中断或主循环从中断处续发
+ */
+static void SendWaveformDataViaUDP(uint8_t from_isr)
+{
+    const uint16_t *block = g_adc_ping_pong_buffer[g_process_buffer_idx];
+
+    // 检查是否是新的发送任务: 控制端口的修改在块之间生效
+    if (!g_tx.started) {
+#if USE_STREAM_GOVERNOR
+        uint8_t raw_governed = STREAM_GOV_SKIP_RAW && StreamCtrl_RawActive();
+#else
+        uint8_t raw_governed = 0;
+#endif
+        uint8_t raw_send;
+        uint8_t gov_level = StreamGov_BlockStart(&g_stream_gov, raw_governed, &raw_send);
+#if !USE_STREAM_GOVERNOR
+        gov_level = 0;  // 只统计负载，不调速
+#endif
+        if (!StreamCtrl_Commit(gov_level, raw_send)) {
+            return; // 信用不足 (BUFFER策略)，等待授予
+        }
+        memset(&g_tx, 0, sizeof(g_tx));
+        g_tx.started = 1;
+        if (!from_isr) {
+            Log_Info("INFO: Starting to send buffer %d to %d group(s)...", g_process_buffer_idx, StreamCtrl_GroupCount());
+        }
+    }
+
+    // 在一次函数调用中，尝试尽可能多地发送数据，直到LwIP或以太网的缓冲区满
+    while (g_tx.group < StreamCtrl_GroupCount())
     {
-        struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, UDP_PAYLOAD_SIZE, PBUF_RAM);
-        if (p == NULL) {
-            Log_Debug("DEBUG: LwIP PBUF pool temporarily empty. Will retry.");
-            return; // pbuf耗尽，退出函数，等待下次轮询
+        const StreamGroup *grp = StreamCtrl_Group(g_tx.group);
+
+        if (g_tx.packet >= grp->packets) {
+            g_tx.group++;
+            g_tx.packet = 0;
+            continue;
         }
 
-        uint32_t chunk_size = total_bytes_to_send - bytes_sent_from_current_buffer;
-        if (chunk_size > UDP_PAYLOAD_SIZE) {
-            chunk_size = UDP_PAYLOAD_SIZE;
+        if (g_tx.len == 0) {
+            g_tx.len = StreamCtrl_Assemble(grp, block, g_tx.packet, &g_tx.payload);
         }
+        uint8_t flags = (g_tx.packet + 1 == grp->packets) ? STREAM_FLAG_BLOCK_END : 0;
+        uint16_t frame_offset = g_tx.packet * grp->frames_per_packet;
+
+        while (g_tx.member < grp->n_members)
+        {
+            StreamSubscriber *sub = StreamCtrl_Subscriber(grp->members[g_tx.member]);
+            err_t err = SendChunk(sub, grp, g_tx.payload, g_tx.len, frame_offset, flags, from_isr);
+
+            if (err == ERR_OK) {
+                g_udp_packets_sent_count++;
+            } else if (err == ERR_MEM || err == ERR_WOULDBLOCK || err == ERR_USE) {
+                // ERR_USE: ethernetif.c 的 low_level_output 遇到发送描述符环满
+                if (!from_isr) {
+                    Log_Debug1("DEBUG: send failed with err=%d (likely queue full). Will retry.", err);
+                }
+                return; // 发送队列满，退出函数，等待发送完成中断或下次轮询
+            } else {
+                sub->send_errors++; // 非暂时性错误(如无路由)，丢弃本包，不阻塞其他订阅者
+            }
+            sub->seq++;
+            g_tx.member++;
+        }
+
+        g_tx.member = 0;
+        g_tx.len = 0;
+        g_tx.packet++;
+    }
 
-        memcpy(udp_tx_sram_staging_buf, ccm_buffer_ptr + bytes_sent_from_current_buffer, chunk_size);
-        pbuf_take(p, udp_tx_sram_staging_buf, chunk_size);
+    // 如果代码执行到这里，说明整个大缓冲区都已发送给所有订阅者
+    if (!from_isr) {
+        Log_Info("OK: Finished sending buffer %d. Total packets sent so far: %u.", g_process_buffer_idx, g_udp_packets_sent_count);
+    }
+    StreamGov_BlockSent(&g_stream_gov); // 发送环排空后按本块的耗时调整下一块的速率
+    if (EthTxRing_InFlight() == 0)
+    {
+        // 本块没有包留在环中 (被调速跳过、全部发送失败或已发完)，不会再有发送完成中断，立即评估
+        StreamGov_TxDrained(&g_stream_gov, HAL_GetTick());
+    }
+    uint32_t drops = g_pp_drops_posted;
+    if (drops != g_pp_drops_seen)
+    {
+        g_pp_drops_seen = drops;
+        g_adc_stats.pp_fill_peak = PING_PONG_BUFFER_SIZE; // 采集回调登记过丢块
+    }
+    else if (g_sample_count > g_adc_stats.pp_fill_peak)
+    {
+        g_adc_stats.pp_fill_peak = g_sample_count; // 发送期间另一块已采到的位置
+    }
+    g_process_buffer_idx = -1; // 标记缓冲区为空闲
+    g_tx.started = 0;          // 为下一个缓冲区重置发送进度
+}
 
-        err_t err = udp_send(g_upcb, p);
-        pbuf_free(p); // 无论成功与否都要释放pbuf
+/**
+ * @brief 向一个订阅者发送一个数据包
+ * @param frame_offset 本包第一帧在(抽取后)块内的帧序号
+ * @param flags        STREAM_FLAG_*
+ * @param from_isr     1: 在以太网中断中调用，不可退回LwIP路径
+ * @details 二层模式直接发以太网帧；UDP模式下快速通道可用时直接写以太网描述符，
+ * 否则退回 CPU搬运(memcpy) + pbuf + udp_sendto。默认PC收到无包头的原始数据
+ */
+static err_t SendChunk(StreamSubscriber *sub, const StreamGroup *grp, const uint8_t *data, uint16_t len,
+                       uint16_t frame_offset, uint8_t flags, uint8_t from_isr)
+{
+    uint8_t in_flight = EthTxRing_RecordOccupancy();
+
+#if STREAM_MODE == STREAM_MODE_RAW_ETH
+    (void)from_isr;
+    (void)in_flight;
+    StreamL2Header hdr;
+    hdr.version = STREAM_PROTO_VERSION;
+    hdr.flags   = flags;
+    hdr.seq     = (uint16_t)sub->seq;
+    hdr.block   = (uint16_t)g_stream_block;
+    hdr.offset  = frame_offset * grp->frame_bytes;
+    if (HasGap(grp, frame_offset, len)) {
+        hdr.flags |= STREAM_FLAG_GAP; // 二层包头放不下缺口表，只标记
+    }
+    return EthFast_SendRaw(g_raw_dest_mac, STREAM_ETHERTYPE, &hdr, sizeof(hdr), data, len);
+#else
+    StreamUdpHeaderExt ext;
+    StreamUdpHeader *hdr = &ext.hdr;
+    uint16_t hdr_len = 0;
 
-        if (err == ERR_OK) {
-            bytes_sent_from_current_buffer += chunk_size;
-            g_udp_packets_sent_count++;
-        } else {
-            Log_Debug1("DEBUG: udp_send failed with err=%d (likely queue full). Will retry.", err);
-            return; // 发送队列满，退出函数，等待下次轮询
+    if (!grp->raw)
+    {
+        hdr->magic        = STREAM_UDP_MAGIC;
+        hdr->version      = STREAM_PROTO_VERSION;
+        hdr->flags        = flags | (sub->rate_changed ? STREAM_FLAG_RATE_CHANGE : 0);
+        hdr->seq          = sub->seq;
+        hdr->block        = g_stream_block;
+        hdr->frame_offset = frame_offset;
+        hdr->channel_mask = grp->channel_mask;
+        hdr->decimation   = grp->decimation;
+        hdr_len = sizeof(*hdr);
+        if (FillGapExt(grp, frame_offset, len, &ext.gaps)) {
+            hdr->flags |= STREAM_FLAG_GAP;
+            hdr_len = sizeof(*hdr) + sizeof(ext.gaps);
+        } else if (sub->timestamps) {
+            uint64_t start = g_block_start_us[g_process_buffer_idx];
+            ext.time.block_start_us = start;
+            ext.time.block_span_us  = g_block_span_us[g_process_buffer_idx];
+            ext.time.handoff_us     = (uint32_t)(Timebase_NowUs() - start);
+            hdr->flags |= STREAM_FLAG_TIME;
+            hdr_len = sizeof(*hdr) + sizeof(ext.time);
         }
     }
 
-    // 如果代码执行到这里，说明整个大缓冲区都已成功发送
-    Log_Debug1("OK: Finished sending buffer %d. Total packets sent so far: %u.", g_process_buffer_idx, g_udp_packets_sent_count);
-    g_process_buffer_idx = -1; // 标记缓冲区为空闲
-    bytes_sent_from_current_buffer = 0; // 为下一个缓冲区重置发送计数器
+#if USE_ETH_FASTPATH
+    if (EthFast_IsReady(&sub->tpl))
+    {
+        err_t fast_err = EthFast_SendUdp(&sub->tpl, &ext, hdr_len, data, len);
+        if (fast_err != ERR_CONN)
+        {
+            return fast_err;
+        }
+        // 模板失效 (例如链路断开)，本次退回标准路径
+    }
+#endif
+    if (from_isr)
+    {
+        return ERR_WOULDBLOCK; // LwIP路径只能在主循环中使用
+    }
+    if (in_flight >= ETH_TXBUFNB)
+    {
+        return ERR_USE; // 发送环满时 low_level_output 必然返回 ERR_USE，不必先分配pbuf和拷贝
+    }
+
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, hdr_len + len, PBUF_RAM);
+    if (p == NULL) {
+        Log_Debug("DEBUG: LwIP PBUF pool temporarily empty. Will retry.");
+        g_adc_stats.pbuf_failures++;
+        StreamGov_SendFailed(&g_stream_gov);
+        return ERR_MEM; // pbuf耗尽，等待下次轮询
+    }
+
+    memcpy(udp_tx_sram_staging_buf, &ext, hdr_len);
+    memcpy(udp_tx_sram_staging_buf + hdr_len, data, len);
+    pbuf_take(p, udp_tx_sram_staging_buf, hdr_len + len);
+
+    err_t err = udp_sendto(g_upcb, p, &sub->ip, sub->port);
+    pbuf_free(p); // 无论成功与否都要释放pbuf
+    if (err != ERR_OK) {
+        g_adc_stats.send_errors++;
+        StreamGov_SendFailed(&g_stream_gov);
+    }
+    return err;
+#endif /* STREAM_MODE */
 }
 
+/**
+ * @brief 在缺口表中记录一个缺口 (在采集中断中调用)
+ * @param sample 缺口后的第一个样本在块内的序号
+ * @param missed 缺失的采样时钟数
+ */
+static void RecordGap(AdcGapTable *t, uint32_t sample, uint32_t missed)
+{
+    if (t->count >= ADC_GAP_TABLE_SIZE)
+    {
+        t->overflow = 1;
+        return;
+    }
+    t->gap[t->count].sample = (uint16_t)sample;
+    t->gap[t->count].missed = (missed > 0xFFFFU) ? 0xFFFFU : (uint16_t)missed;
+    t->count++;
+}
+
+#if STREAM_MODE == STREAM_MODE_RAW_ETH
+/**
+ * @brief 当前发送块中，本包覆盖的原始样本范围内是否有缺口
+ */
+static uint8_t HasGap(const StreamGroup *grp, uint16_t frame_offset, uint16_t len)
+{
+    const AdcGapTable *t = &g_gaps[g_process_buffer_idx];
+    uint32_t first = (uint32_t)frame_offset * grp->decimation * CHANNELS_PER_SAMPLE;
+    uint32_t end = ((uint32_t)frame_offset + len / grp->frame_bytes) * grp->decimation * CHANNELS_PER_SAMPLE;
+    uint16_t i;
+
+    for (i = 0; i < t->count; i++)
+    {
+        if (t->gap[i].sample >= first && t->gap[i].sample < end)
+        {
+            return 1;
+        }
+    }
+    // 表满之后的缺口位置未知, 只可能在最后一个已记录的缺口之后
+    return t->overflow && end > t->gap[ADC_GAP_TABLE_SIZE - 1].sample;
+}
+#else
+/**
+ * @brief 从当前发送块的缺口表中取出位于本包原始样本范围内的缺口
+ * @param len 本包负载字节数
+ * @retval 1: 本包范围内有缺口，ext 已填写
+ */
+static uint8_t FillGapExt(const StreamGroup *grp, uint16_t frame_offset, uint16_t len, StreamGapExt *ext)
+{
+    const AdcGapTable *t = &g_gaps[g_process_buffer_idx];
+    uint32_t first = (uint32_t)frame_offset * grp->decimation * CHANNELS_PER_SAMPLE;
+    uint32_t end = ((uint32_t)frame_offset + len / grp->frame_bytes) * grp->decimation * CHANNELS_PER_SAMPLE;
+    uint32_t total = 0;
+    uint16_t i;
+
+    if (t->count == 0)
+    {
+        return 0; // 绝大多数块没有缺口
+    }
+    memset(ext, 0, sizeof(*ext));
+    for (i = 0; i < t->count; i++)
+    {
+        if (t->gap[i].sample < first || t->gap[i].sample >= end)
+        {
+            continue;
+        }
+        total += t->gap[i].missed;
+        if (ext->count < STREAM_GAP_MAX)
+        {
+            ext->gap[ext->count++] = t->gap[i];
+        }
+        else
+        {
+            ext->overflow = 1;
+        }
+    }
+    // 表满之后的缺口位置未知, 只可能在最后一个已记录的缺口之后
+    if (t->overflow && end > t->gap[ADC_GAP_TABLE_SIZE - 1].sample)
+    {
+        ext->overflow = 1;
+    }
+    ext->missed_total = (total > 0xFFFFU) ? 0xFFFFU : (uint16_t)total;
+    return ext->count != 0 || ext->overflow;
+}
+#endif /* STREAM_MODE */
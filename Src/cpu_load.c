@@ -0,0 +1,155 @@
+/**
+ ******************************************************************************
+ * @file    cpu_load.c
+ * @brief   主循环负载计量：按段统计有效工作时间，可选在空闲时执行WFI
+ *
+ * @details
+ * - **分段**: 主循环每调用完一个子系统就调用 CpuLoad_Account，本段耗时为与上一段结束时刻之差
+ * (DWT周期计数器)。各段记住自己最短的一次耗时作为空转查询的开销，超出
+ * CPU_LOAD_WORK_MARGIN 的一段算作有效工作; 一轮中没有任何有效工作的算作空转轮。
+ * - **负载**: 每 CPU_LOAD_WINDOW_MS 用 有效工作周期数 / 窗口总周期数 得到各段和总的负载，
+ * 再做滑动平均。窗口总长取自 HAL_GetTick，不依赖周期计数器在睡眠中是否计数。
+ * 中断的耗时计入它所打断的那一段; 短于 CPU_LOAD_WORK_MARGIN 的中断落在空转的段中时不被计入，
+ * 因此负载最多低估 中断频率 x 单次中断耗时 (Tools/cpu_load_sim.c 的 -i 选项可复现)。
+ * - **WFI**: 主循环在关中断的情况下检查没有待处理的工作后调用 CpuLoad_Sleep，
+ * 内核停在WFI直到下一个中断 (采样期间最长一个TIM2周期)，期间不再空转查询，
+ * 减少与DMA的总线争用。在关中断状态下检查并进入WFI，避免检查之后到来的中断被错过。
+ * - **主机**: 定义 HOST_BUILD 时时钟和WFI由测试程序提供 (见 Tools/cpu_load_sim.c)。
+ ******************************************************************************
+ */
+
+#include "cpu_load.h"
+#include <string.h>
+
+/* Private defines -----------------------------------------------------------*/
+#ifdef HOST_BUILD
+#define CPU_NOW()       ((uint32_t)CpuLoad_HostCycles())
+#define CPU_TICK_MS()   ((uint32_t)(CpuLoad_HostCycles() / (CPU_LOAD_HOST_HZ / 1000U)))
+#define CPU_HZ          CPU_LOAD_HOST_HZ
+#define CPU_WFI()       CpuLoad_HostWfi()
+#else
+#define CPU_NOW()       DWT->CYCCNT
+#define CPU_TICK_MS()   HAL_GetTick()
+#define CPU_HZ          SystemCoreClock
+#define CPU_WFI()       __WFI()
+#endif
+
+/* Private variables ---------------------------------------------------------*/
+static CpuLoad_Stats g_cpu_stats;
+static uint32_t s_mark;                         // 上一段结束的时刻 (周期)
+static uint32_t s_idle_cost[CPU_SUB_COUNT];     // 各段空转一次的最短耗时
+static uint32_t s_busy[CPU_SUB_COUNT];          // 本窗口内各段的有效工作周期数
+static uint32_t s_window_start_ms;
+static uint8_t  s_pass_worked;
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief 滑动平均 (新值权重1/4)
+ */
+static uint16_t Average(uint16_t avg, uint64_t busy, uint64_t total)
+{
+    uint32_t permille = (uint32_t)((busy * 1000U) / total);
+
+    if (permille > 1000U)
+    {
+        permille = 1000U;
+    }
+    return (uint16_t)((3U * avg + permille + 2U) / 4U);
+}
+
+/* Public functions ----------------------------------------------------------*/
+
+/**
+ * @brief 启动DWT周期计数器并开始第一个统计窗口
+ */
+void CpuLoad_Init(void)
+{
+    uint32_t i;
+
+#ifndef HOST_BUILD
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+    memset(&g_cpu_stats, 0, sizeof(g_cpu_stats));
+    memset(s_busy, 0, sizeof(s_busy));
+    for (i = 0; i < CPU_SUB_COUNT; i++)
+    {
+        s_idle_cost[i] = 0xFFFFFFFFU;
+    }
+    s_pass_worked = 0;
+    s_window_start_ms = CPU_TICK_MS();
+    s_mark = CPU_NOW();
+}
+
+/**
+ * @brief 一段结束: 按耗时判断它是空转查询还是有效工作
+ * @param sub CpuSubsystem
+ */
+void CpuLoad_Account(uint32_t sub)
+{
+    uint32_t now = CPU_NOW();
+    uint32_t cycles = now - s_mark;
+
+    s_mark = now;
+    if (cycles < s_idle_cost[sub])
+    {
+        s_idle_cost[sub] = cycles;
+    }
+    if (cycles > s_idle_cost[sub] + CPU_LOAD_WORK_MARGIN)
+    {
+        s_busy[sub] += cycles;
+        s_pass_worked = 1;
+    }
+}
+
+/**
+ * @brief 一轮结束: 统计空转轮, 窗口结束时更新负载
+ */
+void CpuLoad_EndPass(void)
+{
+    uint32_t now_ms = CPU_TICK_MS();
+    uint32_t elapsed = now_ms - s_window_start_ms;
+    uint64_t total, busy = 0;
+    uint32_t i;
+
+    g_cpu_stats.passes++;
+    if (!s_pass_worked)
+    {
+        g_cpu_stats.idle_passes++;
+    }
+    s_pass_worked = 0;
+
+    if (elapsed < CPU_LOAD_WINDOW_MS)
+    {
+        return;
+    }
+    total = (uint64_t)elapsed * (CPU_HZ / 1000U);
+    for (i = 0; i < CPU_SUB_COUNT; i++)
+    {
+        g_cpu_stats.sub_permille[i] = Average(g_cpu_stats.sub_permille[i], s_busy[i], total);
+        busy += s_busy[i];
+        s_busy[i] = 0;
+    }
+    g_cpu_stats.load_permille = Average(g_cpu_stats.load_permille, busy, total);
+    s_window_start_ms = now_ms;
+}
+
+/**
+ * @brief 睡眠到下一个中断
+ * @note  调用者须已关中断并确认没有待处理的工作; 返回后由调用者开中断，唤醒的中断随即执行
+ */
+void CpuLoad_Sleep(void)
+{
+    CPU_WFI();
+    g_cpu_stats.sleeps++;
+    s_mark = CPU_NOW(); // 睡眠时间不计入任何一段
+}
+
+/**
+ * @brief 当前统计 (供遥测和串口状态块读取)
+ */
+const CpuLoad_Stats *CpuLoad_GetStats(void)
+{
+    return &g_cpu_stats;
+}
@@ -1,56 +1,353 @@
 #include "debug_log.h"
 #include <stdio.h>
 #include <string.h>
-#include "main.h"
 #include <stdarg.h> // ͷļ
+#ifdef HOST_BUILD
+#include <stdatomic.h>
+#include <time.h>
+#else
+#include "main.h"
+#if LOG_OUTPUT_BINARY
+#include "usart.h"
+#include "uart_console.h"
+#endif
+#endif
+
+// /߶
+//
+//  (TIM2/SPI1/DMA2жϡѭɻǶ)  LDREX/STREX  head ǰƣ
+// ռԤһ; дʽָʱд LOG_REC_COMMITTED ͷ֡
+// ϵԼ (쳣ռ)ԴǶ׵жϲ
+// Ψһ Log_Process Ԥ˳ȡ; δύļ¼ͣ£
+// ȡһ¼ռõ㣬ǰ tail˻пеʼΪ0
+//
+// ¼ʽ (32λΪλڻпɻ):
+//   [0] ͷ: bit0-7 , bit8 ַ(Log_Debug), bit12-13 , bit31 ύ
+//   [1] ʽַָ (Ϊ64λռ2)
+//   [.] ʱ (ms)
+//   [.] ԭʼ
+#define LOG_PTR_WORDS       (sizeof(const char *) / sizeof(uint32_t))
+#define LOG_HDR_WORDS       (2U + LOG_PTR_WORDS)
+#define LOG_REC_PLAIN       0x100U
+#define LOG_REC_LEVEL_SHIFT 12
+#define LOG_REC_COMMITTED   0x80000000U
+#define LOG_RING_MASK       (LOG_RING_WORDS - 1U)
+
+typedef char log_ring_pow2_check[((LOG_RING_WORDS & LOG_RING_MASK) == 0) ? 1 : -1];
+
+// ֽ֡ͬ; ıв0x00PC˿ͬһ
+#define LOG_SYNC0           0x00
+#define LOG_SYNC1           0xA5
+
+#ifdef HOST_BUILD
+typedef _Atomic uint32_t LogWord;
+#else
+typedef volatile uint32_t LogWord;
+#endif
 
-// λṹ
-static volatile struct {
-    const char* buffer[LOG_BUFFER_SIZE];
-    volatile int head;
-    volatile int tail;
+// λṹ (head/tail Ϊ)
+static struct {
+    LogWord buffer[LOG_RING_WORDS];
+    LogWord head;                       // Ԥλ
+    LogWord tail;                       // ȡߵλ
+    LogWord dropped[LOG_LEVEL_COUNT];   // 򻺳ļ¼
 } log_queue;
 
-// ʼ־ϵͳ
+static uint32_t log_dropped_reported[LOG_LEVEL_COUNT];
+static uint32_t log_high_water;
+
+/* ƽ̨صԭӲ --------------------------------------------------------*/
+#ifdef HOST_BUILD
+
+static inline uint32_t LogLoad(LogWord *p)           { return atomic_load_explicit(p, memory_order_relaxed); }
+static inline uint32_t LogLoadAcquire(LogWord *p)    { return atomic_load_explicit(p, memory_order_acquire); }
+static inline void LogStore(LogWord *p, uint32_t v)  { atomic_store_explicit(p, v, memory_order_relaxed); }
+static inline void LogStoreRelease(LogWord *p, uint32_t v) { atomic_store_explicit(p, v, memory_order_release); }
+
+static inline void LogAtomicInc(LogWord *p)
+{
+    atomic_fetch_add_explicit(p, 1U, memory_order_relaxed);
+}
+
+// Ԥ words ֣ռ䲻ʱ0
+static inline int LogReserve(uint32_t words, uint32_t *pos)
+{
+    uint32_t head = atomic_load_explicit(&log_queue.head, memory_order_relaxed);
+    do {
+        if (LOG_RING_WORDS - (head - LogLoadAcquire(&log_queue.tail)) < words) {
+            return 0;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&log_queue.head, &head, head + words,
+                                                    memory_order_relaxed, memory_order_relaxed));
+    *pos = head;
+    return 1;
+}
+
+static inline uint32_t LogNow(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000U + ts.tv_nsec / 1000000U);
+}
+
+#else
+
+// Cortex-M4 ΪˣDMB Ҫϣ֤д˳
+static inline uint32_t LogLoad(LogWord *p)           { return *p; }
+static inline uint32_t LogLoadAcquire(LogWord *p)    { uint32_t v = *p; __DMB(); return v; }
+static inline void LogStore(LogWord *p, uint32_t v)  { *p = v; }
+static inline void LogStoreRelease(LogWord *p, uint32_t v) { __DMB(); *p = v; }
+
+static inline void LogAtomicInc(LogWord *p)
+{
+    uint32_t v;
+    do {
+        v = __LDREXW(p);
+    } while (__STREXW(v + 1U, p) != 0U);
+}
+
+// Ԥ words ֣ռ䲻ʱ0
+static inline int LogReserve(uint32_t words, uint32_t *pos)
+{
+    uint32_t head;
+    do {
+        head = __LDREXW(&log_queue.head);
+        if (LOG_RING_WORDS - (head - log_queue.tail) < words) {
+            __CLREX();
+            return 0;
+        }
+    } while (__STREXW(head + words, &log_queue.head) != 0U);
+    *pos = head;
+    return 1;
+}
+
+static inline uint32_t LogNow(void)
+{
+    return HAL_GetTick();
+}
+
+#endif /* HOST_BUILD */
+
+/* в ------------------------------------------------------------------*/
+
+// жϰȫһ¼
+static void Log_Enqueue(uint32_t hdr, const char *format, uint32_t nargs, const uint32_t *args)
+{
+    uint64_t fmt = (uintptr_t)format;
+    uint32_t pos, i;
+
+    // ˣͶϢ
+    if (!LogReserve(LOG_HDR_WORDS + nargs, &pos)) {
+        LogAtomicInc(&log_queue.dropped[(hdr >> LOG_REC_LEVEL_SHIFT) & 3U]);
+        return;
+    }
+    for (i = 0; i < LOG_PTR_WORDS; i++) {
+        LogStore(&log_queue.buffer[(pos + 1U + i) & LOG_RING_MASK], (uint32_t)fmt);
+        fmt >>= 32;
+    }
+    LogStore(&log_queue.buffer[(pos + 1U + LOG_PTR_WORDS) & LOG_RING_MASK], LogNow());
+    for (i = 0; i < nargs; i++) {
+        LogStore(&log_queue.buffer[(pos + LOG_HDR_WORDS + i) & LOG_RING_MASK], args[i]);
+    }
+    // ύͷ
+    LogStoreRelease(&log_queue.buffer[pos & LOG_RING_MASK], hdr | nargs | LOG_REC_COMMITTED);
+}
+
+// ʼ־ϵͳ (κ֮ǰ)
 void Log_Init(void) {
-    log_queue.head = 0;
-    log_queue.tail = 0;
+    uint32_t i;
+    for (i = 0; i < LOG_RING_WORDS; i++) {
+        LogStore(&log_queue.buffer[i], 0);
+    }
+    for (i = 0; i < LOG_LEVEL_COUNT; i++) {
+        LogStore(&log_queue.dropped[i], 0);
+        log_dropped_reported[i] = 0;
+    }
+    log_high_water = 0;
+    LogStore(&log_queue.tail, 0);
+    LogStoreRelease(&log_queue.head, 0);
 }
 
 // жϰȫһ־Ϣ
 void Log_Debug(const char* message) {
-    int next_head = (log_queue.head + 1) % LOG_BUFFER_SIZE;
-    // ˣͶɵϢʲô
-    if (next_head != log_queue.tail) {
-        log_queue.buffer[log_queue.head] = message;
-        log_queue.head = next_head;
+    Log_Enqueue(LOG_REC_PLAIN | ((uint32_t)LOG_LEVEL_DEBUG << LOG_REC_LEVEL_SHIFT), message, 0, NULL);
+}
+
+// жϰȫ¼ʽַָԭʼκθʽ
+void Log_Write(uint32_t level, const char *format, uint32_t nargs, ...)
+{
+    uint32_t a[LOG_MAX_ARGS];
+    uint32_t i;
+    va_list args;
+
+    if (nargs > LOG_MAX_ARGS) {
+        nargs = LOG_MAX_ARGS;
+    }
+    va_start(args, nargs);
+    for (i = 0; i < nargs; i++) {
+        a[i] = va_arg(args, uint32_t);
     }
+    va_end(args);
+    Log_Enqueue((level & 3U) << LOG_REC_LEVEL_SHIFT, format, nargs, a);
 }
 
-// ѭдӡ־
-void Log_Process(void) {
+// ȡһύļ¼ (ֻһߵ)
+int Log_Pop(LogRecord *rec)
+{
+    uint32_t tail = LogLoad(&log_queue.tail);
+    uint32_t head = LogLoadAcquire(&log_queue.head);
+    uint32_t hdr, words, i;
+    uint64_t fmt = 0;
+
     // 黺Ƿ
-    if (log_queue.tail != log_queue.head) {
-        // βȡϢ
-        const char* message = log_queue.buffer[log_queue.tail];
-        // βָ
-        log_queue.tail = (log_queue.tail + 1) % LOG_BUFFER_SIZE;
-        
-        // ﰲȫص printf
-        printf("%s\r\n", message);
+    if (tail == head) {
+        return 0;
+    }
+    if (head - tail > log_high_water) {
+        log_high_water = head - tail;
+    }
+    // Ԥļ¼д (߱ȼжϴ)
+    hdr = LogLoadAcquire(&log_queue.buffer[tail & LOG_RING_MASK]);
+    if (!(hdr & LOG_REC_COMMITTED)) {
+        return 0;
+    }
+
+    rec->nargs = hdr & 0xFFU;
+    rec->plain = (hdr & LOG_REC_PLAIN) ? 1U : 0U;
+    rec->level = (hdr >> LOG_REC_LEVEL_SHIFT) & 3U;
+    for (i = LOG_PTR_WORDS; i > 0; i--) {
+        fmt = (fmt << 32) | LogLoad(&log_queue.buffer[(tail + i) & LOG_RING_MASK]);
+    }
+    rec->format = (const char *)(uintptr_t)fmt;
+    rec->timestamp = LogLoad(&log_queue.buffer[(tail + 1U + LOG_PTR_WORDS) & LOG_RING_MASK]);
+    for (i = 0; i < rec->nargs; i++) {
+        rec->args[i] = LogLoad(&log_queue.buffer[(tail + LOG_HDR_WORDS + i) & LOG_RING_MASK]);
+    }
+    for (; i < LOG_MAX_ARGS; i++) {
+        rec->args[i] = 0;
+    }
+
+    // ٸβָ룬вɵͷ
+    words = LOG_HDR_WORDS + rec->nargs;
+    for (i = 0; i < words; i++) {
+        LogStore(&log_queue.buffer[(tail + i) & LOG_RING_MASK], 0);
+    }
+    LogStoreRelease(&log_queue.tail, tail + words);
+    return 1;
+}
+
+uint32_t Log_GetHighWater(void)
+{
+    return log_high_water;
+}
+
+int Log_Pending(void)
+{
+    return LogLoad(&log_queue.head) != LogLoad(&log_queue.tail);
+}
+
+uint32_t Log_GetDropped(uint32_t level)
+{
+    return (level < LOG_LEVEL_COUNT) ? LogLoad(&log_queue.dropped[level]) : 0U;
+}
+
+// ѭдӡ־ (ÿεһ¼)
+void Log_Process(void) {
+    static const char level_tag[LOG_LEVEL_COUNT] = { 'E', 'W', 'I', 'D' };
+    LogRecord rec;
+    uint32_t i;
+
+    for (i = 0; i < LOG_LEVEL_COUNT; i++) {
+        uint32_t dropped = Log_GetDropped(i);
+        if (dropped != log_dropped_reported[i]) {
+            printf("!!! LOG: %c records dropped (buffer full): %lu\r\n", level_tag[i],
+                   (unsigned long)(dropped - log_dropped_reported[i]));
+            log_dropped_reported[i] = dropped;
+        }
+    }
+
+    if (!Log_Pop(&rec)) {
+        return;
+    }
+
+#if LOG_OUTPUT_BINARY && !defined(HOST_BUILD)
+    {
+        // ֡: 00 A5 <ͷ16λ> <ʽָ> <ʱ> <...>С
+        uint8_t frame[4 + 4 * (2 + LOG_MAX_ARGS)];
+        uint16_t hdr = (uint16_t)(rec.nargs | (rec.plain ? LOG_REC_PLAIN : 0U) |
+                                  (rec.level << LOG_REC_LEVEL_SHIFT));
+        uint32_t fmt = (uint32_t)rec.format;
+        frame[0] = LOG_SYNC0;
+        frame[1] = LOG_SYNC1;
+        memcpy(&frame[2], &hdr, 2);
+        memcpy(&frame[4], &fmt, 4);
+        memcpy(&frame[8], &rec.timestamp, 4);
+        memcpy(&frame[12], rec.args, 4 * rec.nargs);
+#if USE_UART_DMA_CONSOLE
+        (void)UartConsole_Write(frame, (uint16_t)(12 + 4 * rec.nargs));  // ֡֡
+#else
+        HAL_UART_Transmit(&huart1, frame, (uint16_t)(12 + 4 * rec.nargs), 0xFFFF);
+#endif
+    }
+#else
+    // ﰲȫص printf; Ĳᱻ
+    printf("[%6lu.%03lu] ", (unsigned long)(rec.timestamp / 1000U), (unsigned long)(rec.timestamp % 1000U));
+    if (rec.plain) {
+        printf("%s\r\n", rec.format);
+    } else {
+        printf(rec.format, rec.args[0], rec.args[1], rec.args[2], rec.args[3],
+               rec.args[4], rec.args[5], rec.args[6], rec.args[7]);
+        printf("\r\n");
     }
+#endif
 }
 
-void Log_Debug1(const char *format, ...)
+#if LOG_BENCHMARK && !defined(HOST_BUILD)
+// ԭȵʵ: ڵô vsnprintfڶԱ
+static void Log_Legacy(const char *format, ...)
 {
     va_list args;
     va_start(args, format);
-    
-    // ʹ vsnprintf ȫظʽַ
     char formatted_msg[128];
     vsnprintf(formatted_msg, sizeof(formatted_msg), format, args);
     va_end(args);
-    
-    // Ȼ󽫸ʽַӵ־
-    //Log_Enqueue(LOG_LEVEL_DEBUG, formatted_msg);
 }
+
+/**
+ * @brief DWTڼÿ־õԭȵ vsnprintf ·Ա
+ * @note   Log_Init ֮ɼ֮ǰ; õļ¼漴ȡ߶
+ */
+void Log_Benchmark(void)
+{
+    const uint32_t n = 64;
+    uint32_t i, t0, deferred = 0, plain = 0, legacy;
+    LogRecord rec;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    for (i = 0; i < n; i++) {
+        t0 = DWT->CYCCNT;
+        Log_Debug1("INFO: Buffer %d full. Swapping to buffer %d.", i, i + 1);
+        deferred += DWT->CYCCNT - t0;
+        (void)Log_Pop(&rec);    // ֶΪգֻд뿪
+    }
+
+    for (i = 0; i < n; i++) {
+        t0 = DWT->CYCCNT;
+        Log_Debug("INFO: constant message.");
+        plain += DWT->CYCCNT - t0;
+        (void)Log_Pop(&rec);
+    }
+
+    t0 = DWT->CYCCNT;
+    for (i = 0; i < n; i++) {
+        Log_Legacy("INFO: Buffer %d full. Swapping to buffer %d.", i, i + 1);
+    }
+    legacy = DWT->CYCCNT - t0;
+
+    printf("LOG benchmark (cycles/call): deferred=%lu plain=%lu vsnprintf=%lu\r\n",
+           (unsigned long)(deferred / n), (unsigned long)(plain / n), (unsigned long)(legacy / n));
+}
+#endif /* LOG_BENCHMARK */
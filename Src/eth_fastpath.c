@@ -0,0 +1,291 @@
+/**
+ ******************************************************************************
+ * @file    eth_fastpath.c
+ * @brief   数据面快速发送通道：绕过LwIP，直接填写以太网DMA发送描述符
+ *
+ * @details
+ * - **动机**: 对固定的目的地址，udp_send 每个包都要重复路由查找、首部构建和
+ * ARP查表，而这些结果在两个包之间完全相同。
+ * - **模板**: 每个目的地址一个模板，根据PCB、目的地址和LwIP的ARP表只构建一次
+ * 以太网/IP/UDP首部模板 (42字节)。每个包只需改写IP总长度、IP标识和UDP长度。
+ * 多个目的地址共用同一个PCB(源端口)，组播目的地址的MAC直接由IP映射。
+ * - **发送**: 直接检查 heth.TxDesc 的OWN位。若描述符空闲，则把模板和采样数据
+ * 拷贝到该描述符的DMA缓冲区(位于SRAM)，再由 HAL_ETH_TransmitFrame 交还给DMA。
+ * - **校验和**: IP首部校验和与UDP校验和均置0，由MAC的硬件校验和卸载计算
+ * (描述符已由驱动配置为 CIC = 全部插入)。
+ * - **控制面**: ARP、ICMP等仍由LwIP处理。本模块只读取ARP表，并周期性地
+ * 主动发起ARP查询，以免表项因无流量经过 etharp_output 而老化。
+ * - **二层模式**: EthFast_SendRaw 以自定义EtherType直接发送以太网帧，
+ * 不带IP/UDP首部，用于专用的点对点采集网络 (见 stream_proto.h)。
+ * - **注意**: CCMRAM不在以太网DMA的可达范围内，采样数据不能零拷贝地挂到描述符上，
+ * 仍需一次CPU拷贝；相比原先 memcpy + pbuf_take 的两次拷贝已减少一次。
+ ******************************************************************************
+ */
+
+#include "eth_fastpath.h"
+#include <string.h>
+#include "debug_log.h"
+#include "stm32f4xx_hal.h"
+#include "lwip/netif.h"
+#include "lwip/etharp.h"
+#include "lwip/prot/ip.h"
+
+/* Private defines -----------------------------------------------------------*/
+// 帧内各字段的字节偏移
+#define OFS_ETH_DST             0
+#define OFS_ETH_SRC             6
+#define OFS_ETH_TYPE            12
+#define OFS_IP                  ETH_FAST_ETH_HDR_LEN
+#define OFS_IP_TOTLEN           (OFS_IP + 2)
+#define OFS_IP_ID               (OFS_IP + 4)
+#define OFS_IP_SRC              (OFS_IP + 12)
+#define OFS_IP_DST              (OFS_IP + 16)
+#define OFS_UDP                 (OFS_IP + ETH_FAST_IP_HDR_LEN)
+#define OFS_UDP_LEN             (OFS_UDP + 4)
+
+// 目的MAC未解析时的重试间隔 (etharp_query 每调用一次就会发出一个ARP请求)
+#define ETH_FAST_ARP_RETRY_MS   500
+
+/* External variables --------------------------------------------------------*/
+extern ETH_HandleTypeDef heth;  // 在 ethernetif.c 中定义
+extern struct netif gnetif;     // 在 lwip.c 中定义
+
+/* Private functions ---------------------------------------------------------*/
+
+// 以网络字节序(大端)写入16位值
+static inline void Put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+/**
+ * @brief 取得当前发送描述符的DMA缓冲区
+ * @retval 缓冲区指针; 描述符仍归DMA所有(发送环已满)时返回NULL
+ */
+static uint8_t *AcquireTxBuffer(void)
+{
+    ETH_DMADescTypeDef *desc = heth.TxDesc;
+
+    if ((desc->Status & ETH_DMATXDESC_OWN) != 0)
+    {
+        return NULL;
+    }
+    return (uint8_t *)desc->Buffer1Addr;
+}
+
+/**
+ * @brief 求目的IP对应的下一跳MAC地址
+ * @retval 1: 已得到MAC; 0: 尚未解析 (已发出ARP请求)
+ */
+static uint8_t ResolveNextHopMac(struct netif *nif, const ip4_addr_t *dst, uint8_t *mac)
+{
+    const ip4_addr_t *next_hop = dst;
+    struct eth_addr *eth_ret;
+    const ip4_addr_t *ip_ret;
+    uint8_t found = 0;
+
+    // 组播: MAC由IP地址直接映射 (01:00:5E + 低23位)
+    if (ip4_addr_ismulticast(dst))
+    {
+        mac[0] = 0x01; mac[1] = 0x00; mac[2] = 0x5E;
+        mac[3] = ip4_addr2(dst) & 0x7F;
+        mac[4] = ip4_addr3(dst);
+        mac[5] = ip4_addr4(dst);
+        return 1;
+    }
+    if (ip4_addr_isbroadcast(dst, nif))
+    {
+        memset(mac, 0xFF, 6);
+        return 1;
+    }
+
+    // 不在同一子网时，帧要发给网关
+    if (!ip4_addr_netcmp(dst, netif_ip4_addr(nif), netif_ip4_netmask(nif)))
+    {
+        next_hop = netif_ip4_gw(nif);
+    }
+
+    if (etharp_find_addr(nif, next_hop, &eth_ret, &ip_ret) >= 0)
+    {
+        memcpy(mac, eth_ret->addr, 6);
+        found = 1;
+    }
+
+    // 无论是否找到都发起一次查询: 未找到时触发解析，找到时为表项续期
+    etharp_query(nif, next_hop, NULL);
+    return found;
+}
+
+/**
+ * @brief 根据PCB和当前网络接口状态重建首部模板
+ * @retval 1: 模板可用; 0: 条件不满足
+ */
+static uint8_t BuildTemplate(EthFast_Template *tpl)
+{
+    struct netif *nif = &gnetif;
+    struct udp_pcb *pcb = tpl->pcb;
+    const ip4_addr_t *dst = ip_2_ip4(&tpl->dest_ip);
+    uint8_t *h = tpl->hdr;
+    uint8_t dst_mac[6];
+
+    if (!netif_is_up(nif) || !netif_is_link_up(nif) || ip4_addr_isany_val(*netif_ip4_addr(nif)))
+    {
+        return 0;
+    }
+    if (!ResolveNextHopMac(nif, dst, dst_mac))
+    {
+        return 0;
+    }
+
+    memset(h, 0, ETH_FAST_HDR_LEN);
+
+    // 以太网首部
+    memcpy(&h[OFS_ETH_DST], dst_mac, 6);
+    memcpy(&h[OFS_ETH_SRC], nif->hwaddr, 6);
+    Put16(&h[OFS_ETH_TYPE], 0x0800);
+
+    // IPv4首部 (总长度/标识逐包填写，校验和由硬件插入)
+    h[OFS_IP + 0] = 0x45;               // 版本4, 首部长度5*4字节
+    h[OFS_IP + 1] = pcb->tos;
+    h[OFS_IP + 8] = pcb->ttl;
+    h[OFS_IP + 9] = IP_PROTO_UDP;
+    memcpy(&h[OFS_IP_SRC], &netif_ip4_addr(nif)->addr, 4);    // addr已是网络字节序
+    memcpy(&h[OFS_IP_DST], &dst->addr, 4);
+
+    // UDP首部 (长度逐包填写，校验和由硬件插入)
+    Put16(&h[OFS_UDP + 0], pcb->local_port);
+    Put16(&h[OFS_UDP + 2], tpl->dest_port);
+
+    return 1;
+}
+
+/* Public functions ----------------------------------------------------------*/
+
+/**
+ * @brief 绑定PCB和目的地址，模板在后续 EthFast_Poll 中构建
+ * @param pcb 已绑定本地端口的UDP控制块，多个模板可共用
+ */
+void EthFast_Init(EthFast_Template *tpl, struct udp_pcb *pcb,
+                  const ip_addr_t *dest_ip, uint16_t dest_port)
+{
+    memset(tpl, 0, sizeof(*tpl));
+    tpl->pcb = pcb;
+    ip_addr_copy(tpl->dest_ip, *dest_ip);
+    tpl->dest_port = dest_port;
+    tpl->last_refresh_tick = HAL_GetTick() - ETH_FAST_ARP_REFRESH_MS; // 使首次Poll立即尝试
+}
+
+/**
+ * @brief 维护模板 (ARP解析、续期、IP变化)，应在主循环中被持续调用
+ */
+void EthFast_Poll(EthFast_Template *tpl)
+{
+    uint32_t now = HAL_GetTick();
+    uint32_t interval = tpl->ready ? ETH_FAST_ARP_REFRESH_MS : ETH_FAST_ARP_RETRY_MS;
+    uint8_t was_ready = tpl->ready;
+
+    if (tpl->pcb == NULL || (now - tpl->last_refresh_tick) < interval)
+    {
+        return;
+    }
+    tpl->last_refresh_tick = now;
+    tpl->ready = BuildTemplate(tpl);
+
+    if (tpl->ready && !was_ready)
+    {
+        const ip4_addr_t *ip = ip_2_ip4(&tpl->dest_ip);
+        Log_Info("OK: Ethernet fast path ready for %d.%d.%d.%d:%d (header template built).",
+                 ip4_addr1_16(ip), ip4_addr2_16(ip), ip4_addr3_16(ip), ip4_addr4_16(ip), tpl->dest_port);
+    }
+}
+
+/**
+ * @brief 通过快速通道发送一个UDP包
+ * @param hdr     紧跟UDP首部的流包头，可为NULL (hdr_len须为0)
+ * @param hdr_len 流包头字节数
+ * @param payload 负载数据，可位于CCMRAM (由CPU拷贝进DMA缓冲区)
+ * @param len     负载字节数
+ * @retval ERR_OK   已交给以太网DMA
+ * @retval ERR_MEM  发送描述符环已满，稍后重试
+ * @retval ERR_CONN 模板不可用 (目的MAC未解析或链路断开)，调用方应退回 udp_send
+ */
+err_t EthFast_SendUdp(EthFast_Template *tpl, const void *hdr, uint16_t hdr_len,
+                      const void *payload, uint16_t len)
+{
+    uint16_t udp_len = ETH_FAST_UDP_HDR_LEN + hdr_len + len;
+    uint8_t *frame;
+
+    if (!tpl->ready)
+    {
+        return ERR_CONN;
+    }
+    if (!netif_is_link_up(&gnetif))
+    {
+        tpl->ready = 0;
+        return ERR_CONN;
+    }
+    if ((uint32_t)ETH_FAST_HDR_LEN + hdr_len + len > ETH_TX_BUF_SIZE)
+    {
+        return ERR_VAL;
+    }
+
+    frame = AcquireTxBuffer();
+    if (frame == NULL)
+    {
+        return ERR_MEM;
+    }
+
+    memcpy(frame, tpl->hdr, ETH_FAST_HDR_LEN);
+    Put16(&frame[OFS_IP_TOTLEN], ETH_FAST_IP_HDR_LEN + udp_len);
+    Put16(&frame[OFS_IP_ID], tpl->ip_id++);
+    Put16(&frame[OFS_UDP_LEN], udp_len);
+    if (hdr_len != 0)
+    {
+        memcpy(frame + ETH_FAST_HDR_LEN, hdr, hdr_len);
+    }
+    memcpy(frame + ETH_FAST_HDR_LEN + hdr_len, payload, len);
+
+    return (HAL_ETH_TransmitFrame(&heth, ETH_FAST_ETH_HDR_LEN + ETH_FAST_IP_HDR_LEN + udp_len) == HAL_OK) ? ERR_OK : ERR_IF;
+}
+
+/**
+ * @brief 以自定义EtherType直接发送一个以太网帧 (二层流模式)
+ * @param dst_mac   目的MAC地址
+ * @param ethertype EtherType (主机字节序)
+ * @param hdr       紧跟以太网首部的流包头
+ * @param hdr_len   流包头字节数
+ * @param payload   负载数据，可位于CCMRAM
+ * @param len       负载字节数
+ * @retval ERR_OK / ERR_MEM(发送环已满) / ERR_CONN(链路断开) / ERR_VAL(帧过长)
+ */
+err_t EthFast_SendRaw(const uint8_t *dst_mac, uint16_t ethertype,
+                      const void *hdr, uint16_t hdr_len,
+                      const void *payload, uint16_t len)
+{
+    uint32_t frame_len = (uint32_t)ETH_FAST_ETH_HDR_LEN + hdr_len + len;
+    uint8_t *frame;
+
+    if (!netif_is_link_up(&gnetif))
+    {
+        return ERR_CONN;
+    }
+    if (frame_len > ETH_TX_BUF_SIZE)
+    {
+        return ERR_VAL;
+    }
+
+    frame = AcquireTxBuffer();
+    if (frame == NULL)
+    {
+        return ERR_MEM;
+    }
+
+    memcpy(&frame[OFS_ETH_DST], dst_mac, 6);
+    memcpy(&frame[OFS_ETH_SRC], gnetif.hwaddr, 6);
+    Put16(&frame[OFS_ETH_TYPE], ethertype);
+    memcpy(frame + ETH_FAST_ETH_HDR_LEN, hdr, hdr_len);
+    memcpy(frame + ETH_FAST_ETH_HDR_LEN + hdr_len, payload, len);
+
+    return (HAL_ETH_TransmitFrame(&heth, frame_len) == HAL_OK) ? ERR_OK : ERR_IF;
+}
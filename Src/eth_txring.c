@@ -0,0 +1,116 @@
+/**
+ ******************************************************************************
+ * @file    eth_txring.c
+ * @brief   以太网发送描述符环：发送完成中断驱动与占用统计
+ *
+ * @details
+ * - **环深度**: ETH_TXBUFNB / ETH_RXBUFNB 可在编译时覆盖 (见 stm32f4xx_hal_conf.h)，
+ * 收发DMA缓冲区的总大小在编译期与 ETH_DMA_BUF_BUDGET 比较。
+ * - **发送完成中断**: 驱动默认不为发送描述符置IC位，也不使能DMA发送中断，
+ * 数据发送只能在主循环的下一轮重试。这里为每个描述符置IC位并使能
+ * ETH_DMA_IT_T，描述符一释放就通过 HAL_ETH_TxCpltCallback 立即续发。
+ * 中断向量 ETH_IRQHandler 也定义在本文件: stm32f4xx_it.c 中用户代码区之外的函数
+ * 在CubeMX重新生成代码时会被删除。CubeMX中须保持ETH全局中断不勾选，否则向量重复定义。
+ * - **统计**: 每次发送前记录归DMA所有的描述符数，得到占用直方图和峰值，
+ * 用于按实际负载选择环深度。
+ ******************************************************************************
+ */
+
+#include "eth_txring.h"
+#include "adc_processing.h"
+#include "stm32f4xx_hal.h"
+
+/* Private defines -----------------------------------------------------------*/
+// 编译期检查 (兼容不支持 _Static_assert 的编译器)
+#define ETH_TXRING_STATIC_CHECK(name, cond) typedef char name[(cond) ? 1 : -1]
+
+ETH_TXRING_STATIC_CHECK(eth_dma_buf_budget_check,
+    (ETH_TXBUFNB * ETH_TX_BUF_SIZE + ETH_RXBUFNB * ETH_RX_BUF_SIZE) <= ETH_DMA_BUF_BUDGET);
+ETH_TXRING_STATIC_CHECK(eth_txbufnb_range_check, ETH_TXBUFNB >= 2 && ETH_TXBUFNB <= 32);
+
+/* External variables --------------------------------------------------------*/
+extern ETH_HandleTypeDef heth;  // 在 ethernetif.c 中定义
+
+/* Private variables ---------------------------------------------------------*/
+volatile EthTxRing_Stats g_eth_tx_stats;
+
+/* Public functions ----------------------------------------------------------*/
+
+/**
+ * @brief 为发送描述符置IC位并使能发送完成中断
+ * @note  须在 MX_LWIP_Init 之后、数据流开始之前调用
+ */
+void EthTxRing_Init(void)
+{
+    ETH_DMADescTypeDef *desc = heth.TxDesc;
+    uint32_t i;
+
+    // 链式描述符: 沿 Buffer2NextDescAddr 遍历一圈
+    for (i = 0; i < ETH_TXBUFNB; i++)
+    {
+        desc->Status |= ETH_DMATXDESC_IC;
+        desc = (ETH_DMADescTypeDef *)desc->Buffer2NextDescAddr;
+    }
+
+    __HAL_ETH_DMA_ENABLE_IT(&heth, ETH_DMA_IT_NIS | ETH_DMA_IT_T);
+    NVIC_SetPriority(ETH_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), ETH_IRQ_PRIORITY, 0));
+    NVIC_EnableIRQ(ETH_IRQn);
+}
+
+/**
+ * @brief 统计当前归DMA所有(尚未发送完成)的发送描述符数
+ */
+uint8_t EthTxRing_InFlight(void)
+{
+    const ETH_DMADescTypeDef *desc = heth.TxDesc;
+    uint8_t count = 0;
+    uint32_t i;
+
+    for (i = 0; i < ETH_TXBUFNB; i++)
+    {
+        if ((desc->Status & ETH_DMATXDESC_OWN) != 0)
+        {
+            count++;
+        }
+        desc = (const ETH_DMADescTypeDef *)desc->Buffer2NextDescAddr;
+    }
+    return count;
+}
+
+/**
+ * @brief 在每次发送前调用，记录发送环占用情况
+ * @retval 当前归DMA所有的描述符数
+ */
+uint8_t EthTxRing_RecordOccupancy(void)
+{
+    uint8_t in_flight = EthTxRing_InFlight();
+
+    g_eth_tx_stats.occupancy_hist[in_flight]++;
+    if (in_flight > g_eth_tx_stats.max_in_flight)
+    {
+        g_eth_tx_stats.max_in_flight = in_flight;
+    }
+    if (in_flight >= ETH_TXBUFNB)
+    {
+        g_eth_tx_stats.ring_full_events++;
+    }
+    return in_flight;
+}
+
+/**
+ * @brief 以太网全局中断 (优先级 ETH_IRQ_PRIORITY, 由 EthTxRing_Init 使能)
+ */
+void ETH_IRQHandler(void)
+{
+    HAL_ETH_IRQHandler(&heth);
+}
+
+/**
+ * @brief 以太网发送完成回调 (在 ETH_IRQHandler -> HAL_ETH_IRQHandler 中被调用)
+ */
+void HAL_ETH_TxCpltCallback(ETH_HandleTypeDef *heth)
+{
+    (void)heth;
+    g_eth_tx_stats.tx_complete_irqs++;
+    ADC_Processing_TxCompleteCallback();
+}
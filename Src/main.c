@@ -33,6 +33,13 @@
 #include "bsp_led.h"
 #include <stdio.h>          // ׼ͷļʹprintf
 #include "debug_log.h"      // Զ־ϵͳͷļ
+#include "eth_txring.h"     // ̫ͻͳ뻥
+#include "stream_governor.h" // ѹ״̬
+#include "uart_console.h"   // ڿ̨
+#include "telemetry.h"      // ң
+#include "profile.h"        // κʱͳ
+#include "cpu_load.h"       // ѭؼ
+#include "mem_watch.h"      // ڴˮλ
 #include "stm32f4xx_hal.h"  // HALͷļʹHAL_Delay
 /* USER CODE END Includes */
 
@@ -64,6 +71,7 @@ extern struct netif gnetif; // <--- 
 extern volatile int8_t g_process_buffer_idx;
 extern volatile uint32_t g_sample_count;
 extern volatile uint32_t g_udp_packets_sent;
+extern StreamGov g_stream_gov;
 /* USER CODE END PV */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -85,7 +93,11 @@ extern volatile uint8_t g_pc_ready_for_data;
  */
 int fputc(int ch, FILE *f)
 {
+#if USE_UART_DMA_CONSOLE
+    UartConsole_Putc((uint8_t)ch);  // DMAں̨ͣ
+#else
     HAL_UART_Transmit(&huart1, (uint8_t *)&ch, 1, 0xFFFF);
+#endif
     return ch;
 }
 
@@ -108,6 +120,7 @@ int main(void)
    */
   // SCB_DisableDCache(); // ͷļûֱӶ壬ʹCMSIS
 	
+  MemWatch_Init(); // ջͿɫ, ʼ֮ǰ
   /* USER CODE END 1 */
 
   /* MCU Configuration--------------------------------------------------------*/
@@ -137,6 +150,9 @@ int main(void)
   MX_USART1_UART_Init();
   MX_TIM2_Init();
   /* USER CODE BEGIN 2 */
+#if USE_UART_DMA_CONSOLE
+    UartConsole_Init();
+#endif
     printf("\r\n\r\n--- System Start ---\r\n");
     printf("Waiting for network interface to be up...\r\n");
 
@@ -147,11 +163,21 @@ int main(void)
 
     // ʼԶ־ϵͳ
     Log_Init(); //
+#if LOG_BENCHMARK
+    Log_Benchmark();
+#endif
 
     // ʼADCģ飬ADS8688оƬĳʼUDP
     ADC_Processing_Init(); //
     printf("ADS8688 & ADC Processing Initialized.\r\n");
 
+    // ԷͶң (洮״̬)
+    Telemetry_Init();
+    CpuLoad_Init();
+#if USE_PROFILING
+    Profile_Init(); // ɼ֮ǰͳƱ
+#endif
+
     // ʱһСᣬȴЭջPHYоƬȶ
     //HAL_Delay(1000);
 
@@ -163,24 +189,40 @@ int main(void)
 
   /* Infinite loop */
   /* USER CODE BEGIN WHILE */
+#if TELEMETRY_UART_STATUS
 		uint32_t last_status_tick = HAL_GetTick();
+#endif
 	
     while (1)
     {
     /* USER CODE END WHILE */
 
     /* USER CODE BEGIN 3 */
+        Telemetry_LoopTick(); // ѭֺʱͳ
 
 			
         /* ---  --- */
 
         // 1. LwIPЭջ
         //    ˺ѭбãԴĽաͺTCP/IP״̬
+        //    жϻֱдLwIPڼ̫жϡ
+        ETH_TX_LOCK();
         MX_LWIP_Process();
+        ETH_TX_UNLOCK();
+        CpuLoad_Account(CPU_SUB_LWIP);
 			
         // 2. ǵADCݴ
         //    ˺ǷвɼݻִӦ
         ADC_Processing_Task(); 
+        CpuLoad_Account(CPU_SUB_ADC);
+
+        // 3. ң (LwIP)
+        ETH_TX_LOCK();
+        Telemetry_Poll();
+        ETH_TX_UNLOCK();
+        CpuLoad_Account(CPU_SUB_TELEM);
+
+#if TELEMETRY_UART_STATUS
 				// =================================================================
 				// ===========        ״̬ģ (ֲ)      ===========
 				// =================================================================
@@ -192,10 +234,63 @@ int main(void)
 						printf("  STM32 IP: %s\n", ip4addr_ntoa(netif_ip4_addr(&gnetif)));
 						// UDPͼ
 						printf("  UDP Packets Sent: %lu\n", g_udp_packets_sent_count);
+						// ̫ͻ:  / ֵռ /  / жϴ
+						printf("  ETH TX Ring: depth=%u max=%u full=%lu irq=%lu\n",
+						       (unsigned)ETH_TXBUFNB, g_eth_tx_stats.max_in_flight,
+						       g_eth_tx_stats.ring_full_events, g_eth_tx_stats.tx_complete_irqs);
+						// ĬPCôǷ (δʱΪ1)
+						printf("  PC Ready For Data: %u\n", g_pc_ready_for_data);
+						// ѹ: (ȡ x2^level) / һ鷢ͺʱռڵı /  / ɼ˶
+						printf("  Governor: level=%u util=%u%% down=%lu dropped=%lu\n",
+						       g_stream_gov.level, g_stream_gov.last_util_pct,
+						       g_stream_gov.steps_down, g_stream_gov.blocks_dropped);
+						// ڿ̨: ֽ / ֵռ
+						printf("  Console: dropped=%lu max=%u/%u\n", g_console_stats.bytes_dropped,
+						       g_console_stats.max_used, (unsigned)UART_CONSOLE_BUF_SIZE);
+						// ѭͣ: һңڵһֺʱ, Լʱ(>=2^i us)ۼ
+						const StreamTelemetry *telem = Telemetry_Last();
+						printf("  Loop: max=%luus hist(us:count)", telem->loop_max_us);
+						for (uint32_t i = 0; i < STREAM_TELEM_LOOP_BINS; i++)
+						{
+								if (telem->loop_hist[i] != 0)
+								{
+										printf(" %lu:%lu", 1UL << i, telem->loop_hist[i]);
+								}
+						}
+						printf("\n");
+						// ѭ: ܸؼθ (ǧֱ), תռ, WFI
+						const CpuLoad_Stats *cpu = CpuLoad_GetStats();
+						printf("  CPU: load=%u.%u%% lwip=%u adc=%u telem=%u log=%u idle_passes=%lu/%lu sleeps=%lu\n",
+						       cpu->load_permille / 10U, cpu->load_permille % 10U,
+						       cpu->sub_permille[CPU_SUB_LWIP], cpu->sub_permille[CPU_SUB_ADC],
+						       cpu->sub_permille[CPU_SUB_TELEM], cpu->sub_permille[CPU_SUB_LOG],
+						       cpu->idle_passes, cpu->passes, cpu->sleeps);
+						// ڴˮλ (ϵ): ջ / LwIP / PBUFʣ / ־ / ƹһ
+						printf("  Memory: stack=%lu/%lu heap=%lu/%lu pbuf_free_min=%u/%u log=%u/%u pp_fill=%lu/%u\n",
+						       telem->stack_peak, telem->stack_size, telem->lwip_heap_peak, telem->lwip_heap_size,
+						       telem->pbuf_pool_min_free, telem->pbuf_pool_size, telem->log_ring_max,
+						       (unsigned)LOG_RING_WORDS, telem->pp_fill_peak, (unsigned)PING_PONG_BUFFER_SIZE);
+#if USE_PROFILING
+						Profile_Print();
+#endif
 						printf("----------------------\n");
 				}
+#endif
 
         Log_Process(); //
+        CpuLoad_Account(CPU_SUB_LOG);
+        CpuLoad_EndPass();
+
+#if CPU_LOAD_USE_WFI
+        // 4. ûдĹʱ˯ߵһжϡжϺټ, ֮ж
+        //    ԻỽWFI, жϺִ
+        __disable_irq();
+        if (!ADC_Processing_Pending() && !Log_Pending())
+        {
+            CpuLoad_Sleep();
+        }
+        __enable_irq();
+#endif
 
 		/* USER CODE END 3 */
 		}
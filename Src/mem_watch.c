@@ -0,0 +1,111 @@
+/**
+ ******************************************************************************
+ * @file    mem_watch.c
+ * @brief   内存高水位：主栈涂色、LwIP堆和内存池的最少剩余
+ *
+ * @details
+ * - **栈**: MemWatch_Init 把链接脚本为主栈保留的区域 (_estack 以下 _Min_Stack_Size 字节)
+ * 中当前栈指针以下的部分填成 MEM_WATCH_STACK_PATTERN。MemWatch_Update 从栈底向上找到第一个
+ * 被改写的字，即为上电以来的最大栈深度。中断也使用主栈，其深度一并计入。
+ * - **LwIP**: 堆和各 memp 池的峰值直接取自 lwip_stats，剩余 = 总数 - 峰值。
+ * - **其余**: 日志环峰值见 Log_GetHighWater，乒乓缓冲余量见 AdcProc_Stats.pp_fill_peak，
+ * 均由遥测包一起发出。PC端用 Tools/map_report.c 把这些峰值与链接map中各区域的用量对照。
+ * - **调用**: MemWatch_Update 由遥测模块在每次组包时调用 (主循环)。
+ ******************************************************************************
+ */
+
+#include "mem_watch.h"
+#include <string.h>
+#include "lwip/opt.h"
+#include "lwip/stats.h"
+#include "lwip/memp.h"
+
+/* External variables --------------------------------------------------------*/
+// 链接脚本中定义的符号 (取地址即为其值)
+extern uint32_t _estack;
+extern uint32_t _Min_Stack_Size;
+
+/* Private variables ---------------------------------------------------------*/
+static MemWatch_Stats g_mem_stats;
+static uint32_t *g_stack_bottom;
+
+/* Public functions ----------------------------------------------------------*/
+
+/**
+ * @brief 给主栈未使用的部分涂色
+ */
+void MemWatch_Init(void)
+{
+    uint32_t *p;
+    uint32_t *limit = (uint32_t *)((__get_MSP() - MEM_WATCH_PAINT_GUARD) & ~3U);
+
+    memset(&g_mem_stats, 0, sizeof(g_mem_stats));
+    g_mem_stats.stack_size = (uint32_t)&_Min_Stack_Size;
+    g_stack_bottom = (uint32_t *)((uint32_t)&_estack - g_mem_stats.stack_size);
+    for (p = g_stack_bottom; p < limit; p++)
+    {
+        *p = MEM_WATCH_STACK_PATTERN;
+    }
+
+    g_mem_stats.pbuf_pool_size = MEM_WATCH_UNKNOWN;
+    g_mem_stats.pbuf_pool_min_free = MEM_WATCH_UNKNOWN;
+    g_mem_stats.memp_min_free = MEM_WATCH_UNKNOWN;
+}
+
+/**
+ * @brief 重新扫描栈和LwIP统计
+ * @note  栈扫描从栈底开始，耗时与尚未用到的栈大小成正比
+ */
+void MemWatch_Update(void)
+{
+    const uint32_t *p = g_stack_bottom;
+    const uint32_t *top = &_estack;
+    uint32_t errors = 0;
+
+    while (p < top && *p == MEM_WATCH_STACK_PATTERN)
+    {
+        p++;
+    }
+    g_mem_stats.stack_peak = (uint32_t)(top - p) * 4U;
+
+#if LWIP_STATS && MEM_STATS
+    g_mem_stats.heap_size = lwip_stats.mem.avail;
+    g_mem_stats.heap_peak = lwip_stats.mem.max;
+    errors += lwip_stats.mem.err;
+#endif
+
+#if LWIP_STATS && MEMP_STATS
+    {
+        uint32_t i;
+        uint16_t min_free = MEM_WATCH_UNKNOWN;
+
+        for (i = 0; i < MEMP_MAX; i++)
+        {
+            const struct stats_mem *m = lwip_stats.memp[i];
+            uint16_t free_min = (uint16_t)(m->avail - m->max);
+
+            errors += m->err;
+            if (i == MEMP_PBUF_POOL)
+            {
+                g_mem_stats.pbuf_pool_size = (uint16_t)m->avail;
+                g_mem_stats.pbuf_pool_min_free = free_min;
+            }
+            else if (free_min < min_free)
+            {
+                min_free = free_min;
+                g_mem_stats.memp_min_pool = (uint8_t)i;
+            }
+        }
+        g_mem_stats.memp_min_free = min_free;
+    }
+#endif
+    g_mem_stats.mem_errors = errors;
+}
+
+/**
+ * @brief 最近一次 MemWatch_Update 的结果
+ */
+const MemWatch_Stats *MemWatch_GetStats(void)
+{
+    return &g_mem_stats;
+}
@@ -0,0 +1,141 @@
+/**
+ ******************************************************************************
+ * @file    profile.c
+ * @brief   代码段耗时统计：DWT周期计数器 + 每段的最小/最大/平均值和直方图
+ *
+ * @details
+ * - **目的**: 210kHz 采样率下每个样本只有 168MHz / 210kHz = 800 个周期的预算，
+ * TIM2中断和SPI接收回调每个样本各执行一次，主循环的发送路径与之争用剩余的周期。
+ * - **测量**: PROF_BEGIN/PROF_END 读取 DWT->CYCCNT，差值交给 Profile_Record 统计。
+ * USE_PROFILING 为0时宏展开为空，被测代码不受任何影响。
+ * - **存储**: 统计表位于CCMRAM，与中断使用的其它数据不争用SRAM总线。
+ * CCMRAM不在启动代码的清零范围内，由 Profile_Init 清零。
+ * - **并发**: Profile_Record 可在任意中断中调用。同一段不会重入自身，
+ * 读取方 (Profile_Snapshot) 与写入方之间的撕裂读只影响单个统计值，不做互斥。
+ * - **主机**: 定义 HOST_BUILD 时计数器取自 CLOCK_MONOTONIC (按 PROF_CPU_HZ 换算)，
+ * 仿真环境中得到同样格式的报告。
+ ******************************************************************************
+ */
+
+#include "profile.h"
+#include <stdio.h>
+#include <string.h>
+#include "adc_processing.h"
+
+/* Private defines -----------------------------------------------------------*/
+#ifdef HOST_BUILD
+#define PROF_CLZ(x)         ((uint32_t)__builtin_clz(x))
+#define PROF_CCMRAM
+#else
+#define PROF_CLZ(x)         __CLZ(x)
+#define PROF_CCMRAM         __attribute__((section(".ccmram")))
+#endif
+
+/* Private variables ---------------------------------------------------------*/
+PROF_CCMRAM static volatile Profile_Stats g_prof_stats[PROF_REGION_COUNT];
+
+static const char *const g_prof_names[PROF_REGION_COUNT] = {
+    "TIM2_IRQ", "SPI_RX_CB", "ADC_Task", "SendUDP",
+};
+
+/* Public functions ----------------------------------------------------------*/
+
+/**
+ * @brief 清零统计表并启动DWT周期计数器
+ */
+void Profile_Init(void)
+{
+    uint32_t i;
+
+#ifndef HOST_BUILD
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+    memset((void *)g_prof_stats, 0, sizeof(g_prof_stats));
+    for (i = 0; i < PROF_REGION_COUNT; i++)
+    {
+        g_prof_stats[i].min_cycles = 0xFFFFFFFFU;
+    }
+}
+
+/**
+ * @brief 记录一次执行的耗时
+ * @param region ProfRegion
+ * @param cycles 周期数
+ */
+void Profile_Record(uint32_t region, uint32_t cycles)
+{
+    volatile Profile_Stats *s = &g_prof_stats[region];
+    uint32_t bin = (cycles < 32U) ? 0U : 27U - PROF_CLZ(cycles);
+
+    s->count++;
+    s->total_cycles += cycles;
+    if (cycles < s->min_cycles)
+    {
+        s->min_cycles = cycles;
+    }
+    if (cycles > s->max_cycles)
+    {
+        s->max_cycles = cycles;
+    }
+    s->hist[(bin < STREAM_PROF_BINS) ? bin : (STREAM_PROF_BINS - 1)]++;
+}
+
+/**
+ * @brief 开始新的统计周期: 清除最小/最大值，累计值保留
+ */
+void Profile_ResetMinMax(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < PROF_REGION_COUNT; i++)
+    {
+        g_prof_stats[i].min_cycles = 0xFFFFFFFFU;
+        g_prof_stats[i].max_cycles = 0;
+    }
+}
+
+/**
+ * @brief 复制统计表到报告包 (seq 由调用者填写)
+ */
+void Profile_Snapshot(StreamProfile *report)
+{
+    uint32_t i, j;
+
+    report->magic          = STREAM_PROF_MAGIC;
+    report->version        = STREAM_PROF_VERSION;
+    report->n_regions      = STREAM_PROF_REGIONS;
+    report->cpu_hz         = PROF_CPU_HZ;
+    report->sample_rate_hz = ADC_SAMPLE_RATE_HZ;
+    for (i = 0; i < PROF_REGION_COUNT; i++)
+    {
+        report->region[i].count        = g_prof_stats[i].count;
+        report->region[i].min_cycles   = g_prof_stats[i].min_cycles;
+        report->region[i].max_cycles   = g_prof_stats[i].max_cycles;
+        report->region[i].total_cycles = g_prof_stats[i].total_cycles;
+        for (j = 0; j < STREAM_PROF_BINS; j++)
+        {
+            report->region[i].hist[j] = g_prof_stats[i].hist[j];
+        }
+    }
+}
+
+/**
+ * @brief 在控制台输出各段的统计 (上电以来的平均值, 本周期的最小/最大值)
+ */
+void Profile_Print(void)
+{
+    uint32_t i;
+
+    printf("  Profile (cycles, budget %lu/sample):\n", (unsigned long)(PROF_CPU_HZ / ADC_SAMPLE_RATE_HZ));
+    for (i = 0; i < PROF_REGION_COUNT; i++)
+    {
+        uint32_t count = g_prof_stats[i].count;
+        uint32_t mean = (count != 0) ? (uint32_t)(g_prof_stats[i].total_cycles / count) : 0;
+        uint32_t min = g_prof_stats[i].min_cycles;
+
+        printf("    %-10s n=%lu mean=%lu min=%lu max=%lu\n", g_prof_names[i], (unsigned long)count,
+               (unsigned long)mean, (unsigned long)((min == 0xFFFFFFFFU) ? 0 : min),
+               (unsigned long)g_prof_stats[i].max_cycles);
+    }
+}
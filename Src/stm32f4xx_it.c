@@ -30,6 +30,8 @@
 #include "adc_processing.h"
 #include <stdio.h> // ȷstdio.hͷļ
 #include "debug_log.h"
+#include "profile.h"
+#include "timebase.h"
 
 /* USER CODE END Includes */
 
@@ -39,6 +41,7 @@
 // Զص
 void SPI1_DMA_RX_Callback(void);
 void SPI1_DMA_Error_Callback(void);
+void SPI1_Abort_Callback(void);
 
 /* USER CODE END TD */
 
@@ -54,6 +57,8 @@ void SPI1_DMA_Error_Callback(void);
 
 /* Private variables ---------------------------------------------------------*/
 /* USER CODE BEGIN PV */
+volatile uint32_t g_timebase_ms_hi = 0;     // HALĸ32λ ( timebase.h)
+volatile uint32_t g_lost_ticks_folded = 0;  // Ѳ lost_ticks  g_lost_ticks_posted (ֻTIM2жд)
 
 /* USER CODE END PV */
 
@@ -200,6 +205,10 @@ void SysTick_Handler(void)
   /* USER CODE END SysTick_IRQn 0 */
   HAL_IncTick();
   /* USER CODE BEGIN SysTick_IRQn 1 */
+  if (HAL_GetTick() == 0U)
+  {
+    g_timebase_ms_hi++; //  (Լ49.7)
+  }
 
   /* USER CODE END SysTick_IRQn 1 */
 }
@@ -247,26 +256,47 @@ void TIM2_IRQHandler(void)
   /* USER CODE BEGIN TIM2_IRQn 0 */
 //	LL_TIM_ClearFlag_UPDATE(TIM2);
 //  printf("TIM2 Interrupt Triggered!\n");
+  PROF_BEGIN(PROF_TIM2_IRQ);
+  // жʱļֵΪӸ¼˴ӳ (ϼ, ʱ)
+  uint32_t lat = LL_TIM_GetCounter(TIM2);
   // ǷǸж
   if(LL_TIM_IsActiveFlag_UPDATE(TIM2) == 1)
   {
+    uint32_t bin = (lat < 8U) ? 0U : 29U - __CLZ(lat);
+    g_adc_stats.tim2_lat_hist[(bin < STREAM_TELEM_LAT_BINS) ? bin : (STREAM_TELEM_LAT_BINS - 1)]++;
+    if (lat > g_adc_stats.tim2_lat_max)
+    {
+      g_adc_stats.tim2_lat_max = (uint16_t)lat;
+    }
+
     // жϱ־λ
     LL_TIM_ClearFlag_UPDATE(TIM2);
 
+    // lost_ticks ֻڱжд: ɼص(ȼ1)ᱻжռдᶪʧ
+    // ˻صֻۼ g_lost_ticks_postedﲢ롣صȵǼDMAæ־
+    // µĴֵǰ֮ǰȫȱʧ
+    uint32_t posted = g_lost_ticks_posted;
+    g_adc_stats.lost_ticks += posted - g_lost_ticks_folded;
+    g_lost_ticks_folded = posted;
+
     // ʱжϴһβɼ
     // DMAǷУֹ
     if (g_dma_busy_flag == 0)
     {
       g_dma_busy_flag = 1;            // DMAæ־
+      g_lost_ticks_at_trigger = g_adc_stats.lost_ticks; // ǰȱʧڶڱ֮ǰ
       g_start_acquisition_flag = 1;   // ѭһDMA
     }
     else
     {
         // DMAȻæ˵ʿܹߣCPUDMA
-        // һ־
         //Log_Debug("IT: DMA Busy! Skipping one sample.");
+        // : λڴ֮һ¼Ϊȱ
+        g_adc_stats.tim2_skips++;
+        g_adc_stats.lost_ticks++;
     }
   }
+  PROF_END(PROF_TIM2_IRQ);
   /* USER CODE END TIM2_IRQn 0 */
 }
 
@@ -288,10 +318,11 @@ void SPI1_IRQHandler(void)
         (void)SPI1->SR;
 
         // 3. ¼һ־
-        Log_Debug("ERR: SPI1 Overrun! State has been reset.");
+        Log_Error("ERR: SPI1 Overrun! State has been reset.");
+        g_adc_stats.spi_overruns++;
 
-        // 4. ֶDMAæ־㣬ʱжϾͿԴһβɼ
-        g_dma_busy_flag = 0;
+        // 4. δɵһ֡ͨͬȻDMAæ־ ( adc_processing.c)
+        SPI1_Abort_Callback();
     }
   /* USER CODE END SPI1_IRQn 0 */
   /* USER CODE BEGIN SPI1_IRQn 1 */
@@ -0,0 +1,665 @@
+/**
+ ******************************************************************************
+ * @file    stream_ctrl.c
+ * @brief   数据流订阅表与控制端口
+ *
+ * @details
+ * - **订阅表**: 每个订阅者有自己的目的地址、通道掩码和抽取因子。表项0为默认PC
+ * (DEST_IP_ADDR:DEST_PORT)，全通道、不抽取、无包头，与原有接收程序兼容。
+ * - **控制端口**: 在 STREAM_CTRL_PORT 上接收 StreamCtrlRequest (见 stream_proto.h)，
+ * 用于订阅、退订和列出订阅表。修改只写入 req_* 字段，在下一个乒乓块开始时生效。
+ * - **分组**: 通道掩码、抽取因子和格式都相同的订阅者归为一组。每个包只从CCMRAM
+ * 组装一次，再依次发给组内各成员；全通道且不抽取的组直接引用CCMRAM数据，不需组装。
+ * - **组播**: 目的地址可以是组播地址，多个接收端加入同一组播组即可共享一个订阅，
+ * 板端只发送一份。
+ * - **目的地址限制**: 订阅、退订和信用授予默认只接受请求方自己的源地址，
+ * 组播和代他人订阅须在编译时放宽 STREAM_DEST_POLICY (见 stream_ctrl.h)，防止控制端口被用作反射放大器。
+ * - **信用流控**: 接收端用 STREAM_CMD_CREDIT 授予包序号上限后，该订阅者进入流控状态。
+ * 每块开始时检查信用能否覆盖整块，不足时按 STREAM_CREDIT_POLICY 暂缓、加倍抽取或跳过，
+ * 跳过的块在接收端表现为块序号跳变，而包序号保持连续，因此不会出现无法区分的丢包。
+ * - **调速**: 背压调速器的级别在块之间生效，带包头订阅者的抽取因子乘以 2^级别
+ * (见 stream_governor.c)。实际抽取因子写在包头中，变化的块置 STREAM_FLAG_RATE_CHANGE。
+ * 无包头的默认PC流无法通知抽取因子，由调速器决定哪些块整块跳过 (STREAM_GOV_SKIP_RAW)。
+ * - **时钟交换**: STREAM_CMD_TIME 立即以板子的微秒时间戳应答，PC据此估计时钟偏差，
+ * 把带时间戳 (STREAM_SUB_OPT_TIME) 的数据包的到达时刻换算为板子时钟。
+ * - **并发**: 控制端口回调在 MX_LWIP_Process 中执行，主循环已屏蔽以太网中断，
+ * 与发送完成中断中的续发互斥。
+ ******************************************************************************
+ */
+
+#include "stream_ctrl.h"
+#include <string.h>
+#include "debug_log.h"
+#include "stream_proto.h"
+#include "timebase.h"
+#include "lwip/pbuf.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define ALL_CHANNELS_MASK       ((uint8_t)((1U << CHANNELS_PER_SAMPLE) - 1U))
+
+/* Private variables ---------------------------------------------------------*/
+volatile uint8_t g_pc_ready_for_data = 1;
+
+static StreamSubscriber g_subs[STREAM_MAX_SUBSCRIBERS];
+static StreamGroup      g_groups[STREAM_MAX_SUBSCRIBERS];
+static uint8_t          g_group_count = 0;
+static uint32_t         g_raw_blocks_skipped = 0;   // 无包头的订阅者被调速跳过的块数 (遥测)
+static uint8_t          g_group_channels[STREAM_MAX_SUBSCRIBERS][CHANNELS_PER_SAMPLE]; // 各组的通道号列表
+static struct udp_pcb  *g_data_pcb;     // 数据发送共用的PCB (源端口)
+static struct udp_pcb  *g_ctrl_pcb;     // 控制端口
+
+// 子集包的组装缓冲区 (位于SRAM)
+static uint16_t g_assembly_buf[STREAM_CHUNK_SIZE / sizeof(uint16_t)] __attribute__((aligned(4)));
+
+/* Private function prototypes -----------------------------------------------*/
+static void    CtrlRecv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port);
+static uint8_t HandleSubscribe(const StreamCtrlRequest *req, const ip_addr_t *addr, u16_t port);
+static uint8_t HandleUnsubscribe(const StreamCtrlRequest *req, const ip_addr_t *addr, u16_t port);
+static void    HandleCredit(const StreamCtrlCredit *grant, const ip_addr_t *addr, u16_t port);
+static void    HandleTime(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port, uint64_t t2);
+static uint8_t CreditDecimation(const StreamSubscriber *sub);
+static uint16_t PacketsPerBlock(uint8_t channel_mask, uint8_t decimation);
+static uint8_t GovernedDecimation(uint8_t decimation, uint8_t gov_level);
+static int8_t  FindSubscriber(const ip_addr_t *ip, uint16_t port);
+static void    SetupSubscriber(uint8_t idx, const ip_addr_t *ip, uint16_t port, uint8_t raw);
+
+/* Public functions ----------------------------------------------------------*/
+
+/**
+ * @brief 初始化订阅表 (表项0为默认PC) 并打开控制端口
+ * @param data_pcb 数据发送用的UDP控制块，所有订阅者共用其源端口
+ */
+void StreamCtrl_Init(struct udp_pcb *data_pcb, const ip_addr_t *default_ip, uint16_t default_port)
+{
+    memset(g_subs, 0, sizeof(g_subs));
+    g_data_pcb = data_pcb;
+
+    SetupSubscriber(0, default_ip, default_port, 1);
+    g_subs[0].req_active       = 1;
+    g_subs[0].req_channel_mask = ALL_CHANNELS_MASK;
+    g_subs[0].req_decimation   = 1;
+    StreamCtrl_Commit(0, 1);
+
+    g_ctrl_pcb = udp_new();
+    if (g_ctrl_pcb == NULL || udp_bind(g_ctrl_pcb, IP_ADDR_ANY, STREAM_CTRL_PORT) != ERR_OK)
+    {
+        Log_Warn("!!! WARNING: Stream control port unavailable. Only the default PC is served.");
+        return;
+    }
+    udp_recv(g_ctrl_pcb, CtrlRecv, NULL);
+    Log_Info("OK: Stream control port listening on %d.", STREAM_CTRL_PORT);
+}
+
+/**
+ * @brief 维护各订阅者的快速通道模板，应在主循环中屏蔽以太网中断后调用
+ */
+void StreamCtrl_Poll(void)
+{
+#if USE_ETH_FASTPATH
+    uint8_t i;
+
+    for (i = 0; i < STREAM_MAX_SUBSCRIBERS; i++)
+    {
+        if (g_subs[i].active || g_subs[i].req_active)
+        {
+            EthFast_Poll(&g_subs[i].tpl);
+        }
+    }
+#endif
+}
+
+/**
+ * @brief 使控制端口的修改生效，按调速级别和信用确定本块各订阅者的抽取因子并重新分组
+ * @note  只能在乒乓块之间调用 (由发送任务在开始新块时调用)
+ * @param gov_level 背压调速器的级别，只作用于带包头的订阅者
+ * @param raw_send  0: 本块跳过无包头的订阅者 (调速器的决定，见 StreamGov_BlockStart)
+ * @retval 1: 可以开始发送本块; 0: BUFFER策略下有订阅者信用不足，本块暂缓
+ */
+uint8_t StreamCtrl_Commit(uint8_t gov_level, uint8_t raw_send)
+{
+    uint8_t decim[STREAM_MAX_SUBSCRIBERS];  // 本块的实际抽取因子, 0表示跳过
+    uint32_t now = HAL_GetTick();
+    uint8_t wait = 0;
+    uint8_t i, g, ch;
+
+    for (i = 0; i < STREAM_MAX_SUBSCRIBERS; i++)
+    {
+        StreamSubscriber *sub = &g_subs[i];
+
+        sub->active       = sub->req_active;
+        sub->channel_mask = sub->req_channel_mask;
+        sub->decimation   = sub->raw ? sub->req_decimation : GovernedDecimation(sub->req_decimation, gov_level);
+        decim[i] = sub->active ? sub->decimation : 0;
+        if (sub->raw && !raw_send)
+        {
+            decim[i] = 0;   // 调速器跳过本块，与信用无关
+            continue;
+        }
+        if (!sub->active || !sub->credit_enabled)
+        {
+            continue;
+        }
+        if ((now - sub->last_grant_tick) > STREAM_CREDIT_TIMEOUT_MS)
+        {
+            sub->credit_enabled = 0;    // 接收端已不再授予，恢复无条件发送
+            continue;
+        }
+        decim[i] = CreditDecimation(sub);
+#if STREAM_CREDIT_POLICY == STREAM_CREDIT_POLICY_BUFFER
+        if (decim[i] == 0)
+        {
+            wait = 1;
+        }
+#endif
+    }
+
+    g_pc_ready_for_data = !g_subs[0].active || !raw_send || decim[0] != 0;
+    if (wait)
+    {
+        return 0;
+    }
+
+    g_group_count = 0;
+    for (i = 0; i < STREAM_MAX_SUBSCRIBERS; i++)
+    {
+        StreamSubscriber *sub = &g_subs[i];
+
+        if (decim[i] == 0)
+        {
+            if (sub->active)
+            {
+                sub->blocks_dropped++;
+                if (sub->raw && !raw_send)
+                {
+                    g_raw_blocks_skipped++;
+                }
+            }
+            continue;
+        }
+        sub->rate_changed = (decim[i] != sub->block_decimation);
+        sub->block_decimation = decim[i];
+
+        for (g = 0; g < g_group_count; g++)
+        {
+            if (g_groups[g].channel_mask == sub->channel_mask &&
+                g_groups[g].decimation == decim[i] &&
+                g_groups[g].raw == sub->raw)
+            {
+                break;
+            }
+        }
+
+        StreamGroup *grp = &g_groups[g];
+        if (g == g_group_count)
+        {
+            uint8_t n = 0;
+
+            memset(grp, 0, sizeof(*grp));
+            grp->channel_mask = sub->channel_mask;
+            grp->decimation   = decim[i];
+            grp->raw          = sub->raw;
+            for (ch = 0; ch < CHANNELS_PER_SAMPLE; ch++)
+            {
+                if (sub->channel_mask & (1U << ch))
+                {
+                    g_group_channels[g][n++] = ch;
+                }
+            }
+            grp->frame_bytes       = n * sizeof(uint16_t);
+            grp->frames            = SAMPLES_PER_CHANNEL / grp->decimation;
+            grp->frames_per_packet = STREAM_CHUNK_SIZE / grp->frame_bytes;
+            grp->packets           = PacketsPerBlock(grp->channel_mask, grp->decimation);
+            g_group_count++;
+        }
+        grp->members[grp->n_members++] = i;
+    }
+    return 1;
+}
+
+/**
+ * @brief 是否有无包头的订阅者 (默认PC) 将在下一块发送，供调速器决定是否按窗口评估
+ */
+uint8_t StreamCtrl_RawActive(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < STREAM_MAX_SUBSCRIBERS; i++)
+    {
+        if (g_subs[i].raw && g_subs[i].req_active)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 无包头的订阅者 (默认PC) 被调速器整块跳过的块数 (STREAM_GOV_SKIP_RAW)
+ */
+uint32_t StreamCtrl_RawBlocksSkipped(void)
+{
+    return g_raw_blocks_skipped;
+}
+
+uint8_t StreamCtrl_GroupCount(void)
+{
+    return g_group_count;
+}
+
+const StreamGroup *StreamCtrl_Group(uint8_t idx)
+{
+    return &g_groups[idx];
+}
+
+StreamSubscriber *StreamCtrl_Subscriber(uint8_t idx)
+{
+    return &g_subs[idx];
+}
+
+/**
+ * @brief 组装一个组的第 packet 个包的负载
+ * @param block   乒乓块 (CCMRAM，按帧交织: block[帧 * CHANNELS_PER_SAMPLE + 通道])
+ * @param payload 输出: 负载指针，指向CCMRAM或组装缓冲区，在下一次组装前有效
+ * @retval 负载字节数
+ */
+uint16_t StreamCtrl_Assemble(const StreamGroup *grp, const uint16_t *block, uint16_t packet,
+                             const uint8_t **payload)
+{
+    uint32_t first = (uint32_t)packet * grp->frames_per_packet;
+    uint32_t count = grp->frames - first;
+    const uint8_t *channels = g_group_channels[grp - g_groups];
+    uint8_t n_ch = grp->frame_bytes / sizeof(uint16_t);
+    uint32_t stride = (uint32_t)grp->decimation * CHANNELS_PER_SAMPLE;
+    const uint16_t *src;
+    uint16_t *dst = g_assembly_buf;
+    uint32_t f;
+    uint8_t c;
+
+    if (count > grp->frames_per_packet)
+    {
+        count = grp->frames_per_packet;
+    }
+
+    // 全通道且不抽取: 数据在CCMRAM中本就连续
+    if (grp->channel_mask == ALL_CHANNELS_MASK && grp->decimation == 1)
+    {
+        *payload = (const uint8_t *)&block[first * CHANNELS_PER_SAMPLE];
+        return (uint16_t)(count * grp->frame_bytes);
+    }
+
+    src = &block[first * stride];
+    for (f = 0; f < count; f++)
+    {
+        for (c = 0; c < n_ch; c++)
+        {
+            *dst++ = src[channels[c]];
+        }
+        src += stride;
+    }
+    *payload = (const uint8_t *)g_assembly_buf;
+    return (uint16_t)(count * grp->frame_bytes);
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief 控制端口接收回调 (在 MX_LWIP_Process 中被调用)
+ */
+static void CtrlRecv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+    uint64_t now_us = Timebase_NowUs(); // 时钟交换的 t2, 尽早记录
+    StreamCtrlRequest req;
+    StreamCtrlCredit grant;
+    uint8_t reply_buf[sizeof(StreamCtrlReply) + STREAM_MAX_SUBSCRIBERS * sizeof(StreamSubInfo)];
+    StreamCtrlReply *reply = (StreamCtrlReply *)reply_buf;
+    uint16_t reply_len = sizeof(StreamCtrlReply);
+    struct pbuf *rp;
+    uint8_t i;
+
+    (void)arg;
+
+    if (p->tot_len >= sizeof(StreamCtrlTime) && pbuf_get_at(p, 0) == STREAM_CMD_TIME)
+    {
+        HandleTime(pcb, p, addr, port, now_us);
+        return;
+    }
+
+    // 信用授予频繁且无应答，单独处理
+    if (p->tot_len >= sizeof(grant) && pbuf_get_at(p, 0) == STREAM_CMD_CREDIT)
+    {
+        pbuf_copy_partial(p, &grant, sizeof(grant), 0);
+        pbuf_free(p);
+        HandleCredit(&grant, addr, port);
+        return;
+    }
+
+    if (p->tot_len < sizeof(req))
+    {
+        pbuf_free(p);
+        return;
+    }
+    pbuf_copy_partial(p, &req, sizeof(req), 0);
+    pbuf_free(p);
+
+    memset(reply_buf, 0, sizeof(reply_buf));
+    reply->cmd = req.cmd | STREAM_CMD_REPLY;
+
+    switch (req.cmd)
+    {
+    case STREAM_CMD_SUBSCRIBE:
+        reply->status = HandleSubscribe(&req, addr, port);
+        break;
+    case STREAM_CMD_UNSUBSCRIBE:
+        reply->status = HandleUnsubscribe(&req, addr, port);
+        break;
+    case STREAM_CMD_LIST:
+        for (i = 0; i < STREAM_MAX_SUBSCRIBERS; i++)
+        {
+            const StreamSubscriber *sub = &g_subs[i];
+            StreamSubInfo *info = (StreamSubInfo *)&reply_buf[reply_len];
+
+            if (!sub->req_active)
+            {
+                continue;
+            }
+            memcpy(info->dest_ip, &ip_2_ip4(&sub->ip)->addr, 4);
+            info->dest_port    = sub->port;
+            info->channel_mask = sub->req_channel_mask;
+            info->decimation   = sub->req_decimation;
+            info->flags        = (sub->raw ? STREAM_SUB_FLAG_RAW : 0) |
+                                 (sub->credit_enabled ? STREAM_SUB_FLAG_CREDIT : 0) |
+                                 (sub->timestamps ? STREAM_SUB_FLAG_TIME : 0);
+            info->seq            = sub->seq;
+            info->seq_limit      = sub->credit_limit;
+            info->blocks_dropped = sub->blocks_dropped;
+            reply_len += sizeof(StreamSubInfo);
+            reply->count++;
+        }
+        reply->status = STREAM_STATUS_OK;
+        break;
+    default:
+        reply->status = STREAM_STATUS_UNSUPPORTED;
+        break;
+    }
+
+    rp = pbuf_alloc(PBUF_TRANSPORT, reply_len, PBUF_RAM);
+    if (rp == NULL)
+    {
+        return;
+    }
+    pbuf_take(rp, reply_buf, reply_len);
+    udp_sendto(pcb, rp, addr, port);
+    pbuf_free(rp);
+}
+
+/**
+ * @brief 解析请求中的目的地址，0.0.0.0 / 端口0 表示请求方自己
+ * @retval 1: 目的地址符合 STREAM_DEST_POLICY; 0: 拒绝
+ */
+static uint8_t ResolveDest(const uint8_t *dest_ip, uint16_t dest_port, const ip_addr_t *addr, u16_t port,
+                           ip_addr_t *ip, uint16_t *dport)
+{
+    if (dest_ip[0] == 0 && dest_ip[1] == 0 && dest_ip[2] == 0 && dest_ip[3] == 0)
+    {
+        ip_addr_copy(*ip, *addr);
+    }
+    else
+    {
+        IP4_ADDR(ip_2_ip4(ip), dest_ip[0], dest_ip[1], dest_ip[2], dest_ip[3]);
+    }
+    *dport = (dest_port != 0) ? dest_port : port;
+
+#if STREAM_DEST_POLICY == STREAM_DEST_POLICY_ANY
+    return 1;
+#elif STREAM_DEST_POLICY == STREAM_DEST_POLICY_MULTICAST
+    return (ip_addr_cmp(ip, addr) || ip4_addr_ismulticast(ip_2_ip4(ip))) ? 1U : 0U;
+#else
+    return ip_addr_cmp(ip, addr) ? 1U : 0U;
+#endif
+}
+
+static uint8_t HandleSubscribe(const StreamCtrlRequest *req, const ip_addr_t *addr, u16_t port)
+{
+    ip_addr_t ip;
+    uint16_t dport;
+    int8_t idx;
+
+#if STREAM_MODE == STREAM_MODE_RAW_ETH
+    (void)req; (void)addr; (void)port; (void)ip; (void)dport; (void)idx;
+    return STREAM_STATUS_UNSUPPORTED;   // 二层模式只有一个固定的目的MAC
+#else
+    // 抽取因子须为2的幂且整除每块帧数，使抽取相位在块之间保持连续
+    if (req->channel_mask == 0 || (req->channel_mask & ~ALL_CHANNELS_MASK) != 0 ||
+        req->decimation == 0 || (req->decimation & (req->decimation - 1)) != 0 ||
+        (SAMPLES_PER_CHANNEL % req->decimation) != 0)
+    {
+        return STREAM_STATUS_BAD_ARG;
+    }
+
+    if (!ResolveDest(req->dest_ip, req->dest_port, addr, port, &ip, &dport))
+    {
+        Log_Warn("WARN: Subscribe for %d.%d.%d.%d from %d.%d.%d.%d denied (STREAM_DEST_POLICY).",
+                 ip4_addr1_16(ip_2_ip4(&ip)), ip4_addr2_16(ip_2_ip4(&ip)), ip4_addr3_16(ip_2_ip4(&ip)),
+                 ip4_addr4_16(ip_2_ip4(&ip)), ip4_addr1_16(ip_2_ip4(addr)), ip4_addr2_16(ip_2_ip4(addr)),
+                 ip4_addr3_16(ip_2_ip4(addr)), ip4_addr4_16(ip_2_ip4(addr)));
+        return STREAM_STATUS_DENIED;
+    }
+    idx = FindSubscriber(&ip, dport);
+    if (idx < 0)
+    {
+        // 找一个当前块和下一块都不使用的空闲表项
+        for (idx = 0; idx < STREAM_MAX_SUBSCRIBERS; idx++)
+        {
+            if (!g_subs[idx].active && !g_subs[idx].req_active)
+            {
+                break;
+            }
+        }
+        if (idx == STREAM_MAX_SUBSCRIBERS)
+        {
+            return STREAM_STATUS_FULL;
+        }
+        SetupSubscriber((uint8_t)idx, &ip, dport, 0);
+    }
+    else if (g_subs[idx].raw &&
+             (req->channel_mask != ALL_CHANNELS_MASK || req->decimation != 1 ||
+              (req->options & STREAM_SUB_OPT_TIME) != 0))
+    {
+        // 默认PC表项发送无包头的原始格式，旧接收端按全通道、不抽取解析，改掩码/抽取/时间戳都会使其错位
+        Log_Warn("WARN: Subscribe for the default PC must keep mask=0x%02X decim=1 without timestamps.",
+                 ALL_CHANNELS_MASK);
+        return STREAM_STATUS_BAD_ARG;
+    }
+
+    g_subs[idx].req_channel_mask = req->channel_mask;
+    g_subs[idx].req_decimation   = req->decimation;
+    g_subs[idx].req_active       = 1;
+    g_subs[idx].timestamps       = (req->options & STREAM_SUB_OPT_TIME) ? 1U : 0U; // 只影响包头，立即生效
+    Log_Info("INFO: Subscriber %d: %d.%d.%d.%d:%d mask=0x%02X decim=%d", idx,
+             ip4_addr1_16(ip_2_ip4(&ip)), ip4_addr2_16(ip_2_ip4(&ip)), ip4_addr3_16(ip_2_ip4(&ip)),
+             ip4_addr4_16(ip_2_ip4(&ip)), dport, req->channel_mask, req->decimation);
+    return STREAM_STATUS_OK;
+#endif
+}
+
+static uint8_t HandleUnsubscribe(const StreamCtrlRequest *req, const ip_addr_t *addr, u16_t port)
+{
+    ip_addr_t ip;
+    uint16_t dport;
+    int8_t idx;
+
+    if (!ResolveDest(req->dest_ip, req->dest_port, addr, port, &ip, &dport))
+    {
+        return STREAM_STATUS_DENIED;
+    }
+    idx = FindSubscriber(&ip, dport);
+    if (idx < 0)
+    {
+        return STREAM_STATUS_NOT_FOUND;
+    }
+    g_subs[idx].req_active = 0;
+    Log_Info("INFO: Subscriber %d removed.", idx);
+    return STREAM_STATUS_OK;
+}
+
+/**
+ * @brief 时钟交换: 原样返回PC的 t1，附上收到请求 (t2) 和发出应答 (t3) 的板子时刻
+ */
+static void HandleTime(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port, uint64_t t2)
+{
+    StreamCtrlTime req;
+    StreamCtrlTimeReply reply;
+    struct pbuf *rp;
+
+    pbuf_copy_partial(p, &req, sizeof(req), 0);
+    pbuf_free(p);
+
+    rp = pbuf_alloc(PBUF_TRANSPORT, sizeof(reply), PBUF_RAM);
+    if (rp == NULL)
+    {
+        return; // PC超时后重发
+    }
+    memset(&reply, 0, sizeof(reply));
+    reply.cmd    = STREAM_CMD_TIME | STREAM_CMD_REPLY;
+    reply.status = STREAM_STATUS_OK;
+    reply.t1     = req.t1;
+    reply.t2_us  = t2;
+    reply.t3_us  = Timebase_NowUs();
+    pbuf_take(rp, &reply, sizeof(reply));
+    udp_sendto(pcb, rp, addr, port);
+    pbuf_free(rp);
+}
+
+/**
+ * @brief 处理信用授予: 首次授予使该订阅者进入流控状态
+ */
+static void HandleCredit(const StreamCtrlCredit *grant, const ip_addr_t *addr, u16_t port)
+{
+    ip_addr_t ip;
+    uint16_t dport;
+    int8_t idx;
+    StreamSubscriber *sub;
+
+    if (!ResolveDest(grant->dest_ip, grant->dest_port, addr, port, &ip, &dport))
+    {
+        return;
+    }
+    idx = FindSubscriber(&ip, dport);
+    if (idx < 0)
+    {
+        return;
+    }
+
+    sub = &g_subs[idx];
+    if (!sub->credit_enabled)
+    {
+        sub->credit_enabled = 1;
+        sub->credit_limit = grant->seq_limit;
+        Log_Info("INFO: Subscriber %d: credit flow control enabled.", idx);
+    }
+    else if ((int32_t)(grant->seq_limit - sub->credit_limit) > 0)
+    {
+        sub->credit_limit = grant->seq_limit;   // 上限只增不减，乱序到达的旧授予被忽略
+    }
+    sub->last_grant_tick = HAL_GetTick();
+}
+
+/**
+ * @brief 按剩余信用确定本块的抽取因子
+ * @retval 抽取因子; 0表示本块跳过
+ */
+static uint8_t CreditDecimation(const StreamSubscriber *sub)
+{
+    int32_t credits = (int32_t)(sub->credit_limit - sub->seq);
+    uint8_t d = sub->decimation;
+
+    if (credits >= (int32_t)PacketsPerBlock(sub->channel_mask, d))
+    {
+        return d;
+    }
+#if STREAM_CREDIT_POLICY == STREAM_CREDIT_POLICY_DECIMATE
+    // 原始格式没有包头，接收端无从得知抽取因子的变化
+    while (!sub->raw && d <= 64 && (SAMPLES_PER_CHANNEL % (d * 2)) == 0)
+    {
+        d *= 2;
+        if (credits >= (int32_t)PacketsPerBlock(sub->channel_mask, d))
+        {
+            return d;
+        }
+    }
+#endif
+    return 0;
+}
+
+/**
+ * @brief 抽取因子乘以 2^gov_level，不超过每块帧数允许的最大2的幂(且不超过128)
+ */
+static uint8_t GovernedDecimation(uint8_t decimation, uint8_t gov_level)
+{
+    // 空闲表项的抽取因子为0
+    while (gov_level-- > 0 && decimation != 0 && decimation <= 64 && (SAMPLES_PER_CHANNEL % (decimation * 2)) == 0)
+    {
+        decimation *= 2;
+    }
+    return decimation;
+}
+
+/**
+ * @brief 一个块按给定通道掩码和抽取因子需要的包数
+ */
+static uint16_t PacketsPerBlock(uint8_t channel_mask, uint8_t decimation)
+{
+    uint16_t frame_bytes = 0;
+    uint16_t frames = SAMPLES_PER_CHANNEL / decimation;
+    uint16_t per_packet;
+    uint8_t ch;
+
+    for (ch = 0; ch < CHANNELS_PER_SAMPLE; ch++)
+    {
+        if (channel_mask & (1U << ch))
+        {
+            frame_bytes += sizeof(uint16_t);
+        }
+    }
+    per_packet = STREAM_CHUNK_SIZE / frame_bytes;
+    return (frames + per_packet - 1) / per_packet;
+}
+
+/**
+ * @brief 按目的地址查找正在使用或待生效的表项
+ * @note  默认PC的表项被再次订阅时保持无包头格式，只改变通道和抽取因子
+ * @retval 表项下标; 未找到返回-1
+ */
+static int8_t FindSubscriber(const ip_addr_t *ip, uint16_t port)
+{
+    int8_t i;
+
+    for (i = 0; i < STREAM_MAX_SUBSCRIBERS; i++)
+    {
+        if ((g_subs[i].active || g_subs[i].req_active) &&
+            g_subs[i].port == port && ip_addr_cmp(&g_subs[i].ip, ip))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void SetupSubscriber(uint8_t idx, const ip_addr_t *ip, uint16_t port, uint8_t raw)
+{
+    StreamSubscriber *sub = &g_subs[idx];
+
+    ip_addr_copy(sub->ip, *ip);
+    sub->port        = port;
+    sub->raw         = raw;
+    sub->seq         = 0;
+    sub->send_errors = 0;
+    sub->credit_enabled = 0;
+    sub->blocks_dropped = 0;
+    sub->block_decimation = 0;
+    sub->timestamps  = 0;
+#if USE_ETH_FASTPATH
+    // 帧头模板需要目的MAC，在主循环中待ARP解析完成后构建
+    EthFast_Init(&sub->tpl, g_data_pcb, ip, port);
+#endif
+}
@@ -0,0 +1,183 @@
+/**
+ ******************************************************************************
+ * @file    stream_governor.c
+ * @brief   背压调速器：以降低速率代替整块丢弃
+ *
+ * @details
+ * - **问题**: 发送跟不上采集时，SPI1_DMA_RX_Callback 只能整块(16KB, 约39ms)丢弃，
+ * 数据流出现大段空洞，频谱分析无法使用。
+ * - **观测量**: 每块从乒乓切换到最后一包离开发送环的耗时占块周期的比例(即乒乓
+ * 缓冲区和发送环的占用程度)、每块的pbuf/udp_send失败次数，以及采集端的丢块事件。
+ * 只看数据交给发送环的时刻是不够的: 低速率时整块都能放进环里，链路已饱和也察觉不到。
+ * - **调节**: 任一指标越过上限就降一级，使带包头订阅流的抽取因子加倍，发送量减半；
+ * 连续若干块负载低于上限的一半以下才升一级，避免在两级之间振荡。
+ * - **通知**: 级别在块之间生效，抽取因子写在每个包头中，变化后的第一块
+ * 置 STREAM_FLAG_RATE_CHANGE。无包头的默认PC流无法通知抽取因子，改为每 2^级别 块只发一块
+ * (STREAM_GOV_SKIP_RAW)，此时按这 2^级别 块的平均负载调整级别: 一块整块原始数据在慢速链路上
+ * 要占用几个块周期，而在正常链路上也占块周期的三成以上，逐块评估会过度降级且永远不能恢复。
+ * - **并发**: BlockReady/BlockDropped 在采集中断中调用，优先级高于调用其余函数的以太网中断，
+ * 若直接修改级别等状态，会打断 Evaluate 的读-改-写。因此采集中断只递增计数 (单写者)，
+ * 由发送一侧在开始新块 (BlockStart) 和发送环排空 (TxDrained) 时处理，效果与在中断中评估相同。
+ * - 本文件不依赖HAL，时间由调用方传入，可在主机上直接编译仿真。
+ ******************************************************************************
+ */
+
+#include "stream_governor.h"
+#include <string.h>
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief 评估一块的负载，窗口内各块都已评估时按平均负载调整级别
+ */
+static void Evaluate(StreamGov *gov, uint32_t now_ms)
+{
+    uint32_t util = (now_ms - gov->ready_tick) * 100U / gov->block_period_ms;
+    uint8_t congested;
+
+    gov->awaiting_drain = 0;
+    gov->last_util_pct = (util > 255U) ? 255U : (uint8_t)util;
+    gov->window_util += util;
+    if (++gov->window_done < gov->window)
+    {
+        return;
+    }
+
+    util = gov->window_util / gov->window;
+    congested = gov->pending_down || util >= STREAM_GOV_HIGH_PCT || gov->fail_count >= STREAM_GOV_FAIL_LIMIT;
+    gov->pending_down = 0;
+    gov->fail_count = 0;
+    gov->window_util = 0;
+    gov->window_done = 0;
+
+    if (congested)
+    {
+        gov->calm_blocks = 0;
+        if (gov->level < STREAM_GOV_MAX_LEVEL)
+        {
+            gov->level++;
+            gov->steps_down++;
+        }
+    }
+    else if (util <= STREAM_GOV_LOW_PCT)
+    {
+        gov->calm_blocks += gov->window;
+        if (gov->level > 0 && gov->calm_blocks >= STREAM_GOV_RECOVER_BLOCKS)
+        {
+            gov->level--;
+            gov->steps_up++;
+            gov->calm_blocks = 0;
+        }
+    }
+    else
+    {
+        gov->calm_blocks = 0;
+    }
+}
+
+/**
+ * @brief 处理采集中断提交的就绪和丢块计数 (只在发送一侧调用)
+ */
+static void Collect(StreamGov *gov)
+{
+    uint32_t ready, tick;
+
+    // 采集中断先写时间再加计数，两次读到相同的计数说明时间属于这一块
+    do
+    {
+        ready = gov->blocks_ready;
+        tick = gov->ready_tick_post;
+    } while (ready != gov->blocks_ready);
+
+    if (gov->blocks_dropped != gov->dropped_seen)
+    {
+        gov->dropped_seen = gov->blocks_dropped;
+        gov->pending_down = 1;
+    }
+    if (ready != gov->ready_seen)
+    {
+        gov->ready_seen = ready;
+        // 上一块的发送环到新块就绪时仍未排空，则以就绪时刻完成评估 (耗时已达整个块周期)
+        if (gov->awaiting_drain)
+        {
+            Evaluate(gov, tick);
+        }
+        gov->ready_tick = tick;
+    }
+}
+
+/* Public functions ----------------------------------------------------------*/
+
+void StreamGov_Init(StreamGov *gov, uint32_t block_period_ms)
+{
+    memset(gov, 0, sizeof(*gov));
+    gov->block_period_ms = block_period_ms;
+    gov->window = 1;
+}
+
+/**
+ * @brief 一个缓冲区填满并交给发送任务 (在采集中断中调用)
+ * @note  只记录时间，评估推迟到发送任务开始这一块时 (StreamGov_BlockStart)
+ */
+void StreamGov_BlockReady(StreamGov *gov, uint32_t now_ms)
+{
+    gov->ready_tick_post = now_ms;
+    gov->blocks_ready++;
+}
+
+/**
+ * @brief 发送任务仍未完成上一块，采集端整块丢弃 (在采集中断中调用)
+ * @note  下次评估时无条件降级
+ */
+void StreamGov_BlockDropped(StreamGov *gov)
+{
+    gov->blocks_dropped++;
+}
+
+/**
+ * @brief 发送任务开始新的一块，处理采集中断的计数后返回本块使用的级别
+ * @param raw_governed 1: 无包头的默认PC流参与调速 (整块跳过)
+ * @param raw_send     输出: 本块是否发送无包头的默认PC流
+ * @note  默认PC流参与调速时，级别L下每 2^L 块 (一个窗口) 只在第一块发送整块原始数据，
+ *        这块的发送环往往要到后几块才排空，因此按整个窗口的平均负载调整级别。
+ *        BUFFER策略暂缓一块时会对同一块重复调用，结果不变。
+ */
+uint8_t StreamGov_BlockStart(StreamGov *gov, uint8_t raw_governed, uint8_t *raw_send)
+{
+    Collect(gov);
+    if (gov->window_done == 0)
+    {
+        gov->window = raw_governed ? (uint8_t)(1U << gov->level) : 1U;
+    }
+    *raw_send = (gov->window_done == 0);
+    return gov->level;
+}
+
+/**
+ * @brief 记录一次pbuf分配或udp_send失败
+ */
+void StreamGov_SendFailed(StreamGov *gov)
+{
+    gov->fail_count++;
+}
+
+/**
+ * @brief 当前块的最后一包已交给发送环
+ */
+void StreamGov_BlockSent(StreamGov *gov)
+{
+    gov->awaiting_drain = 1;
+}
+
+/**
+ * @brief 发送环已排空 (在发送完成中断或主循环中调用)，评估当前块并调整级别
+ * @note  新级别在下一块开始时由 StreamCtrl_Commit 生效
+ */
+void StreamGov_TxDrained(StreamGov *gov, uint32_t now_ms)
+{
+    Collect(gov);
+    if (gov->awaiting_drain)
+    {
+        Evaluate(gov, now_ms);
+    }
+}
@@ -0,0 +1,263 @@
+/**
+ ******************************************************************************
+ * @file    telemetry.c
+ * @brief   二进制遥测包：周期性发送各模块的计数器、队列峰值和延迟直方图
+ *
+ * @details
+ * - **格式**: 每 TELEMETRY_PERIOD_MS 发送一个定长的 StreamTelemetry (见 stream_proto.h)，
+ * 直接从各模块的统计结构体复制字段，不做任何字符串格式化。PC端用 Tools/telemetry_mon.c 解码。
+ * - **目的地址**: 默认 DEST_IP_ADDR:STREAM_TELEM_PORT; 收到发往 STREAM_TELEM_PORT 的登记包
+ * (StreamTelemRegister) 后改为该包的源地址，监视程序只需周期性地发一个登记包即可接收遥测。
+ * 其他包被忽略; TELEMETRY_REG_POLICY 默认只接受默认PC的登记，网段内其他主机无法把遥测引走。
+ * - **主循环耗时**: 每轮主循环调用 Telemetry_LoopTick，用DWT周期计数器统计单轮耗时直方图。
+ * - **内存**: 组包时调用 MemWatch_Update 重新扫描栈和LwIP统计。
+ * - **耗时报告**: 启用 USE_PROFILING 时，每个遥测包之后紧跟一个同序号的 StreamProfile。
+ * - **并发**: Telemetry_Poll 经LwIP发送，须在主循环中屏蔽以太网中断后调用。
+ ******************************************************************************
+ */
+
+#include "telemetry.h"
+#include <string.h>
+#include "adc_processing.h"
+#include "cpu_load.h"
+#include "debug_log.h"
+#include "mem_watch.h"
+#include "profile.h"
+#include "eth_txring.h"
+#include "stream_ctrl.h"
+#include "stream_governor.h"
+#include "uart_console.h"
+#include "lwip/udp.h"
+#include "lwip/pbuf.h"
+
+/* Private defines -----------------------------------------------------------*/
+// 遥测包中的各段负载与 CpuSubsystem 一一对应
+typedef char telem_cpu_subs_check[(CPU_SUB_COUNT == STREAM_TELEM_CPU_SUBS) ? 1 : -1];
+typedef char telem_mem_unknown_check[(MEM_WATCH_UNKNOWN == STREAM_TELEM_MEM_UNKNOWN) ? 1 : -1];
+
+/* External variables --------------------------------------------------------*/
+extern StreamGov g_stream_gov;  // 在 adc_processing.c 中定义
+
+/* Private variables ---------------------------------------------------------*/
+static struct udp_pcb *g_telem_pcb;
+static ip_addr_t g_telem_ip;
+static uint16_t  g_telem_port;
+static uint32_t  g_telem_last_tick;
+static StreamTelemetry g_telem;         // 最近一次发送的内容
+#if USE_PROFILING
+static StreamProfile g_telem_prof;
+#endif
+
+// 主循环耗时统计
+static uint32_t g_loop_cycles;
+static uint32_t g_loop_max_us;
+static uint32_t g_loop_hist[STREAM_TELEM_LOOP_BINS];
+
+/* Private function prototypes -----------------------------------------------*/
+static void TelemRecv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port);
+static void Build(StreamTelemetry *t);
+static void Send(const void *data, uint16_t len);
+
+/* Public functions ----------------------------------------------------------*/
+
+/**
+ * @brief 打开遥测端口并启动DWT周期计数器
+ * @note  须在 MX_LWIP_Init 之后调用
+ */
+void Telemetry_Init(void)
+{
+    IP4_ADDR(&g_telem_ip, DEST_IP_ADDR0, DEST_IP_ADDR1, DEST_IP_ADDR2, DEST_IP_ADDR3);
+    g_telem_port = STREAM_TELEM_PORT;
+    g_telem_last_tick = HAL_GetTick();
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    g_loop_cycles = DWT->CYCCNT;
+
+    g_telem_pcb = udp_new();
+    if (g_telem_pcb == NULL || udp_bind(g_telem_pcb, IP_ADDR_ANY, STREAM_TELEM_PORT) != ERR_OK)
+    {
+        Log_Warn("!!! WARNING: Telemetry port unavailable.");
+        g_telem_pcb = NULL;
+        return;
+    }
+    udp_recv(g_telem_pcb, TelemRecv, NULL);
+    Log_Info("OK: Telemetry every %d ms on port %d.", TELEMETRY_PERIOD_MS, STREAM_TELEM_PORT);
+}
+
+/**
+ * @brief 在每轮主循环开始时调用，记录上一轮的耗时
+ */
+void Telemetry_LoopTick(void)
+{
+    uint32_t now = DWT->CYCCNT;
+    uint32_t us = (now - g_loop_cycles) / (SystemCoreClock / 1000000U);
+    uint32_t bin = (us == 0) ? 0 : 31U - __CLZ(us);
+
+    g_loop_cycles = now;
+    g_loop_hist[(bin < STREAM_TELEM_LOOP_BINS) ? bin : (STREAM_TELEM_LOOP_BINS - 1)]++;
+    if (us > g_loop_max_us)
+    {
+        g_loop_max_us = us;
+    }
+}
+
+/**
+ * @brief 到达发送周期时组装并发送一个遥测包
+ */
+void Telemetry_Poll(void)
+{
+    if (HAL_GetTick() - g_telem_last_tick < TELEMETRY_PERIOD_MS)
+    {
+        return;
+    }
+    g_telem_last_tick = HAL_GetTick();
+
+    Build(&g_telem);
+    g_loop_max_us = 0;
+    Send(&g_telem, sizeof(g_telem));
+
+#if USE_PROFILING
+    Profile_Snapshot(&g_telem_prof);
+    Profile_ResetMinMax();
+    g_telem_prof.seq = g_telem.seq;
+    Send(&g_telem_prof, sizeof(g_telem_prof));
+#endif
+}
+
+/**
+ * @brief 最近一次组装的遥测内容 (供串口状态块使用)
+ */
+const StreamTelemetry *Telemetry_Last(void)
+{
+    return &g_telem;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief 登记包把遥测目的地址改为其源地址 (须带 STREAM_TELEM_REG_MAGIC 且符合 TELEMETRY_REG_POLICY)
+ */
+static void TelemRecv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+    StreamTelemRegister reg;
+    uint16_t len;
+
+    (void)arg;
+    (void)pcb;
+    len = pbuf_copy_partial(p, &reg, sizeof(reg), 0);
+    pbuf_free(p);
+    if (len < sizeof(reg) || reg.magic != STREAM_TELEM_REG_MAGIC)
+    {
+        return;     // 不是登记包 (误发的数据、端口扫描等)
+    }
+#if TELEMETRY_REG_POLICY == TELEMETRY_REG_DEFAULT_PC
+    ip_addr_t pc;
+    IP4_ADDR(&pc, DEST_IP_ADDR0, DEST_IP_ADDR1, DEST_IP_ADDR2, DEST_IP_ADDR3);
+    if (!ip_addr_cmp(addr, &pc))
+    {
+        Log_Warn("WARN: Telemetry registration from %d.%d.%d.%d denied (TELEMETRY_REG_POLICY).",
+                 ip4_addr1_16(ip_2_ip4(addr)), ip4_addr2_16(ip_2_ip4(addr)),
+                 ip4_addr3_16(ip_2_ip4(addr)), ip4_addr4_16(ip_2_ip4(addr)));
+        return;
+    }
+#endif
+    ip_addr_copy(g_telem_ip, *addr);
+    g_telem_port = port;
+}
+
+/**
+ * @brief 发送一个遥测包; 失败时不重试，下个周期的累计计数器会补上这一包的内容
+ */
+static void Send(const void *data, uint16_t len)
+{
+    struct pbuf *p;
+
+    if (g_telem_pcb == NULL)
+    {
+        return;
+    }
+    p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+    if (p == NULL)
+    {
+        return;
+    }
+    pbuf_take(p, data, len);
+    udp_sendto(g_telem_pcb, p, &g_telem_ip, g_telem_port);
+    pbuf_free(p);
+}
+
+/**
+ * @brief 从各模块的统计结构体复制字段
+ */
+static void Build(StreamTelemetry *t)
+{
+    const CpuLoad_Stats *cpu = CpuLoad_GetStats();
+    const MemWatch_Stats *mem = MemWatch_GetStats();
+    uint32_t i, log_dropped = 0;
+
+    MemWatch_Update();
+
+    for (i = 0; i < LOG_LEVEL_COUNT; i++)
+    {
+        log_dropped += Log_GetDropped(i);
+    }
+
+    t->magic             = STREAM_TELEM_MAGIC;
+    t->version           = STREAM_TELEM_VERSION;
+    t->reserved          = 0;
+    t->seq++;
+    t->uptime_ms         = HAL_GetTick();
+
+    t->blocks_acquired   = g_adc_stats.blocks_acquired;
+    t->samples           = t->blocks_acquired * PING_PONG_BUFFER_SIZE + g_sample_count;
+    t->blocks_dropped    = g_stream_gov.blocks_dropped;
+    t->tim2_skips        = g_adc_stats.tim2_skips;
+    t->spi_overruns      = g_adc_stats.spi_overruns;
+    t->spi_dma_errors    = g_adc_stats.spi_dma_errors;
+
+    t->packets_sent      = g_udp_packets_sent_count;
+    t->pbuf_failures     = g_adc_stats.pbuf_failures;
+    t->send_errors       = g_adc_stats.send_errors;
+    t->eth_ring_full     = g_eth_tx_stats.ring_full_events;
+    t->eth_tx_irqs       = g_eth_tx_stats.tx_complete_irqs;
+
+    t->eth_ring_depth    = ETH_TXBUFNB;
+    t->eth_ring_max      = g_eth_tx_stats.max_in_flight;
+    t->gov_level         = g_stream_gov.level;
+    t->gov_util_pct      = g_stream_gov.last_util_pct;
+    t->log_ring_max      = (uint16_t)Log_GetHighWater();
+    t->console_max       = g_console_stats.max_used;
+    t->log_dropped       = log_dropped;
+    t->console_dropped   = g_console_stats.bytes_dropped;
+
+    t->cpu_load_permille = cpu->load_permille;
+    t->tim2_lat_max      = g_adc_stats.tim2_lat_max;
+    t->loop_max_us       = g_loop_max_us;
+    for (i = 0; i < STREAM_TELEM_LAT_BINS; i++)
+    {
+        t->tim2_lat_hist[i] = g_adc_stats.tim2_lat_hist[i];
+    }
+    memcpy(t->loop_hist, g_loop_hist, sizeof(t->loop_hist));
+    for (i = 0; i < STREAM_TELEM_CPU_SUBS; i++)
+    {
+        t->cpu_sub_permille[i] = cpu->sub_permille[i];
+    }
+    t->loop_passes       = cpu->passes;
+    t->loop_idle_passes  = cpu->idle_passes;
+
+    t->stack_size        = mem->stack_size;
+    t->stack_peak        = mem->stack_peak;
+    t->lwip_heap_size    = mem->heap_size;
+    t->lwip_heap_peak    = mem->heap_peak;
+    t->pbuf_pool_size    = mem->pbuf_pool_size;
+    t->pbuf_pool_min_free = mem->pbuf_pool_min_free;
+    t->memp_min_free     = mem->memp_min_free;
+    t->memp_min_pool     = mem->memp_min_pool;
+    t->reserved2         = 0;
+    t->mem_errors        = mem->mem_errors;
+    t->log_ring_words    = LOG_RING_WORDS;
+    t->pp_block_samples  = PING_PONG_BUFFER_SIZE;
+    t->pp_fill_peak      = g_adc_stats.pp_fill_peak;
+    t->raw_blocks_skipped = StreamCtrl_RawBlocksSkipped();
+}
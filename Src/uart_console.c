@@ -0,0 +1,197 @@
+/**
+ ******************************************************************************
+ * @file    uart_console.c
+ * @brief   非阻塞串口控制台：输出环形缓冲区 + USART1 发送DMA
+ *
+ * @details
+ * - **问题**: fputc 原先对每个字符调用 HAL_UART_Transmit 并等待发送完成，
+ * 115200 波特率下每字节约87us，5秒一次的状态块(约400字节)会让主循环停顿
+ * 几十毫秒，期间数据发送和LwIP处理都得不到执行。
+ * - **做法**: fputc 只把字符放入环形缓冲区，由 DMA2 Stream7 (通道4, USART1_TX)
+ * 在后台发送。每次DMA传输缓冲区中连续的一段，传输完成中断推进读指针并启动下一段。
+ * - **缓冲区满**: 直接丢弃并计数，绝不等待。二进制日志帧 (UartConsole_Write)
+ * 要么整帧放入要么整帧丢弃，避免在串口上出现残帧。
+ * - 缓冲区位于普通SRAM (DMA无法访问CCMRAM)。
+ * - 改动前后的主循环停顿对照: 目标板上切换 USE_UART_DMA_CONSOLE 比较状态块的 Loop 直方图;
+ * 主机仿真见 Tools/lwip_bench 的 -u block|dma。
+ * - 中断向量 DMA2_Stream7_IRQHandler 与其NVIC配置一起放在本文件: stm32f4xx_it.c 中用户代码区
+ * 之外的函数在CubeMX重新生成代码时会被删除。CubeMX中须保持 DMA2 Stream7 中断不勾选。
+ ******************************************************************************
+ */
+
+#include "uart_console.h"
+#include "usart.h"
+#include "stm32f4xx_ll_dma.h"
+#include "stm32f4xx_ll_usart.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define UART_CONSOLE_MASK   (UART_CONSOLE_BUF_SIZE - 1U)
+
+// 编译期检查 (兼容不支持 _Static_assert 的编译器)
+typedef char uart_console_pow2_check[((UART_CONSOLE_BUF_SIZE & UART_CONSOLE_MASK) == 0) ? 1 : -1];
+
+/* Private variables ---------------------------------------------------------*/
+volatile UartConsole_Stats g_console_stats;
+
+static uint8_t s_buf[UART_CONSOLE_BUF_SIZE];
+static volatile uint32_t s_head;        // 主循环写入位置 (自由增长)
+static volatile uint32_t s_tail;        // DMA中断推进的读取位置 (自由增长)
+static volatile uint16_t s_dma_len;     // 正在传输的字节数，0 表示DMA空闲
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief 若DMA空闲且缓冲区有数据，则启动一次传输
+ * @note  在DMA中断中调用，或在屏蔽DMA中断的情况下从主循环调用
+ */
+static void StartTransfer(void)
+{
+    uint32_t pending, offset, len;
+
+    if (s_dma_len != 0)
+    {
+        return;
+    }
+    pending = s_head - s_tail;
+    if (pending == 0)
+    {
+        return;
+    }
+    // 每次只传输到缓冲区末尾，回绕部分由下一次传输发送
+    offset = s_tail & UART_CONSOLE_MASK;
+    len = UART_CONSOLE_BUF_SIZE - offset;
+    if (len > pending)
+    {
+        len = pending;
+    }
+
+    s_dma_len = (uint16_t)len;
+    LL_DMA_SetMemoryAddress(DMA2, LL_DMA_STREAM_7, (uint32_t)&s_buf[offset]);
+    LL_DMA_SetDataLength(DMA2, LL_DMA_STREAM_7, len);
+    LL_DMA_EnableStream(DMA2, LL_DMA_STREAM_7);
+    g_console_stats.dma_transfers++;
+}
+
+/**
+ * @brief 主循环中启动DMA: 与传输完成中断互斥
+ */
+static void Kick(void)
+{
+    uint32_t used = s_head - s_tail;
+
+    if (used > g_console_stats.max_used)
+    {
+        g_console_stats.max_used = (uint16_t)used;
+    }
+    if (s_dma_len == 0)
+    {
+        NVIC_DisableIRQ(DMA2_Stream7_IRQn);
+        StartTransfer();
+        NVIC_EnableIRQ(DMA2_Stream7_IRQn);
+    }
+}
+
+/* Public functions ----------------------------------------------------------*/
+
+/**
+ * @brief 配置 DMA2 Stream7 并打开 USART1 的DMA发送请求
+ * @note  须在 MX_DMA_Init 和 MX_USART1_UART_Init 之后、第一次 printf 之前调用
+ */
+void UartConsole_Init(void)
+{
+    LL_DMA_DisableStream(DMA2, LL_DMA_STREAM_7);
+    while (LL_DMA_IsEnabledStream(DMA2, LL_DMA_STREAM_7))
+    {
+    }
+    LL_DMA_SetChannelSelection(DMA2, LL_DMA_STREAM_7, LL_DMA_CHANNEL_4);
+    LL_DMA_SetDataTransferDirection(DMA2, LL_DMA_STREAM_7, LL_DMA_DIRECTION_MEMORY_TO_PERIPH);
+    LL_DMA_SetStreamPriorityLevel(DMA2, LL_DMA_STREAM_7, LL_DMA_PRIORITY_LOW);
+    LL_DMA_SetMode(DMA2, LL_DMA_STREAM_7, LL_DMA_MODE_NORMAL);
+    LL_DMA_SetPeriphIncMode(DMA2, LL_DMA_STREAM_7, LL_DMA_PERIPH_NOINCREMENT);
+    LL_DMA_SetMemoryIncMode(DMA2, LL_DMA_STREAM_7, LL_DMA_MEMORY_INCREMENT);
+    LL_DMA_SetPeriphSize(DMA2, LL_DMA_STREAM_7, LL_DMA_PDATAALIGN_BYTE);
+    LL_DMA_SetMemorySize(DMA2, LL_DMA_STREAM_7, LL_DMA_MDATAALIGN_BYTE);
+    LL_DMA_DisableFifoMode(DMA2, LL_DMA_STREAM_7);
+    LL_DMA_SetPeriphAddress(DMA2, LL_DMA_STREAM_7, LL_USART_DMA_GetRegAddr(USART1));
+
+    LL_DMA_ClearFlag_TC7(DMA2);
+    LL_DMA_ClearFlag_TE7(DMA2);
+    LL_DMA_EnableIT_TC(DMA2, LL_DMA_STREAM_7);
+    LL_DMA_EnableIT_TE(DMA2, LL_DMA_STREAM_7);
+
+    s_head = 0;
+    s_tail = 0;
+    s_dma_len = 0;
+
+    LL_USART_EnableDMAReq_TX(USART1);
+    NVIC_SetPriority(DMA2_Stream7_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), UART_CONSOLE_IRQ_PRIORITY, 0));
+    NVIC_EnableIRQ(DMA2_Stream7_IRQn);
+}
+
+/**
+ * @brief 放入一个字符，缓冲区满则丢弃 (从不阻塞)
+ */
+void UartConsole_Putc(uint8_t ch)
+{
+    if (s_head - s_tail >= UART_CONSOLE_BUF_SIZE)
+    {
+        g_console_stats.bytes_dropped++;
+        return;
+    }
+    s_buf[s_head & UART_CONSOLE_MASK] = ch;
+    s_head++;
+    Kick();
+}
+
+/**
+ * @brief 整段放入，空间不足则整段丢弃
+ * @retval 放入的字节数 (len 或 0)
+ */
+uint16_t UartConsole_Write(const uint8_t *data, uint16_t len)
+{
+    uint32_t i;
+
+    if (UART_CONSOLE_BUF_SIZE - (s_head - s_tail) < len)
+    {
+        g_console_stats.bytes_dropped += len;
+        return 0;
+    }
+    for (i = 0; i < len; i++)
+    {
+        s_buf[(s_head + i) & UART_CONSOLE_MASK] = data[i];
+    }
+    s_head += len;
+    Kick();
+    return len;
+}
+
+/**
+ * @brief DMA2 Stream7 中断: 释放已发送的一段并启动下一段
+ */
+void UartConsole_DmaIRQHandler(void)
+{
+    if (LL_DMA_IsActiveFlag_TC7(DMA2) == 1)
+    {
+        LL_DMA_ClearFlag_TC7(DMA2);
+        s_tail += s_dma_len;
+        s_dma_len = 0;
+        StartTransfer();
+    }
+    else if (LL_DMA_IsActiveFlag_TE7(DMA2) == 1)
+    {
+        // 传输错误: 丢弃这一段，继续发送后面的数据
+        LL_DMA_ClearFlag_TE7(DMA2);
+        g_console_stats.dma_errors++;
+        s_tail += s_dma_len;
+        s_dma_len = 0;
+        StartTransfer();
+    }
+}
+
+/**
+ * @brief DMA2 Stream7 全局中断 (USART1_TX, 优先级 UART_CONSOLE_IRQ_PRIORITY, 由 UartConsole_Init 使能)
+ */
+void DMA2_Stream7_IRQHandler(void)
+{
+    UartConsole_DmaIRQHandler();
+}
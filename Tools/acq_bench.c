@@ -0,0 +1,777 @@
+/**
+ ******************************************************************************
+ * @file    acq_bench.c
+ * @brief   采集链路的主机基准: 固件源码原样编译，在虚拟时间中驱动 ADS8688/SPI/DMA/TIM2 模型
+ *
+ * @details
+ * 编译 (在 Tools/ 下):
+ *   gcc -O2 -Wall -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast -no-pie -Ihostsim -I../Inc \
+ *       -o acq_bench acq_bench.c hostsim/hostsim.c ../Src/adc_processing.c ../Src/ads8688.c \
+ *       ../Src/stm32f4xx_it.c ../Src/stream_ctrl.c ../Src/stream_governor.c ../Src/eth_txring.c \
+ *       ../Src/eth_fastpath.c ../Src/spi.c ../Src/tim.c ../Src/dma.c -lm
+ * (固件把RAM地址写进32位的DMA和描述符寄存器，须用 -no-pie 链接在4GB以下)
+ *
+ * 用法:
+ *   acq_bench [选项]
+ * 选项 (周期数按168MHz计，可取自 USE_PROFILING 的报告):
+ *   -t <s>          仿真时长 (默认2秒)
+ *   -a <arr>        覆盖TIM2的自动重装值 (默认用 tim.c 的400, 即209.5kHz)
+ *   -g <波形>       tagged|sine|square|ramp|noise|dc (默认tagged: 可逐样本校验数据链路)
+ *   -f <Hz>         波形频率 (默认1000)
+ *   -l <cyc>        主循环一轮中遥测/日志/负载统计等未仿真部分的开销 (默认200)
+ *   -L <cyc>        每次LL寄存器访问的开销 (默认4)
+ *   -n <cyc>        一次LwIP发送的协议栈开销 (默认2500)
+ *   -s <掩码:抽取[:t]>  启动前经控制端口订阅一个带包头的流 (t: 带时间戳), 如 -s 0x0f:4:t
+ *   -F <故障>       注入故障, 可重复: 类型:时刻ms[:参数[:周期ms:次数]]
+ *                   类型 ovr|te (SPI过载/DMA传输错误, 参数为被打断前交换的字节数, 默认2),
+ *                   pbuf|errmem|link (pbuf分配失败/udp_sendto返回ERR_MEM/链路断开, 参数为持续ms, 默认1)
+ *                   如 -F ovr:100:2:10:50 从100ms起每10ms一次SPI过载, 共50次
+ *   -v <级别>       打印不高于该级别的固件日志 (0错误 ~ 3调试)
+ *
+ * 主循环与 main.c 相同: LwIP处理 -> ADC_Processing_Task (遥测由 -l 的固定开销代替)。
+ * 没有待处理的工作时按整轮跳过空转，直到下一个事件。默认209.5kHz下每个样本约有2.6轮
+ * 主循环和两次中断逐一执行，约为实时的20倍; 采样率越低跳过的空转越多 (21kHz时约140倍)。
+ * tagged 波形下检查默认PC的原始流和订阅流: 通道顺序、各通道转换序号连续 (丢包或丢块
+ * 时同一帧各通道的前跳相同, 只统计不算错误)、订阅流的包序号/帧偏移连续和抽取步长。
+ * 数据错乱、ADS8688命令错误或转换周期过短时返回1。
+ * 另外核对TIM2周期的去向: TIM2中断处理的每个更新周期 (入口延迟直方图之和) 必须恰好是一个存入的
+ * 样本 (含被丢弃的块)、一个 lost_ticks (含采集回调已登记、TIM2尚未并入的) 或正在传输的样本，
+ * 任何一处计数丢失都会使等式不成立。hostsim 只在仿真开销处切换中断，抢占不会落在一次读改写中间，
+ * 因此这里检查的是各中断只写自己的计数器这一约定，而不是靠时序碰撞。
+ *
+ * 注入故障时按类型报告: 生效次数、丢失的转换数 (已转换但没有送到PC的样本, 各通道之和)、
+ * 通道错位的样本数和恢复时间。以下情况返回1: 有错位的样本; 默认PC流整块丢失的块数超过
+ * 每次故障 RAW_BLOCKS_PER_FAULT 块加上故障持续期间的块数 (调速器有意跳过的块不计); 最后一次故障
+ * 结束 GOV_SETTLE_S 秒后调速器仍未回到0级。丢失和错位归于此前最近一次生效的故障; 恢复时间为故障生效到
+ * 各通道都重新连续送达 (且通道正确) 的采样时刻。SPI类故障后同一帧各通道的前跳可以不同
+ * (固件丢弃半帧, 被中止的转换和重同步帧的转换也不送出); 错位的样本算作失败。
+ ******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hostsim.h"
+#include "main.h"
+#include "adc_processing.h"
+#include "debug_log.h"
+#include "dma.h"
+#include "eth_txring.h"
+#include "spi.h"
+#include "stream_ctrl.h"
+#include "stream_governor.h"
+#include "stream_proto.h"
+#include "tim.h"
+
+#define SUB_IP3             101     // 订阅者 192.168.0.101:SUB_PORT
+#define SUB_PORT            6000
+#define MAX_ERRORS_PRINTED  10
+
+extern StreamGov g_stream_gov;      // adc_processing.c
+
+// --- 原始流校验 (默认PC) ---
+static struct {
+    uint64_t samples;               // 收到的样本数 (流内位置)
+    uint64_t packets;
+    uint16_t expect[HOSTSIM_ADS_CHANNELS];
+    uint8_t  valid;
+    uint16_t jump;                  // 当前帧各通道相对预期的前跳 (须相同)
+    uint64_t frames_lost;           // 丢失的帧数 (前跳之和)
+    uint64_t losses;                // 前跳次数
+    uint64_t block_losses;          // 其中恰为整块的次数 (采集端丢块)
+    uint64_t blocks_lost;           // 这些整块前跳合计的块数
+    uint64_t errors;
+} g_raw;
+
+// --- 订阅流校验 ---
+static struct {
+    uint8_t  mask;
+    uint8_t  decim;
+    uint8_t  options;
+    uint8_t  subscribed;            // 收到订阅应答
+    uint64_t packets;
+    uint64_t frames;
+    uint32_t next_seq;
+    uint64_t packets_lost;          // 包序号前跳之和
+    uint32_t block;
+    uint16_t next_frame;
+    uint16_t last[HOSTSIM_ADS_CHANNELS];
+    uint8_t  have_last;
+    uint8_t  started;               // 0: 首包或丢包之后, 不检查帧偏移
+    uint64_t gap_packets;
+    uint64_t time_packets;
+    uint64_t errors;
+} g_sub;
+
+static uint8_t g_check;             // 1: tagged 波形, 逐样本校验
+
+// --- 故障注入 (-F) 的逐次统计, 按故障序号 ---
+static struct {
+    uint64_t lost;                  // 归于该故障的丢失转换数
+    uint64_t misaligned;            // 通道错位的样本数
+    uint64_t resumed_at;            // 最后一次丢失或错位之后第一个正确样本的采样时刻
+    uint8_t  disturbed;             // 有丢失或错位
+} g_fm[HOSTSIM_FAULT_MAX];
+static int     g_misaligned = -1;   // 正处于错位状态: 归于的故障序号
+static uint8_t g_spi_faults;        // 注入了SPI类故障
+
+static const char *const g_fault_names[HOSTSIM_FAULT_COUNT] = { "ovr", "te", "pbuf", "errmem", "link" };
+
+#define MAX_FAULT_SPECS     16
+#define GOV_SETTLE_S        3.0     // 调速器从最高级别恢复到0的时间上限 (4级 x 16块 x 39ms, 约2.5s)
+#define RAW_BLOCKS_PER_FAULT 2      // 每次故障允许默认PC流整块丢失的块数 (另加故障持续期间的块数)
+
+typedef struct {
+    HostSim_FaultType type;
+    double   at_ms;                 // 相对采集开始
+    double   arg;                   // SPI类: 字节数; 其余: 持续ms
+    double   period_ms;
+    unsigned count;
+} FaultSpec;
+
+static void Fail(uint64_t *counter, const char *what, uint64_t a, uint64_t b)
+{
+    if (++(*counter) <= MAX_ERRORS_PRINTED)
+    {
+        printf("[%10.6f] CHECK: %s (%llu, %llu)\n", (double)HostSim_Now() / HOSTSIM_CPU_HZ, what,
+               (unsigned long long)a, (unsigned long long)b);
+    }
+}
+
+/**
+ * @brief 此前最近一次生效的故障
+ */
+static int FaultBefore(uint64_t t)
+{
+    int best = -1;
+    int i;
+
+    for (i = 0; i < HostSim_FaultCount(); i++)
+    {
+        const HostSim_Fault *f = HostSim_GetFault(i);
+
+        if (f->start != 0 && f->start <= t && (best < 0 || f->start >= HostSim_GetFault(best)->start))
+        {
+            best = i;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief 原始流: 每帧按通道0~7排列; 各通道转换序号连续，丢包或丢块时同一帧的各通道前跳相同
+ */
+static void CheckRaw(const uint8_t *p, uint16_t len)
+{
+    uint16_t i;
+
+    g_raw.packets++;
+    for (i = 0; i + 1 < len; i += 2)
+    {
+        uint16_t code = (uint16_t)(p[i] | (p[i + 1] << 8));
+        uint8_t ch = (uint8_t)(g_raw.samples % HOSTSIM_ADS_CHANNELS);
+        uint16_t cnt = HOSTSIM_TAG_COUNT(code);
+        uint64_t at;
+        int f;
+
+        g_raw.samples++;
+        if (!g_check)
+        {
+            continue;
+        }
+        at = HostSim_ConversionTime(code);
+        if (HOSTSIM_TAG_CHANNEL(code) != ch)
+        {
+            f = (g_misaligned >= 0) ? g_misaligned : FaultBefore(at);
+            if (f < 0)
+            {
+                Fail(&g_raw.errors, "raw: channel order", HOSTSIM_TAG_CHANNEL(code), ch);
+                continue;
+            }
+            g_misaligned = f;
+            g_fm[f].misaligned++;
+            g_fm[f].disturbed = 1;
+            g_fm[f].resumed_at = 0;
+            continue;
+        }
+        f = g_misaligned;
+        g_misaligned = -1;
+        if (g_raw.valid & (1U << ch))
+        {
+            uint16_t diff = (uint16_t)((cnt - g_raw.expect[ch]) & (HOSTSIM_TAG_MOD - 1U));
+
+            if (ch == 0)
+            {
+                g_raw.jump = diff;
+                if (diff != 0)
+                {
+                    g_raw.losses++;
+                    g_raw.frames_lost += diff;
+                    if (diff % SAMPLES_PER_CHANNEL == 0)
+                    {
+                        g_raw.block_losses++;
+                        g_raw.blocks_lost += diff / SAMPLES_PER_CHANNEL;
+                    }
+                }
+            }
+            else if (diff != g_raw.jump && !g_spi_faults)
+            {
+                Fail(&g_raw.errors, "raw: conversion count", cnt, g_raw.expect[ch]);
+            }
+            if (diff != 0)
+            {
+                f = (f >= 0) ? f : FaultBefore(at);
+                if (f >= 0)
+                {
+                    g_fm[f].lost += diff;
+                    g_fm[f].disturbed = 1;
+                    g_fm[f].resumed_at = 0;
+                }
+            }
+        }
+        if (f >= 0 && g_fm[f].resumed_at == 0)
+        {
+            g_fm[f].resumed_at = at;    // 丢失或错位之后第一个正确的样本
+        }
+        g_raw.valid |= (uint8_t)(1U << ch);
+        g_raw.expect[ch] = (uint16_t)((cnt + 1U) & (HOSTSIM_TAG_MOD - 1U));
+    }
+}
+
+static void CheckSub(const uint8_t *p, uint16_t len)
+{
+    StreamUdpHeader h;
+    uint16_t off = sizeof(h);
+    uint8_t chans[HOSTSIM_ADS_CHANNELS];
+    uint8_t nch = 0;
+    uint16_t nframes;
+    uint16_t f;
+    uint8_t c;
+
+    if (len < sizeof(h))
+    {
+        Fail(&g_sub.errors, "sub: short packet", len, sizeof(h));
+        return;
+    }
+    memcpy(&h, p, sizeof(h));
+    if (h.magic != STREAM_UDP_MAGIC || h.version != STREAM_PROTO_VERSION)
+    {
+        Fail(&g_sub.errors, "sub: bad magic", h.magic, STREAM_UDP_MAGIC);
+        return;
+    }
+    g_sub.packets++;
+    if (g_sub.started && h.seq != g_sub.next_seq)
+    {
+        if ((int32_t)(h.seq - g_sub.next_seq) > 0)
+        {
+            g_sub.packets_lost += h.seq - g_sub.next_seq;   // 发送失败的包被跳过
+            g_sub.started = 0;
+        }
+        else
+        {
+            Fail(&g_sub.errors, "sub: seq", h.seq, g_sub.next_seq);
+        }
+    }
+    g_sub.next_seq = h.seq + 1U;
+
+    if (h.frame_offset == 0)
+    {
+        if (g_sub.started && (int32_t)(h.block - g_sub.block) <= 0)
+        {
+            Fail(&g_sub.errors, "sub: block not increasing", h.block, g_sub.block);
+        }
+        g_sub.block = h.block;
+        g_sub.have_last = 0;
+    }
+    else if (!g_sub.started || h.block != g_sub.block || h.frame_offset != g_sub.next_frame)
+    {
+        if (g_sub.started)
+        {
+            Fail(&g_sub.errors, "sub: frame offset", h.frame_offset, g_sub.next_frame);
+        }
+        g_sub.block = h.block;
+        g_sub.have_last = 0;
+    }
+    g_sub.started = 1;
+
+    if (h.flags & STREAM_FLAG_GAP)
+    {
+        off = (uint16_t)(off + sizeof(StreamGapExt));
+        g_sub.gap_packets++;
+        g_sub.have_last = 0;    // 缺口两侧的转换序号步长不定 (中止的传输丢弃半帧)
+    }
+    if (h.flags & STREAM_FLAG_TIME)
+    {
+        off = (uint16_t)(off + sizeof(StreamTimeExt));
+        g_sub.time_packets++;
+    }
+    for (c = 0; c < HOSTSIM_ADS_CHANNELS; c++)
+    {
+        if (h.channel_mask & (1U << c))
+        {
+            chans[nch++] = c;
+        }
+    }
+    if (nch == 0 || off > len)
+    {
+        Fail(&g_sub.errors, "sub: header", h.channel_mask, off);
+        return;
+    }
+    nframes = (uint16_t)((len - off) / (nch * 2U));
+    g_sub.frames += nframes;
+    g_sub.next_frame = (uint16_t)(h.frame_offset + nframes);
+
+    if (!g_check)
+    {
+        return;
+    }
+    for (f = 0; f < nframes; f++)
+    {
+        for (c = 0; c < nch; c++)
+        {
+            const uint8_t *s = p + off + ((uint32_t)f * nch + c) * 2U;
+            uint16_t code = (uint16_t)(s[0] | (s[1] << 8));
+            uint8_t ch = chans[c];
+
+            if (HOSTSIM_TAG_CHANNEL(code) != ch)
+            {
+                Fail(&g_sub.errors, "sub: channel order", HOSTSIM_TAG_CHANNEL(code), ch);
+                continue;
+            }
+            if ((g_sub.have_last & (1U << ch)) && !(h.flags & STREAM_FLAG_GAP) &&
+                ((HOSTSIM_TAG_COUNT(code) - g_sub.last[ch]) & (HOSTSIM_TAG_MOD - 1U)) != h.decimation)
+            {
+                Fail(&g_sub.errors, "sub: decimation step",
+                     (HOSTSIM_TAG_COUNT(code) - g_sub.last[ch]) & (HOSTSIM_TAG_MOD - 1U), h.decimation);
+            }
+            g_sub.last[ch] = HOSTSIM_TAG_COUNT(code);
+            g_sub.have_last |= (uint8_t)(1U << ch);
+        }
+    }
+}
+
+/**
+ * @brief 线路上发完的每个帧 (PC端)
+ */
+static void Sink(uint16_t ethertype, const ip4_addr_t *dst, uint16_t dst_port, const uint8_t *payload, uint16_t len)
+{
+    if (ethertype != 0x0800 || dst == NULL)
+    {
+        return;
+    }
+    if (dst_port == DEST_PORT && ip4_addr4(dst) == DEST_IP_ADDR3)
+    {
+        CheckRaw(payload, len);
+    }
+    else if (dst_port == SUB_PORT && ip4_addr4(dst) == SUB_IP3)
+    {
+        if (len >= sizeof(StreamCtrlReply) && payload[0] == (STREAM_CMD_SUBSCRIBE | STREAM_CMD_REPLY))
+        {
+            g_sub.subscribed = (payload[1] == STREAM_STATUS_OK);
+            if (!g_sub.subscribed)
+            {
+                printf("subscribe rejected: status %u\n", payload[1]);
+            }
+        }
+        else
+        {
+            CheckSub(payload, len);
+        }
+    }
+}
+
+static void Subscribe(void)
+{
+    StreamCtrlRequest req;
+    ip4_addr_t src;
+
+    memset(&req, 0, sizeof(req));
+    req.cmd = STREAM_CMD_SUBSCRIBE;
+    req.channel_mask = g_sub.mask;
+    req.decimation = g_sub.decim;
+    req.options = g_sub.options;
+    IP4_ADDR(&src, DEST_IP_ADDR0, DEST_IP_ADDR1, DEST_IP_ADDR2, SUB_IP3);
+    HostSim_Inject(&src, SUB_PORT, STREAM_CTRL_PORT, &req, sizeof(req));
+}
+
+static double HostSeconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief -F 类型:时刻ms[:参数[:周期ms:次数]]
+ */
+static int ParseFault(const char *s, FaultSpec *spec)
+{
+    char name[16];
+    int i;
+
+    memset(spec, 0, sizeof(*spec));
+    spec->arg = -1.0;
+    spec->count = 1;
+    if (sscanf(s, "%15[^:]:%lf:%lf:%lf:%u", name, &spec->at_ms, &spec->arg, &spec->period_ms, &spec->count) < 2 ||
+        spec->count == 0)
+    {
+        return 0;
+    }
+    for (i = 0; i < HOSTSIM_FAULT_COUNT; i++)
+    {
+        if (strcmp(name, g_fault_names[i]) == 0)
+        {
+            spec->type = (HostSim_FaultType)i;
+            if (spec->arg < 0.0)
+            {
+                spec->arg = (i == HOSTSIM_FAULT_SPI_OVR || i == HOSTSIM_FAULT_DMA_TE) ? 2.0 : 1.0;
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 按类型汇总故障的影响
+ */
+static int PrintFaults(uint64_t run_end)
+{
+    const uint64_t block_cycles = (uint64_t)BLOCK_PERIOD_MS * HOSTSIM_CPU_HZ / 1000U;
+    uint64_t last_end = 0, allowed = 0, raw_lost, received;
+    int t, i;
+    int fail = 0;
+
+    for (t = 0; t < HOSTSIM_FAULT_COUNT; t++)
+    {
+        uint64_t lost = 0, misaligned = 0;
+        uint64_t rec_sum = 0, rec_max = 0;
+        int scheduled = 0, fired = 0, disturbed = 0, recovered = 0;
+
+        for (i = 0; i < HostSim_FaultCount(); i++)
+        {
+            const HostSim_Fault *f = HostSim_GetFault(i);
+
+            if ((int)f->type != t)
+            {
+                continue;
+            }
+            scheduled++;
+            fired += (f->start != 0);
+            last_end = (f->start != 0 && f->end > last_end) ? f->end : last_end;
+            if (f->start != 0)
+            {
+                allowed += RAW_BLOCKS_PER_FAULT + (f->end - f->start + block_cycles - 1) / block_cycles;
+            }
+            lost += g_fm[i].lost;
+            misaligned += g_fm[i].misaligned;
+            if (!g_fm[i].disturbed)
+            {
+                continue;
+            }
+            disturbed++;
+            if (g_fm[i].resumed_at != 0)
+            {
+                uint64_t rec = g_fm[i].resumed_at - f->start;
+
+                recovered++;
+                rec_sum += rec;
+                rec_max = (rec > rec_max) ? rec : rec_max;
+            }
+        }
+        if (scheduled == 0)
+        {
+            continue;
+        }
+        printf("fault %-6s: %d scheduled, %d fired, %llu hits; %llu samples lost (%.1f per fault), %llu misaligned; ",
+               g_fault_names[t], scheduled, fired, (unsigned long long)g_hostsim_stats.fault_hits[t],
+               (unsigned long long)lost, fired ? (double)lost / fired : 0.0, (unsigned long long)misaligned);
+        if (recovered != 0)
+        {
+            printf("recovery avg %.1f us max %.1f us", (double)rec_sum * 1e6 / recovered / HOSTSIM_CPU_HZ,
+                   (double)rec_max * 1e6 / HOSTSIM_CPU_HZ);
+        }
+        else
+        {
+            printf("no data loss");
+        }
+        if (recovered != disturbed)
+        {
+            printf(", %d NOT RECOVERED", disturbed - recovered);
+        }
+        printf("\n");
+        fail |= (misaligned != 0);
+    }
+    printf("firmware: SPI overruns %u, DMA errors %u\n",
+           (unsigned)g_adc_stats.spi_overruns, (unsigned)g_adc_stats.spi_dma_errors);
+
+    // 默认PC流的整块丢失: 标记按 HOSTSIM_TAG_MOD 回绕，连续丢失8块以上时按采集块数和收到的块数核对
+    // (最后一块可能正在发送); 调速器有意跳过的块 (STREAM_GOV_SKIP_RAW) 另行报告，不计入
+    received = g_raw.samples / PING_PONG_BUFFER_SIZE;
+    raw_lost = g_raw.blocks_lost;
+    if (g_adc_stats.blocks_acquired > received + 1 && g_adc_stats.blocks_acquired - received - 1 > raw_lost)
+    {
+        raw_lost = g_adc_stats.blocks_acquired - received - 1;
+    }
+    raw_lost = (raw_lost > StreamCtrl_RawBlocksSkipped()) ? raw_lost - StreamCtrl_RawBlocksSkipped() : 0;
+    printf("raw stream: %llu whole blocks lost (allowed %llu), %u skipped by the governor%s\n",
+           (unsigned long long)raw_lost, (unsigned long long)allowed, (unsigned)StreamCtrl_RawBlocksSkipped(),
+           (raw_lost > allowed) ? ", TOO MANY" : "");
+    fail |= (raw_lost > allowed);
+
+    // 故障结束后调速器必须回到0级; 最后一次故障离结束不足 GOV_SETTLE_S 时不检查
+    printf("governor: level %u at end, %u steps down, %u up", (unsigned)g_stream_gov.level,
+           (unsigned)g_stream_gov.steps_down, (unsigned)g_stream_gov.steps_up);
+    if (run_end - last_end < (uint64_t)(GOV_SETTLE_S * HOSTSIM_CPU_HZ))
+    {
+        printf(" (not checked: last fault ended less than %.1f s before the end)\n", GOV_SETTLE_S);
+    }
+    else
+    {
+        printf("%s\n", (g_stream_gov.level != 0) ? ", NOT RECOVERED" : "");
+        fail |= (g_stream_gov.level != 0);
+    }
+    return fail;
+}
+
+static int ParseWave(const char *s, HostSim_WaveType *type)
+{
+    static const char *names[] = { "tagged", "sine", "square", "ramp", "noise", "dc" };
+    int i;
+
+    for (i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++)
+    {
+        if (strcmp(s, names[i]) == 0)
+        {
+            *type = (HostSim_WaveType)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = 2.0;
+    long arr = -1;
+    uint32_t loop_other = 200;
+    HostSim_Wave wave = { HOSTSIM_WAVE_TAGGED, 1000.0, 20000.0, 0.0 };
+    int log_level = -1;
+    int opt;
+    uint64_t end;
+    uint64_t passes = 0;
+    double t0, host;
+    FaultSpec faults[MAX_FAULT_SPECS];
+    int n_faults = 0;
+    uint8_t ch;
+    uint32_t i;
+
+    HostSim_Init();
+    while ((opt = getopt(argc, argv, "t:a:g:f:l:L:n:s:F:v:")) != -1)
+    {
+        switch (opt)
+        {
+        case 't': seconds = atof(optarg); break;
+        case 'a': arr = atol(optarg); break;
+        case 'g':
+            if (!ParseWave(optarg, &wave.type))
+            {
+                fprintf(stderr, "unknown waveform: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'f': wave.freq_hz = atof(optarg); break;
+        case 'l': loop_other = (uint32_t)atol(optarg); break;
+        case 'L': g_hostsim_costs.ll_access = (uint32_t)atol(optarg); break;
+        case 'n': g_hostsim_costs.lwip_send = (uint32_t)atol(optarg); break;
+        case 's':
+        {
+            unsigned mask = 0, decim = 1;
+            char t = 0;
+
+            if (sscanf(optarg, "%i:%u:%c", &mask, &decim, &t) < 2 || mask == 0 || mask > 0xFF)
+            {
+                fprintf(stderr, "bad subscription: %s (mask:decim[:t])\n", optarg);
+                return 2;
+            }
+            g_sub.mask = (uint8_t)mask;
+            g_sub.decim = (uint8_t)decim;
+            g_sub.options = (t == 't') ? STREAM_SUB_OPT_TIME : 0;
+            break;
+        }
+        case 'F':
+            if (n_faults >= MAX_FAULT_SPECS || !ParseFault(optarg, &faults[n_faults]))
+            {
+                fprintf(stderr, "bad fault: %s (ovr|te|pbuf|errmem|link:ms[:arg[:period_ms:count]])\n", optarg);
+                return 2;
+            }
+            n_faults++;
+            break;
+        case 'v': log_level = atoi(optarg); break;
+        default:
+            fprintf(stderr, "usage: %s [-t s] [-a arr] [-g wave] [-f Hz] [-l cyc] [-L cyc] [-n cyc] "
+                            "[-s mask:decim[:t]] [-F fault] [-v level]\n", argv[0]);
+            return 2;
+        }
+    }
+    HostSim_Init();     // 选项可能修改了开销表
+    HostSim_SetSink(Sink);
+    HostSim_SetLogLevel(log_level);
+    for (ch = 0; ch < HOSTSIM_ADS_CHANNELS; ch++)
+    {
+        HostSim_Wave w = wave;
+
+        w.offset = (wave.type == HOSTSIM_WAVE_DC) ? 1000.0 * ch : 0.0;
+        HostSim_SetWave(ch, &w);
+    }
+    g_check = (wave.type == HOSTSIM_WAVE_TAGGED);
+
+    // main.c 的初始化顺序
+    NVIC_SetPriority(SysTick_IRQn, 15);
+    MX_LWIP_Init();
+    MX_DMA_Init();
+    MX_SPI1_Init();
+    MX_TIM2_Init();
+    if (arr > 0)
+    {
+        LL_TIM_SetAutoReload(TIM2, (uint32_t)arr);
+    }
+    ADC_Processing_Init();
+    if (g_sub.mask != 0)
+    {
+        Subscribe();
+    }
+    HostSim_ResetStats(); // 初始化期间的轮询命令帧不计入
+    ADC_Processing_Start();
+    for (i = 0; i < (uint32_t)n_faults; i++)
+    {
+        const FaultSpec *fs = &faults[i];
+        uint8_t spi = (fs->type == HOSTSIM_FAULT_SPI_OVR || fs->type == HOSTSIM_FAULT_DMA_TE);
+        uint32_t arg = spi ? (uint32_t)fs->arg : (uint32_t)(fs->arg * 1e-3 * HOSTSIM_CPU_HZ);
+        unsigned k;
+
+        g_spi_faults |= spi;
+        for (k = 0; k < fs->count; k++)
+        {
+            uint64_t at = HostSim_Now() + (uint64_t)((fs->at_ms + k * fs->period_ms) * 1e-3 * HOSTSIM_CPU_HZ);
+
+            if (HostSim_ScheduleFault(fs->type, at, arg) < 0)
+            {
+                fprintf(stderr, "too many faults (max %d)\n", HOSTSIM_FAULT_MAX);
+                return 2;
+            }
+        }
+    }
+
+    end = HostSim_Now() + (uint64_t)(seconds * HOSTSIM_CPU_HZ);
+    t0 = HostSeconds();
+    while (HostSim_Now() < end)
+    {
+        uint64_t pass_start = HostSim_Now();
+
+        HostSim_Spend(loop_other);
+        ETH_TX_LOCK();
+        MX_LWIP_Process();
+        ETH_TX_UNLOCK();
+        ADC_Processing_Task();
+        passes++;
+        if (!ADC_Processing_Pending())
+        {
+            HostSim_Idle((uint32_t)(HostSim_Now() - pass_start));
+        }
+    }
+    host = HostSeconds() - t0;
+
+    // --- 报告 ---
+    {
+        double sim = (double)HostSim_Now() / HOSTSIM_CPU_HZ;
+        double rate = (double)HOSTSIM_CPU_HZ / (2.0 * (TIM2->ARR + 1U) * (TIM2->PSC + 1U));
+        uint64_t lat_total = 0;
+        uint64_t samples = (uint64_t)g_adc_stats.blocks_acquired * PING_PONG_BUFFER_SIZE + g_sample_count;
+        uint32_t posted = g_lost_ticks_posted - g_lost_ticks_folded;
+        int ticks_ok;
+        int fail;
+
+        printf("sim %.3f s in %.3f s host (%.0fx realtime), %llu main loop passes, %.1f%% skipped idle\n",
+               sim, host, sim / host, (unsigned long long)passes,
+               100.0 * (double)g_hostsim_stats.idle_skipped / (double)HostSim_Now());
+        printf("TIM2 %.0f Hz: %llu updates, samples %u, skips %u, lost ticks %u, latency max %u\n",
+               rate, (unsigned long long)g_hostsim_stats.tim2_updates,
+               (unsigned)(g_adc_stats.blocks_acquired * PING_PONG_BUFFER_SIZE + g_sample_count),
+               (unsigned)g_adc_stats.tim2_skips, (unsigned)g_adc_stats.lost_ticks, (unsigned)g_adc_stats.tim2_lat_max);
+        printf("  TIM2 latency hist:");
+        for (i = 0; i < STREAM_TELEM_LAT_BINS; i++)
+        {
+            printf(" %u", (unsigned)g_adc_stats.tim2_lat_hist[i]);
+            lat_total += g_adc_stats.tim2_lat_hist[i];
+        }
+        printf(" (%llu)\n", (unsigned long long)lat_total);
+        ticks_ok = (lat_total == samples + g_adc_stats.lost_ticks + posted + g_dma_busy_flag);
+        printf("  tick accounting: %llu handled = %llu samples + %u lost + %u posted + %u in flight%s\n",
+               (unsigned long long)lat_total, (unsigned long long)samples, (unsigned)g_adc_stats.lost_ticks,
+               (unsigned)posted, (unsigned)g_dma_busy_flag, ticks_ok ? "" : " MISMATCH");
+        printf("blocks acquired %u, dropped %u, ping-pong fill peak %u/%u, governor level %u\n",
+               (unsigned)g_adc_stats.blocks_acquired, (unsigned)g_stream_gov.blocks_dropped,
+               (unsigned)g_adc_stats.pp_fill_peak, (unsigned)PING_PONG_BUFFER_SIZE, (unsigned)g_stream_gov.level);
+        printf("ethernet: %llu frames, %.1f%% wire busy, ring full %llu, send errors %u, pbuf failures %u, "
+               "packets sent %u\n",
+               (unsigned long long)g_hostsim_stats.wire_frames,
+               100.0 * (double)g_hostsim_stats.wire_busy / (double)HostSim_Now(),
+               (unsigned long long)g_hostsim_stats.eth_ring_full, (unsigned)g_adc_stats.send_errors,
+               (unsigned)g_adc_stats.pbuf_failures, (unsigned)g_udp_packets_sent_count);
+        printf("irqs: TIM2 %llu, DMA2_S0 %llu, ETH %llu, SysTick %llu, nested %llu\n",
+               (unsigned long long)g_hostsim_stats.irq_count[TIM2_IRQn + 16],
+               (unsigned long long)g_hostsim_stats.irq_count[DMA2_Stream0_IRQn + 16],
+               (unsigned long long)g_hostsim_stats.irq_count[ETH_IRQn + 16],
+               (unsigned long long)g_hostsim_stats.irq_count[SysTick_IRQn + 16],
+               (unsigned long long)g_hostsim_stats.preemptions);
+        printf("ADS8688: %llu frames, %llu conversions, %llu command errors, %llu cycle violations, "
+               "min cycle %.2f us\n",
+               (unsigned long long)g_hostsim_stats.ads_frames, (unsigned long long)g_hostsim_stats.ads_conversions,
+               (unsigned long long)g_hostsim_stats.ads_cmd_errors,
+               (unsigned long long)g_hostsim_stats.ads_cycle_violations,
+               (g_hostsim_stats.ads_min_cycle == UINT64_MAX) ? 0.0
+                   : (double)g_hostsim_stats.ads_min_cycle * 1e6 / HOSTSIM_CPU_HZ);
+        printf("log: %llu errors, %llu warnings, %llu info\n",
+               (unsigned long long)HostSim_LogCount(LOG_LEVEL_ERROR),
+               (unsigned long long)HostSim_LogCount(LOG_LEVEL_WARN),
+               (unsigned long long)HostSim_LogCount(LOG_LEVEL_INFO));
+        if (!g_check)
+        {
+            printf("PC raw stream: %llu packets, %llu samples (%.1f blocks), not checked (waveform not tagged)\n",
+                   (unsigned long long)g_raw.packets, (unsigned long long)g_raw.samples,
+                   (double)g_raw.samples / PING_PONG_BUFFER_SIZE);
+        }
+        else
+        {
+            printf("PC raw stream: %llu packets, %llu samples (%.1f blocks), %llu frames lost in %llu runs "
+                   "(%llu whole blocks), %llu errors\n",
+                   (unsigned long long)g_raw.packets, (unsigned long long)g_raw.samples,
+                   (double)g_raw.samples / PING_PONG_BUFFER_SIZE, (unsigned long long)g_raw.frames_lost,
+                   (unsigned long long)g_raw.losses, (unsigned long long)g_raw.block_losses,
+                   (unsigned long long)g_raw.errors);
+        }
+        if (g_sub.mask != 0)
+        {
+            printf("subscriber 0x%02x/%u%s: %s, %llu packets, %llu lost, %llu frames, %llu with gaps, "
+                   "%llu timestamped, %llu errors\n",
+                   g_sub.mask, g_sub.decim, g_sub.options ? "+time" : "", g_sub.subscribed ? "ok" : "NOT SUBSCRIBED",
+                   (unsigned long long)g_sub.packets, (unsigned long long)g_sub.packets_lost,
+                   (unsigned long long)g_sub.frames,
+                   (unsigned long long)g_sub.gap_packets, (unsigned long long)g_sub.time_packets,
+                   (unsigned long long)g_sub.errors);
+        }
+
+        fail = (n_faults != 0) ? PrintFaults(end) : 0;
+        fail = fail || !ticks_ok || g_raw.errors != 0 || g_sub.errors != 0 || g_raw.packets == 0 ||
+               (g_sub.mask != 0 && (!g_sub.subscribed || g_sub.packets == 0)) ||
+               g_hostsim_stats.ads_cmd_errors != 0 || g_hostsim_stats.ads_cycle_violations != 0;
+        printf("%s\n", fail ? "FAIL" : "PASS");
+        return fail ? 1 : 0;
+    }
+}
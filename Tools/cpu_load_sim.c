@@ -0,0 +1,294 @@
+/**
+ ******************************************************************************
+ * @file    cpu_load_sim.c
+ * @brief   主循环负载计量 (Src/cpu_load.c) 的主机测试: 用模拟时钟驱动真实的计量代码
+ *
+ * @details
+ * 编译: gcc -O2 -Wall -DHOST_BUILD -I../Inc -o cpu_load_sim cpu_load_sim.c
+ *
+ * 用法:
+ *   cpu_load_sim [-t s] [-r Hz] [-i cyc] [-a cyc] [-n Hz] [-p cyc] [-e permille]
+ * 选项 (周期数按168MHz计):
+ *   -t <s>      仿真时长 (默认3秒)
+ *   -r <Hz>     TIM2采样率, 每个周期产生一次中断和一次ADC段的工作 (默认20000, 0为不采集)
+ *   -i <cyc>    每次中断的开销 (默认230, 即TIM2中断 + SPI接收回调)
+ *   -a <cyc>    ADC段每个采集请求的工作量 (默认400)
+ *   -n <Hz>     以太网收包率, 每包一次中断和一次LwIP段的工作 (默认2000)
+ *   -p <cyc>    LwIP段每包的工作量 (默认3000)
+ *   -e <permille> 报告值与实际值允许的最大偏差 (默认20)
+ *
+ * 主循环按固件的顺序执行 LwIP/ADC/遥测/日志 四段, 每段有固定的空转查询开销和随机抖动
+ * (小于 CPU_LOAD_WORK_MARGIN)，有待处理的事件时再执行相应的工作。中断按到达时刻打断主循环并
+ * 推迟当前段的完成时间; 遥测段每100ms、日志段每10ms有一次工作。
+ * 分别在不睡眠和空闲时WFI两种方式下运行，WFI把模拟时钟推进到下一个中断，中断在开中断后
+ * 计入下一段。实际值为第一秒之后有工作或被中断打断的段的耗时之和占总时间的比例，
+ * 与计量模块最后报告的滑动平均值比较，偏差超过 -e 时返回1。
+ * 单次中断耗时 (-i) 小于 CPU_LOAD_WORK_MARGIN 时，落在空转段中的中断不被计量模块计入，
+ * 报告值会低于实际值，这是按耗时区分空转与工作的固有限制。
+ ******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../Src/cpu_load.c"
+
+#define SIM_HZ          ((double)CPU_LOAD_HOST_HZ)
+#define IDLE_JITTER     50      // 空转查询耗时的随机抖动, 须小于 CPU_LOAD_WORK_MARGIN
+
+typedef struct {
+    double  seconds, sample_hz, packet_hz;
+    int64_t isr, adc_work, lwip_work;
+    int     tolerance;
+} SimParams;
+
+// 各段的空转查询开销, 以及定时产生工作的段 (遥测/日志) 的周期和工作量
+static const int64_t k_idle[CPU_SUB_COUNT]      = { 120, 60, 40, 80 };
+static const double  k_timer_ms[CPU_SUB_COUNT]  = { 0, 0, 100, 10 };
+static const int64_t k_timer_work[CPU_SUB_COUNT] = { 0, 0, 6000, 1500 };
+
+// 模拟状态
+static struct {
+    const SimParams *p;
+    uint64_t now;
+    uint64_t next_irq[CPU_SUB_COUNT];   // 产生该段工作的中断 (0表示没有)
+    uint64_t irq_period[CPU_SUB_COUNT];
+    uint64_t next_timer[CPU_SUB_COUNT];
+    uint32_t pending[CPU_SUB_COUNT];
+    int      seg_irq;
+    uint64_t busy[CPU_SUB_COUNT];       // 实际值, 只统计第一秒之后的稳态部分
+    uint64_t total;
+    uint32_t rng;
+} g;
+
+uint64_t CpuLoad_HostCycles(void)
+{
+    return g.now;
+}
+
+// WFI: 时钟停到下一个中断到达, 中断本身在开中断后执行
+void CpuLoad_HostWfi(void)
+{
+    uint64_t next = UINT64_MAX;
+
+    for (int s = 0; s < CPU_SUB_COUNT; s++)
+    {
+        if (g.next_irq[s] && g.next_irq[s] < next)
+        {
+            next = g.next_irq[s];
+        }
+        if (g.next_timer[s] && g.next_timer[s] < next)
+        {
+            next = g.next_timer[s];
+        }
+    }
+    if (next != UINT64_MAX && next > g.now)
+    {
+        g.now = next;
+    }
+}
+
+static uint32_t Rand(void)
+{
+    g.rng ^= g.rng << 13;
+    g.rng ^= g.rng >> 17;
+    g.rng ^= g.rng << 5;
+    return g.rng;
+}
+
+/**
+ * @brief 主循环执行 cycles 个周期，期间到来的中断推迟完成时间
+ */
+static void Spend(int64_t cycles)
+{
+    uint64_t end = g.now + (uint64_t)cycles;
+
+    for (;;)
+    {
+        int which = -1;
+        uint64_t t = UINT64_MAX;
+
+        for (int s = 0; s < CPU_SUB_COUNT; s++)
+        {
+            if (g.next_irq[s] && g.next_irq[s] < t)
+            {
+                t = g.next_irq[s];
+                which = s;
+            }
+        }
+        if (which < 0 || t > end)
+        {
+            break;
+        }
+        g.pending[which]++;
+        g.next_irq[which] += g.irq_period[which];
+        end += (uint64_t)g.p->isr;
+        g.seg_irq = 1;
+    }
+    g.now = end;
+}
+
+static void Segment(int s)
+{
+    uint64_t start = g.now;
+    int worked = 0;
+
+    g.seg_irq = 0;
+    Spend(k_idle[s] + (int64_t)(Rand() % IDLE_JITTER));
+    if (g.next_timer[s] && g.now >= g.next_timer[s])
+    {
+        g.next_timer[s] += (uint64_t)(k_timer_ms[s] * SIM_HZ / 1000.0);
+        Spend(k_timer_work[s]);
+        worked = 1;
+    }
+    if (g.pending[s])
+    {
+        uint32_t n = g.pending[s];
+        g.pending[s] = 0;
+        Spend((int64_t)n * (s == CPU_SUB_ADC ? g.p->adc_work : g.p->lwip_work));
+        worked = 1;
+    }
+    CpuLoad_Account((uint32_t)s);
+    if (worked || g.seg_irq)
+    {
+        g.busy[s] += g.now - start;
+    }
+}
+
+static int Pending(void)
+{
+    for (int s = 0; s < CPU_SUB_COUNT; s++)
+    {
+        if (g.pending[s] || (g.next_timer[s] && g.now >= g.next_timer[s]))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int Run(const SimParams *p, int use_wfi)
+{
+    uint64_t stop = (uint64_t)(p->seconds * SIM_HZ);
+    uint64_t warm_start = 0;
+    int warm = 0;
+    const CpuLoad_Stats *st;
+    int fail = 0;
+
+    memset(&g, 0, sizeof(g));
+    g.p = p;
+    g.rng = 12345;
+    if (p->packet_hz > 0)
+    {
+        g.irq_period[CPU_SUB_LWIP] = (uint64_t)(SIM_HZ / p->packet_hz);
+        g.next_irq[CPU_SUB_LWIP] = g.irq_period[CPU_SUB_LWIP];
+    }
+    if (p->sample_hz > 0)
+    {
+        g.irq_period[CPU_SUB_ADC] = (uint64_t)(SIM_HZ / p->sample_hz);
+        g.next_irq[CPU_SUB_ADC] = g.irq_period[CPU_SUB_ADC] / 3; // 与收包错开
+    }
+    for (int s = 0; s < CPU_SUB_COUNT; s++)
+    {
+        if (k_timer_ms[s] > 0)
+        {
+            g.next_timer[s] = (uint64_t)(k_timer_ms[s] * SIM_HZ / 1000.0);
+        }
+    }
+
+    CpuLoad_Init();
+    while (g.now < stop)
+    {
+        // 跳过第一秒 (滑动平均收敛)
+        if (!warm && g.now >= (uint64_t)SIM_HZ)
+        {
+            memset(g.busy, 0, sizeof(g.busy));
+            warm_start = g.now;
+            warm = 1;
+        }
+        for (int s = 0; s < CPU_SUB_COUNT; s++)
+        {
+            Segment(s);
+        }
+        CpuLoad_EndPass();
+        if (use_wfi && !Pending())
+        {
+            CpuLoad_Sleep();
+        }
+    }
+    g.total = g.now - warm_start;
+
+    st = CpuLoad_GetStats();
+    printf("%s: passes=%u idle_passes=%u sleeps=%u\n", use_wfi ? "WFI" : "busy-poll",
+           st->passes, st->idle_passes, st->sleeps);
+    for (int s = 0; s <= CPU_SUB_COUNT; s++)
+    {
+        static const char *const names[CPU_SUB_COUNT + 1] = { "lwip", "adc", "telem", "log", "total" };
+        uint64_t busy = 0;
+        int reported, actual;
+
+        if (s < CPU_SUB_COUNT)
+        {
+            busy = g.busy[s];
+            reported = st->sub_permille[s];
+        }
+        else
+        {
+            for (int i = 0; i < CPU_SUB_COUNT; i++)
+            {
+                busy += g.busy[i];
+            }
+            reported = st->load_permille;
+        }
+        actual = g.total ? (int)(busy * 1000U / g.total) : 0;
+        printf("  %-6s reported=%4d actual=%4d permille%s\n", names[s], reported, actual,
+               abs(reported - actual) > p->tolerance ? "  <-- FAIL" : "");
+        if (abs(reported - actual) > p->tolerance)
+        {
+            fail = 1;
+        }
+    }
+    return fail;
+}
+
+static void Usage(void)
+{
+    fprintf(stderr, "usage: cpu_load_sim [-t s] [-r Hz] [-i cyc] [-a cyc] [-n Hz] [-p cyc] [-e permille]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    SimParams p = { 3.0, 20000, 2000, 230, 400, 3000, 20 };
+    int opt, fail;
+
+    while ((opt = getopt(argc, argv, "t:r:i:a:n:p:e:")) != -1)
+    {
+        switch (opt)
+        {
+        case 't': p.seconds = atof(optarg); break;
+        case 'r': p.sample_hz = atof(optarg); break;
+        case 'i': p.isr = atoll(optarg); break;
+        case 'a': p.adc_work = atoll(optarg); break;
+        case 'n': p.packet_hz = atof(optarg); break;
+        case 'p': p.lwip_work = atoll(optarg); break;
+        case 'e': p.tolerance = atoi(optarg); break;
+        default: Usage();
+        }
+    }
+    if (p.seconds < 2.0)
+    {
+        fprintf(stderr, "need at least 2 seconds\n");
+        return 2;
+    }
+    printf("sample=%.0fHz isr=%lld adc=%lld packets=%.0fHz lwip=%lld cycles, window=%dms margin=%d\n",
+           p.sample_hz, (long long)p.isr, (long long)p.adc_work, p.packet_hz, (long long)p.lwip_work,
+           CPU_LOAD_WINDOW_MS, CPU_LOAD_WORK_MARGIN);
+    fail = Run(&p, 0);
+    fail |= Run(&p, 1);
+    printf("%s\n", fail ? "FAIL" : "PASS");
+    return fail;
+}
@@ -0,0 +1,549 @@
+/**
+ ******************************************************************************
+ * @file    credit_rx.c
+ * @brief   信用流控的参考接收端，以及慢速消费者的主机仿真
+ *
+ * @details
+ * 编译: gcc -O2 -Wall -pthread -I../Inc -o credit_rx credit_rx.c
+ *
+ * 用法:
+ *   credit_rx rx  <board-ip> <mask> <decim> [window] [consume-pps] [port]
+ *   credit_rx sim <buffer|decimate|drop|none> [consume-pps] [window] [seconds]
+ *
+ * rx: 订阅后按消费进度授予信用: 上限 = 已消费的最大包序号 + 1 + window。
+ *     授予是累计上限，每200ms重发一次，丢失的授予包不影响正确性。
+ *     consume-pps 非0时模拟慢速消费者。接收套接字缓冲区按 window 设置，
+ *     保证已授予的包一定放得下。
+ * sim: 在本进程中运行一个固件替身 (127.0.0.1:5002)，按固件的块节奏(约25.6块/秒，
+ *     每块12包)、乒乓双缓冲和 STREAM_CREDIT_POLICY 的三种策略发送，
+ *     接收端即上面的参考接收端。none 表示接收端不授予信用，作为无流控的对照。
+ *     替身的采样值可由块号和帧号推出，接收端逐样本校验抽取和通道子集。
+ *
+ * 输出中 lost 为包序号跳变(无法区分的丢包)，流控下应始终为0；
+ * blocks skipped 为块序号跳变(固件主动丢弃并可被接收端识别的块)。
+ ******************************************************************************
+ */
+
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stream_proto.h"
+
+// 与 adc_processing.h 保持一致
+#define FRAME_RATE          26250.0         // 210 kHz / 8 通道
+#define DEFAULT_RX_PORT     5003
+#define DEFAULT_WINDOW      32              // 包; 须不小于一块的包数(全通道12包)
+
+#define GRANT_REFRESH_S     0.2
+#define REPORT_INTERVAL_S   2.0
+
+#define POLICY_NONE         (-1)
+#define POLICY_BUFFER       0               // 与 STREAM_CREDIT_POLICY_* 相同
+#define POLICY_DECIMATE     1
+#define POLICY_DROP         2
+
+static double NowSec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void SleepSec(double s)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)s;
+    ts.tv_nsec = (long)((s - ts.tv_sec) * 1e9);
+    nanosleep(&ts, NULL);
+}
+
+static uint32_t FrameBytes(uint8_t mask)
+{
+    return (uint32_t)__builtin_popcount(mask) * 2;
+}
+
+static uint32_t PacketsPerBlock(uint8_t mask, uint8_t decim)
+{
+    uint32_t per_packet = STREAM_UDP_CHUNK_SIZE / FrameBytes(mask);
+    uint32_t frames = STREAM_FRAMES_PER_BLOCK / decim;
+    return (frames + per_packet - 1) / per_packet;
+}
+
+// 固件替身的采样值: 第 block 块、第 frame 帧、通道 ch
+static uint16_t SimSample(uint32_t block, uint32_t frame, uint32_t ch)
+{
+    return (uint16_t)(((block * STREAM_FRAMES_PER_BLOCK + frame) * STREAM_CHANNELS + ch) * 2654435761u >> 16);
+}
+
+// ============================ 固件替身 ============================
+typedef struct {
+    int      policy;
+    int      fd;
+    volatile int stop;
+    // 订阅者 (替身只支持一个)
+    int      subscribed;
+    struct sockaddr_in dest;
+    uint8_t  mask, decim;
+    uint32_t seq;
+    int      credit_enabled;
+    uint32_t credit_limit;
+    uint32_t blocks_dropped;        // 信用不足跳过的块
+    uint32_t acq_dropped;           // 乒乓缓冲区都满时采集端丢弃的块
+} Emu;
+
+static void EmuHandleCtrl(Emu *e)
+{
+    uint8_t buf[64];
+    struct sockaddr_in from;
+    socklen_t fl = sizeof(from);
+    ssize_t n;
+
+    while ((n = recvfrom(e->fd, buf, sizeof(buf), MSG_DONTWAIT, (struct sockaddr *)&from, &fl)) > 0)
+    {
+        if (buf[0] == STREAM_CMD_CREDIT && (size_t)n >= sizeof(StreamCtrlCredit))
+        {
+            const StreamCtrlCredit *g = (const StreamCtrlCredit *)buf;
+            if (!e->credit_enabled)
+            {
+                e->credit_enabled = 1;
+                e->credit_limit = g->seq_limit;
+            }
+            else if ((int32_t)(g->seq_limit - e->credit_limit) > 0)
+            {
+                e->credit_limit = g->seq_limit;
+            }
+            continue;
+        }
+        if ((size_t)n < sizeof(StreamCtrlRequest))
+        {
+            continue;
+        }
+        const StreamCtrlRequest *req = (const StreamCtrlRequest *)buf;
+        StreamCtrlReply rep = { (uint8_t)(req->cmd | STREAM_CMD_REPLY), STREAM_STATUS_OK, 0, 0 };
+        if (req->cmd == STREAM_CMD_SUBSCRIBE)
+        {
+            e->dest = from;
+            e->mask = req->channel_mask;
+            e->decim = req->decimation;
+            e->seq = 0;
+            e->credit_enabled = 0;
+            e->subscribed = 1;
+        }
+        else if (req->cmd == STREAM_CMD_UNSUBSCRIBE)
+        {
+            e->subscribed = 0;
+        }
+        sendto(e->fd, &rep, sizeof(rep), 0, (struct sockaddr *)&from, fl);
+    }
+}
+
+// 与 StreamCtrl_Commit / CreditDecimation 相同的决策; 返回 -1 表示暂缓, 0 表示跳过
+static int EmuDecide(const Emu *e)
+{
+    int32_t credits = (int32_t)(e->credit_limit - e->seq);
+    uint8_t d = e->decim;
+
+    if (e->policy == POLICY_NONE || !e->credit_enabled ||
+        credits >= (int32_t)PacketsPerBlock(e->mask, d))
+    {
+        return d;
+    }
+    if (e->policy == POLICY_BUFFER)
+    {
+        return -1;
+    }
+    if (e->policy == POLICY_DECIMATE)
+    {
+        while (d <= 64)
+        {
+            d *= 2;
+            if (credits >= (int32_t)PacketsPerBlock(e->mask, d))
+            {
+                return d;
+            }
+        }
+    }
+    return 0;
+}
+
+static void *EmuThread(void *arg)
+{
+    Emu *e = (Emu *)arg;
+    const double block_period = STREAM_FRAMES_PER_BLOCK / FRAME_RATE;
+    double next_block = NowSec() + block_period;
+    uint32_t acq_block = 0;
+    int64_t pending = -1;           // 待发送的块号
+    int started = 0, decim = 1;
+    uint32_t packet = 0;
+    uint8_t pkt[sizeof(StreamUdpHeader) + STREAM_UDP_CHUNK_SIZE];
+
+    while (!e->stop)
+    {
+        EmuHandleCtrl(e);
+
+        // 采集: 另一缓冲区仍未发完时整块丢弃
+        if (NowSec() >= next_block)
+        {
+            next_block += block_period;
+            if (pending < 0)
+            {
+                pending = acq_block;
+            }
+            else
+            {
+                e->acq_dropped++;
+            }
+            acq_block++;
+        }
+
+        if (pending >= 0 && !e->subscribed)
+        {
+            pending = -1;
+        }
+        if (pending >= 0 && !started)
+        {
+            decim = EmuDecide(e);
+            if (decim > 0)
+            {
+                started = 1;
+                packet = 0;
+            }
+            else if (decim == 0)
+            {
+                e->blocks_dropped++;
+                pending = -1;
+            }
+        }
+
+        // 每轮最多发8包，模拟发送环深度
+        for (int burst = 0; started && burst < 8; burst++)
+        {
+            StreamUdpHeader *h = (StreamUdpHeader *)pkt;
+            uint16_t *out = (uint16_t *)(pkt + sizeof(*h));
+            uint32_t per_packet = STREAM_UDP_CHUNK_SIZE / FrameBytes(e->mask);
+            uint32_t frames = STREAM_FRAMES_PER_BLOCK / decim;
+            uint32_t first = packet * per_packet;
+            uint32_t count = frames - first < per_packet ? frames - first : per_packet;
+            uint32_t n = 0;
+
+            for (uint32_t f = 0; f < count; f++)
+            {
+                for (uint32_t ch = 0; ch < STREAM_CHANNELS; ch++)
+                {
+                    if (e->mask & (1U << ch))
+                    {
+                        out[n++] = SimSample((uint32_t)pending, (first + f) * decim, ch);
+                    }
+                }
+            }
+            h->magic = STREAM_UDP_MAGIC;
+            h->version = STREAM_PROTO_VERSION;
+            h->flags = (first + count == frames) ? STREAM_FLAG_BLOCK_END : 0;
+            h->seq = e->seq++;
+            h->block = (uint32_t)pending;
+            h->frame_offset = (uint16_t)first;
+            h->channel_mask = e->mask;
+            h->decimation = (uint8_t)decim;
+            sendto(e->fd, pkt, sizeof(*h) + n * 2, 0, (struct sockaddr *)&e->dest, sizeof(e->dest));
+
+            if (++packet == PacketsPerBlock(e->mask, (uint8_t)decim))
+            {
+                started = 0;
+                pending = -1;
+            }
+        }
+        SleepSec(0.001);
+    }
+    return NULL;
+}
+
+// ============================ 参考接收端 ============================
+typedef struct {
+    uint64_t packets;
+    uint64_t lost;                  // 包序号跳变: 无法区分的丢包
+    uint64_t bad;                   // 包头或样本校验失败
+    uint64_t blocks_ok;
+    uint64_t blocks_skipped;        // 块序号跳变
+    uint64_t decim_hist[8];         // 完整块按抽取因子(log2)统计
+} RxStats;
+
+static void PrintStats(const char *tag, const RxStats *st, double dt, uint64_t dp)
+{
+    printf("[%s] %6.0f pkt/s  lost=%llu  bad=%llu  blocks ok=%llu skipped=%llu  decim",
+           tag, dt > 0 ? dp / dt : 0.0, (unsigned long long)st->lost, (unsigned long long)st->bad,
+           (unsigned long long)st->blocks_ok, (unsigned long long)st->blocks_skipped);
+    for (int i = 0; i < 8; i++)
+    {
+        if (st->decim_hist[i])
+        {
+            printf(" x%d:%llu", 1 << i, (unsigned long long)st->decim_hist[i]);
+        }
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+static int OpenUdp(int port, int rcvbuf)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+    if (rcvbuf > 0)
+    {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    struct timeval tv = { 0, 100000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+/**
+ * @brief 参考接收端
+ * @param grant  0: 不授予信用 (无流控对照)
+ * @param verify 1: 按 SimSample 逐样本校验 (仅固件替身)
+ * @param seconds 0表示一直运行
+ * @retval 无法区分的丢包数和校验失败数之和
+ */
+static uint64_t RunReceiver(const char *board, uint8_t mask, uint8_t decim, uint32_t window,
+                            double consume_pps, int port, int grant, int verify, double seconds)
+{
+    // 已授予但尚未消费的包必须放得下
+    int fd = OpenUdp(port, (int)(window * 2048));
+    if (fd < 0)
+    {
+        return 1;
+    }
+
+    struct sockaddr_in board_addr;
+    memset(&board_addr, 0, sizeof(board_addr));
+    board_addr.sin_family = AF_INET;
+    board_addr.sin_port = htons(STREAM_CTRL_PORT);
+    inet_pton(AF_INET, board, &board_addr.sin_addr);
+
+    StreamCtrlRequest req;
+    memset(&req, 0, sizeof(req));
+    req.cmd = STREAM_CMD_SUBSCRIBE;
+    req.channel_mask = mask;
+    req.decimation = decim;
+    sendto(fd, &req, sizeof(req), 0, (struct sockaddr *)&board_addr, sizeof(board_addr));
+
+    StreamCtrlCredit credit;
+    memset(&credit, 0, sizeof(credit));
+    credit.cmd = STREAM_CMD_CREDIT;
+    credit.seq_limit = window;
+    if (grant)
+    {
+        sendto(fd, &credit, sizeof(credit), 0, (struct sockaddr *)&board_addr, sizeof(board_addr));
+    }
+
+    RxStats st;
+    memset(&st, 0, sizeof(st));
+    uint8_t pkt[2048];
+    uint32_t next_seq = 0, next_frame = 0, cur_block = 0, last_block = 0;
+    int have_block = 0, block_valid = 0;
+    double t0 = NowSec(), t_grant = t0, t_report = t0;
+    uint64_t packets_last = 0;
+
+    while (seconds <= 0 || NowSec() - t0 < seconds)
+    {
+        ssize_t n = recv(fd, pkt, sizeof(pkt), 0);
+        double now = NowSec();
+
+        if (n >= (ssize_t)sizeof(StreamUdpHeader))
+        {
+            const StreamUdpHeader *h = (const StreamUdpHeader *)pkt;
+            uint32_t fb = FrameBytes(h->channel_mask);
+            uint32_t hdr_len = sizeof(*h) + ((h->flags & STREAM_FLAG_GAP) ? sizeof(StreamGapExt) : 0)
+                             + ((h->flags & STREAM_FLAG_TIME) ? sizeof(StreamTimeExt) : 0);
+            uint32_t payload = ((uint32_t)n > hdr_len) ? (uint32_t)n - hdr_len : 0;
+
+            if (h->magic != STREAM_UDP_MAGIC || h->channel_mask != mask || payload % fb != 0)
+            {
+                continue;   // 控制应答等
+            }
+            st.packets++;
+            if (h->seq != next_seq)
+            {
+                st.lost += (uint32_t)(h->seq - next_seq);
+            }
+            next_seq = h->seq + 1;
+
+            if (h->frame_offset == 0)
+            {
+                if (have_block && h->block != last_block + 1)
+                {
+                    st.blocks_skipped += h->block - last_block - 1;
+                }
+                cur_block = h->block;
+                next_frame = 0;
+                block_valid = 1;
+            }
+            if (h->block != cur_block || h->frame_offset != next_frame)
+            {
+                block_valid = 0;
+            }
+
+            if (verify)
+            {
+                const uint16_t *s = (const uint16_t *)(pkt + hdr_len);
+                uint32_t frames = payload / fb, k = 0;
+                for (uint32_t f = 0; f < frames; f++)
+                {
+                    for (uint32_t ch = 0; ch < STREAM_CHANNELS; ch++)
+                    {
+                        if ((mask & (1U << ch)) &&
+                            s[k++] != SimSample(h->block, (h->frame_offset + f) * h->decimation, ch))
+                        {
+                            block_valid = 0;
+                        }
+                    }
+                }
+            }
+
+            next_frame = h->frame_offset + payload / fb;
+            if (h->flags & STREAM_FLAG_BLOCK_END)
+            {
+                if (block_valid && next_frame * h->decimation == STREAM_FRAMES_PER_BLOCK)
+                {
+                    st.blocks_ok++;
+                    st.decim_hist[__builtin_ctz(h->decimation) & 7]++;
+                }
+                else
+                {
+                    st.bad++;
+                }
+                have_block = 1;
+                last_block = h->block;
+                block_valid = 0;
+            }
+
+            // 慢速消费者: 按 consume_pps 限速处理
+            if (consume_pps > 0)
+            {
+                SleepSec(1.0 / consume_pps);
+            }
+
+            // 已消费到 h->seq，窗口向前滑动
+            uint32_t limit = h->seq + 1 + window;
+            if (grant && (int32_t)(limit - credit.seq_limit) >= (int32_t)(window / 4))
+            {
+                credit.seq_limit = limit;
+                sendto(fd, &credit, sizeof(credit), 0, (struct sockaddr *)&board_addr, sizeof(board_addr));
+                t_grant = now;
+            }
+        }
+
+        // 周期性重发当前上限: 弥补丢失的授予，并保持流控状态不超时
+        if (grant && now - t_grant >= GRANT_REFRESH_S)
+        {
+            sendto(fd, &credit, sizeof(credit), 0, (struct sockaddr *)&board_addr, sizeof(board_addr));
+            t_grant = now;
+        }
+        if (now - t_report >= REPORT_INTERVAL_S)
+        {
+            PrintStats("rx", &st, now - t_report, st.packets - packets_last);
+            packets_last = st.packets;
+            t_report = now;
+        }
+    }
+
+    req.cmd = STREAM_CMD_UNSUBSCRIBE;
+    sendto(fd, &req, sizeof(req), 0, (struct sockaddr *)&board_addr, sizeof(board_addr));
+    PrintStats("total", &st, 0, 0);
+    close(fd);
+    return st.lost + st.bad;
+}
+
+static int RunSim(const char *policy_name, double consume_pps, uint32_t window, double seconds)
+{
+    Emu emu;
+    memset(&emu, 0, sizeof(emu));
+    if (strcmp(policy_name, "buffer") == 0)        emu.policy = POLICY_BUFFER;
+    else if (strcmp(policy_name, "decimate") == 0) emu.policy = POLICY_DECIMATE;
+    else if (strcmp(policy_name, "drop") == 0)     emu.policy = POLICY_DROP;
+    else if (strcmp(policy_name, "none") == 0)     emu.policy = POLICY_NONE;
+    else
+    {
+        fprintf(stderr, "unknown policy: %s\n", policy_name);
+        return 2;
+    }
+
+    emu.fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(STREAM_CTRL_PORT);
+    if (emu.fd < 0 || bind(emu.fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("emulator bind");
+        return 1;
+    }
+
+    pthread_t th;
+    pthread_create(&th, NULL, EmuThread, &emu);
+
+    printf("sim: policy=%s consume=%.0f pkt/s window=%u (firmware rate ~%.0f pkt/s)\n",
+           policy_name, consume_pps, window, FRAME_RATE / STREAM_FRAMES_PER_BLOCK * PacketsPerBlock(0xFF, 1));
+    uint64_t errors = RunReceiver("127.0.0.1", 0xFF, 1, window, consume_pps, DEFAULT_RX_PORT,
+                                  emu.policy != POLICY_NONE, 1, seconds);
+
+    emu.stop = 1;
+    pthread_join(th, NULL);
+    close(emu.fd);
+    printf("firmware: blocks skipped for credit=%u, dropped at acquisition=%u\n",
+           emu.blocks_dropped, emu.acq_dropped);
+    if (emu.policy == POLICY_NONE)
+    {
+        return 0;
+    }
+    printf("%s: uncontrolled loss %s\n", errors == 0 ? "PASS" : "FAIL", errors == 0 ? "= 0" : "> 0");
+    return errors == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 5 && strcmp(argv[1], "rx") == 0)
+    {
+        RunReceiver(argv[2], (uint8_t)strtoul(argv[3], NULL, 0), (uint8_t)atoi(argv[4]),
+                    argc >= 6 ? (uint32_t)atoi(argv[5]) : DEFAULT_WINDOW,
+                    argc >= 7 ? atof(argv[6]) : 0.0,
+                    argc >= 8 ? atoi(argv[7]) : DEFAULT_RX_PORT, 1, 0, 0);
+        return 0;
+    }
+    if (argc >= 3 && strcmp(argv[1], "sim") == 0)
+    {
+        return RunSim(argv[2], argc >= 4 ? atof(argv[3]) : 150.0,
+                      argc >= 5 ? (uint32_t)atoi(argv[4]) : DEFAULT_WINDOW,
+                      argc >= 6 ? atof(argv[5]) : 10.0);
+    }
+
+    fprintf(stderr,
+            "usage: %s rx  <board-ip> <mask> <decim> [window] [consume-pps] [port]\n"
+            "       %s sim <buffer|decimate|drop|none> [consume-pps] [window] [seconds]\n",
+            argv[0], argv[0]);
+    return 2;
+}
@@ -0,0 +1,222 @@
+/**
+ ******************************************************************************
+ * @file    governor_sim.c
+ * @brief   背压调速器的主机仿真: 限速的假网络 + 乒乓采集 + 固件调速器
+ *
+ * @details
+ * 编译: gcc -O2 -Wall -I../Inc -o governor_sim governor_sim.c
+ * (直接包含 ../Src/stream_governor.c，仿真的是固件中的同一份代码)
+ *
+ * 用法:
+ *   governor_sim [on|off|raw] [ramp|step]
+ *
+ * 以0.1ms为步长仿真: 采集每 BLOCK_PERIOD 填满一个乒乓缓冲区，发送任务把当前块的包
+ * 放入8深度的发送环，假网络按限速曲线从环中取包。一个全通道订阅者，无抽取。
+ *   ramp: 10 Mbit/s -> 5~15s 线性降到 1.2 Mbit/s -> 保持到25s -> 恢复10 Mbit/s
+ *   step: 10 Mbit/s -> 5s 突降到 1.2 Mbit/s -> 25s 恢复
+ * (全速约需 12包 * 1502字节 / 39ms = 3.7 Mbit/s)
+ *
+ * raw: 订阅者换成无包头的默认PC流 (STREAM_GOV_SKIP_RAW)，不抽取而是每 2^级别 块只发一块，
+ *     gaps 中包括这些跳过的块; 结束时另外给出跳过的块数和采集端丢弃的块数。
+ *     off 时默认PC流不参与调速，相当于 STREAM_GOV_SKIP_RAW = 0。
+ *
+ * 接收端检查块序号是否连续，以及每次抽取因子变化是否置了 STREAM_FLAG_RATE_CHANGE。
+ * 调速器的评估与固件的调用方式相同: 发送完成中断 (一个包离开环) 时若环已空则评估
+ * (ADC_Processing_TxCompleteCallback); 一块全部入环后环已空 (没有包入环) 时立即评估
+ * (SendWaveformDataViaUDP); 采集事件在发送任务开始新块时处理 (StreamGov_BlockStart)。
+ * 每秒输出一行: 链路速率、调速级别、该秒收到的块数和块序号空洞数。
+ * 调速器 (on/raw) 在链路恢复后没有回到0级时返回1。
+ ******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "stream_proto.h"
+#include "../Src/stream_governor.c"
+
+// 采样率和块周期取自 stream_proto.h (与固件的 ADC_SAMPLE_RATE_HZ / BLOCK_PERIOD_MS 相同)
+#define TX_RING_DEPTH       8               // ETH_TXBUFNB
+#define FRAME_OVERHEAD      (14 + 20 + 8 + sizeof(StreamUdpHeader) + 24) // 首部 + 前导码/帧间隔等
+
+#define STEP_MS             0.1
+#define SIM_SECONDS         35
+
+static double LinkMbps(double t, int step)
+{
+    if (t < 5.0 || t >= 25.0)
+    {
+        return 10.0;
+    }
+    if (step || t >= 15.0)
+    {
+        return 1.2;
+    }
+    return 10.0 - (10.0 - 1.2) * (t - 5.0) / 10.0;
+}
+
+static uint32_t PacketsPerBlock(uint32_t decim)
+{
+    uint32_t per_packet = STREAM_UDP_CHUNK_SIZE / (STREAM_CHANNELS * 2);
+    uint32_t frames = STREAM_FRAMES_PER_BLOCK / decim;
+    return (frames + per_packet - 1) / per_packet;
+}
+
+static uint32_t PacketBytes(uint32_t decim, uint32_t packet)
+{
+    uint32_t per_packet = STREAM_UDP_CHUNK_SIZE / (STREAM_CHANNELS * 2);
+    uint32_t frames = STREAM_FRAMES_PER_BLOCK / decim;
+    uint32_t first = packet * per_packet;
+    uint32_t count = frames - first < per_packet ? frames - first : per_packet;
+    return count * STREAM_CHANNELS * 2 + FRAME_OVERHEAD;
+}
+
+int main(int argc, char **argv)
+{
+    int governor_on = !(argc >= 2 && strcmp(argv[1], "off") == 0);
+    int raw = (argc >= 2 && strcmp(argv[1], "raw") == 0);
+    int step = (argc >= 3 && strcmp(argv[2], "step") == 0);
+    const double block_period_ms = STREAM_BLOCK_SAMPLES * 1000.0 / STREAM_SAMPLE_RATE_HZ;
+
+    StreamGov gov;
+    StreamGov_Init(&gov, STREAM_BLOCK_PERIOD_MS);
+
+    // 采集与发送状态
+    double next_block_ms = block_period_ms;
+    uint32_t acq_block = 0;
+    int64_t pending = -1;
+    int started = 0;
+    uint32_t decim = 1, last_decim = 0, packet = 0, packets = 0, rate_flag = 0;
+    uint64_t skipped = 0;
+
+    // 假网络: 发送环中每包剩余的字节数
+    double ring[TX_RING_DEPTH];
+    int ring_count = 0;
+
+    // 接收端
+    int64_t rx_last_block = -1;
+    uint32_t rx_decim = 0;
+    uint64_t rx_blocks = 0, rx_gaps = 0, rx_unsignalled = 0;
+    uint64_t sec_blocks = 0, sec_gaps = 0;
+
+    printf("governor=%s profile=%s\n", governor_on ? "on" : "off", step ? "step" : "ramp");
+    printf("  t(s)  link(Mbit/s)  level  blocks  gaps\n");
+
+    for (uint64_t tick = 0; tick < (uint64_t)(SIM_SECONDS * 1000 / STEP_MS); tick++)
+    {
+        double now_ms = tick * STEP_MS;
+        uint32_t now_tick = (uint32_t)now_ms;   // HAL_GetTick() 的毫秒分辨率
+        double mbps = LinkMbps(now_ms / 1000.0, step);
+
+        // 采集: 上一块尚未发完则整块丢弃
+        if (now_ms >= next_block_ms)
+        {
+            next_block_ms += block_period_ms;
+            if (pending < 0)
+            {
+                pending = acq_block;
+                StreamGov_BlockReady(&gov, now_tick);
+            }
+            else
+            {
+                StreamGov_BlockDropped(&gov);
+            }
+            acq_block++;
+        }
+
+        // 假网络: 按链路速率消耗环头的包
+        double budget = mbps * 1e6 / 8 * STEP_MS / 1000.0;
+        while (ring_count > 0 && budget > 0)
+        {
+            double take = ring[0] < budget ? ring[0] : budget;
+            ring[0] -= take;
+            budget -= take;
+            if (ring[0] <= 0)
+            {
+                memmove(ring, ring + 1, (size_t)(ring_count - 1) * sizeof(ring[0]));
+                ring_count--;
+                // 发送完成中断: 同 ADC_Processing_TxCompleteCallback，只在有包发完时评估
+                if (gov.awaiting_drain && ring_count == 0)
+                {
+                    StreamGov_TxDrained(&gov, now_tick);
+                }
+            }
+        }
+
+        // 发送任务: 块开始时按调速级别确定抽取因子 (同 StreamCtrl_Commit)
+        if (pending >= 0 && !started)
+        {
+            uint8_t raw_send;
+            uint8_t level = StreamGov_BlockStart(&gov, (uint8_t)raw, &raw_send);
+            if (!raw_send)
+            {
+                // 默认PC流整块跳过: 没有包入环，同固件立即 BlockSent，环已空时立即评估
+                skipped++;
+                StreamGov_BlockSent(&gov);
+                if (ring_count == 0)
+                {
+                    StreamGov_TxDrained(&gov, now_tick);
+                }
+                pending = -1;
+            }
+            else
+            {
+                decim = (governor_on && !raw) ? (1U << level) : 1U;
+                rate_flag = (decim != last_decim);
+                last_decim = decim;
+                packets = PacketsPerBlock(decim);
+                packet = 0;
+                started = 1;
+            }
+        }
+        while (started && ring_count < TX_RING_DEPTH)
+        {
+            ring[ring_count++] = PacketBytes(decim, packet);
+            if (++packet == packets)
+            {
+                // 块交付: 接收端检查 (仿真中网络不丢包，块在此刻可视为到达)
+                if (rx_last_block >= 0 && pending != rx_last_block + 1)
+                {
+                    rx_gaps += (uint64_t)(pending - rx_last_block - 1);
+                    sec_gaps += (uint64_t)(pending - rx_last_block - 1);
+                }
+                if (decim != rx_decim && !rate_flag && rx_decim != 0)
+                {
+                    rx_unsignalled++;
+                }
+                rx_decim = decim;
+                rx_last_block = pending;
+                rx_blocks++;
+                sec_blocks++;
+
+                StreamGov_BlockSent(&gov);  // 刚入环的包还在环中，固件的 InFlight()==0 检查不成立
+                started = 0;
+                pending = -1;
+            }
+        }
+
+        if (tick % (uint64_t)(1000 / STEP_MS) == (uint64_t)(1000 / STEP_MS) - 1)
+        {
+            printf("%6.0f  %12.1f  %5u  %6llu  %4llu\n", (now_ms + STEP_MS) / 1000.0, mbps,
+                   gov.level, (unsigned long long)sec_blocks, (unsigned long long)sec_gaps);
+            sec_blocks = 0;
+            sec_gaps = 0;
+        }
+    }
+
+    printf("total: blocks=%llu gaps=%llu unsignalled rate changes=%llu  steps down=%u up=%u\n",
+           (unsigned long long)rx_blocks, (unsigned long long)rx_gaps,
+           (unsigned long long)rx_unsignalled, gov.steps_down, gov.steps_up);
+    if (raw)
+    {
+        printf("raw: skipped=%llu dropped=%u\n", (unsigned long long)skipped, gov.blocks_dropped);
+    }
+    // 两种曲线最后10秒都恢复到 10 Mbit/s，调速器应已回到0级
+    if (governor_on && gov.level != 0)
+    {
+        printf("FAIL: governor still at level %u after the link recovered\n", gov.level);
+        return 1;
+    }
+    return 0;
+}
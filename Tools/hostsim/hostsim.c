@@ -0,0 +1,2043 @@
+/**
+ ******************************************************************************
+ * @file    hostsim.c
+ * @brief   采集链路主机仿真内核: 虚拟时间、中断分发、ADS8688模型、以太网发送线路
+ *
+ * @details
+ * - **虚拟时间**: hostsim_now 以CPU周期计。固件代码本身不耗时，只有经过替身的访问
+ * (HOSTSIM_LL, SPI轮询字节, 以太网发送) 和 HostSim_Costs 中的固定开销推进时间。
+ * 推进时间时触发到期的事件，事件置起的中断若优先级高于当前执行流则立即分发，
+ * 因此中断在主循环的LL访问之间抢占，高优先级中断 (TIM2) 也能打断DMA和以太网中断。
+ * - **事件**: SysTick (1ms)、TIM2更新 ((ARR+1)*(PSC+1) 个84MHz定时器时钟)、
+ * SPI1/DMA传输完成 (32位 * SPI分频)、以太网帧发完、控制包到达。
+ * - **ADS8688**: 按数据手册的SPI协议建模。片选下降沿对上一帧命令选定的通道采样，
+ * 同一帧的第17~32个时钟输出该次转换结果; 第16个时钟后译码本帧命令
+ * (NO_OP 在自动模式下前进到下一个已使能通道, AUTO_RST, MAN_Ch_n, RST, STDBY/PWR_DN,
+ * 程序寄存器读写, 读出的寄存器值在第17~24个时钟输出)。
+ * - **以太网**: 发送描述符环与旧版HAL相同 (OWN位、链式描述符)，描述符按顺序以
+ * 100Mbit/s 发出 (含前导码、FCS和帧间隔)，发完清OWN位并触发发送完成中断。
+ * - **LwIP**: 发送环满时 udp_sendto 与 ethernetif.c 的 low_level_output 一样返回 ERR_USE;
+ * ARP在第一次查询 1ms 后解析成功，此前 etharp 只保留每个表项最后一个待发的包 (ARP_QUEUEING 0)。
+ * PBUF_RAM 按 mem.c 的首次适配从 MEM_SIZE 的堆中分配 (含 struct pbuf、预留首部和块头)，
+ * PBUF_POOL 按 PBUF_POOL_BUFSIZE 计数; 分配失败返回NULL。接收帧先占用 ETH_RXBUFNB 个接收
+ * 描述符，MX_LWIP_Process 每次调用像 CubeMX 无操作系统的 ethernetif_input 一样只处理一帧。
+ * - **串口控制台**: 默认日志只计数 (可打印)，串口输出为空操作。HostSim_SetConsole 开启后日志
+ * 记录按固件 LOG_RING_WORDS 的容量排队，由 HostSim_LogProcess 逐条输出到 115200 波特率的串口:
+ * 阻塞模式每字节耗时约87us (USE_UART_DMA_CONSOLE 0)，DMA模式只耗放入环形缓冲区的时间，
+ * 缓冲区按波特率在后台排空 (USE_UART_DMA_CONSOLE 1)。
+ ******************************************************************************
+ */
+
+#include "hostsim.h"
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "debug_log.h"
+#include "eth_txring.h"
+#include "stm32f4xx_it.h"
+#include "uart_console.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define THREAD_PRIORITY     256         // 线程模式的执行优先级 (低于所有中断)
+#define IRQ_INDEX(irq)      ((int)(irq) + 16)
+#define ARP_DELAY_CYCLES    (HOSTSIM_CPU_HZ / 1000U)
+#define ARP_TABLE_SIZE      4
+#define INJECT_QUEUE_SIZE   16
+#define UDP_PCB_COUNT       8
+#define HEAP_MAX_BLOCKS     64          // 同时存在的 PBUF_RAM 块数上限
+#define CONSOLE_BYTE_CYCLES (HOSTSIM_CPU_HZ / (115200U / 10U))  // 8N1 每字节10位
+#define LOG_QUEUE_MAX       (LOG_RING_WORDS / 3U)               // 每条记录至少占3个字
+#define LOG_TEXT_EXTRA      15U         // Log_Process 加上的 "[%6lu.%03lu] " 和 "\r\n"
+
+// lwIP 2.1 在32位目标上的尺寸 (MEM_ALIGNMENT 4)
+#define MEM_ALIGN_SIZE(x)   (((x) + 3U) & ~3U)
+#define SIZEOF_STRUCT_PBUF  16U
+#define MIN_SIZE_ALIGNED    12U
+#define PBUF_LINK_HLEN      14U
+#define PBUF_IP_HLEN        20U
+#define PBUF_TRANSPORT_HLEN 8U
+#define UDP_FRAME_HLEN      (PBUF_LINK_HLEN + PBUF_IP_HLEN + PBUF_TRANSPORT_HLEN)
+
+#define CS_PORT             GPIOA       // 与 main.h 的 CS1 一致
+#define CS_PIN              LL_GPIO_PIN_4
+
+typedef enum {
+    EV_SYSTICK = 0,
+    EV_TIM2,
+    EV_DMA,
+    EV_WIRE,
+    EV_INJECT,
+    EV_FAULT,
+    EV_COUNT
+} EventId;
+
+// ADS8688 命令 (数据手册 表10)
+#define ADS_CMD_NO_OP       0x0000U
+#define ADS_CMD_STDBY       0x8200U
+#define ADS_CMD_PWR_DN      0x8300U
+#define ADS_CMD_RST         0x8500U
+#define ADS_CMD_AUTO_RST    0xA000U
+#define ADS_CMD_MAN_CH0     0xC000U
+#define ADS_REG_AUTO_SEQ_EN 0x01U
+#define ADS_REG_COUNT       0x40U
+
+/* Public variables ----------------------------------------------------------*/
+uint64_t hostsim_now;
+uint64_t hostsim_next_event;
+uint32_t hostsim_ll_cost;
+uint32_t SystemCoreClock = HOSTSIM_CPU_HZ;
+
+SPI_TypeDef  hostsim_spi1, hostsim_spi2, hostsim_spi3;
+DMA_TypeDef  hostsim_dma1, hostsim_dma2;
+TIM_TypeDef  hostsim_tim2;
+GPIO_TypeDef hostsim_gpioa, hostsim_gpiob, hostsim_gpioc, hostsim_gpiof;
+CoreDebug_Type hostsim_coredebug;
+
+ETH_HandleTypeDef heth;                 // 固件中在 ethernetif.c 定义
+struct netif gnetif;                    // 固件中在 lwip.c 定义
+const ip_addr_t ip_addr_any = { 0 };
+
+HostSim_Costs g_hostsim_costs = {
+    .ll_access   = 4,
+    .isr_entry   = 12,
+    .isr_exit    = 10,
+    .tim2_isr    = 30,
+    .dma_isr     = 60,
+    .eth_isr     = 20,
+    .systick_isr = 10,
+    .dma_start   = 6,
+    .fast_send   = 60,
+    .lwip_send   = 2500,
+    .lwip_input  = 800,
+    .copy_per_kb = 350,
+    .log_call    = 60,
+    .log_format  = 1500,
+    .console_putc = 30,
+};
+
+// CubeMX 生成的 lwipopts.h 默认值 (即 lwIP opt.h 的默认值)
+HostSim_LwipOpts g_hostsim_lwip = {
+    .mem_size          = 1600,
+    .pbuf_pool_size    = 16,
+    .pbuf_pool_bufsize = 592,
+};
+
+HostSim_Stats g_hostsim_stats;
+
+/* Private variables ---------------------------------------------------------*/
+static struct {
+    uint64_t ev[EV_COUNT];
+    int32_t  cur_prio;
+    uint32_t n_pending;
+    uint8_t  pending[HOSTSIM_IRQ_COUNT];
+    uint8_t  enabled[HOSTSIM_IRQ_COUNT];
+    uint8_t  prio[HOSTSIM_IRQ_COUNT];
+
+    SysTick_Type systick;
+    SCB_Type     scb;
+    DWT_Type     dwt;
+    uint32_t     tick_ms;
+    uint64_t     systick_reload_at;     // 最近一次 SysTick 重装的时刻
+
+    uint64_t tim2_update_at;            // 最近一次TIM2更新事件的时刻
+    uint8_t  dma_active;
+    uint16_t spi_faults_armed;          // 已到时刻、等待下一次DMA传输的SPI类故障数
+    int16_t  spi_fault;                 // 当前DMA传输将被打断 (故障序号), -1 没有
+    uint8_t  fault_active[HOSTSIM_FAULT_COUNT]; // 正在持续的各类故障数
+
+    ETH_DMADescTypeDef *wire_desc;      // 线路上正在发送的描述符 (最早交给DMA的)
+    uint64_t wire_start;
+
+    HostSim_SinkFn sink;
+    int log_level;
+    uint64_t log_count[LOG_LEVEL_COUNT];
+    uint32_t rng;
+} g;
+
+// --- ADS8688 模型 ---
+static struct {
+    uint8_t  regs[ADS_REG_COUNT];
+    uint8_t  auto_mode;
+    uint8_t  standby;
+    uint8_t  next_ch;                   // 下一个片选下降沿采样的通道
+    uint8_t  cs_low;
+    uint8_t  nbytes;                    // 本帧已交换的字节数
+    uint16_t cmd;
+    uint16_t conv;                      // 本帧输出的转换结果
+    uint8_t  reg_out;                   // 程序寄存器读写帧: 第三个字节输出的寄存器值
+    uint8_t  reg_frame;
+    uint64_t last_conv;
+    uint32_t conv_count[HOSTSIM_ADS_CHANNELS];
+    uint8_t  cut;                       // 本帧被注入的故障截断
+    HostSim_Wave wave[HOSTSIM_ADS_CHANNELS];
+} ads;
+
+static uint64_t g_conv_at[HOSTSIM_ADS_CHANNELS][HOSTSIM_TAG_MOD];  // tagged 转换结果 -> 采样时刻
+
+static HostSim_Fault g_faults[HOSTSIM_FAULT_MAX];
+static uint8_t g_fault_state[HOSTSIM_FAULT_MAX];   // 0 未到时刻, 1 等待传输/持续中, 2 已结束
+static int g_fault_count;
+
+// --- 以太网描述符环和缓冲区 (ethernetif.c 的 DMATxDscrTab / Tx_Buff) ---
+static ETH_DMADescTypeDef g_tx_desc[ETH_TXBUFNB];
+static uint8_t g_tx_buff[ETH_TXBUFNB][ETH_TX_BUF_SIZE] __attribute__((aligned(4)));
+
+// --- LwIP 替身 ---
+static struct udp_pcb g_pcbs[UDP_PCB_COUNT];
+static uint8_t  g_pcb_count;
+static uint16_t g_next_port = 49152;
+
+static struct {
+    ip4_addr_t ip;
+    uint64_t   resolved_at;
+    struct eth_addr mac;
+    struct pbuf *q;                     // 等待解析的包 (etharp_query 的 q)
+    uint16_t   q_src_port;
+    uint16_t   q_dst_port;
+    ip4_addr_t q_dst;
+} g_arp[ARP_TABLE_SIZE];
+static uint8_t g_arp_count;
+
+// mem.c 的堆: 已分配块按偏移排序
+static struct {
+    uint32_t ofs[HEAP_MAX_BLOCKS];
+    uint32_t size[HEAP_MAX_BLOCKS];     // 含块头
+    uint32_t count;
+    uint32_t used;
+} g_heap;
+static uint16_t g_pool_used;
+
+// 串口控制台和日志队列 (HostSim_SetConsole 开启时)
+static struct {
+    HostSim_ConsoleMode mode;
+    uint32_t used;                      // DMA环形缓冲区中尚未发出的字节
+    uint64_t drained_at;                // used 对应的时刻
+    uint16_t len[LOG_QUEUE_MAX];        // 每条记录输出的字节数
+    uint8_t  words[LOG_QUEUE_MAX];      // 每条记录在固件日志环中占的字数
+    uint32_t head, count, words_used;
+} g_console;
+
+static struct {
+    uint64_t   at;
+    ip4_addr_t src;
+    uint16_t   src_port;
+    uint16_t   dst_port;
+    uint16_t   len;
+    uint8_t    data[256];
+} g_inject[INJECT_QUEUE_SIZE];
+static uint8_t g_inject_head, g_inject_count;
+
+// 接收描述符环 (ethernetif.c 的 DMARxDscrTab): 已到达、等待 ethernetif_input 的帧
+static struct {
+    uint8_t    background;              // 1: 与固件无关的广播帧, 协议栈丢弃
+    ip4_addr_t src;
+    uint16_t   src_port;
+    uint16_t   dst_port;
+    uint16_t   len;                     // UDP负载长度 (background: 以太网帧长)
+    uint8_t    data[256];
+} g_rx[ETH_RXBUFNB];
+static uint8_t g_rx_head, g_rx_count;
+static double  g_bg_next = -1.0;        // 下一个背景帧到达的时刻 (周期), <0 没有背景流量
+static double  g_bg_period;
+static uint16_t g_bg_len;
+
+/* Private function prototypes -----------------------------------------------*/
+static void UpdateNextEvent(void);
+static void FireEvents(void);
+static void Dispatch(void);
+static void Pend(IRQn_Type irq);
+static void DmaComplete(void);
+static void FaultEvents(void);
+static uint64_t FaultNext(void);
+static int  SpiFaultArmed(void);
+static void WireStart(void);
+static void WireComplete(void);
+static void AdsCsFall(void);
+static void AdsCsRise(void);
+static uint8_t AdsExchange(uint8_t mosi);
+static uint16_t AdsSample(uint8_t ch);
+static uint32_t SpiCyclesPerBit(const SPI_TypeDef *spi);
+static uint64_t Tim2Period(void);
+static uint64_t RxNextArrival(void);
+static void RxAdmit(void);
+static int  HeapAlloc(uint32_t size, uint32_t *ofs);
+static void HeapFree(uint32_t ofs);
+static int  ArpEntry(const ip4_addr_t *ip);
+static void ArpFlush(void);
+static void ConsoleDrain(void);
+static void LogEnqueue(uint32_t text_len, uint32_t nargs);
+static err_t LinkOutput(uint16_t src_port, const struct pbuf *p, const ip4_addr_t *dst_ip, uint16_t dst_port,
+                        const uint8_t *mac);
+
+/* Public functions ----------------------------------------------------------*/
+
+/**
+ * @brief 复位所有模型和统计
+ */
+void HostSim_Init(void)
+{
+    static const uint8_t probe;
+    uint32_t i;
+
+    // 固件把RAM地址存进32位DMA/描述符寄存器，主机上须链接在4GB以下 (-no-pie)
+    if ((uintptr_t)(uint32_t)(uintptr_t)&probe != (uintptr_t)&probe)
+    {
+        fprintf(stderr, "hostsim: static data above 4GB, link with -no-pie\n");
+        exit(2);
+    }
+
+    memset(&g, 0, sizeof(g));
+    memset(&ads, 0, sizeof(ads));
+    memset(&g_hostsim_stats, 0, sizeof(g_hostsim_stats));
+    hostsim_now = 0;
+    hostsim_ll_cost = g_hostsim_costs.ll_access;
+    for (i = 0; i < EV_COUNT; i++)
+    {
+        g.ev[i] = UINT64_MAX;
+    }
+    g.cur_prio = THREAD_PRIORITY;
+    g.log_level = -1;
+    g.spi_fault = -1;
+    g_fault_count = 0;
+    g.rng = 0x12345678U;
+
+    // HAL_Init: SysTick 1ms, 最低优先级
+    g.systick.LOAD = SystemCoreClock / 1000U - 1U;
+    g.systick.VAL = g.systick.LOAD;
+    g.enabled[IRQ_INDEX(SysTick_IRQn)] = 1;
+    g.prio[IRQ_INDEX(SysTick_IRQn)] = 15;
+    g.ev[EV_SYSTICK] = SystemCoreClock / 1000U;
+
+    memset(&hostsim_spi1, 0, sizeof(SPI_TypeDef));
+    memset(&hostsim_dma2, 0, sizeof(DMA_TypeDef));
+    memset(&hostsim_tim2, 0, sizeof(TIM_TypeDef));
+    hostsim_gpioa.ODR = CS_PIN;         // MX_GPIO_Init: 片选空闲为高
+
+    // ethernetif.c: HAL_ETH_DMATxDescListInit 的链式描述符
+    for (i = 0; i < ETH_TXBUFNB; i++)
+    {
+        g_tx_desc[i].Status = 0;
+        g_tx_desc[i].Buffer1Addr = (uint32_t)(uintptr_t)g_tx_buff[i];
+        g_tx_desc[i].Buffer2NextDescAddr = (uint32_t)(uintptr_t)&g_tx_desc[(i + 1) % ETH_TXBUFNB];
+    }
+    memset(&heth, 0, sizeof(heth));
+    heth.TxDesc = &g_tx_desc[0];
+    g.wire_desc = &g_tx_desc[0];
+
+    // lwip.c: 静态IP 192.168.0.10/24
+    memset(&gnetif, 0, sizeof(gnetif));
+    IP4_ADDR(&gnetif.ip_addr, 192, 168, 0, 10);
+    IP4_ADDR(&gnetif.netmask, 255, 255, 255, 0);
+    IP4_ADDR(&gnetif.gw, 192, 168, 0, 1);
+    gnetif.hwaddr[0] = 0x02;
+    gnetif.flags = NETIF_FLAG_UP | NETIF_FLAG_LINK_UP;
+    g_pcb_count = 0;
+    g_arp_count = 0;
+    g_inject_head = g_inject_count = 0;
+    g_rx_head = g_rx_count = 0;
+    g_bg_next = -1.0;
+    memset(&g_heap, 0, sizeof(g_heap));
+    g_pool_used = 0;
+    memset(&g_console, 0, sizeof(g_console));
+    g_hostsim_stats.pool_min_free = g_hostsim_lwip.pbuf_pool_size;
+
+    // ADS8688 上电: 手动模式通道0, 全部通道参与自动扫描
+    ads.regs[ADS_REG_AUTO_SEQ_EN] = 0xFF;
+    ads.last_conv = UINT64_MAX;
+    for (i = 0; i < HOSTSIM_ADS_CHANNELS; i++)
+    {
+        ads.wave[i].type = HOSTSIM_WAVE_TAGGED;
+    }
+    g_hostsim_stats.ads_min_cycle = UINT64_MAX;
+
+    UpdateNextEvent();
+}
+
+/**
+ * @brief 清零统计 (例如在固件初始化之后, 只统计采集期间)
+ */
+void HostSim_ResetStats(void)
+{
+    memset(&g_hostsim_stats, 0, sizeof(g_hostsim_stats));
+    g_hostsim_stats.ads_min_cycle = UINT64_MAX;
+    g_hostsim_stats.heap_peak = g_heap.used;
+    g_hostsim_stats.pool_min_free = (uint16_t)(g_hostsim_lwip.pbuf_pool_size - g_pool_used);
+    ads.last_conv = UINT64_MAX;
+}
+
+void HostSim_SetWave(uint8_t ch, const HostSim_Wave *wave)
+{
+    if (ch < HOSTSIM_ADS_CHANNELS)
+    {
+        ads.wave[ch] = *wave;
+    }
+}
+
+void HostSim_SetSink(HostSim_SinkFn sink)
+{
+    g.sink = sink;
+}
+
+void HostSim_SetLogLevel(int level)
+{
+    g.log_level = level;
+}
+
+uint64_t HostSim_Now(void)
+{
+    return hostsim_now;
+}
+
+uint64_t HostSim_LogCount(uint32_t level)
+{
+    return (level < LOG_LEVEL_COUNT) ? g.log_count[level] : 0;
+}
+
+/**
+ * @brief 选择串口控制台模型并清空日志队列
+ */
+void HostSim_SetConsole(HostSim_ConsoleMode mode)
+{
+    memset(&g_console, 0, sizeof(g_console));
+    g_console.mode = mode;
+    g_console.drained_at = hostsim_now;
+}
+
+/**
+ * @brief printf 经 fputc 输出 len 个字节: 阻塞模式等待逐字节发完，DMA模式放不下的字节被丢弃
+ */
+void HostSim_ConsoleWrite(uint32_t len)
+{
+    uint32_t room;
+
+    if (g_console.mode == HOSTSIM_CONSOLE_OFF)
+    {
+        return;
+    }
+    g_hostsim_stats.console_bytes += len;
+    if (g_console.mode == HOSTSIM_CONSOLE_BLOCKING)
+    {
+        HostSim_Spend(len * CONSOLE_BYTE_CYCLES);   // HAL_UART_Transmit 轮询 TXE/TC
+        return;
+    }
+
+    ConsoleDrain();
+    room = UART_CONSOLE_BUF_SIZE - g_console.used;
+    if (len > room)
+    {
+        g_hostsim_stats.console_dropped += len - room;
+    }
+    g_console.used += (len > room) ? room : len;
+    if (g_console.used > g_hostsim_stats.console_max_used)
+    {
+        g_hostsim_stats.console_max_used = g_console.used;
+    }
+    HostSim_Spend(len * g_hostsim_costs.console_putc);  // 丢弃的字符同样经过 fputc
+}
+
+/**
+ * @brief Log_Process: 取出一条记录，格式化后输出
+ */
+void HostSim_LogProcess(void)
+{
+    uint32_t len;
+
+    if (g_console.count == 0)
+    {
+        return;
+    }
+    len = g_console.len[g_console.head];
+    g_console.words_used -= g_console.words[g_console.head];
+    g_console.head = (g_console.head + 1U) % LOG_QUEUE_MAX;
+    g_console.count--;
+    g_hostsim_stats.log_records++;
+    HostSim_Spend(g_hostsim_costs.log_format);
+    HostSim_ConsoleWrite(len);
+}
+
+int HostSim_LogPending(void)
+{
+    return g_console.count != 0;
+}
+
+/**
+ * @brief 排队一个发往固件的UDP包 (当前时刻到达, 由下一次 MX_LWIP_Process 交付)
+ */
+void HostSim_Inject(const ip4_addr_t *src, uint16_t src_port, uint16_t dst_port,
+                    const void *data, uint16_t len)
+{
+    uint8_t idx;
+
+    if (g_inject_count >= INJECT_QUEUE_SIZE || len > sizeof(g_inject[0].data))
+    {
+        return;
+    }
+    idx = (uint8_t)((g_inject_head + g_inject_count) % INJECT_QUEUE_SIZE);
+    g_inject[idx].at = hostsim_now;
+    g_inject[idx].src = *src;
+    g_inject[idx].src_port = src_port;
+    g_inject[idx].dst_port = dst_port;
+    g_inject[idx].len = len;
+    memcpy(g_inject[idx].data, data, len);
+    g_inject_count++;
+    g.ev[EV_INJECT] = RxNextArrival();
+    UpdateNextEvent();
+}
+
+/**
+ * @brief 设置背景接收流量: 从当前时刻起按固定间隔到达的广播帧
+ * @param frames_per_s 0: 关闭
+ * @param len          以太网帧长 (不含FCS)
+ */
+void HostSim_SetRxLoad(double frames_per_s, uint16_t len)
+{
+    if (frames_per_s <= 0.0)
+    {
+        g_bg_next = -1.0;
+    }
+    else
+    {
+        g_bg_period = (double)HOSTSIM_CPU_HZ / frames_per_s;
+        g_bg_next = (double)hostsim_now + g_bg_period;
+        g_bg_len = (len < 60U) ? 60U : len;
+    }
+    g.ev[EV_INJECT] = RxNextArrival();
+    UpdateNextEvent();
+}
+
+uint32_t HostSim_HeapUsed(void)
+{
+    return g_heap.used;
+}
+
+uint16_t HostSim_PoolUsed(void)
+{
+    return g_pool_used;
+}
+
+/**
+ * @brief 计划一次故障 (时刻可以无序, 须在 HostSim_Init 之后)
+ * @param arg SPI类: 被打断前交换的字节数 (>=2 时ADS8688已译码命令并前进到下一个通道);
+ *            其余: 持续的周期数
+ */
+int HostSim_ScheduleFault(HostSim_FaultType type, uint64_t at, uint32_t arg)
+{
+    HostSim_Fault *f;
+
+    if (g_fault_count >= HOSTSIM_FAULT_MAX || type >= HOSTSIM_FAULT_COUNT)
+    {
+        return -1;
+    }
+    f = &g_faults[g_fault_count];
+    memset(f, 0, sizeof(*f));
+    f->type = type;
+    f->at = at;
+    f->arg = arg;
+    g_fault_state[g_fault_count] = 0;
+    g_fault_count++;
+    g.ev[EV_FAULT] = FaultNext();
+    UpdateNextEvent();
+    return g_fault_count - 1;
+}
+
+int HostSim_FaultCount(void)
+{
+    return g_fault_count;
+}
+
+const HostSim_Fault *HostSim_GetFault(int idx)
+{
+    return (idx >= 0 && idx < g_fault_count) ? &g_faults[idx] : NULL;
+}
+
+uint64_t HostSim_ConversionTime(uint16_t code)
+{
+    return g_conv_at[HOSTSIM_TAG_CHANNEL(code)][HOSTSIM_TAG_COUNT(code)];
+}
+
+/**
+ * @brief 主循环空转: 没有待处理的工作时按整轮跳过，直到下一个事件所在的一轮
+ * @param pass_cycles 主循环空转一轮的周期数
+ * @note  保持事件相对主循环各轮的相位，与逐轮执行的结果相同
+ */
+void HostSim_Idle(uint32_t pass_cycles)
+{
+    uint64_t passes;
+
+    if (pass_cycles == 0 || hostsim_next_event == UINT64_MAX || hostsim_next_event <= hostsim_now ||
+        g_rx_count != 0 || RxNextArrival() <= hostsim_now)
+    {
+        return;
+    }
+    passes = (hostsim_next_event - hostsim_now) / pass_cycles;
+    hostsim_now += passes * pass_cycles;
+    g_hostsim_stats.idle_skipped += passes * pass_cycles;
+}
+
+/**
+ * @brief 推进虚拟时间; 触发其间到期的事件并分发可抢占当前执行流的中断
+ * @note  中断的执行时间加在当前执行流上
+ */
+void HostSim_SpendSlow(uint32_t cycles)
+{
+    uint64_t target = hostsim_now + cycles;
+
+    for (;;)
+    {
+        if (hostsim_next_event > target)
+        {
+            hostsim_now = target;
+            return;
+        }
+        if (hostsim_next_event > hostsim_now)
+        {
+            hostsim_now = hostsim_next_event;
+        }
+        FireEvents();
+        if (g.n_pending != 0)
+        {
+            uint64_t t0 = hostsim_now;
+            Dispatch();
+            target += hostsim_now - t0;
+        }
+    }
+}
+
+/* --- CMSIS ---------------------------------------------------------------- */
+
+SysTick_Type *HostSim_SysTick(void)
+{
+    g.systick.VAL = g.systick.LOAD - (uint32_t)((hostsim_now - g.systick_reload_at) % (g.systick.LOAD + 1U));
+    return &g.systick;
+}
+
+SCB_Type *HostSim_Scb(void)
+{
+    if (g.pending[IRQ_INDEX(SysTick_IRQn)])
+    {
+        g.scb.ICSR |= SCB_ICSR_PENDSTSET_Msk;
+    }
+    else
+    {
+        g.scb.ICSR &= ~SCB_ICSR_PENDSTSET_Msk;
+    }
+    return &g.scb;
+}
+
+DWT_Type *HostSim_Dwt(void)
+{
+    g.dwt.CYCCNT = (uint32_t)hostsim_now;
+    return &g.dwt;
+}
+
+void NVIC_SetPriority(IRQn_Type irq, uint32_t priority)
+{
+    g.prio[IRQ_INDEX(irq)] = (uint8_t)(priority & 0x0FU);
+}
+
+void NVIC_EnableIRQ(IRQn_Type irq)
+{
+    HOSTSIM_LL();
+    g.enabled[IRQ_INDEX(irq)] = 1;
+    if (g.pending[IRQ_INDEX(irq)])
+    {
+        Dispatch(); // 屏蔽期间挂起的中断在使能后立即执行
+    }
+}
+
+void NVIC_DisableIRQ(IRQn_Type irq)
+{
+    HOSTSIM_LL();
+    g.enabled[IRQ_INDEX(irq)] = 0;
+}
+
+uint32_t NVIC_GetPriorityGrouping(void)
+{
+    return 3U; // NVIC_PRIORITYGROUP_4: 4位抢占优先级, 无子优先级
+}
+
+uint32_t NVIC_EncodePriority(uint32_t group, uint32_t preempt, uint32_t sub)
+{
+    uint32_t pre_bits = (7U - group > 4U) ? 4U : 7U - group;
+    uint32_t sub_bits = (group + 4U < 7U) ? 0U : group + 4U - 7U;
+
+    return ((preempt & ((1U << pre_bits) - 1U)) << sub_bits) | (sub & ((1U << sub_bits) - 1U));
+}
+
+/* --- HAL ------------------------------------------------------------------ */
+
+uint32_t HAL_GetTick(void)
+{
+    return g.tick_ms;
+}
+
+void HAL_IncTick(void)
+{
+    g.tick_ms++;
+}
+
+void HAL_Delay(uint32_t ms)
+{
+    uint32_t start = HAL_GetTick();
+
+    while (HAL_GetTick() - start < ms + 1U)
+    {
+        HostSim_Spend(SystemCoreClock / 1000U);
+    }
+}
+
+/* --- 外设副作用 ----------------------------------------------------------- */
+
+void HostSim_GpioWrite(GPIO_TypeDef *port, uint32_t pins, uint8_t level)
+{
+    uint32_t old = port->ODR;
+
+    HOSTSIM_LL();
+    port->ODR = level ? (old | pins) : (old & ~pins);
+    if (port == CS_PORT && (pins & CS_PIN) != 0)
+    {
+        if (!level && (old & CS_PIN) != 0)
+        {
+            AdsCsFall();
+        }
+        else if (level && (old & CS_PIN) == 0)
+        {
+            AdsCsRise();
+        }
+    }
+}
+
+void HostSim_DmaStreamEnable(DMA_TypeDef *dma, uint32_t stream)
+{
+    dma->Stream[stream].CR |= DMA_SxCR_EN;
+
+    // SPI1 全双工: RX(stream0) 和 TX(stream3) 都使能、SPI已使能且开了DMA请求后开始传输
+    if (dma == DMA2 && !g.dma_active &&
+        (dma->Stream[0].CR & DMA_SxCR_EN) && (dma->Stream[3].CR & DMA_SxCR_EN) &&
+        (SPI1->CR1 & SPI_CR1_SPE) && (SPI1->CR2 & SPI_CR2_TXDMAEN))
+    {
+        uint32_t bits = dma->Stream[3].NDTR * 8U;
+
+        SPI1->SR &= ~SPI_SR_OVR;    // 固件在SPI1中断中读DR、SR清除; 替身的寄存器读没有副作用, 在这里补做
+        g.dma_active = 1;
+        g.spi_fault = (g.spi_faults_armed != 0) ? SpiFaultArmed() : -1;
+        if (g.spi_fault >= 0 && g_faults[g.spi_fault].arg * 8U < bits)
+        {
+            bits = g_faults[g.spi_fault].arg * 8U;
+        }
+        g.ev[EV_DMA] = hostsim_now + g_hostsim_costs.dma_start + (uint64_t)bits * SpiCyclesPerBit(SPI1);
+        UpdateNextEvent();
+    }
+}
+
+void HostSim_DmaStreamDisable(DMA_TypeDef *dma, uint32_t stream)
+{
+    dma->Stream[stream].CR &= ~DMA_SxCR_EN;
+    if (dma == DMA2 && g.dma_active && (stream == 0 || stream == 3))
+    {
+        g.dma_active = 0; // 传输被中止
+        g.spi_fault = -1;   // 故障没来得及发生, 留给下一次传输
+        g.ev[EV_DMA] = UINT64_MAX;
+        UpdateNextEvent();
+    }
+}
+
+void HostSim_SpiWrite8(SPI_TypeDef *spi, uint8_t data)
+{
+    uint8_t miso = 0xFF;
+
+    HostSim_Spend(8U * SpiCyclesPerBit(spi));
+    if (spi == SPI1 && ads.cs_low)
+    {
+        miso = AdsExchange(data);
+    }
+    if (spi->SR & SPI_SR_RXNE)
+    {
+        spi->SR |= SPI_SR_OVR; // 上一个字节尚未读出
+    }
+    spi->DR = miso;
+    spi->SR |= SPI_SR_RXNE | SPI_SR_TXE;
+}
+
+void HostSim_TimEnable(TIM_TypeDef *tim)
+{
+    tim->CR1 |= TIM_CR1_CEN;
+    if (tim == TIM2)
+    {
+        g.tim2_update_at = hostsim_now;
+        g.ev[EV_TIM2] = hostsim_now + Tim2Period();
+        UpdateNextEvent();
+    }
+}
+
+uint32_t HostSim_TimCounter(TIM_TypeDef *tim)
+{
+    uint64_t cnt;
+
+    if (tim != TIM2 || !(tim->CR1 & TIM_CR1_CEN))
+    {
+        return 0;
+    }
+    cnt = (hostsim_now - g.tim2_update_at) / (2U * (tim->PSC + 1U)); // APB1定时器时钟 = CPU/2
+    return (cnt > tim->ARR) ? tim->ARR : (uint32_t)cnt;
+}
+
+/* --- 以太网 --------------------------------------------------------------- */
+
+/**
+ * @brief 把当前描述符 (缓冲区已填好) 交给以太网DMA
+ */
+HAL_StatusTypeDef HAL_ETH_TransmitFrame(ETH_HandleTypeDef *h, uint32_t len)
+{
+    ETH_DMADescTypeDef *desc = h->TxDesc;
+
+    HostSim_Spend(g_hostsim_costs.fast_send + (uint32_t)(((uint64_t)len * g_hostsim_costs.copy_per_kb) >> 10));
+    if ((desc->Status & ETH_DMATXDESC_OWN) != 0 || len > ETH_TX_BUF_SIZE)
+    {
+        g_hostsim_stats.eth_ring_full++;
+        return HAL_ERROR;
+    }
+    desc->ControlBufferSize = len;
+    desc->Status |= ETH_DMATXDESC_OWN | ETH_DMATXDESC_FS | ETH_DMATXDESC_LS;
+    h->TxDesc = (ETH_DMADescTypeDef *)(uintptr_t)desc->Buffer2NextDescAddr;
+    if (g.ev[EV_WIRE] == UINT64_MAX)
+    {
+        WireStart();
+    }
+    return HAL_OK;
+}
+
+void HAL_ETH_IRQHandler(ETH_HandleTypeDef *h)
+{
+    if (h->dma_sr & ETH_DMA_IT_T)
+    {
+        h->dma_sr &= ~ETH_DMA_IT_T;
+        HAL_ETH_TxCpltCallback(h);
+    }
+}
+
+/* --- LwIP 替身 ------------------------------------------------------------ */
+
+/**
+ * @brief 分配pbuf: PBUF_RAM 计入堆, PBUF_POOL 计入池 (长度超过一个池缓冲区时按链占用多个)
+ */
+struct pbuf *pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type)
+{
+    static const uint16_t layer_hlen[] = {
+        [PBUF_TRANSPORT] = UDP_FRAME_HLEN,
+        [PBUF_IP]        = PBUF_LINK_HLEN + PBUF_IP_HLEN,
+        [PBUF_LINK]      = PBUF_LINK_HLEN,
+        [PBUF_RAW]       = 0,
+    };
+    uint16_t offset = layer_hlen[layer];
+    uint32_t units = 0;
+    uint32_t ofs = 0;
+    struct pbuf *p;
+
+    if (g.fault_active[HOSTSIM_FAULT_PBUF] && (type == PBUF_RAM || type == PBUF_POOL))
+    {
+        g_hostsim_stats.fault_hits[HOSTSIM_FAULT_PBUF]++;
+        return NULL;
+    }
+    if (type == PBUF_RAM)
+    {
+        units = MEM_ALIGN_SIZE(SIZEOF_STRUCT_PBUF + offset) + MEM_ALIGN_SIZE(length);
+        if (!HeapAlloc(units, &ofs))
+        {
+            g_hostsim_stats.heap_errors++;
+            return NULL;
+        }
+    }
+    else if (type == PBUF_POOL)
+    {
+        uint32_t buf = MEM_ALIGN_SIZE(g_hostsim_lwip.pbuf_pool_bufsize);
+        uint32_t first = buf - MEM_ALIGN_SIZE(offset);
+
+        units = 1U + ((length > first) ? (length - first + buf - 1U) / buf : 0U);
+        if (g_pool_used + units > g_hostsim_lwip.pbuf_pool_size)
+        {
+            g_hostsim_stats.pool_errors++;
+            return NULL;
+        }
+        g_pool_used = (uint16_t)(g_pool_used + units);
+        if (g_hostsim_lwip.pbuf_pool_size - g_pool_used < g_hostsim_stats.pool_min_free)
+        {
+            g_hostsim_stats.pool_min_free = (uint16_t)(g_hostsim_lwip.pbuf_pool_size - g_pool_used);
+        }
+    }
+
+    p = malloc(sizeof(struct pbuf) + offset + length);
+    if (p == NULL)
+    {
+        fprintf(stderr, "hostsim: out of host memory\n");
+        exit(2);
+    }
+    p->next = NULL;
+    p->payload = (uint8_t *)(p + 1) + offset;
+    p->tot_len = p->len = length;
+    p->type = (u8_t)type;
+    p->ref = 1;
+    p->hostsim_units = (u16_t)units;
+    p->hostsim_offset = ofs;
+    return p;
+}
+
+u8_t pbuf_free(struct pbuf *p)
+{
+    if (p == NULL || --p->ref != 0)
+    {
+        return 0;
+    }
+    if (p->type == PBUF_RAM)
+    {
+        HeapFree(p->hostsim_offset);
+    }
+    else if (p->type == PBUF_POOL)
+    {
+        g_pool_used = (uint16_t)(g_pool_used - p->hostsim_units);
+    }
+    free(p);
+    return 1;
+}
+
+void pbuf_ref(struct pbuf *p)
+{
+    p->ref++;
+}
+
+err_t pbuf_take(struct pbuf *p, const void *data, u16_t len)
+{
+    if (len > p->tot_len)
+    {
+        return ERR_ARG;
+    }
+    memcpy(p->payload, data, len);
+    return ERR_OK;
+}
+
+u8_t pbuf_get_at(const struct pbuf *p, u16_t offset)
+{
+    return (offset < p->len) ? ((const u8_t *)p->payload)[offset] : 0;
+}
+
+u16_t pbuf_copy_partial(const struct pbuf *p, void *dst, u16_t len, u16_t offset)
+{
+    if (offset >= p->len)
+    {
+        return 0;
+    }
+    if (len > p->len - offset)
+    {
+        len = (u16_t)(p->len - offset);
+    }
+    memcpy(dst, (const u8_t *)p->payload + offset, len);
+    return len;
+}
+
+struct udp_pcb *udp_new(void)
+{
+    struct udp_pcb *pcb;
+
+    if (g_pcb_count >= UDP_PCB_COUNT)
+    {
+        return NULL;
+    }
+    pcb = &g_pcbs[g_pcb_count++];
+    memset(pcb, 0, sizeof(*pcb));
+    pcb->ttl = 255;
+    return pcb;
+}
+
+err_t udp_bind(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port)
+{
+    (void)ipaddr;
+    pcb->local_port = port ? port : g_next_port++;
+    return ERR_OK;
+}
+
+err_t udp_connect(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port)
+{
+    if (pcb->local_port == 0)
+    {
+        udp_bind(pcb, IP_ADDR_ANY, 0);
+    }
+    pcb->remote_ip = *ipaddr;
+    pcb->remote_port = port;
+    return ERR_OK;
+}
+
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *recv_arg)
+{
+    pcb->recv = recv;
+    pcb->recv_arg = recv_arg;
+}
+
+/**
+ * @brief udp_sendto -> ip4_output -> etharp_output: 目的MAC已解析时组帧交给 low_level_output,
+ *        否则由 etharp 保留该包 (替换同一表项上一个待发的包) 并返回 ERR_OK
+ * @retval ERR_USE 发送环满 (low_level_output)
+ * @retval ERR_RTE 链路断开 (ip4_route 不选链路断开的接口)
+ */
+err_t udp_sendto(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *dst_ip, u16_t dst_port)
+{
+    const ip4_addr_t *next_hop = dst_ip;
+    uint8_t mac[6];
+    int i;
+
+    HostSim_Spend(g_hostsim_costs.lwip_send);
+    if (pcb->local_port == 0)
+    {
+        udp_bind(pcb, IP_ADDR_ANY, 0);
+    }
+    if (UDP_FRAME_HLEN + p->tot_len > ETH_TX_BUF_SIZE)
+    {
+        return ERR_VAL;
+    }
+    if (!netif_is_link_up(&gnetif))
+    {
+        g_hostsim_stats.fault_hits[HOSTSIM_FAULT_LINK_DOWN]++;
+        return ERR_RTE;
+    }
+    if (g.fault_active[HOSTSIM_FAULT_UDP_ERR_MEM])
+    {
+        g_hostsim_stats.fault_hits[HOSTSIM_FAULT_UDP_ERR_MEM]++;
+        return ERR_MEM;
+    }
+    if (ip4_addr_isbroadcast(dst_ip, &gnetif) || ip4_addr_ismulticast(dst_ip))
+    {
+        memset(mac, 0xFF, sizeof(mac));
+        return LinkOutput(pcb->local_port, p, dst_ip, dst_port, mac);
+    }
+    if (!ip4_addr_netcmp(dst_ip, netif_ip4_addr(&gnetif), netif_ip4_netmask(&gnetif)))
+    {
+        next_hop = netif_ip4_gw(&gnetif);
+    }
+
+    i = ArpEntry(next_hop);
+    if (i < 0)
+    {
+        return ERR_MEM;
+    }
+    if (hostsim_now >= g_arp[i].resolved_at)
+    {
+        return LinkOutput(pcb->local_port, p, dst_ip, dst_port, g_arp[i].mac.addr);
+    }
+    if (g_arp[i].q != NULL)
+    {
+        pbuf_free(g_arp[i].q);
+        g_hostsim_stats.arp_queue_drops++;
+    }
+    pbuf_ref(p);                        // PBUF_RAM 不复制
+    g_arp[i].q = p;
+    g_arp[i].q_src_port = pcb->local_port;
+    g_arp[i].q_dst_port = dst_port;
+    g_arp[i].q_dst = *dst_ip;
+    g_hostsim_stats.arp_queued++;
+    g.ev[EV_INJECT] = RxNextArrival();  // ARP应答到达时由 MX_LWIP_Process 发出
+    UpdateNextEvent();
+    return ERR_OK;
+}
+
+err_t udp_send(struct udp_pcb *pcb, struct pbuf *p)
+{
+    return udp_sendto(pcb, p, &pcb->remote_ip, pcb->remote_port);
+}
+
+u8_t ip4_addr_isbroadcast(const ip4_addr_t *addr, const struct netif *nif)
+{
+    u32_t host = ~nif->netmask.addr;
+
+    return addr->addr == 0xFFFFFFFFU || (addr->addr & host) == host;
+}
+
+int etharp_find_addr(struct netif *nif, const ip4_addr_t *ipaddr,
+                     struct eth_addr **eth_ret, const ip4_addr_t **ip_ret)
+{
+    uint8_t i;
+
+    (void)nif;
+    for (i = 0; i < g_arp_count; i++)
+    {
+        if (g_arp[i].ip.addr == ipaddr->addr && hostsim_now >= g_arp[i].resolved_at)
+        {
+            *eth_ret = &g_arp[i].mac;
+            *ip_ret = &g_arp[i].ip;
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief 发起ARP查询: 对端在 ARP_DELAY_CYCLES 后应答 (MAC为 02:00:00:00:00:<IP末字节>)
+ */
+err_t etharp_query(struct netif *nif, const ip4_addr_t *ipaddr, struct pbuf *q)
+{
+    (void)nif;
+    (void)q;                            // 固件只用 q == NULL (快速通道的解析与续期)
+    return (ArpEntry(ipaddr) < 0) ? ERR_MEM : ERR_OK;
+}
+
+void MX_LWIP_Init(void)
+{
+}
+
+/**
+ * @brief ethernetif_input: 从接收描述符环取一帧交给协议栈 (每次调用最多一帧)
+ * @note  ARP应答不占接收描述符，在这里直接发出 etharp 保留的包
+ */
+void MX_LWIP_Process(void)
+{
+    uint8_t i;
+
+    RxAdmit();
+    ArpFlush();
+    if (g_rx_count == 0)
+    {
+        return;
+    }
+
+    {
+        uint8_t idx = g_rx_head;
+        uint16_t frame_len = g_rx[idx].background ? g_rx[idx].len : (uint16_t)(UDP_FRAME_HLEN + g_rx[idx].len);
+        struct pbuf *p;
+
+        HostSim_Spend(g_hostsim_costs.lwip_input);
+        g_hostsim_stats.rx_frames++;
+        p = pbuf_alloc(PBUF_RAW, frame_len, PBUF_POOL);  // low_level_input; 失败时该帧丢弃
+        if (p != NULL && g_rx[idx].background)
+        {
+            pbuf_free(p);
+            p = NULL;
+        }
+        if (p != NULL)
+        {
+            p->payload = (uint8_t *)p->payload + UDP_FRAME_HLEN;   // udp_input 剥去首部
+            p->tot_len = p->len = g_rx[idx].len;
+            memcpy(p->payload, g_rx[idx].data, g_rx[idx].len);
+            for (i = 0; i < g_pcb_count; i++)
+            {
+                if (g_pcbs[i].local_port == g_rx[idx].dst_port && g_pcbs[i].recv != NULL)
+                {
+                    g_pcbs[i].recv(g_pcbs[i].recv_arg, &g_pcbs[i], p, &g_rx[idx].src, g_rx[idx].src_port);
+                    p = NULL;           // 回调负责释放
+                    break;
+                }
+            }
+            pbuf_free(p);
+        }
+        g_rx_head = (uint8_t)((g_rx_head + 1U) % ETH_RXBUFNB);
+        g_rx_count--;
+    }
+}
+
+/* --- 固件其余模块的替身 --------------------------------------------------- */
+
+void Log_Write(uint32_t level, const char *format, uint32_t nargs, ...)
+{
+    HostSim_Spend(g_hostsim_costs.log_call);
+    if (level < LOG_LEVEL_COUNT)
+    {
+        g.log_count[level]++;
+    }
+    if (g_console.mode != HOSTSIM_CONSOLE_OFF)
+    {
+        va_list ap;
+
+        va_start(ap, nargs);
+        LogEnqueue((uint32_t)vsnprintf(NULL, 0, format, ap), nargs);
+        va_end(ap);
+    }
+    if ((int)level <= g.log_level)
+    {
+        va_list ap;
+
+        printf("[%10.6f] ", (double)hostsim_now / HOSTSIM_CPU_HZ);
+        va_start(ap, nargs);
+        vprintf(format, ap);
+        va_end(ap);
+        printf("\n");
+    }
+}
+
+void Log_Debug(const char *message)
+{
+    HostSim_Spend(g_hostsim_costs.log_call);
+    g.log_count[LOG_LEVEL_DEBUG]++;
+    if (g_console.mode != HOSTSIM_CONSOLE_OFF)
+    {
+        LogEnqueue((uint32_t)strlen(message), 0);
+    }
+    if (g.log_level >= (int)LOG_LEVEL_DEBUG)
+    {
+        printf("[%10.6f] %s\n", (double)hostsim_now / HOSTSIM_CPU_HZ, message);
+    }
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+static void UpdateNextEvent(void)
+{
+    uint64_t next = UINT64_MAX;
+    uint32_t i;
+
+    for (i = 0; i < EV_COUNT; i++)
+    {
+        if (g.ev[i] < next)
+        {
+            next = g.ev[i];
+        }
+    }
+    hostsim_next_event = next;
+}
+
+static void Pend(IRQn_Type irq)
+{
+    int idx = IRQ_INDEX(irq);
+
+    if (!g.pending[idx])
+    {
+        g.pending[idx] = 1;
+        g.n_pending++;
+    }
+}
+
+/**
+ * @brief 触发所有不晚于当前时刻的事件
+ */
+static void FireEvents(void)
+{
+    uint64_t now = hostsim_now;
+
+    if (g.ev[EV_SYSTICK] <= now)
+    {
+        g.systick_reload_at = g.ev[EV_SYSTICK];
+        g.ev[EV_SYSTICK] += g.systick.LOAD + 1U;
+        Pend(SysTick_IRQn);
+    }
+    if (g.ev[EV_TIM2] <= now)
+    {
+        g.tim2_update_at = g.ev[EV_TIM2];
+        g.ev[EV_TIM2] += Tim2Period();
+        g_hostsim_stats.tim2_updates++;
+        TIM2->SR |= TIM_SR_UIF;
+        if (TIM2->DIER & TIM_DIER_UIE)
+        {
+            Pend(TIM2_IRQn);
+        }
+    }
+    if (g.ev[EV_DMA] <= now)
+    {
+        g.ev[EV_DMA] = UINT64_MAX;
+        DmaComplete();
+    }
+    if (g.ev[EV_WIRE] <= now)
+    {
+        g.ev[EV_WIRE] = UINT64_MAX;
+        WireComplete();
+    }
+    if (g.ev[EV_INJECT] <= now)
+    {
+        g.ev[EV_INJECT] = UINT64_MAX; // 只用于结束空转, 帧由 MX_LWIP_Process 收进接收环并交付
+    }
+    if (g.ev[EV_FAULT] <= now)
+    {
+        FaultEvents();
+    }
+    UpdateNextEvent();
+}
+
+/**
+ * @brief 按优先级执行所有能抢占当前执行流的挂起中断 (含尾链)
+ */
+static void Dispatch(void)
+{
+    static const struct {
+        IRQn_Type irq;
+        void (*handler)(void);
+    } table[] = {
+        { SysTick_IRQn,      SysTick_Handler },
+        { TIM2_IRQn,         TIM2_IRQHandler },
+        { SPI1_IRQn,         SPI1_IRQHandler },
+        { DMA2_Stream0_IRQn, DMA2_Stream0_IRQHandler },
+        { ETH_IRQn,          ETH_IRQHandler },
+    };
+
+    while (g.n_pending != 0)
+    {
+        int32_t best_prio = g.cur_prio;
+        int best = -1;
+        uint32_t i;
+
+        for (i = 0; i < sizeof(table) / sizeof(table[0]); i++)
+        {
+            int idx = IRQ_INDEX(table[i].irq);
+
+            if (g.pending[idx] && g.enabled[idx] && (int32_t)g.prio[idx] < best_prio)
+            {
+                best_prio = g.prio[idx];
+                best = (int)i;
+            }
+        }
+        if (best < 0)
+        {
+            return;
+        }
+
+        {
+            int idx = IRQ_INDEX(table[best].irq);
+            int32_t saved = g.cur_prio;
+            uint32_t body;
+
+            g.pending[idx] = 0;
+            g.n_pending--;
+            g_hostsim_stats.irq_count[idx]++;
+            if (saved != THREAD_PRIORITY)
+            {
+                g_hostsim_stats.preemptions++;
+            }
+            switch (table[best].irq)
+            {
+            case TIM2_IRQn:         body = g_hostsim_costs.tim2_isr; break;
+            case DMA2_Stream0_IRQn: body = g_hostsim_costs.dma_isr; break;
+            case ETH_IRQn:          body = g_hostsim_costs.eth_isr; break;
+            case SysTick_IRQn:      body = g_hostsim_costs.systick_isr; break;
+            default:                body = 0; break;
+            }
+
+            g.cur_prio = g.prio[idx];
+            HostSim_Spend(g_hostsim_costs.isr_entry);
+            table[best].handler();
+            HostSim_Spend(body + g_hostsim_costs.isr_exit);
+            g.cur_prio = saved;
+        }
+    }
+}
+
+static uint32_t SpiCyclesPerBit(const SPI_TypeDef *spi)
+{
+    // APB2 = 84MHz = CPU/2, SPI时钟 = APB2 / 2^(BR+1)
+    return 2U * (2U << ((spi->CR1 & SPI_CR1_BR_Msk) >> SPI_CR1_BR_Pos));
+}
+
+static uint64_t Tim2Period(void)
+{
+    return 2ULL * (TIM2->ARR + 1ULL) * (TIM2->PSC + 1ULL);
+}
+
+/**
+ * @brief SPI1 全双工DMA传输完成: 与ADS8688交换字节，置TC标志并请求中断
+ */
+static void DmaComplete(void)
+{
+    DMA_Stream_TypeDef *rx = &DMA2->Stream[0];
+    DMA_Stream_TypeDef *tx = &DMA2->Stream[3];
+    const uint8_t *src = (const uint8_t *)(uintptr_t)tx->M0AR;
+    uint8_t *dst = (uint8_t *)(uintptr_t)rx->M0AR;
+    uint32_t n = (tx->NDTR < rx->NDTR) ? tx->NDTR : rx->NDTR;
+    uint32_t i;
+
+    if (g.spi_fault >= 0)
+    {
+        HostSim_Fault *f = &g_faults[g.spi_fault];
+
+        // 交换 arg 个字节后出错: 没有TC, 由错误中断处理
+        n = (f->arg < n) ? f->arg : n;
+        for (i = 0; i < n; i++)
+        {
+            dst[i] = ads.cs_low ? AdsExchange(src[i]) : 0xFF;
+        }
+        ads.cut = ads.cs_low;
+        g.dma_active = 0;
+        g.spi_fault = -1;
+        g.spi_faults_armed--;
+        g_fault_state[f - g_faults] = 2;
+        f->start = f->end = hostsim_now;
+        g_hostsim_stats.fault_hits[f->type]++;
+        rx->NDTR -= n;
+        tx->NDTR -= n;
+        if (f->type == HOSTSIM_FAULT_SPI_OVR)
+        {
+            SPI1->SR |= SPI_SR_OVR;
+            if (SPI1->CR2 & SPI_CR2_ERRIE)
+            {
+                Pend(SPI1_IRQn);
+            }
+        }
+        else
+        {
+            rx->CR &= ~DMA_SxCR_EN; // 传输错误: 硬件清EN
+            tx->CR &= ~DMA_SxCR_EN;
+            DMA2->LISR |= DMA_LISR_TEIF0;
+            if (rx->CR & DMA_SxCR_TEIE)
+            {
+                Pend(DMA2_Stream0_IRQn);
+            }
+        }
+        return;
+    }
+    for (i = 0; i < n; i++)
+    {
+        dst[i] = ads.cs_low ? AdsExchange(src[i]) : 0xFF;
+    }
+    g.dma_active = 0;
+    g_hostsim_stats.dma_transfers++;
+    rx->NDTR = tx->NDTR = 0;
+    rx->CR &= ~DMA_SxCR_EN; // 普通模式: 传输结束硬件清EN
+    tx->CR &= ~DMA_SxCR_EN;
+    DMA2->LISR |= DMA_LISR_TCIF0 | DMA_LISR_TCIF3;
+    if (rx->CR & DMA_SxCR_TCIE)
+    {
+        Pend(DMA2_Stream0_IRQn);
+    }
+}
+
+/**
+ * @brief 线路开始发送 wire_desc (须归DMA所有)
+ */
+static void WireStart(void)
+{
+    ETH_DMADescTypeDef *desc = g.wire_desc;
+    uint32_t len = desc->ControlBufferSize;
+    uint32_t wire_bytes;
+
+    if ((desc->Status & ETH_DMATXDESC_OWN) == 0)
+    {
+        return;
+    }
+    // 前导码8 + 帧(最短60) + FCS 4 + 帧间隔12, 100Mbit/s下每字节 13.44 个CPU周期
+    wire_bytes = 8U + ((len < 60U) ? 60U : len) + 4U + 12U;
+    g.wire_start = hostsim_now;
+    g.ev[EV_WIRE] = hostsim_now + ((uint64_t)wire_bytes * 1344U + 99U) / 100U;
+    UpdateNextEvent();
+}
+
+/**
+ * @brief 一帧发完: 交给接收端，释放描述符，置发送完成中断，开始下一帧
+ */
+static void WireComplete(void)
+{
+    ETH_DMADescTypeDef *desc = g.wire_desc;
+    const uint8_t *f = (const uint8_t *)(uintptr_t)desc->Buffer1Addr;
+    uint32_t len = desc->ControlBufferSize;
+    uint16_t ethertype = (uint16_t)((f[12] << 8) | f[13]);
+
+    g_hostsim_stats.wire_frames++;
+    g_hostsim_stats.wire_bytes += len;
+    g_hostsim_stats.wire_busy += hostsim_now - g.wire_start;
+
+    if (!netif_is_link_up(&gnetif))
+    {
+        g_hostsim_stats.fault_hits[HOSTSIM_FAULT_LINK_DOWN]++; // MAC照常发送, 对端收不到
+    }
+    else if (g.sink != NULL)
+    {
+        if (ethertype == 0x0800 && len >= 42U && f[23] == IP_PROTO_UDP)
+        {
+            ip4_addr_t dst;
+            uint16_t port = (uint16_t)((f[36] << 8) | f[37]);
+            uint16_t udp_len = (uint16_t)((f[38] << 8) | f[39]);
+
+            memcpy(&dst.addr, &f[30], 4);
+            g.sink(ethertype, &dst, port, f + 42, (uint16_t)(udp_len - 8U));
+        }
+        else if (len >= 14U)
+        {
+            g.sink(ethertype, NULL, 0, f + 14, (uint16_t)(len - 14U));
+        }
+    }
+
+    desc->Status &= ~ETH_DMATXDESC_OWN;
+    if ((desc->Status & ETH_DMATXDESC_IC) && (heth.dma_ie & ETH_DMA_IT_T))
+    {
+        heth.dma_sr |= ETH_DMA_IT_T;
+        Pend(ETH_IRQn);
+    }
+    g.wire_desc = (ETH_DMADescTypeDef *)(uintptr_t)desc->Buffer2NextDescAddr;
+    WireStart();
+}
+
+/* --- LwIP 内存、ARP和接收环 ---------------------------------------------- */
+
+/**
+ * @brief 下一个尚未收进接收环的帧 (控制包、背景帧或有待发包的ARP应答) 的到达时刻
+ */
+static uint64_t RxNextArrival(void)
+{
+    uint64_t next = UINT64_MAX;
+    uint8_t i;
+
+    if (g_inject_count != 0)
+    {
+        next = g_inject[g_inject_head].at;
+    }
+    if (g_bg_next >= 0.0 && (uint64_t)g_bg_next < next)
+    {
+        next = (uint64_t)g_bg_next;
+    }
+    for (i = 0; i < g_arp_count; i++)
+    {
+        if (g_arp[i].q != NULL && g_arp[i].resolved_at < next)
+        {
+            next = g_arp[i].resolved_at;
+        }
+    }
+    return next;
+}
+
+/**
+ * @brief 按到达顺序把已到达的帧放进接收描述符环; 环满时到达的帧丢失
+ * @note  接收环只在 MX_LWIP_Process 中取出, 因此在这里一次补做两次调用之间的到达是精确的
+ */
+static void RxAdmit(void)
+{
+    for (;;)
+    {
+        uint64_t inject_at = (g_inject_count != 0) ? g_inject[g_inject_head].at : UINT64_MAX;
+        uint8_t background = (g_bg_next >= 0.0 && (uint64_t)g_bg_next < inject_at);
+        uint64_t at = background ? (uint64_t)g_bg_next : inject_at;
+
+        if (at > hostsim_now)
+        {
+            break;
+        }
+        if (!netif_is_link_up(&gnetif))
+        {
+            g_hostsim_stats.fault_hits[HOSTSIM_FAULT_LINK_DOWN]++;
+        }
+        else if (g_rx_count >= ETH_RXBUFNB)
+        {
+            g_hostsim_stats.rx_ring_drops++;
+        }
+        else
+        {
+            uint8_t idx = (uint8_t)((g_rx_head + g_rx_count) % ETH_RXBUFNB);
+
+            g_rx[idx].background = background;
+            if (background)
+            {
+                g_rx[idx].len = g_bg_len;
+            }
+            else
+            {
+                g_rx[idx].src = g_inject[g_inject_head].src;
+                g_rx[idx].src_port = g_inject[g_inject_head].src_port;
+                g_rx[idx].dst_port = g_inject[g_inject_head].dst_port;
+                g_rx[idx].len = g_inject[g_inject_head].len;
+                memcpy(g_rx[idx].data, g_inject[g_inject_head].data, g_rx[idx].len);
+            }
+            g_rx_count++;
+        }
+        if (background)
+        {
+            g_bg_next += g_bg_period;
+        }
+        else
+        {
+            g_inject_head = (uint8_t)((g_inject_head + 1U) % INJECT_QUEUE_SIZE);
+            g_inject_count--;
+        }
+    }
+    g.ev[EV_INJECT] = RxNextArrival();
+    UpdateNextEvent();
+}
+
+/**
+ * @brief mem_malloc: 首次适配; 块大小不小于 MIN_SIZE_ALIGNED, 另加 struct mem 块头
+ * @retval 1: 成功, *ofs 为块在堆中的偏移; 0: 没有足够大的连续空间
+ */
+static int HeapAlloc(uint32_t size, uint32_t *ofs)
+{
+    uint32_t hdr = (g_hostsim_lwip.mem_size > 64000U) ? 12U : 8U;  // mem_size_t 为 u32_t / u16_t
+    uint32_t limit = MEM_ALIGN_SIZE(g_hostsim_lwip.mem_size);
+    uint32_t prev_end = 0;
+    uint32_t i;
+
+    size = MEM_ALIGN_SIZE(size);
+    size = ((size < MIN_SIZE_ALIGNED) ? MIN_SIZE_ALIGNED : size) + hdr;
+    if (g_heap.count >= HEAP_MAX_BLOCKS)
+    {
+        return 0;
+    }
+    for (i = 0; i <= g_heap.count; i++)
+    {
+        uint32_t end = (i < g_heap.count) ? g_heap.ofs[i] : limit;
+
+        if (end >= prev_end + size)
+        {
+            memmove(&g_heap.ofs[i + 1], &g_heap.ofs[i], (g_heap.count - i) * sizeof(g_heap.ofs[0]));
+            memmove(&g_heap.size[i + 1], &g_heap.size[i], (g_heap.count - i) * sizeof(g_heap.size[0]));
+            g_heap.ofs[i] = prev_end;
+            g_heap.size[i] = size;
+            g_heap.count++;
+            g_heap.used += size;
+            if (g_heap.used > g_hostsim_stats.heap_peak)
+            {
+                g_hostsim_stats.heap_peak = g_heap.used;
+            }
+            *ofs = prev_end;
+            return 1;
+        }
+        if (i < g_heap.count)
+        {
+            prev_end = g_heap.ofs[i] + g_heap.size[i];
+        }
+    }
+    return 0;
+}
+
+static void HeapFree(uint32_t ofs)
+{
+    uint32_t i;
+
+    for (i = 0; i < g_heap.count; i++)
+    {
+        if (g_heap.ofs[i] == ofs)
+        {
+            g_heap.used -= g_heap.size[i];
+            g_heap.count--;
+            memmove(&g_heap.ofs[i], &g_heap.ofs[i + 1], (g_heap.count - i) * sizeof(g_heap.ofs[0]));
+            memmove(&g_heap.size[i], &g_heap.size[i + 1], (g_heap.count - i) * sizeof(g_heap.size[0]));
+            return;
+        }
+    }
+}
+
+/**
+ * @brief 查找或新建ARP表项: 对端在新建 ARP_DELAY_CYCLES 后应答 (MAC为 02:00:00:00:00:<IP末字节>)
+ * @retval 表项序号; 表满时返回-1
+ */
+static int ArpEntry(const ip4_addr_t *ip)
+{
+    uint8_t i;
+
+    for (i = 0; i < g_arp_count; i++)
+    {
+        if (g_arp[i].ip.addr == ip->addr)
+        {
+            return i;
+        }
+    }
+    if (g_arp_count >= ARP_TABLE_SIZE)
+    {
+        return -1;
+    }
+    memset(&g_arp[i], 0, sizeof(g_arp[0]));
+    g_arp[i].ip = *ip;
+    g_arp[i].resolved_at = hostsim_now + ARP_DELAY_CYCLES;
+    g_arp[i].mac.addr[0] = 0x02;
+    g_arp[i].mac.addr[5] = ip4_addr4(ip);
+    g_arp_count++;
+    return i;
+}
+
+/**
+ * @brief etharp_update_arp_entry: 解析完成的表项发出保留的包 (发送环满时该包丢失, 与lwIP相同)
+ */
+static void ArpFlush(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < g_arp_count; i++)
+    {
+        if (g_arp[i].q != NULL && hostsim_now >= g_arp[i].resolved_at)
+        {
+            struct pbuf *q = g_arp[i].q;
+
+            g_arp[i].q = NULL;
+            LinkOutput(g_arp[i].q_src_port, q, &g_arp[i].q_dst, g_arp[i].q_dst_port, g_arp[i].mac.addr);
+            pbuf_free(q);
+        }
+    }
+}
+
+/**
+ * @brief 组一个完整的以太网/IP/UDP帧放进当前发送描述符 (ethernetif.c 的 low_level_output)
+ * @retval ERR_USE 发送环满
+ */
+static err_t LinkOutput(uint16_t src_port, const struct pbuf *p, const ip4_addr_t *dst_ip, uint16_t dst_port,
+                        const uint8_t *mac)
+{
+    ETH_DMADescTypeDef *desc = heth.TxDesc;
+    uint8_t *f = (uint8_t *)(uintptr_t)desc->Buffer1Addr;
+    uint16_t udp_len = (uint16_t)(8U + p->tot_len);
+    uint16_t ip_len = (uint16_t)(20U + udp_len);
+
+    if ((desc->Status & ETH_DMATXDESC_OWN) != 0)
+    {
+        g_hostsim_stats.eth_ring_full++;
+        return ERR_USE;
+    }
+
+    memset(f, 0, UDP_FRAME_HLEN);
+    memcpy(&f[0], mac, 6);
+    memcpy(&f[6], gnetif.hwaddr, 6);
+    f[12] = 0x08; f[13] = 0x00;
+    f[14] = 0x45;
+    f[16] = (uint8_t)(ip_len >> 8); f[17] = (uint8_t)ip_len;
+    f[22] = 255;
+    f[23] = IP_PROTO_UDP;
+    memcpy(&f[26], &gnetif.ip_addr.addr, 4);
+    memcpy(&f[30], &dst_ip->addr, 4);
+    f[34] = (uint8_t)(src_port >> 8); f[35] = (uint8_t)src_port;
+    f[36] = (uint8_t)(dst_port >> 8); f[37] = (uint8_t)dst_port;
+    f[38] = (uint8_t)(udp_len >> 8); f[39] = (uint8_t)udp_len;
+    memcpy(&f[UDP_FRAME_HLEN], p->payload, p->tot_len);
+
+    return (HAL_ETH_TransmitFrame(&heth, 14U + ip_len) == HAL_OK) ? ERR_OK : ERR_USE;
+}
+
+/* --- 故障注入 ------------------------------------------------------------ */
+
+static uint8_t FaultIsSpi(HostSim_FaultType type)
+{
+    return type == HOSTSIM_FAULT_SPI_OVR || type == HOSTSIM_FAULT_DMA_TE;
+}
+
+/**
+ * @brief 下一个故障开始或结束的时刻
+ */
+static uint64_t FaultNext(void)
+{
+    uint64_t next = UINT64_MAX;
+    int i;
+
+    for (i = 0; i < g_fault_count; i++)
+    {
+        if (g_fault_state[i] == 0 && g_faults[i].at < next)
+        {
+            next = g_faults[i].at;
+        }
+        else if (g_fault_state[i] == 1 && !FaultIsSpi(g_faults[i].type) && g_faults[i].end < next)
+        {
+            next = g_faults[i].end;
+        }
+    }
+    return next;
+}
+
+/**
+ * @brief 最早到时刻、尚未打断传输的SPI类故障
+ */
+static int SpiFaultArmed(void)
+{
+    int best = -1;
+    int i;
+
+    for (i = 0; i < g_fault_count; i++)
+    {
+        if (g_fault_state[i] == 1 && FaultIsSpi(g_faults[i].type) &&
+            (best < 0 || g_faults[i].at < g_faults[best].at))
+        {
+            best = i;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief 开始或结束到时刻的故障; SPI类等到下一次DMA传输开始 (见 HostSim_DmaStreamEnable)
+ */
+static void FaultEvents(void)
+{
+    uint64_t now = hostsim_now;
+    int i;
+
+    for (i = 0; i < g_fault_count; i++)
+    {
+        HostSim_Fault *f = &g_faults[i];
+
+        if (g_fault_state[i] == 0 && f->at <= now)
+        {
+            g_fault_state[i] = 1;
+            if (FaultIsSpi(f->type))
+            {
+                g.spi_faults_armed++;
+                continue;
+            }
+            f->start = now;
+            f->end = now + f->arg;
+            g.fault_active[f->type]++;
+            if (f->type == HOSTSIM_FAULT_LINK_DOWN)
+            {
+                uint8_t j;
+
+                // netif_set_link_down -> etharp_cleanup_netif: 丢弃ARP表和其中保留的包
+                gnetif.flags &= ~NETIF_FLAG_LINK_UP;
+                for (j = 0; j < g_arp_count; j++)
+                {
+                    pbuf_free(g_arp[j].q);
+                }
+                g_arp_count = 0;
+            }
+        }
+        if (g_fault_state[i] == 1 && !FaultIsSpi(f->type) && f->end <= now)
+        {
+            g_fault_state[i] = 2;
+            if (--g.fault_active[f->type] == 0 && f->type == HOSTSIM_FAULT_LINK_DOWN)
+            {
+                gnetif.flags |= NETIF_FLAG_LINK_UP;
+            }
+        }
+    }
+    g.ev[EV_FAULT] = FaultNext();
+}
+
+/* --- ADS8688 ------------------------------------------------------------- */
+
+/**
+ * @brief 片选下降沿: 采样上一帧命令选定的通道
+ */
+static void AdsCsFall(void)
+{
+    uint8_t ch = ads.next_ch;
+
+    ads.cs_low = 1;
+    ads.nbytes = 0;
+    ads.cmd = 0;
+    ads.reg_frame = 0;
+    ads.cut = 0;
+    g_hostsim_stats.ads_frames++;
+    if (ads.standby)
+    {
+        ads.conv = 0;
+        return;
+    }
+    if (ads.last_conv != UINT64_MAX)
+    {
+        uint64_t dt = hostsim_now - ads.last_conv;
+
+        if (dt < g_hostsim_stats.ads_min_cycle)
+        {
+            g_hostsim_stats.ads_min_cycle = dt;
+        }
+        if (dt * 1000000000ULL < (uint64_t)HOSTSIM_ADS_MIN_CYCLE_NS * HOSTSIM_CPU_HZ)
+        {
+            g_hostsim_stats.ads_cycle_violations++;
+        }
+    }
+    ads.last_conv = hostsim_now;
+    g_conv_at[ch][ads.conv_count[ch] & (HOSTSIM_TAG_MOD - 1U)] = hostsim_now;
+    ads.conv = AdsSample(ch);
+    ads.conv_count[ch]++;
+    g_hostsim_stats.ads_conversions++;
+}
+
+static void AdsCsRise(void)
+{
+    ads.cs_low = 0;
+    if (ads.nbytes < 2 && !ads.cut)     // 注入的故障截断的帧不算固件的命令错误
+    {
+        g_hostsim_stats.ads_cmd_errors++; // 不足16个时钟, 命令无效; 通道选择不变
+    }
+}
+
+/**
+ * @brief 下一个已使能的自动扫描通道
+ */
+static uint8_t AdsNextAuto(uint8_t from, uint8_t include_from)
+{
+    uint8_t mask = ads.regs[ADS_REG_AUTO_SEQ_EN];
+    uint8_t i;
+
+    if (mask == 0)
+    {
+        return 0;
+    }
+    for (i = include_from ? 0 : 1; i <= HOSTSIM_ADS_CHANNELS; i++)
+    {
+        uint8_t ch = (uint8_t)((from + i) % HOSTSIM_ADS_CHANNELS);
+
+        if (mask & (1U << ch))
+        {
+            return ch;
+        }
+    }
+    return from;
+}
+
+/**
+ * @brief 第16个时钟: 译码本帧命令，决定下一帧采样的通道
+ */
+static void AdsDecode(void)
+{
+    uint16_t cmd = ads.cmd;
+    uint8_t cur = ads.next_ch;
+
+    if (cmd == ADS_CMD_NO_OP)
+    {
+        if (ads.auto_mode)
+        {
+            ads.next_ch = AdsNextAuto(cur, 0);
+        }
+    }
+    else if (cmd < 0x8000U)
+    {
+        // 程序寄存器: [15:9] 地址, [8] 写, [7:0] 数据; 不改变工作模式
+        uint8_t addr = (uint8_t)(cmd >> 9);
+
+        ads.reg_frame = 1;
+        if (addr < ADS_REG_COUNT)
+        {
+            if (cmd & 0x0100U)
+            {
+                ads.regs[addr] = (uint8_t)cmd;
+            }
+            ads.reg_out = ads.regs[addr];
+        }
+        if (ads.auto_mode)
+        {
+            ads.next_ch = AdsNextAuto(cur, 0);
+        }
+    }
+    else if (cmd == ADS_CMD_AUTO_RST)
+    {
+        ads.auto_mode = 1;
+        ads.standby = 0;
+        ads.next_ch = AdsNextAuto(0, 1);
+    }
+    else if ((cmd & 0xE3FFU) == ADS_CMD_MAN_CH0 && ((cmd >> 10) & 0x7U) < HOSTSIM_ADS_CHANNELS)
+    {
+        ads.auto_mode = 0;
+        ads.standby = 0;
+        ads.next_ch = (uint8_t)((cmd >> 10) & 0x7U);
+    }
+    else if (cmd == ADS_CMD_RST)
+    {
+        memset(ads.regs, 0, sizeof(ads.regs));
+        ads.regs[ADS_REG_AUTO_SEQ_EN] = 0xFF;
+        ads.auto_mode = 0;
+        ads.standby = 0;
+        ads.next_ch = 0;
+    }
+    else if (cmd == ADS_CMD_STDBY || cmd == ADS_CMD_PWR_DN)
+    {
+        ads.standby = 1;
+    }
+    else
+    {
+        g_hostsim_stats.ads_cmd_errors++;
+    }
+}
+
+/**
+ * @brief 片选有效时交换一个字节 (MSB先)
+ */
+static uint8_t AdsExchange(uint8_t mosi)
+{
+    uint8_t idx = ads.nbytes;
+    uint8_t miso = 0;
+
+    if (idx < 2)
+    {
+        ads.cmd = (uint16_t)((ads.cmd << 8) | mosi);
+        if (idx == 1)
+        {
+            AdsDecode();
+        }
+    }
+    else if (idx == 2)
+    {
+        miso = ads.reg_frame ? ads.reg_out : (uint8_t)(ads.conv >> 8);
+    }
+    else if (idx == 3)
+    {
+        miso = ads.reg_frame ? 0 : (uint8_t)ads.conv;
+    }
+    if (ads.nbytes < 0xFF)
+    {
+        ads.nbytes++;
+    }
+    return miso;
+}
+
+static uint32_t Rand(void)
+{
+    g.rng ^= g.rng << 13;
+    g.rng ^= g.rng >> 17;
+    g.rng ^= g.rng << 5;
+    return g.rng;
+}
+
+/**
+ * @brief 通道 ch 在当前时刻的转换结果 (直码, 0x8000 为零点)
+ */
+static uint16_t AdsSample(uint8_t ch)
+{
+    const HostSim_Wave *w = &ads.wave[ch];
+    double t = (double)hostsim_now / HOSTSIM_CPU_HZ;
+    double ph = w->freq_hz * t;
+    double v;
+
+    switch (w->type)
+    {
+    case HOSTSIM_WAVE_TAGGED:
+        return (uint16_t)((ch << 13) | (ads.conv_count[ch] & (HOSTSIM_TAG_MOD - 1U)));
+    case HOSTSIM_WAVE_SINE:
+        v = sin(2.0 * M_PI * ph);
+        break;
+    case HOSTSIM_WAVE_SQUARE:
+        v = (ph - floor(ph) < 0.5) ? 1.0 : -1.0;
+        break;
+    case HOSTSIM_WAVE_RAMP:
+        v = 2.0 * (ph - floor(ph)) - 1.0;
+        break;
+    case HOSTSIM_WAVE_NOISE:
+        v = (double)Rand() / 2147483648.0 - 1.0;
+        break;
+    default:
+        v = 0.0;
+        break;
+    }
+    v = 32768.0 + w->offset + w->amplitude * v;
+    if (v < 0.0)
+    {
+        v = 0.0;
+    }
+    if (v > 65535.0)
+    {
+        v = 65535.0;
+    }
+    return (uint16_t)lrint(v);
+}
+
+/**
+ * @brief 按波特率从DMA环形缓冲区中移走自上次以来已发出的字节
+ */
+static void ConsoleDrain(void)
+{
+    uint64_t sent = (hostsim_now - g_console.drained_at) / CONSOLE_BYTE_CYCLES;
+
+    if (sent >= g_console.used)
+    {
+        g_console.used = 0;
+        g_console.drained_at = hostsim_now;
+    }
+    else
+    {
+        g_console.used -= (uint32_t)sent;
+        g_console.drained_at += sent * CONSOLE_BYTE_CYCLES;
+    }
+}
+
+/**
+ * @brief 一条日志记录入队 (固件日志环按字计容量，每条 3 + nargs 个字); 队列满则丢弃
+ */
+static void LogEnqueue(uint32_t text_len, uint32_t nargs)
+{
+    uint32_t words = 3U + nargs;
+    uint32_t i;
+
+    if (g_console.count == LOG_QUEUE_MAX || g_console.words_used + words > LOG_RING_WORDS)
+    {
+        g_hostsim_stats.log_dropped++;
+        return;
+    }
+    i = (g_console.head + g_console.count) % LOG_QUEUE_MAX;
+    g_console.len[i] = (uint16_t)(text_len + LOG_TEXT_EXTRA);
+    g_console.words[i] = (uint8_t)words;
+    g_console.count++;
+    g_console.words_used += words;
+}
@@ -0,0 +1,174 @@
+// Tools/hostsim/hostsim.h
+//
+// 采集链路的主机仿真内核: 虚拟时间事件调度 (TIM2更新、DMA2 stream0/3 完成、SysTick、
+// 以太网发送完成)、按优先级抢占的中断分发、ADS8688行为模型和100Mbit/s发送线路。
+// 固件源码 (adc_processing.c、ads8688.c、stm32f4xx_it.c 等) 原样编译，经本目录的
+// HAL/LL/LwIP 替身访问这些模型。时间单位为CPU周期 (168MHz)。
+// 可在指定时刻注入故障 (SPI过载、DMA传输错误、pbuf耗尽、udp_sendto ERR_MEM、链路断开)。
+#ifndef HOSTSIM_H_
+#define HOSTSIM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "stm32f4xx_hal.h"
+#include "hostsim_lwip.h"
+
+#define HOSTSIM_CPU_HZ          168000000U
+#define HOSTSIM_ADS_CHANNELS    8
+#define HOSTSIM_ADS_MIN_CYCLE_NS 2000   // ADS8688 最短转换周期 (500kSPS)
+
+// --- 代码段开销 (周期数, 可按 USE_PROFILING 的报告校准) ---
+// 固件自身的计算 (组装、调速、缺口表) 不计时间，只有经过替身的访问和下列固定开销计时
+typedef struct {
+    uint32_t ll_access;         // 每次有副作用的LL寄存器访问
+    uint32_t isr_entry;         // 中断入口 (压栈、取向量)
+    uint32_t isr_exit;          // 中断出口
+    uint32_t tim2_isr;          // TIM2_IRQHandler 除LL访问外的开销
+    uint32_t dma_isr;           // DMA2_Stream0_IRQHandler + SPI1_DMA_RX_Callback
+    uint32_t eth_isr;           // ETH_IRQHandler (不含其中的续发)
+    uint32_t systick_isr;
+    uint32_t dma_start;         // DMA流使能到SPI第一个时钟
+    uint32_t fast_send;         // HAL_ETH_TransmitFrame (描述符交给DMA)
+    uint32_t lwip_send;         // pbuf_alloc + 中转拷贝 + pbuf_take + udp_sendto 协议栈开销
+    uint32_t lwip_input;        // 收到一个控制包 (ethernetif_input -> udp_input)
+    uint32_t copy_per_kb;       // 拷进以太网DMA缓冲区, 每KB
+    uint32_t log_call;          // Log_Write / Log_Debug
+    uint32_t log_format;        // Log_Process 取出并用 printf 格式化一条记录 (不含逐字符输出)
+    uint32_t console_putc;      // fputc -> UartConsole_Putc 放入一个字符 (USE_UART_DMA_CONSOLE 1)
+} HostSim_Costs;
+
+extern HostSim_Costs g_hostsim_costs;
+
+// --- LwIP 内存配置 (对应 lwipopts.h, 在 HostSim_Init 之前设置) ---
+// 接收描述符数取 ETH_RXBUFNB, 发送描述符数取 ETH_TXBUFNB (编译时 -D 覆盖)
+typedef struct {
+    uint32_t mem_size;          // MEM_SIZE: PBUF_RAM 的堆
+    uint16_t pbuf_pool_size;    // PBUF_POOL_SIZE: 接收帧 (ethernetif.c 的 low_level_input)
+    uint16_t pbuf_pool_bufsize; // PBUF_POOL_BUFSIZE
+} HostSim_LwipOpts;
+
+extern HostSim_LwipOpts g_hostsim_lwip;
+
+// --- ADS8688 波形 ---
+typedef enum {
+    HOSTSIM_WAVE_TAGGED = 0,    // 高3位为通道号, 低13位为该通道的转换序号 (用于校验数据链路)
+    HOSTSIM_WAVE_SINE,
+    HOSTSIM_WAVE_SQUARE,
+    HOSTSIM_WAVE_RAMP,
+    HOSTSIM_WAVE_NOISE,         // 均匀分布
+    HOSTSIM_WAVE_DC,
+} HostSim_WaveType;
+
+typedef struct {
+    HostSim_WaveType type;
+    double freq_hz;
+    double amplitude;           // LSB
+    double offset;              // LSB, 相对中间码 0x8000
+} HostSim_Wave;
+
+#define HOSTSIM_TAG_CHANNEL(code)   ((uint16_t)(code) >> 13)
+#define HOSTSIM_TAG_COUNT(code)     ((uint16_t)(code) & 0x1FFFU)
+#define HOSTSIM_TAG_MOD             0x2000U
+
+// --- 串口控制台 (USART1, 115200 8N1) ---
+// 开启后 Log_Write/Log_Debug 的记录进入与固件 LOG_RING_WORDS 同容量的队列，HostSim_LogProcess
+// 像 Log_Process (LOG_OUTPUT_BINARY 0) 一样每次取出一条，按 "[时间戳] 文本\r\n" 的长度输出
+typedef enum {
+    HOSTSIM_CONSOLE_OFF = 0,    // 日志和输出只计数, 不耗时 (默认)
+    HOSTSIM_CONSOLE_BLOCKING,   // USE_UART_DMA_CONSOLE 0: fputc 逐字节等待发送完成 (期间中断照常)
+    HOSTSIM_CONSOLE_DMA,        // USE_UART_DMA_CONSOLE 1: 放入 UART_CONSOLE_BUF_SIZE 的环形缓冲区,
+                                // 按波特率在后台排空, 满则丢弃 (不计DMA传输完成中断的开销)
+} HostSim_ConsoleMode;
+
+// --- 故障注入 ---
+typedef enum {
+    HOSTSIM_FAULT_SPI_OVR = 0,  // SPI1过载: 下一次DMA传输交换 arg 个字节后停止, 置OVR并请求SPI1中断
+    HOSTSIM_FAULT_DMA_TE,       // DMA传输错误: 同上, 置TEIF0、清两个流的EN并请求DMA2_Stream0中断
+    HOSTSIM_FAULT_PBUF,         // arg 个周期内 pbuf_alloc 失败 (PBUF_RAM 和 PBUF_POOL)
+    HOSTSIM_FAULT_UDP_ERR_MEM,  // arg 个周期内 udp_sendto 返回 ERR_MEM
+    HOSTSIM_FAULT_LINK_DOWN,    // arg 个周期内链路断开: 清 NETIF_FLAG_LINK_UP 并清空ARP表, 线路上的帧丢失
+    HOSTSIM_FAULT_COUNT
+} HostSim_FaultType;
+
+#define HOSTSIM_FAULT_MAX   256
+
+typedef struct {
+    HostSim_FaultType type;
+    uint64_t at;                // 计划注入的时刻
+    uint32_t arg;
+    uint64_t start;             // 实际生效的时刻 (SPI类为传输被打断的时刻), 0: 尚未生效
+    uint64_t end;               // 持续类的结束时刻 (SPI类与 start 相同)
+} HostSim_Fault;
+
+// --- 统计 ---
+typedef struct {
+    uint64_t tim2_updates;
+    uint64_t irq_count[HOSTSIM_IRQ_COUNT];
+    uint64_t preemptions;       // 中断打断了另一个中断
+    uint64_t dma_transfers;
+    uint64_t ads_frames;        // 片选帧数
+    uint64_t ads_conversions;
+    uint64_t ads_cmd_errors;    // 不认识的命令或不足16个时钟的帧
+    uint64_t ads_cycle_violations;  // 两次转换间隔小于 HOSTSIM_ADS_MIN_CYCLE_NS
+    uint64_t ads_min_cycle;     // 最短转换间隔 (周期)
+    uint64_t wire_frames;
+    uint64_t wire_bytes;        // 以太网帧字节数 (不含前导码和帧间隔)
+    uint64_t wire_busy;         // 线路忙的周期数
+    uint64_t eth_ring_full;     // HAL_ETH_TransmitFrame / udp_sendto 遇到发送环满
+    uint64_t idle_skipped;      // HostSim_Idle 跳过的周期数
+    // LwIP 内存与接收
+    uint32_t heap_peak;         // 堆的最大占用 (字节, 含 mem.c 的块头)
+    uint64_t heap_errors;       // PBUF_RAM 分配失败 (堆满或碎片)
+    uint16_t pool_min_free;     // PBUF_POOL 的最少剩余
+    uint64_t pool_errors;       // PBUF_POOL 分配失败 (该接收帧被丢弃)
+    uint64_t rx_frames;         // MX_LWIP_Process 交给协议栈的接收帧
+    uint64_t rx_ring_drops;     // 接收描述符全被占用时到达的帧
+    uint64_t arp_queued;        // 目的MAC未解析时 etharp 代为保留的包
+    uint64_t arp_queue_drops;   // 其中被同一表项的下一个包替换而丢弃的 (ARP_QUEUEING 0)
+    // 串口控制台 (HostSim_SetConsole 开启时)
+    uint64_t console_bytes;     // 经 fputc 输出的字节数
+    uint64_t console_dropped;   // DMA环形缓冲区满时丢弃的字节数
+    uint32_t console_max_used;  // DMA环形缓冲区的最大占用
+    uint64_t log_records;       // HostSim_LogProcess 输出的记录数
+    uint64_t log_dropped;       // 日志队列满时丢弃的记录数
+    // 故障注入
+    uint64_t fault_hits[HOSTSIM_FAULT_COUNT];   // 被打断的传输、被拒绝的分配/发送、链路断开时丢失的帧
+} HostSim_Stats;
+
+extern HostSim_Stats g_hostsim_stats;
+
+// 收到一个以太网帧 (帧在线路上发完的时刻调用); UDP帧给出目的地址和UDP负载，其余帧给出以太网负载
+typedef void (*HostSim_SinkFn)(uint16_t ethertype, const ip4_addr_t *dst, uint16_t dst_port,
+                               const uint8_t *payload, uint16_t len);
+
+// --- 对外暴露的函数 ---
+void     HostSim_Init(void);                // 复位所有模型; 须在固件初始化之前调用
+void     HostSim_ResetStats(void);
+void     HostSim_SetWave(uint8_t ch, const HostSim_Wave *wave);
+void     HostSim_SetSink(HostSim_SinkFn sink);
+void     HostSim_SetLogLevel(int level);    // 打印不高于该级别的固件日志, -1 不打印 (默认)
+void     HostSim_Inject(const ip4_addr_t *src, uint16_t src_port, uint16_t dst_port,
+                        const void *data, uint16_t len);    // 发往固件的UDP包, 由 MX_LWIP_Process 交付
+void     HostSim_SetRxLoad(double frames_per_s, uint16_t len);  // 与固件无关的广播帧 (占用接收描述符和PBUF_POOL)
+uint32_t HostSim_HeapUsed(void);
+uint16_t HostSim_PoolUsed(void);
+int      HostSim_ScheduleFault(HostSim_FaultType type, uint64_t at, uint32_t arg);  // 返回故障序号, 表满返回-1
+int      HostSim_FaultCount(void);
+const HostSim_Fault *HostSim_GetFault(int idx);
+uint64_t HostSim_ConversionTime(uint16_t code);     // tagged 波形的一个转换结果的采样时刻 (最近 HOSTSIM_TAG_MOD 次之内)
+void     HostSim_Idle(uint32_t pass_cycles);    // 主循环空转: 按整轮跳到下一个事件之前
+uint64_t HostSim_Now(void);
+uint64_t HostSim_LogCount(uint32_t level);
+void     HostSim_SetConsole(HostSim_ConsoleMode mode);
+void     HostSim_ConsoleWrite(uint32_t len);    // printf 经 fputc 输出 len 个字节
+void     HostSim_LogProcess(void);              // Log_Process: 取出一条记录并输出
+int      HostSim_LogPending(void);              // Log_Pending
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOSTSIM_H_ */
@@ -0,0 +1,149 @@
+// Tools/hostsim/hostsim_lwip.h
+//
+// 主机仿真用的 LwIP 替身: 只有固件数据面和控制端口用到的 udp/pbuf/netif/etharp 接口。
+// udp_sendto 像 ethernetif.c 的 low_level_output 一样把整帧拷进以太网发送描述符的缓冲区，
+// 由 hostsim.c 的线路模型发出; 收到的控制包由 MX_LWIP_Process 交给 udp_recv 注册的回调。
+// PBUF_RAM 按 mem.c 的首次适配从 MEM_SIZE 大小的堆分配, PBUF_POOL 从 PBUF_POOL_SIZE 个
+// 缓冲区分配 (见 HostSim_LwipOpts)，分配失败与真实协议栈一样返回NULL。
+#ifndef HOSTSIM_LWIP_H_
+#define HOSTSIM_LWIP_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+typedef uint8_t  u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+typedef int8_t   s8_t;
+typedef s8_t     err_t;
+
+// --- lwip/err.h ---
+#define ERR_OK          0
+#define ERR_MEM         -1
+#define ERR_BUF         -2
+#define ERR_TIMEOUT     -3
+#define ERR_RTE         -4
+#define ERR_INPROGRESS  -5
+#define ERR_VAL         -6
+#define ERR_WOULDBLOCK  -7
+#define ERR_USE         -8
+#define ERR_ALREADY     -9
+#define ERR_ISCONN      -10
+#define ERR_CONN        -11
+#define ERR_IF          -12
+#define ERR_ARG         -16
+
+// --- 地址 (只有IPv4, addr 为网络字节序) ---
+typedef struct ip4_addr {
+    u32_t addr;
+} ip4_addr_t;
+typedef ip4_addr_t ip_addr_t;
+
+#define PP_HTONL(x)     __builtin_bswap32((u32_t)(x))
+#define LWIP_MAKEU32(a, b, c, d) (((u32_t)((a) & 0xff) << 24) | ((u32_t)((b) & 0xff) << 16) | \
+                                  ((u32_t)((c) & 0xff) << 8)  |  (u32_t)((d) & 0xff))
+#define IP4_ADDR(ipaddr, a, b, c, d)    ((ipaddr)->addr = PP_HTONL(LWIP_MAKEU32(a, b, c, d)))
+#define ip_2_ip4(ipaddr)                (ipaddr)
+#define ip_addr_copy(dest, src)         ((dest).addr = (src).addr)
+#define ip_addr_cmp(a, b)               ((a)->addr == (b)->addr)
+#define ip4_addr_isany_val(a)           ((a).addr == 0)
+#define ip4_addr_ismulticast(a)         (((a)->addr & PP_HTONL(0xF0000000UL)) == PP_HTONL(0xE0000000UL))
+#define ip4_addr_netcmp(a, b, mask)     ((((a)->addr ^ (b)->addr) & (mask)->addr) == 0)
+#define ip4_addr1(a)                    (((const u8_t *)(&(a)->addr))[0])
+#define ip4_addr2(a)                    (((const u8_t *)(&(a)->addr))[1])
+#define ip4_addr3(a)                    (((const u8_t *)(&(a)->addr))[2])
+#define ip4_addr4(a)                    (((const u8_t *)(&(a)->addr))[3])
+#define ip4_addr1_16(a)                 ((u16_t)ip4_addr1(a))
+#define ip4_addr2_16(a)                 ((u16_t)ip4_addr2(a))
+#define ip4_addr3_16(a)                 ((u16_t)ip4_addr3(a))
+#define ip4_addr4_16(a)                 ((u16_t)ip4_addr4(a))
+
+extern const ip_addr_t ip_addr_any;
+#define IP_ADDR_ANY     (&ip_addr_any)
+
+#define IP_PROTO_UDP    17
+
+// --- pbuf (主机上总是单段; PBUF_POOL 按占用的池缓冲区个数计数) ---
+typedef enum { PBUF_TRANSPORT, PBUF_IP, PBUF_LINK, PBUF_RAW } pbuf_layer;
+typedef enum { PBUF_RAM, PBUF_ROM, PBUF_REF, PBUF_POOL } pbuf_type;
+
+struct pbuf {
+    struct pbuf *next;
+    void  *payload;
+    u16_t  tot_len;
+    u16_t  len;
+    u8_t   type;
+    u8_t   ref;
+    u16_t  hostsim_units;       // PBUF_RAM: 堆块字节数; PBUF_POOL: 池缓冲区个数
+    u32_t  hostsim_offset;      // PBUF_RAM: 堆块在 MEM_SIZE 堆中的偏移
+};
+
+struct pbuf *pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type);
+u8_t         pbuf_free(struct pbuf *p);
+void         pbuf_ref(struct pbuf *p);
+err_t        pbuf_take(struct pbuf *p, const void *data, u16_t len);
+u8_t         pbuf_get_at(const struct pbuf *p, u16_t offset);
+u16_t        pbuf_copy_partial(const struct pbuf *p, void *dst, u16_t len, u16_t offset);
+
+// --- udp ---
+struct udp_pcb;
+typedef void (*udp_recv_fn)(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port);
+
+struct udp_pcb {
+    ip_addr_t   remote_ip;
+    u16_t       local_port;
+    u16_t       remote_port;
+    u8_t        tos;
+    u8_t        ttl;
+    udp_recv_fn recv;
+    void       *recv_arg;
+};
+
+struct udp_pcb *udp_new(void);
+err_t udp_bind(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port);
+err_t udp_connect(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port);
+void  udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *recv_arg);
+err_t udp_sendto(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *dst_ip, u16_t dst_port);
+err_t udp_send(struct udp_pcb *pcb, struct pbuf *p);
+
+// --- netif / etharp ---
+#define NETIF_FLAG_UP       0x01U
+#define NETIF_FLAG_LINK_UP  0x04U
+
+struct netif {
+    ip4_addr_t ip_addr;
+    ip4_addr_t netmask;
+    ip4_addr_t gw;
+    u8_t       hwaddr[6];
+    u8_t       flags;
+};
+
+struct eth_addr {
+    u8_t addr[6];
+};
+
+extern struct netif gnetif;
+
+#define netif_is_up(n)          (((n)->flags & NETIF_FLAG_UP) != 0)
+#define netif_is_link_up(n)     (((n)->flags & NETIF_FLAG_LINK_UP) != 0)
+#define netif_ip4_addr(n)       ((const ip4_addr_t *)&(n)->ip_addr)
+#define netif_ip4_netmask(n)    ((const ip4_addr_t *)&(n)->netmask)
+#define netif_ip4_gw(n)         ((const ip4_addr_t *)&(n)->gw)
+
+u8_t  ip4_addr_isbroadcast(const ip4_addr_t *addr, const struct netif *nif);
+int   etharp_find_addr(struct netif *nif, const ip4_addr_t *ipaddr,
+                       struct eth_addr **eth_ret, const ip4_addr_t **ip_ret);
+err_t etharp_query(struct netif *nif, const ip4_addr_t *ipaddr, struct pbuf *q);
+
+// --- lwip.h ---
+void MX_LWIP_Init(void);
+void MX_LWIP_Process(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOSTSIM_LWIP_H_ */
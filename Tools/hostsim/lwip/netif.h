@@ -0,0 +1,3 @@
+// Tools/hostsim/lwip/netif.h
+// 主机仿真: 所有LwIP替身都在 hostsim_lwip.h 中
+#include "hostsim_lwip.h"
@@ -0,0 +1,539 @@
+// Tools/hostsim/stm32f4xx_hal.h
+//
+// 主机仿真用的 HAL/LL/CMSIS 替身: 固件源码原样编译，外设寄存器是普通内存中的结构体，
+// 有副作用的访问 (使能DMA流、片选翻转、SPI收发、读定时器计数) 转入 hostsim.c 的虚拟时间仿真。
+// 只实现 adc_processing.c / ads8688.c / stm32f4xx_it.c / stream_ctrl.c / eth_*.c /
+// spi.c / tim.c / dma.c / profile.c 用到的部分; 每次LL访问计 HostSim_Costs.ll_access 个周期。
+// 各 stm32f4xx_ll_*.h 替身都只包含本文件。
+#ifndef HOSTSIM_STM32F4XX_HAL_H_
+#define HOSTSIM_STM32F4XX_HAL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+// --- 与 Inc/stm32f4xx_hal_conf.h 一致的以太网配置 (原文件包含全部HAL模块头，不能直接使用) ---
+#define ETH_MAX_PACKET_SIZE     1524U
+#define ETH_RX_BUF_SIZE         ETH_MAX_PACKET_SIZE
+#define ETH_TX_BUF_SIZE         ETH_MAX_PACKET_SIZE
+#ifndef ETH_RXBUFNB
+#define ETH_RXBUFNB             4U
+#endif
+#ifndef ETH_TXBUFNB
+#define ETH_TXBUFNB             8U
+#endif
+#ifndef ETH_DMA_BUF_BUDGET
+#define ETH_DMA_BUF_BUDGET      (20U * 1024U)
+#endif
+
+// ============================================================================
+// CMSIS
+// ============================================================================
+typedef enum {
+    NonMaskableInt_IRQn     = -14,
+    MemoryManagement_IRQn   = -12,
+    BusFault_IRQn           = -11,
+    UsageFault_IRQn         = -10,
+    SVCall_IRQn             = -5,
+    DebugMonitor_IRQn       = -4,
+    PendSV_IRQn             = -2,
+    SysTick_IRQn            = -1,
+    DMA1_Stream0_IRQn       = 11,
+    DMA1_Stream3_IRQn       = 14,
+    TIM2_IRQn               = 28,
+    SPI1_IRQn               = 35,
+    USART1_IRQn             = 37,
+    DMA2_Stream0_IRQn       = 56,
+    DMA2_Stream3_IRQn       = 59,
+    ETH_IRQn                = 61,
+    DMA2_Stream7_IRQn       = 70,
+} IRQn_Type;
+
+#define HOSTSIM_IRQ_COUNT       (16 + 82)   // 系统异常 + 外设中断, 下标为 IRQn + 16
+
+typedef struct {
+    volatile uint32_t CTRL;
+    volatile uint32_t LOAD;
+    volatile uint32_t VAL;
+    volatile uint32_t CALIB;
+} SysTick_Type;
+
+typedef struct {
+    volatile uint32_t CPUID;
+    volatile uint32_t ICSR;
+} SCB_Type;
+
+typedef struct {
+    volatile uint32_t CTRL;
+    volatile uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk      (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk  (1UL << 24)
+
+#define SCB_ICSR_PENDSTSET_Pos  26U
+#define SCB_ICSR_PENDSTSET_Msk  (1UL << SCB_ICSR_PENDSTSET_Pos)
+
+// 读取时按当前虚拟时间刷新 VAL / CYCCNT / PENDSTSET
+SysTick_Type *HostSim_SysTick(void);
+SCB_Type     *HostSim_Scb(void);
+DWT_Type     *HostSim_Dwt(void);
+#define SysTick                 (HostSim_SysTick())
+#define SCB                     (HostSim_Scb())
+#define DWT                     (HostSim_Dwt())
+#define CoreDebug               (&hostsim_coredebug)
+
+extern CoreDebug_Type hostsim_coredebug;
+
+extern uint32_t SystemCoreClock;
+
+void     NVIC_SetPriority(IRQn_Type irq, uint32_t priority);
+void     NVIC_EnableIRQ(IRQn_Type irq);
+void     NVIC_DisableIRQ(IRQn_Type irq);
+uint32_t NVIC_GetPriorityGrouping(void);
+uint32_t NVIC_EncodePriority(uint32_t group, uint32_t preempt, uint32_t sub);
+
+static inline uint32_t __CLZ(uint32_t x)
+{
+    return (x == 0U) ? 32U : (uint32_t)__builtin_clz(x);
+}
+
+// ============================================================================
+// 外设寄存器块 (只含用到的寄存器)
+// ============================================================================
+typedef struct {
+    volatile uint32_t CR1;
+    volatile uint32_t CR2;
+    volatile uint32_t SR;
+    volatile uint32_t DR;
+} SPI_TypeDef;
+
+typedef struct {
+    volatile uint32_t CR;
+    volatile uint32_t NDTR;
+    volatile uint32_t PAR;
+    volatile uint32_t M0AR;
+} DMA_Stream_TypeDef;
+
+typedef struct {
+    volatile uint32_t LISR;
+    volatile uint32_t HISR;
+    DMA_Stream_TypeDef Stream[8];
+} DMA_TypeDef;
+
+typedef struct {
+    volatile uint32_t CR1;
+    volatile uint32_t DIER;
+    volatile uint32_t SR;
+    volatile uint32_t PSC;
+    volatile uint32_t ARR;
+} TIM_TypeDef;
+
+typedef struct {
+    volatile uint32_t ODR;
+} GPIO_TypeDef;
+
+extern SPI_TypeDef  hostsim_spi1, hostsim_spi2, hostsim_spi3;
+extern DMA_TypeDef  hostsim_dma1, hostsim_dma2;
+extern TIM_TypeDef  hostsim_tim2;
+extern GPIO_TypeDef hostsim_gpioa, hostsim_gpiob, hostsim_gpioc, hostsim_gpiof;
+
+#define SPI1                    (&hostsim_spi1)
+#define SPI2                    (&hostsim_spi2)
+#define SPI3                    (&hostsim_spi3)
+#define DMA1                    (&hostsim_dma1)
+#define DMA2                    (&hostsim_dma2)
+#define TIM2                    (&hostsim_tim2)
+#define GPIOA                   (&hostsim_gpioa)
+#define GPIOB                   (&hostsim_gpiob)
+#define GPIOC                   (&hostsim_gpioc)
+#define GPIOF                   (&hostsim_gpiof)
+
+// 寄存器位 (与参考手册相同)
+#define SPI_CR1_BR_Pos          3U
+#define SPI_CR1_BR_Msk          (7UL << SPI_CR1_BR_Pos)
+#define SPI_CR1_SPE             (1UL << 6)
+#define SPI_CR2_RXDMAEN         (1UL << 0)
+#define SPI_CR2_TXDMAEN         (1UL << 1)
+#define SPI_CR2_ERRIE           (1UL << 5)
+#define SPI_SR_RXNE             (1UL << 0)
+#define SPI_SR_TXE              (1UL << 1)
+#define SPI_SR_OVR              (1UL << 6)
+#define DMA_SxCR_EN             (1UL << 0)
+#define DMA_SxCR_TEIE           (1UL << 2)
+#define DMA_SxCR_TCIE           (1UL << 4)
+#define DMA_LISR_TEIF0          (1UL << 3)
+#define DMA_LISR_TCIF0          (1UL << 5)
+#define DMA_LISR_TEIF3          (1UL << 25)
+#define DMA_LISR_TCIF3          (1UL << 27)
+#define TIM_CR1_CEN             (1UL << 0)
+#define TIM_DIER_UIE            (1UL << 0)
+#define TIM_SR_UIF              (1UL << 0)
+
+// ============================================================================
+// 仿真钩子 (hostsim.c)
+// ============================================================================
+extern uint64_t hostsim_now;        // 虚拟时间 (CPU周期)
+extern uint64_t hostsim_next_event; // 最早的待触发事件
+extern uint32_t hostsim_ll_cost;    // = HostSim_Costs.ll_access
+void     HostSim_SpendSlow(uint32_t cycles);
+void     HostSim_GpioWrite(GPIO_TypeDef *port, uint32_t pins, uint8_t level);
+void     HostSim_DmaStreamEnable(DMA_TypeDef *dma, uint32_t stream);
+void     HostSim_DmaStreamDisable(DMA_TypeDef *dma, uint32_t stream);
+void     HostSim_SpiWrite8(SPI_TypeDef *spi, uint8_t data);
+void     HostSim_TimEnable(TIM_TypeDef *tim);
+uint32_t HostSim_TimCounter(TIM_TypeDef *tim);
+
+// 当前执行流花费 cycles 个周期; 期间到期的事件照常触发，优先级更高的中断在此处抢占
+static inline void HostSim_Spend(uint32_t cycles)
+{
+    if (hostsim_now + cycles < hostsim_next_event)
+    {
+        hostsim_now += cycles;
+        return;
+    }
+    HostSim_SpendSlow(cycles);
+}
+
+#define HOSTSIM_LL()            HostSim_Spend(hostsim_ll_cost)
+
+// ============================================================================
+// HAL
+// ============================================================================
+typedef enum { HAL_OK = 0, HAL_ERROR, HAL_BUSY, HAL_TIMEOUT } HAL_StatusTypeDef;
+typedef enum { SUCCESS = 0, ERROR = !SUCCESS } ErrorStatus;
+
+uint32_t HAL_GetTick(void);
+void     HAL_IncTick(void);
+void     HAL_Delay(uint32_t ms);
+
+// --- 以太网 (旧版HAL的描述符环，见 hostsim.c 的发送线路模型) ---
+typedef struct {
+    volatile uint32_t Status;
+    uint32_t ControlBufferSize;
+    uint32_t Buffer1Addr;
+    uint32_t Buffer2NextDescAddr;
+} ETH_DMADescTypeDef;
+
+typedef struct {
+    ETH_DMADescTypeDef *TxDesc;         // 下一个要填写的发送描述符
+    uint32_t            dma_ie;         // 已使能的DMA中断 (ETH_DMA_IT_*)
+    uint32_t            dma_sr;         // 待处理的DMA中断状态
+} ETH_HandleTypeDef;
+
+#define ETH_DMATXDESC_OWN       0x80000000U
+#define ETH_DMATXDESC_IC        0x40000000U
+#define ETH_DMATXDESC_LS        0x20000000U
+#define ETH_DMATXDESC_FS        0x10000000U
+#define ETH_DMA_IT_NIS          0x00010000U
+#define ETH_DMA_IT_T            0x00000001U
+
+#define __HAL_ETH_DMA_ENABLE_IT(h, it)  ((h)->dma_ie |= (it))
+#define __HAL_ETH_DMA_DISABLE_IT(h, it) ((h)->dma_ie &= ~(it))
+
+HAL_StatusTypeDef HAL_ETH_TransmitFrame(ETH_HandleTypeDef *heth, uint32_t len);
+void              HAL_ETH_IRQHandler(ETH_HandleTypeDef *heth);
+void              HAL_ETH_TxCpltCallback(ETH_HandleTypeDef *heth);
+
+// ============================================================================
+// LL: 时钟与GPIO (配置类调用无副作用)
+// ============================================================================
+#define LL_AHB1_GRP1_PERIPH_GPIOA   (1UL << 0)
+#define LL_AHB1_GRP1_PERIPH_GPIOB   (1UL << 1)
+#define LL_AHB1_GRP1_PERIPH_GPIOC   (1UL << 2)
+#define LL_AHB1_GRP1_PERIPH_DMA1    (1UL << 21)
+#define LL_AHB1_GRP1_PERIPH_DMA2    (1UL << 22)
+#define LL_APB1_GRP1_PERIPH_TIM2    (1UL << 0)
+#define LL_APB1_GRP1_PERIPH_SPI2    (1UL << 14)
+#define LL_APB1_GRP1_PERIPH_SPI3    (1UL << 15)
+#define LL_APB2_GRP1_PERIPH_SPI1    (1UL << 12)
+
+static inline void LL_AHB1_GRP1_EnableClock(uint32_t p) { (void)p; }
+static inline void LL_APB1_GRP1_EnableClock(uint32_t p) { (void)p; }
+static inline void LL_APB2_GRP1_EnableClock(uint32_t p) { (void)p; }
+
+#define LL_GPIO_PIN_2               (1UL << 2)
+#define LL_GPIO_PIN_3               (1UL << 3)
+#define LL_GPIO_PIN_4               (1UL << 4)
+#define LL_GPIO_PIN_5               (1UL << 5)
+#define LL_GPIO_PIN_6               (1UL << 6)
+#define LL_GPIO_PIN_7               (1UL << 7)
+#define LL_GPIO_PIN_8               (1UL << 8)
+#define LL_GPIO_PIN_9               (1UL << 9)
+#define LL_GPIO_PIN_10              (1UL << 10)
+#define LL_GPIO_PIN_11              (1UL << 11)
+#define LL_GPIO_PIN_12              (1UL << 12)
+#define LL_GPIO_MODE_OUTPUT         1U
+#define LL_GPIO_MODE_ALTERNATE      2U
+#define LL_GPIO_SPEED_FREQ_VERY_HIGH 3U
+#define LL_GPIO_OUTPUT_PUSHPULL     0U
+#define LL_GPIO_PULL_NO             0U
+#define LL_GPIO_AF_5                5U
+#define LL_GPIO_AF_6                6U
+
+typedef struct {
+    uint32_t Pin, Mode, Speed, OutputType, Pull, Alternate;
+} LL_GPIO_InitTypeDef;
+
+static inline ErrorStatus LL_GPIO_Init(GPIO_TypeDef *port, LL_GPIO_InitTypeDef *init)
+{
+    (void)port; (void)init;
+    return SUCCESS;
+}
+
+static inline void LL_GPIO_SetOutputPin(GPIO_TypeDef *port, uint32_t pins)
+{
+    HostSim_GpioWrite(port, pins, 1);
+}
+
+static inline void LL_GPIO_ResetOutputPin(GPIO_TypeDef *port, uint32_t pins)
+{
+    HostSim_GpioWrite(port, pins, 0);
+}
+
+// ============================================================================
+// LL: DMA
+// ============================================================================
+#define LL_DMA_STREAM_0             0U
+#define LL_DMA_STREAM_3             3U
+#define LL_DMA_CHANNEL_0            0U
+#define LL_DMA_CHANNEL_3            (3UL << 25)
+#define LL_DMA_DIRECTION_PERIPH_TO_MEMORY 0U
+#define LL_DMA_DIRECTION_MEMORY_TO_PERIPH (1UL << 6)
+#define LL_DMA_PRIORITY_MEDIUM      (1UL << 16)
+#define LL_DMA_PRIORITY_HIGH        (2UL << 16)
+#define LL_DMA_MODE_NORMAL          0U
+#define LL_DMA_MODE_CIRCULAR        (1UL << 8)
+#define LL_DMA_PERIPH_NOINCREMENT   0U
+#define LL_DMA_MEMORY_INCREMENT     (1UL << 10)
+#define LL_DMA_PDATAALIGN_BYTE      0U
+#define LL_DMA_PDATAALIGN_HALFWORD  (1UL << 11)
+#define LL_DMA_MDATAALIGN_BYTE      0U
+#define LL_DMA_MDATAALIGN_HALFWORD  (1UL << 13)
+
+static inline void LL_DMA_SetChannelSelection(DMA_TypeDef *d, uint32_t s, uint32_t v) { (void)d; (void)s; (void)v; }
+static inline void LL_DMA_SetDataTransferDirection(DMA_TypeDef *d, uint32_t s, uint32_t v) { (void)d; (void)s; (void)v; }
+static inline void LL_DMA_SetStreamPriorityLevel(DMA_TypeDef *d, uint32_t s, uint32_t v) { (void)d; (void)s; (void)v; }
+static inline void LL_DMA_SetMode(DMA_TypeDef *d, uint32_t s, uint32_t v) { (void)d; (void)s; (void)v; }
+static inline void LL_DMA_SetPeriphIncMode(DMA_TypeDef *d, uint32_t s, uint32_t v) { (void)d; (void)s; (void)v; }
+static inline void LL_DMA_SetMemoryIncMode(DMA_TypeDef *d, uint32_t s, uint32_t v) { (void)d; (void)s; (void)v; }
+static inline void LL_DMA_SetPeriphSize(DMA_TypeDef *d, uint32_t s, uint32_t v) { (void)d; (void)s; (void)v; }
+static inline void LL_DMA_SetMemorySize(DMA_TypeDef *d, uint32_t s, uint32_t v) { (void)d; (void)s; (void)v; }
+static inline void LL_DMA_DisableFifoMode(DMA_TypeDef *d, uint32_t s) { (void)d; (void)s; }
+
+static inline void LL_DMA_SetDataLength(DMA_TypeDef *d, uint32_t s, uint32_t n)
+{
+    HOSTSIM_LL();
+    d->Stream[s].NDTR = n;
+}
+
+static inline void LL_DMA_SetPeriphAddress(DMA_TypeDef *d, uint32_t s, uint32_t a)
+{
+    HOSTSIM_LL();
+    d->Stream[s].PAR = a;
+}
+
+static inline void LL_DMA_SetMemoryAddress(DMA_TypeDef *d, uint32_t s, uint32_t a)
+{
+    HOSTSIM_LL();
+    d->Stream[s].M0AR = a;
+}
+
+static inline void LL_DMA_EnableIT_TC(DMA_TypeDef *d, uint32_t s)
+{
+    HOSTSIM_LL();
+    d->Stream[s].CR |= DMA_SxCR_TCIE;
+}
+
+static inline void LL_DMA_EnableIT_TE(DMA_TypeDef *d, uint32_t s)
+{
+    HOSTSIM_LL();
+    d->Stream[s].CR |= DMA_SxCR_TEIE;
+}
+
+static inline void LL_DMA_EnableStream(DMA_TypeDef *d, uint32_t s)
+{
+    HOSTSIM_LL();
+    HostSim_DmaStreamEnable(d, s);
+}
+
+static inline void LL_DMA_DisableStream(DMA_TypeDef *d, uint32_t s)
+{
+    HOSTSIM_LL();
+    HostSim_DmaStreamDisable(d, s);
+}
+
+#define HOSTSIM_DMA_FLAG_FN(name, bit)                                  \
+    static inline void LL_DMA_ClearFlag_##name(DMA_TypeDef *d)          \
+    { HOSTSIM_LL(); d->LISR &= ~(bit); }                                \
+    static inline uint32_t LL_DMA_IsActiveFlag_##name(DMA_TypeDef *d)   \
+    { HOSTSIM_LL(); return (d->LISR & (bit)) ? 1U : 0U; }
+HOSTSIM_DMA_FLAG_FN(TC0, DMA_LISR_TCIF0)
+HOSTSIM_DMA_FLAG_FN(TE0, DMA_LISR_TEIF0)
+HOSTSIM_DMA_FLAG_FN(TC3, DMA_LISR_TCIF3)
+HOSTSIM_DMA_FLAG_FN(TE3, DMA_LISR_TEIF3)
+
+// ============================================================================
+// LL: SPI
+// ============================================================================
+#define LL_SPI_FULL_DUPLEX          0U
+#define LL_SPI_MODE_MASTER          (1UL << 2)
+#define LL_SPI_DATAWIDTH_8BIT       0U
+#define LL_SPI_DATAWIDTH_16BIT      (1UL << 11)
+#define LL_SPI_POLARITY_LOW         0U
+#define LL_SPI_PHASE_1EDGE          0U
+#define LL_SPI_PHASE_2EDGE          1U
+#define LL_SPI_NSS_SOFT             (1UL << 9)
+#define LL_SPI_BAUDRATEPRESCALER_DIV2   (0UL << SPI_CR1_BR_Pos)
+#define LL_SPI_BAUDRATEPRESCALER_DIV4   (1UL << SPI_CR1_BR_Pos)
+#define LL_SPI_BAUDRATEPRESCALER_DIV8   (2UL << SPI_CR1_BR_Pos)
+#define LL_SPI_BAUDRATEPRESCALER_DIV16  (3UL << SPI_CR1_BR_Pos)
+#define LL_SPI_MSB_FIRST            0U
+#define LL_SPI_CRCCALCULATION_DISABLE 0U
+#define LL_SPI_PROTOCOL_MOTOROLA    0U
+
+typedef struct {
+    uint32_t TransferDirection, Mode, DataWidth, ClockPolarity, ClockPhase, NSS;
+    uint32_t BaudRate, BitOrder, CRCCalculation, CRCPoly;
+} LL_SPI_InitTypeDef;
+
+static inline ErrorStatus LL_SPI_Init(SPI_TypeDef *spi, LL_SPI_InitTypeDef *init)
+{
+    spi->CR1 = (spi->CR1 & ~SPI_CR1_BR_Msk) | (init->BaudRate & SPI_CR1_BR_Msk);
+    spi->SR |= SPI_SR_TXE;
+    return SUCCESS;
+}
+
+static inline void LL_SPI_SetStandard(SPI_TypeDef *spi, uint32_t v) { (void)spi; (void)v; }
+
+static inline void LL_SPI_Enable(SPI_TypeDef *spi)
+{
+    HOSTSIM_LL();
+    spi->CR1 |= SPI_CR1_SPE;
+}
+
+static inline void LL_SPI_Disable(SPI_TypeDef *spi)
+{
+    HOSTSIM_LL();
+    spi->CR1 &= ~SPI_CR1_SPE;
+}
+
+static inline void LL_SPI_EnableDMAReq_TX(SPI_TypeDef *spi)
+{
+    HOSTSIM_LL();
+    spi->CR2 |= SPI_CR2_TXDMAEN;
+}
+
+static inline void LL_SPI_EnableDMAReq_RX(SPI_TypeDef *spi)
+{
+    HOSTSIM_LL();
+    spi->CR2 |= SPI_CR2_RXDMAEN;
+}
+
+static inline void LL_SPI_EnableIT_ERR(SPI_TypeDef *spi)
+{
+    spi->CR2 |= SPI_CR2_ERRIE;
+}
+
+static inline uint32_t LL_SPI_IsActiveFlag_TXE(SPI_TypeDef *spi)
+{
+    return (spi->SR & SPI_SR_TXE) ? 1U : 0U;
+}
+
+static inline uint32_t LL_SPI_IsActiveFlag_RXNE(SPI_TypeDef *spi)
+{
+    return (spi->SR & SPI_SR_RXNE) ? 1U : 0U;
+}
+
+static inline uint32_t LL_SPI_IsActiveFlag_OVR(SPI_TypeDef *spi)
+{
+    HOSTSIM_LL();
+    return (spi->SR & SPI_SR_OVR) ? 1U : 0U;
+}
+
+static inline void LL_SPI_TransmitData8(SPI_TypeDef *spi, uint8_t data)
+{
+    HostSim_SpiWrite8(spi, data);
+}
+
+static inline uint8_t LL_SPI_ReceiveData8(SPI_TypeDef *spi)
+{
+    spi->SR &= ~SPI_SR_RXNE;
+    return (uint8_t)spi->DR;
+}
+
+// ============================================================================
+// LL: TIM
+// ============================================================================
+#define LL_TIM_COUNTERMODE_UP       0U
+#define LL_TIM_CLOCKDIVISION_DIV1   0U
+#define LL_TIM_CLOCKSOURCE_INTERNAL 0U
+#define LL_TIM_TRGO_RESET           0U
+
+typedef struct {
+    uint16_t Prescaler;
+    uint32_t CounterMode;
+    uint32_t Autoreload;
+    uint32_t ClockDivision;
+    uint8_t  RepetitionCounter;
+} LL_TIM_InitTypeDef;
+
+static inline ErrorStatus LL_TIM_Init(TIM_TypeDef *tim, LL_TIM_InitTypeDef *init)
+{
+    tim->PSC = init->Prescaler;
+    tim->ARR = init->Autoreload;
+    return SUCCESS;
+}
+
+static inline void LL_TIM_DisableARRPreload(TIM_TypeDef *tim) { (void)tim; }
+static inline void LL_TIM_SetClockSource(TIM_TypeDef *tim, uint32_t v) { (void)tim; (void)v; }
+static inline void LL_TIM_SetTriggerOutput(TIM_TypeDef *tim, uint32_t v) { (void)tim; (void)v; }
+static inline void LL_TIM_DisableMasterSlaveMode(TIM_TypeDef *tim) { (void)tim; }
+
+static inline void LL_TIM_SetAutoReload(TIM_TypeDef *tim, uint32_t arr)
+{
+    HOSTSIM_LL();
+    tim->ARR = arr; // ARR预装载关闭: 从下一个更新事件起生效
+}
+
+static inline void LL_TIM_EnableIT_UPDATE(TIM_TypeDef *tim)
+{
+    tim->DIER |= TIM_DIER_UIE;
+}
+
+static inline void LL_TIM_EnableCounter(TIM_TypeDef *tim)
+{
+    HOSTSIM_LL();
+    HostSim_TimEnable(tim);
+}
+
+static inline uint32_t LL_TIM_GetCounter(TIM_TypeDef *tim)
+{
+    HOSTSIM_LL();
+    return HostSim_TimCounter(tim);
+}
+
+static inline uint32_t LL_TIM_IsActiveFlag_UPDATE(TIM_TypeDef *tim)
+{
+    HOSTSIM_LL();
+    return (tim->SR & TIM_SR_UIF) ? 1U : 0U;
+}
+
+static inline void LL_TIM_ClearFlag_UPDATE(TIM_TypeDef *tim)
+{
+    HOSTSIM_LL();
+    tim->SR &= ~TIM_SR_UIF;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOSTSIM_STM32F4XX_HAL_H_ */
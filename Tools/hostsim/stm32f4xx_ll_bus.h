@@ -0,0 +1,3 @@
+// Tools/hostsim/stm32f4xx_ll_bus.h
+// 主机仿真: 所有LL替身都在 stm32f4xx_hal.h 中
+#include "stm32f4xx_hal.h"
@@ -0,0 +1,570 @@
+/**
+ ******************************************************************************
+ * @file    latency_rx.c
+ * @brief   从采样到PC收包的端到端延迟测量：订阅带时间戳的流，与板子交换时钟并统计延迟分布
+ *
+ * @details
+ * 编译: gcc -O2 -Wall -I../Inc -o latency_rx latency_rx.c
+ *
+ * 用法:
+ *   latency_rx <board-ip> [mask] [decim] [port] [seconds]
+ * 默认 mask=0xFF decim=1 port=5003，seconds 为0时运行到 Ctrl-C。
+ *
+ * - **订阅**: 以 STREAM_SUB_OPT_TIME 订阅，每个数据包带 StreamTimeExt (块的采集起止时刻和
+ * 本包交给以太网的时刻，板子时钟)。带缺口表的包不带时间戳，计入 untimed。
+ * - **时钟**: 每 CLOCK_SYNC_INTERVAL_MS 从同一个套接字发一次 STREAM_CMD_TIME，t1 为发送前的
+ * CLOCK_REALTIME，t4 为内核收包时间戳 (SO_TIMESTAMPNS)。窗口内取往返时间接近最小值的交换，
+ * 用最小二乘拟合 "板子时钟 - PC时钟" 随PC时间的直线: 截距为偏差，斜率为频差
+ * (板子使用HSI，频差可达1%)。上下行延迟不对称的部分无法从交换中测出，是偏差的系统误差。
+ * - **延迟**: 数据包的内核收包时间戳换算到板子时钟，与包内样本的采集时刻相减，再按拟合的频差
+ * 换算为PC时钟的微秒。样本的采集时刻按块内均匀分布由 block_start_us / block_span_us 插值。
+ *   fw     = 交给以太网 - 本包最新样本的采集 (板内: 等满一块 + 主循环调度 + 拷贝)，不依赖时钟同步
+ *   net    = PC收到 - 交给以太网 (MAC/PHY/交换机/网卡/内核)
+ *   newest = PC收到 - 本包最新样本的采集
+ *   oldest = PC收到 - 本包最老样本的采集
+ * 每 REPORT_INTERVAL_S 秒打印一次各项的 p50/p99/p99.9/max，退出时打印全程的分布。Ctrl-C时退订。
+ *
+ * 时钟同步和延迟计算的代码由 latency_sim.c 在已知真值的仿真中验证
+ * (定义 LATENCY_RX_NO_MAIN 后包含本文件)。
+ ******************************************************************************
+ */
+
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stream_proto.h"
+
+#define DEFAULT_RX_PORT     5003
+
+#define REPORT_INTERVAL_S       2.0
+#define CLOCK_SYNC_INTERVAL_MS  200
+#define CLOCK_SYNC_WINDOW       64          // 参与拟合的最近交换数 (约13秒)
+#define CLOCK_SYNC_RTT_SLACK_US 20.0        // 往返时间不超过 窗口最小值 + 此值 的交换参与拟合
+#define CLOCK_SYNC_MIN_COUNT    16          // 窗口内至少有这么多次交换才开始统计延迟
+#define CLOCK_SYNC_MIN_SPAN_US  2000000.0   // 参与拟合的交换至少跨越的PC时间, 否则频差不可信
+
+// ============================ 时钟同步 ============================
+// 内部用相对于第一次交换的差值计算，避免双精度在 1e15 量级上损失微秒精度
+typedef struct {
+    double pc;              // (t1 + t4) / 2 - pc_base
+    double offset;          // 板子 - PC - offset_base
+    double rtt;             // (t4 - t1) - (t3 - t2)
+} SyncSample;
+
+typedef struct {
+    SyncSample s[CLOCK_SYNC_WINDOW];
+    uint32_t n, head;
+    uint64_t total;         // 收到的交换数
+    int64_t  pc_base, offset_base;
+    int      have_base;
+    // 拟合结果: 偏差(pc) = a + b * (pc - pc_ref)
+    double   a, b, pc_ref;
+    double   min_rtt;
+    uint32_t used;          // 参与拟合的交换数
+    int      ready;
+} ClockSync;
+
+static int CmpDouble(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void ClockSync_Fit(ClockSync *cs)
+{
+    double rtt[CLOCK_SYNC_WINDOW];
+    double mean_pc = 0, mean_off = 0, sxx = 0, sxy = 0;
+    double lo = 0, hi = 0, limit;
+    uint32_t i, used = 0;
+
+    for (i = 0; i < cs->n; i++)
+    {
+        rtt[i] = cs->s[i].rtt;
+    }
+    qsort(rtt, cs->n, sizeof(double), CmpDouble);
+    cs->min_rtt = rtt[0];
+    limit = cs->min_rtt + CLOCK_SYNC_RTT_SLACK_US;
+    for (i = 0; i < cs->n; i++)
+    {
+        const SyncSample *p = &cs->s[i];
+        if (p->rtt > limit)
+        {
+            continue;
+        }
+        if (used == 0 || p->pc < lo)
+        {
+            lo = p->pc;
+        }
+        if (used == 0 || p->pc > hi)
+        {
+            hi = p->pc;
+        }
+        mean_pc += p->pc;
+        mean_off += p->offset;
+        used++;
+    }
+    if (used == 0)
+    {
+        return;
+    }
+    mean_pc /= used;
+    mean_off /= used;
+    for (i = 0; i < cs->n; i++)
+    {
+        const SyncSample *p = &cs->s[i];
+        if (p->rtt > limit)
+        {
+            continue;
+        }
+        sxx += (p->pc - mean_pc) * (p->pc - mean_pc);
+        sxy += (p->pc - mean_pc) * (p->offset - mean_off);
+    }
+    cs->used = used;
+    cs->pc_ref = mean_pc;
+    cs->a = mean_off;
+    cs->ready = (cs->n >= CLOCK_SYNC_MIN_COUNT && used >= 3 && hi - lo >= CLOCK_SYNC_MIN_SPAN_US);
+    cs->b = cs->ready ? sxy / sxx : 0.0;
+}
+
+/**
+ * @brief 加入一次交换 (t1/t4 为PC时钟微秒，t2/t3 为板子时钟微秒) 并重新拟合
+ * @retval 0 成功; -1 时间不合理 (应答早于请求等)
+ */
+static int ClockSync_Add(ClockSync *cs, uint64_t t1, uint64_t t2, uint64_t t3, uint64_t t4)
+{
+    SyncSample *p;
+
+    if (t4 < t1 || t3 < t2 || (t4 - t1) < (t3 - t2))
+    {
+        return -1;
+    }
+    if (!cs->have_base)
+    {
+        cs->pc_base = (int64_t)t1;
+        cs->offset_base = (int64_t)(t2 - t1);
+        cs->have_base = 1;
+    }
+    p = &cs->s[cs->head];
+    cs->head = (cs->head + 1) % CLOCK_SYNC_WINDOW;
+    if (cs->n < CLOCK_SYNC_WINDOW)
+    {
+        cs->n++;
+    }
+    cs->total++;
+    p->pc = (double)((int64_t)t1 - cs->pc_base) + (double)(t4 - t1) / 2.0;
+    p->offset = ((double)((int64_t)(t2 - t1) - cs->offset_base) +
+                 (double)((int64_t)(t3 - t4) - cs->offset_base)) / 2.0;
+    p->rtt = (double)(t4 - t1) - (double)(t3 - t2);
+    ClockSync_Fit(cs);
+    return 0;
+}
+
+// PC时钟 -> 板子时钟 (微秒)
+static double ClockSync_ToBoard(const ClockSync *cs, uint64_t pc_us)
+{
+    double x = (double)((int64_t)pc_us - cs->pc_base);
+    double off = cs->a + cs->b * (x - cs->pc_ref);
+    return (double)((int64_t)pc_us + cs->offset_base) + off;
+}
+
+// 板子时钟每PC微秒走过的微秒数
+static double ClockSync_Rate(const ClockSync *cs)
+{
+    return 1.0 + cs->b;
+}
+
+// ============================ 延迟计算 ============================
+typedef struct {
+    double fw, net, newest, oldest;     // PC时钟微秒
+} LatencySample;
+
+/**
+ * @brief 由包头、时间戳扩展和收包时刻 (已换算到板子时钟) 计算一个包的各项延迟
+ * @param frames 本包的帧数 (抽取后)
+ * @param rate   ClockSync_Rate，把板子时钟的时间差换算为PC时钟
+ */
+static void Latency_Compute(const StreamUdpHeader *h, const StreamTimeExt *t, uint32_t frames,
+                            double arrival_board, double rate, LatencySample *out)
+{
+    // 块内交织序号: 原始帧 * 8 + 通道; 本包最老样本为第一帧的最低通道，最新为最后一帧的最高通道
+    uint32_t first = (uint32_t)h->frame_offset * h->decimation * STREAM_CHANNELS +
+                     (uint32_t)__builtin_ctz(h->channel_mask);
+    uint32_t last = ((uint32_t)h->frame_offset + frames - 1) * h->decimation * STREAM_CHANNELS +
+                    (uint32_t)(31 - __builtin_clz(h->channel_mask));
+    double per_sample = (double)t->block_span_us / (STREAM_BLOCK_SAMPLES - 1);
+    double start = (double)t->block_start_us;
+    double handoff = start + t->handoff_us;
+    double conv_first = start + first * per_sample;
+    double conv_last = start + last * per_sample;
+
+    out->fw = (handoff - conv_last) / rate;
+    out->net = (arrival_board - handoff) / rate;
+    out->newest = (arrival_board - conv_last) / rate;
+    out->oldest = (arrival_board - conv_first) / rate;
+}
+
+// ============================ 分布统计 ============================
+typedef struct {
+    double *v;
+    size_t n, cap;
+} Series;
+
+static void Series_Add(Series *s, double x)
+{
+    if (s->n == s->cap)
+    {
+        size_t cap = s->cap ? s->cap * 2 : 4096;
+        double *v = realloc(s->v, cap * sizeof(*v));
+        if (v == NULL)
+        {
+            return;
+        }
+        s->v = v;
+        s->cap = cap;
+    }
+    s->v[s->n++] = x;
+}
+
+// 须先排序
+static double Series_Pct(const Series *s, double pct)
+{
+    size_t i = (size_t)(pct / 100.0 * (double)(s->n - 1) + 0.5);
+    return s->v[i < s->n ? i : s->n - 1];
+}
+
+typedef struct {
+    Series fw, net, newest, oldest;
+} LatencySeries;
+
+static void LatencySeries_Add(LatencySeries *ls, const LatencySample *x)
+{
+    Series_Add(&ls->fw, x->fw);
+    Series_Add(&ls->net, x->net);
+    Series_Add(&ls->newest, x->newest);
+    Series_Add(&ls->oldest, x->oldest);
+}
+
+static void LatencySeries_Print(const char *tag, LatencySeries *ls)
+{
+    Series *all[4] = { &ls->fw, &ls->net, &ls->newest, &ls->oldest };
+    static const char *const names[4] = { "fw", "net", "newest", "oldest" };
+
+    if (ls->fw.n == 0)
+    {
+        printf("%s no timed packets\n", tag);
+        return;
+    }
+    printf("%s %zu packets (us)   p50       p99     p99.9       max\n", tag, ls->fw.n);
+    for (int i = 0; i < 4; i++)
+    {
+        Series *s = all[i];
+        qsort(s->v, s->n, sizeof(double), CmpDouble);
+        printf("  %-7s %13.1f %9.1f %9.1f %9.1f\n", names[i],
+               Series_Pct(s, 50), Series_Pct(s, 99), Series_Pct(s, 99.9), s->v[s->n - 1]);
+    }
+}
+
+#ifndef LATENCY_RX_NO_MAIN
+// ============================ 收发 ============================
+static volatile sig_atomic_t g_stop = 0;
+
+static void OnSignal(int sig)
+{
+    (void)sig;
+    g_stop = 1;
+}
+
+static void LatencySeries_Reset(LatencySeries *ls)
+{
+    ls->fw.n = ls->net.n = ls->newest.n = ls->oldest.n = 0;
+}
+
+static double NowSec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// 与 SO_TIMESTAMPNS 相同的时钟
+static uint64_t NowRealUs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000U + (uint64_t)ts.tv_nsec / 1000U;
+}
+
+static int OpenUdp(int port)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one)) < 0)
+    {
+        perror("SO_TIMESTAMPNS");   // 退回到用户态收包时刻, 包含调度延迟
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief 收一个包和它的内核时间戳 (PC时钟微秒)
+ * @retval 包长; 超时或出错返回-1
+ */
+static ssize_t RecvStamped(int fd, uint8_t *buf, size_t size, uint64_t *stamp_us)
+{
+    struct iovec iov = { buf, size };
+    union {
+        struct cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(struct timespec))];
+    } ctrl;
+    struct msghdr msg;
+    ssize_t n;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+    n = recvmsg(fd, &msg, 0);
+    if (n < 0)
+    {
+        return -1;
+    }
+    *stamp_us = 0;
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c != NULL; c = CMSG_NXTHDR(&msg, c))
+    {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            *stamp_us = (uint64_t)ts.tv_sec * 1000000U + (uint64_t)ts.tv_nsec / 1000U;
+        }
+    }
+    if (*stamp_us == 0)
+    {
+        *stamp_us = NowRealUs();
+    }
+    return n;
+}
+
+/**
+ * @brief 发送订阅/退订请求并等待应答 (超时重试3次)，期间到达的数据包被丢弃
+ * @retval 应答的状态; 无应答返回-1
+ */
+static int CtrlTransact(int fd, const struct sockaddr_in *board, const StreamCtrlRequest *req)
+{
+    uint8_t reply[512];
+    uint64_t stamp;
+
+    for (int attempt = 0; attempt < 3; attempt++)
+    {
+        double deadline = NowSec() + 1.0;
+
+        if (sendto(fd, req, sizeof(*req), 0, (const struct sockaddr *)board, sizeof(*board)) < 0)
+        {
+            perror("sendto");
+            return -1;
+        }
+        while (NowSec() < deadline)
+        {
+            ssize_t n = RecvStamped(fd, reply, sizeof(reply), &stamp);
+            if (n >= (ssize_t)sizeof(StreamCtrlReply) && reply[0] == (req->cmd | STREAM_CMD_REPLY))
+            {
+                return reply[1];
+            }
+        }
+    }
+    return -1;
+}
+
+static void SendTimeRequest(int fd, const struct sockaddr_in *board)
+{
+    StreamCtrlTime req;
+
+    memset(&req, 0, sizeof(req));
+    req.cmd = STREAM_CMD_TIME;
+    req.t1 = NowRealUs();
+    sendto(fd, &req, sizeof(req), 0, (const struct sockaddr *)board, sizeof(*board));
+}
+
+static void Usage(void)
+{
+    fprintf(stderr, "usage: latency_rx <board-ip> [mask] [decim] [port] [seconds]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t mask = 0xFF, decim = 1;
+    int port = DEFAULT_RX_PORT;
+    double seconds = 0;
+    struct sockaddr_in board;
+    StreamCtrlRequest req;
+    static ClockSync cs;
+    static LatencySeries interval, total;
+    static uint8_t pkt[2048];
+    uint64_t packets = 0, untimed = 0, unsynced = 0, time_replies = 0;
+    int fd, status;
+
+    if (argc < 2)
+    {
+        Usage();
+    }
+    if (argc > 2) mask = (uint8_t)strtoul(argv[2], NULL, 0);
+    if (argc > 3) decim = (uint8_t)atoi(argv[3]);
+    if (argc > 4) port = atoi(argv[4]);
+    if (argc > 5) seconds = atof(argv[5]);
+    if (mask == 0 || decim == 0)
+    {
+        Usage();
+    }
+
+    memset(&board, 0, sizeof(board));
+    board.sin_family = AF_INET;
+    board.sin_port = htons(STREAM_CTRL_PORT);
+    if (inet_pton(AF_INET, argv[1], &board.sin_addr) != 1)
+    {
+        fprintf(stderr, "bad board address: %s\n", argv[1]);
+        return 2;
+    }
+
+    fd = OpenUdp(port);
+    if (fd < 0)
+    {
+        return 1;
+    }
+    struct timeval tv = { 0, 10000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    memset(&req, 0, sizeof(req));
+    req.cmd = STREAM_CMD_SUBSCRIBE;
+    req.channel_mask = mask;
+    req.decimation = decim;
+    req.options = STREAM_SUB_OPT_TIME;
+    status = CtrlTransact(fd, &board, &req);
+    if (status != STREAM_STATUS_OK)
+    {
+        fprintf(stderr, status < 0 ? "no reply from %s:%d\n" : "subscribe failed (%s:%d)\n",
+                argv[1], STREAM_CTRL_PORT);
+        close(fd);
+        return 1;
+    }
+
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+    printf("Subscribed mask=0x%02X decim=%u on port %d with timestamps\n", mask, decim, port);
+
+    const uint32_t frame_bytes = (uint32_t)__builtin_popcount(mask) * 2;
+    double t_start = NowSec(), t_report = t_start, t_sync = 0;
+
+    while (!g_stop && (seconds <= 0 || NowSec() - t_start < seconds))
+    {
+        uint64_t stamp;
+        ssize_t n;
+
+        if (NowSec() - t_sync >= CLOCK_SYNC_INTERVAL_MS / 1000.0)
+        {
+            SendTimeRequest(fd, &board);
+            t_sync = NowSec();
+        }
+        if (NowSec() - t_report >= REPORT_INTERVAL_S)
+        {
+            printf("[lat] packets=%llu untimed=%llu unsynced=%llu | clock: offset=%.1fus "
+                   "skew=%+.0fppm min-rtt=%.1fus fit=%u/%u%s\n",
+                   (unsigned long long)packets, (unsigned long long)untimed,
+                   (unsigned long long)unsynced, cs.offset_base + cs.a, cs.b * 1e6, cs.min_rtt,
+                   cs.used, cs.n, cs.ready ? "" : " (settling)");
+            LatencySeries_Print("[lat]", &interval);
+            LatencySeries_Reset(&interval);
+            t_report = NowSec();
+        }
+
+        n = RecvStamped(fd, pkt, sizeof(pkt), &stamp);
+        if (n < 0)
+        {
+            continue;
+        }
+        if (n == (ssize_t)sizeof(StreamCtrlTimeReply) && pkt[0] == (STREAM_CMD_TIME | STREAM_CMD_REPLY))
+        {
+            StreamCtrlTimeReply rep;
+            memcpy(&rep, pkt, sizeof(rep));
+            if (rep.status == STREAM_STATUS_OK && ClockSync_Add(&cs, rep.t1, rep.t2_us, rep.t3_us, stamp) == 0)
+            {
+                time_replies++;
+            }
+            continue;
+        }
+        if (n < (ssize_t)sizeof(StreamUdpHeader))
+        {
+            continue;
+        }
+
+        const StreamUdpHeader *h = (const StreamUdpHeader *)pkt;
+        uint32_t hdr_len = sizeof(*h) + ((h->flags & STREAM_FLAG_GAP) ? sizeof(StreamGapExt) : 0)
+                         + ((h->flags & STREAM_FLAG_TIME) ? sizeof(StreamTimeExt) : 0);
+        if (h->magic != STREAM_UDP_MAGIC || h->version != STREAM_PROTO_VERSION ||
+            h->channel_mask != mask || (uint32_t)n <= hdr_len || ((uint32_t)n - hdr_len) % frame_bytes != 0)
+        {
+            continue;
+        }
+        packets++;
+        if (!(h->flags & STREAM_FLAG_TIME))
+        {
+            untimed++;
+            continue;
+        }
+        if (!cs.ready)
+        {
+            unsynced++;
+            continue;
+        }
+
+        StreamTimeExt te;
+        LatencySample x;
+        memcpy(&te, pkt + hdr_len - sizeof(te), sizeof(te));
+        Latency_Compute(h, &te, ((uint32_t)n - hdr_len) / frame_bytes,
+                        ClockSync_ToBoard(&cs, stamp), ClockSync_Rate(&cs), &x);
+        LatencySeries_Add(&interval, &x);
+        LatencySeries_Add(&total, &x);
+    }
+
+    req.cmd = STREAM_CMD_UNSUBSCRIBE;
+    req.channel_mask = 0;
+    req.decimation = 0;
+    req.options = 0;
+    CtrlTransact(fd, &board, &req);
+    close(fd);
+
+    printf("\n[lat] total: packets=%llu untimed=%llu unsynced=%llu time-replies=%llu\n",
+           (unsigned long long)packets, (unsigned long long)untimed,
+           (unsigned long long)unsynced, (unsigned long long)time_replies);
+    LatencySeries_Print("[lat]", &total);
+    return 0;
+}
+#endif /* LATENCY_RX_NO_MAIN */
@@ -0,0 +1,281 @@
+/**
+ ******************************************************************************
+ * @file    latency_sim.c
+ * @brief   延迟测量 (latency_rx.c) 的主机测试: 在已知真值的仿真中检验时钟同步和延迟计算
+ *
+ * @details
+ * 编译: gcc -O2 -Wall -I../Inc -o latency_sim latency_sim.c -lm
+ *
+ * 用法:
+ *   latency_sim [-t s] [-s ppm] [-a us] [-j us] [-p us] [-m mask] [-d decim] [-e us]
+ * 选项:
+ *   -t <s>      仿真时长 (默认30秒)
+ *   -s <ppm>    板子时钟相对PC的频差 (默认+5000, 即HSI快0.5%)
+ *   -a <us>     上行 (PC->板子) 比下行多出的固定延迟 (默认10)
+ *   -j <us>     网络延迟随机部分的均值 (指数分布, 默认40); 另有2%的包多延迟2ms
+ *   -p <us>     t2 中主循环轮询延迟的均值 (指数分布, 默认50)
+ *   -m <mask>   订阅的通道掩码 (默认0xFF)
+ *   -d <decim>  抽取因子 (默认1)
+ *   -e <us>     估计值与真值允许的偏差, 不含上下行不对称引起的 a/2 (默认20)
+ *
+ * 真实时间即PC时钟; 板子时钟 = 起始值 + 真实时间 * (1 + 频差)，取整到微秒。
+ * 时钟交换每200ms一次，t2 含主循环轮询延迟。采集按210kHz的TIM2节奏填满8192样本的块，
+ * 块起止时刻在DMA完成时记录; 块满后主循环在0~200us (5%的块为0~3ms) 内开始发送，
+ * 每包间隔25~35us，交给以太网后经过固定100us加随机延迟到达PC。
+ * 所有交换和数据包按PC收到的时刻排序后交给 latency_rx.c 中的 ClockSync / Latency_Compute，
+ * 与真值比较各项延迟的误差。同时给出不做频差修正 (rate=1) 时的误差作为对照。
+ * 任一项的最大误差超过 -e (net/newest/oldest 另加 a/2) 时返回1。
+ * 轮询延迟只加在上行一侧，取往返最短的交换只能减小不能消除它，net/newest/oldest 的误差
+ * 因此偏正，均值随 -p 增大 (默认参数下约+8us)。fw 只用板子时钟，误差为DMA完成与转换之间的1.5us。
+ ******************************************************************************
+ */
+
+#define LATENCY_RX_NO_MAIN
+#include "latency_rx.c"
+
+#include <math.h>
+
+#define SIM_PC_BASE_US      1700000000000000.0  // PC时钟的起点 (约2023年的CLOCK_REALTIME)
+#define SIM_BOARD_BASE_US   3000000.0           // 板子上电3秒后开始
+#define SIM_SAMPLE_HZ       210000.0
+#define SIM_DMA_US          1.5                 // 转换到SPI/DMA完成回调的时间
+#define SIM_NET_BASE_US     100.0
+
+typedef struct {
+    double seconds, skew_ppm, asym, jitter, poll, tolerance;
+    uint8_t mask, decim;
+} SimParams;
+
+typedef struct {
+    double arrival_pc;          // PC收到的时刻 (排序键)
+    int is_time;
+    uint64_t t1, t2, t3, t4;
+    StreamUdpHeader hdr;
+    StreamTimeExt ext;
+    uint32_t frames;
+    LatencySample truth;
+} SimEvent;
+
+static const SimParams *g_p;
+static uint32_t g_rng = 2463534242U;
+
+static double Uniform(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return (g_rng + 0.5) / 4294967296.0;
+}
+
+static double NetDelay(double base)
+{
+    double d = base - g_p->jitter * log(Uniform());
+    if (Uniform() < 0.02)
+    {
+        d += 2000.0;
+    }
+    return d;
+}
+
+static uint64_t BoardUs(double t)
+{
+    return (uint64_t)floor(SIM_BOARD_BASE_US + t * (1.0 + g_p->skew_ppm * 1e-6));
+}
+
+static uint64_t PcUs(double t)
+{
+    return (uint64_t)floor(SIM_PC_BASE_US + t);
+}
+
+static int CmpEvent(const void *a, const void *b)
+{
+    double x = ((const SimEvent *)a)->arrival_pc, y = ((const SimEvent *)b)->arrival_pc;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    double max_abs, sum;
+    uint64_t n;
+} ErrStat;
+
+static void ErrAdd(ErrStat *e, double err)
+{
+    if (fabs(err) > e->max_abs)
+    {
+        e->max_abs = fabs(err);
+    }
+    e->sum += err;
+    e->n++;
+}
+
+static void Usage(void)
+{
+    fprintf(stderr, "usage: latency_sim [-t s] [-s ppm] [-a us] [-j us] [-p us] [-m mask] [-d decim] [-e us]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    SimParams p = { 30.0, 5000.0, 10.0, 40.0, 50.0, 20.0, 0xFF, 1 };
+    SimEvent *ev;
+    size_t n_ev = 0, cap;
+    static ClockSync cs;
+    static LatencySeries est;
+    ErrStat err[4], raw[4];
+    uint64_t skipped = 0;
+    int opt, fail = 0;
+
+    while ((opt = getopt(argc, argv, "t:s:a:j:p:m:d:e:")) != -1)
+    {
+        switch (opt)
+        {
+        case 't': p.seconds = atof(optarg); break;
+        case 's': p.skew_ppm = atof(optarg); break;
+        case 'a': p.asym = atof(optarg); break;
+        case 'j': p.jitter = atof(optarg); break;
+        case 'p': p.poll = atof(optarg); break;
+        case 'm': p.mask = (uint8_t)strtoul(optarg, NULL, 0); break;
+        case 'd': p.decim = (uint8_t)atoi(optarg); break;
+        case 'e': p.tolerance = atof(optarg); break;
+        default: Usage();
+        }
+    }
+    if (p.mask == 0 || p.decim == 0 || (p.decim & (p.decim - 1)) != 0 || p.decim > 64 || p.seconds < 5)
+    {
+        Usage();
+    }
+    g_p = &p;
+
+    const uint32_t frame_bytes = (uint32_t)__builtin_popcount(p.mask) * 2;
+    const uint32_t frames_per_block = (STREAM_BLOCK_SAMPLES / STREAM_CHANNELS) / p.decim;
+    const uint32_t frames_per_pkt = STREAM_UDP_CHUNK_SIZE / frame_bytes;
+    const double block_us = STREAM_BLOCK_SAMPLES / SIM_SAMPLE_HZ * 1e6;
+
+    cap = (size_t)(p.seconds * 1e6 / block_us + 2) * (frames_per_block / frames_per_pkt + 2) +
+          (size_t)(p.seconds * 5 + 2);
+    ev = calloc(cap, sizeof(*ev));
+    if (ev == NULL)
+    {
+        return 2;
+    }
+
+    // --- 时钟交换 ---
+    for (double t1 = 1000.0; t1 < p.seconds * 1e6 && n_ev < cap; t1 += CLOCK_SYNC_INTERVAL_MS * 1000.0)
+    {
+        SimEvent *e = &ev[n_ev++];
+        double t2 = t1 + NetDelay(SIM_NET_BASE_US + p.asym) - p.poll * log(Uniform());
+        double t3 = t2 + 5.0 + 5.0 * Uniform();
+        double t4 = t3 + NetDelay(SIM_NET_BASE_US);
+
+        e->is_time = 1;
+        e->t1 = PcUs(t1);
+        e->t2 = BoardUs(t2);
+        e->t3 = BoardUs(t3);
+        e->t4 = PcUs(t4);
+        e->arrival_pc = t4;
+    }
+
+    // --- 采集块和数据包 ---
+    uint32_t seq = 0;
+    for (uint32_t block = 0; ; block++)
+    {
+        double t0 = block * block_us;                       // 块内第一个样本的转换时刻
+        double t_last = t0 + (STREAM_BLOCK_SAMPLES - 1) * 1e6 / SIM_SAMPLE_HZ;
+        double t_send;
+        uint64_t start;
+
+        if (t_last >= p.seconds * 1e6)
+        {
+            break;
+        }
+        start = BoardUs(t0 + SIM_DMA_US);
+        t_send = t_last + SIM_DMA_US + (Uniform() < 0.05 ? 3000.0 : 200.0) * Uniform();
+        for (uint32_t off = 0; off < frames_per_block && n_ev < cap; off += frames_per_pkt)
+        {
+            SimEvent *e = &ev[n_ev++];
+            uint32_t frames = frames_per_block - off < frames_per_pkt ? frames_per_block - off : frames_per_pkt;
+            uint32_t s_first = off * p.decim * STREAM_CHANNELS + (uint32_t)__builtin_ctz(p.mask);
+            uint32_t s_last = (off + frames - 1) * p.decim * STREAM_CHANNELS + (uint32_t)(31 - __builtin_clz(p.mask));
+            double conv_first = t0 + s_first * 1e6 / SIM_SAMPLE_HZ;
+            double conv_last = t0 + s_last * 1e6 / SIM_SAMPLE_HZ;
+            double arrival;
+
+            t_send += 25.0 + 10.0 * Uniform();
+            arrival = t_send + NetDelay(SIM_NET_BASE_US);
+
+            e->hdr.magic = STREAM_UDP_MAGIC;
+            e->hdr.version = STREAM_PROTO_VERSION;
+            e->hdr.flags = STREAM_FLAG_TIME;
+            e->hdr.seq = seq++;
+            e->hdr.block = block;
+            e->hdr.frame_offset = (uint16_t)off;
+            e->hdr.channel_mask = p.mask;
+            e->hdr.decimation = p.decim;
+            e->ext.block_start_us = start;
+            e->ext.block_span_us = (uint32_t)(BoardUs(t_last + SIM_DMA_US) - start);
+            e->ext.handoff_us = (uint32_t)(BoardUs(t_send) - start);
+            e->frames = frames;
+            e->arrival_pc = arrival;
+            e->truth.fw = t_send - conv_last;
+            e->truth.net = arrival - t_send;
+            e->truth.newest = arrival - conv_last;
+            e->truth.oldest = arrival - conv_first;
+        }
+    }
+    qsort(ev, n_ev, sizeof(*ev), CmpEvent);
+
+    // --- 按到达顺序交给接收端的估计代码 ---
+    memset(err, 0, sizeof(err));
+    memset(raw, 0, sizeof(raw));
+    for (size_t i = 0; i < n_ev; i++)
+    {
+        SimEvent *e = &ev[i];
+        LatencySample x, x_raw;
+        double board;
+
+        if (e->is_time)
+        {
+            ClockSync_Add(&cs, e->t1, e->t2, e->t3, e->t4);
+            continue;
+        }
+        if (!cs.ready)
+        {
+            skipped++;
+            continue;
+        }
+        board = ClockSync_ToBoard(&cs, PcUs(e->arrival_pc));
+        Latency_Compute(&e->hdr, &e->ext, e->frames, board, ClockSync_Rate(&cs), &x);
+        Latency_Compute(&e->hdr, &e->ext, e->frames, board, 1.0, &x_raw);
+        LatencySeries_Add(&est, &x);
+        ErrAdd(&err[0], x.fw - e->truth.fw);
+        ErrAdd(&err[1], x.net - e->truth.net);
+        ErrAdd(&err[2], x.newest - e->truth.newest);
+        ErrAdd(&err[3], x.oldest - e->truth.oldest);
+        ErrAdd(&raw[0], x_raw.fw - e->truth.fw);
+        ErrAdd(&raw[1], x_raw.net - e->truth.net);
+        ErrAdd(&raw[2], x_raw.newest - e->truth.newest);
+        ErrAdd(&raw[3], x_raw.oldest - e->truth.oldest);
+    }
+
+    printf("skew=%+.0fppm asym=%.1fus jitter=%.1fus mask=0x%02X decim=%u: %zu events, "
+           "%llu packets before clock settled\n",
+           p.skew_ppm, p.asym, p.jitter, p.mask, p.decim, n_ev, (unsigned long long)skipped);
+    printf("clock fit: skew=%+.1fppm (true %+.1f) min-rtt=%.1fus fit=%u/%u\n",
+           cs.b * 1e6, p.skew_ppm, cs.min_rtt, cs.used, cs.n);
+    LatencySeries_Print("estimated", &est);
+    printf("error (us)      mean  max|err|   limit | rate=1: mean  max|err|\n");
+    for (int i = 0; i < 4; i++)
+    {
+        static const char *const names[4] = { "fw", "net", "newest", "oldest" };
+        double limit = p.tolerance + (i == 0 ? 0.0 : p.asym / 2.0);
+        int bad = err[i].n == 0 || err[i].max_abs > limit;
+
+        printf("  %-7s %9.2f %9.2f %7.1f | %12.2f %9.2f%s\n", names[i],
+               err[i].n ? err[i].sum / err[i].n : 0.0, err[i].max_abs, limit,
+               raw[i].n ? raw[i].sum / raw[i].n : 0.0, raw[i].max_abs, bad ? "  <-- FAIL" : "");
+        fail |= bad;
+    }
+    printf("%s\n", fail ? "FAIL" : "PASS");
+    free(ev);
+    return fail;
+}
@@ -0,0 +1,279 @@
+/**
+ ******************************************************************************
+ * @file    log_decode.c
+ * @brief   延迟日志的PC端解码器: 对照固件ELF把二进制日志记录还原为文本
+ *
+ * @details
+ * 编译: gcc -O2 -Wall -o log_decode log_decode.c
+ *
+ * 用法:
+ *   stty -F /dev/ttyUSB0 115200 raw -echo
+ *   log_decode <firmware.elf> [/dev/ttyUSB0 | capture.bin]
+ *   (省略第二个参数时从标准输入读取)
+ *
+ * 固件设置 LOG_OUTPUT_BINARY = 1 时，Log_Process 不再格式化，而是输出:
+ *   00 A5 <头: 参数个数, 标志> <格式字符串地址 u32> <时间戳 ms u32> <参数 u32 x N>
+ * (小端)。格式字符串和 %s 参数都是固件中的地址，本工具从ELF的可加载段中取出
+ * 对应的字符串后格式化。串口上的其他字节(普通 printf 输出)原样透传。
+ * 地址不在ELF中(如指向RAM的字符串)时输出 <0x........>。
+ ******************************************************************************
+ */
+
+#include <elf.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_SYNC0           0x00            // 与 debug_long.c 保持一致
+#define LOG_SYNC1           0xA5
+#define LOG_MAX_ARGS        8
+#define LOG_REC_PLAIN       0x100U
+
+#define MAX_SEGMENTS        16
+
+typedef struct {
+    uint32_t addr;
+    uint32_t size;
+    const uint8_t *data;
+} Segment;
+
+static Segment g_segs[MAX_SEGMENTS];
+static int g_seg_count;
+static uint8_t *g_elf;
+
+/**
+ * @brief 载入ELF32(小端)的可加载段; 按虚拟地址查找，.rodata 位于其中
+ */
+static int LoadElf(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    long size;
+    const Elf32_Ehdr *eh;
+
+    if (!f)
+    {
+        perror(path);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    g_elf = malloc((size_t)size);
+    if (!g_elf || fread(g_elf, 1, (size_t)size, f) != (size_t)size)
+    {
+        fprintf(stderr, "%s: read failed\n", path);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    eh = (const Elf32_Ehdr *)g_elf;
+    if (size < (long)sizeof(*eh) || memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0 ||
+        eh->e_ident[EI_CLASS] != ELFCLASS32 || eh->e_ident[EI_DATA] != ELFDATA2LSB)
+    {
+        fprintf(stderr, "%s: not a little-endian ELF32 file\n", path);
+        return -1;
+    }
+    for (int i = 0; i < eh->e_phnum && g_seg_count < MAX_SEGMENTS; i++)
+    {
+        const Elf32_Phdr *ph = (const Elf32_Phdr *)(g_elf + eh->e_phoff + (size_t)i * eh->e_phentsize);
+        if (ph->p_type != PT_LOAD || ph->p_filesz == 0 || ph->p_offset + ph->p_filesz > (uint32_t)size)
+        {
+            continue;
+        }
+        g_segs[g_seg_count].addr = ph->p_vaddr;
+        g_segs[g_seg_count].size = ph->p_filesz;
+        g_segs[g_seg_count].data = g_elf + ph->p_offset;
+        g_seg_count++;
+    }
+    if (g_seg_count == 0)
+    {
+        fprintf(stderr, "%s: no loadable segments\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief 把固件地址解析为以NUL结尾的字符串，找不到时返回 NULL
+ */
+static const char *ResolveString(uint32_t addr)
+{
+    for (int i = 0; i < g_seg_count; i++)
+    {
+        const Segment *s = &g_segs[i];
+        if (addr >= s->addr && addr - s->addr < s->size)
+        {
+            const char *p = (const char *)s->data + (addr - s->addr);
+            if (memchr(p, '\0', s->size - (addr - s->addr)) == NULL)
+            {
+                return NULL;
+            }
+            return p;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 按固件的格式字符串格式化一条记录
+ * @note  固件参数都是32位: 去掉长度修饰符后以 int 传给 printf，%s 则从ELF中取字符串
+ */
+static void FormatRecord(const char *fmt, const uint32_t *args, uint32_t nargs)
+{
+    uint32_t next = 0;
+
+    while (*fmt)
+    {
+        char spec[32];
+        size_t n = 0;
+        const char *p;
+
+        if (*fmt != '%')
+        {
+            putchar(*fmt++);
+            continue;
+        }
+        if (fmt[1] == '%')
+        {
+            putchar('%');
+            fmt += 2;
+            continue;
+        }
+
+        // 复制标志、宽度、精度，丢弃长度修饰符
+        spec[n++] = *fmt++;
+        for (p = fmt; *p && strchr("-+ #0123456789.", *p) && n < sizeof(spec) - 3; p++)
+        {
+            spec[n++] = *p;
+        }
+        while (*p && strchr("hlLqjzt", *p))
+        {
+            p++;
+        }
+        if (*p == '\0')
+        {
+            break;
+        }
+        spec[n++] = *p;
+        spec[n] = '\0';
+        fmt = p + 1;
+
+        uint32_t v = (next < nargs) ? args[next] : 0;
+        next++;
+        if (*p == 's')
+        {
+            const char *s = ResolveString(v);
+            if (s)
+            {
+                printf(spec, s);
+            }
+            else
+            {
+                printf("<0x%08X>", v);
+            }
+        }
+        else if (*p == 'p')
+        {
+            printf("0x%08X", v);
+        }
+        else if (strchr("diouxXc", *p))
+        {
+            printf(spec, v);
+        }
+        else
+        {
+            printf("<%s?>", spec);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    FILE *in;
+    int c;
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <firmware.elf> [tty|capture]\n", argv[0]);
+        return 1;
+    }
+    if (LoadElf(argv[1]) != 0)
+    {
+        return 1;
+    }
+    in = (argc >= 3) ? fopen(argv[2], "rb") : stdin;
+    if (!in)
+    {
+        perror(argv[2]);
+        return 1;
+    }
+
+    while ((c = fgetc(in)) != EOF)
+    {
+        uint8_t raw[8 + 4 * LOG_MAX_ARGS];
+        uint32_t hdr, fmt_addr, ts, args[LOG_MAX_ARGS], nargs;
+        const char *fmt;
+
+        if (c != LOG_SYNC0)
+        {
+            putchar(c);
+            continue;
+        }
+        c = fgetc(in);
+        if (c != LOG_SYNC1)
+        {
+            if (c == EOF)
+            {
+                break;
+            }
+            ungetc(c, in);
+            continue;
+        }
+        if (fread(raw, 1, 10, in) != 10)
+        {
+            break;
+        }
+        hdr = raw[0] | ((uint32_t)raw[1] << 8);
+        memcpy(&fmt_addr, &raw[2], 4);
+        memcpy(&ts, &raw[6], 4);
+        nargs = hdr & 0xFFU;
+        if (nargs > LOG_MAX_ARGS)
+        {
+            fprintf(stderr, "log_decode: bad record header 0x%04X, resyncing\n", hdr);
+            continue;
+        }
+        if (nargs && fread(args, 4, nargs, in) != nargs)
+        {
+            break;
+        }
+
+        printf("[%6u.%03u] ", ts / 1000U, ts % 1000U);
+        fmt = ResolveString(fmt_addr);
+        if (!fmt)
+        {
+            printf("<unknown format 0x%08X>", fmt_addr);
+            for (uint32_t i = 0; i < nargs; i++)
+            {
+                printf(" 0x%08X", args[i]);
+            }
+        }
+        else if (hdr & LOG_REC_PLAIN)
+        {
+            fputs(fmt, stdout);
+        }
+        else
+        {
+            FormatRecord(fmt, args, nargs);
+        }
+        printf("\r\n");
+        fflush(stdout);
+    }
+
+    if (in != stdin)
+    {
+        fclose(in);
+    }
+    return 0;
+}
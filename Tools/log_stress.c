@@ -0,0 +1,212 @@
+/**
+ ******************************************************************************
+ * @file    log_stress.c
+ * @brief   无锁日志队列的主机多线程压力测试
+ *
+ * @details
+ * 编译: gcc -O2 -Wall -pthread -DHOST_BUILD -I../Inc -o log_stress log_stress.c
+ * (直接包含 ../Src/debug_long.c，HOST_BUILD 下用C11原子操作代替 LDREX/STREX)
+ *
+ * 用法:
+ *   log_stress [producers] [messages-per-producer] [yield-every] [rate] [min-verified-%]
+ *
+ * 多个生产者线程同时调用 Log_Write，一个消费者线程用 Log_Pop 取出并逐条校验:
+ *  - 参数个数与格式指针对应 (2~8个参数各用一个格式字符串)
+ *  - 每个参数都等于由 (线程号, 序号, 参数下标) 算出的值，否则为撕裂记录
+ *  - 同一线程的序号严格递增，否则为重复或乱序
+ *  - 收到的条数 + 各级别丢弃数 == 发送总数
+ *  - 通过上述校验的条数不少于发送总数的 min-verified-% (默认90)
+ * 任一项不符则返回非0。
+ *
+ * 队列满时的丢弃是正常行为，但生产者不限速时几乎全部被丢弃 (单核机器上 8M 条只收到约两千条)，
+ * 上面的校验便形同虚设。因此默认:
+ *  - yield-every = 4: 生产者每发送4条让出一次CPU，消费者空闲时也让出。固件的队列约容纳128条记录，
+ *    16个生产者各发4条后消费者即可运行，CPU核数少于线程数时消费者也能跟上;
+ *  - rate = 1000000: 所有生产者合计每秒最多发送这么多条 (0 不限速)，多核机器上生产者不会远远超过消费者;
+ *  - 队列为固件的 LOG_RING_WORDS，可加 -DLOG_RING_WORDS=65536 等放大。
+ * 要专门测试队列满时的丢弃路径，可用 "log_stress 4 2000000 0 0 0"。
+ ******************************************************************************
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../Src/debug_long.c"
+
+#define MAX_PRODUCERS       16
+
+static const char *const g_formats[LOG_MAX_ARGS + 1] = {
+    "", "",
+    "t=%u s=%u", "t=%u s=%u %u", "t=%u s=%u %u %u", "t=%u s=%u %u %u %u",
+    "t=%u s=%u %u %u %u %u", "t=%u s=%u %u %u %u %u %u", "t=%u s=%u %u %u %u %u %u %u",
+};
+
+static uint32_t g_messages;
+static uint32_t g_yield_every;
+static double g_rate_per_producer;      // 每个生产者每秒的条数, 0 不限速
+static struct timespec g_t0;
+static atomic_int g_producers_done;
+
+static double Elapsed(const struct timespec *t0)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)(t.tv_sec - t0->tv_sec) + (double)(t.tv_nsec - t0->tv_nsec) / 1e9;
+}
+
+static uint32_t Pattern(uint32_t tid, uint32_t seq, uint32_t i)
+{
+    uint32_t x = (tid * 0x9E3779B9U) ^ (seq * 0x85EBCA6BU) ^ (i * 0xC2B2AE35U);
+    return x ^ (x >> 15);
+}
+
+static void *Producer(void *arg)
+{
+    uint32_t tid = (uint32_t)(uintptr_t)arg;
+
+    for (uint32_t seq = 0; seq < g_messages; seq++)
+    {
+        uint32_t n = 2 + seq % (LOG_MAX_ARGS - 1);
+        uint32_t p[LOG_MAX_ARGS];
+        for (uint32_t i = 2; i < n; i++)
+        {
+            p[i] = Pattern(tid, seq, i);
+        }
+        // 参数个数在运行时变化，按 n 展开到 Log_Write
+        switch (n)
+        {
+        case 2: Log_Write(seq & 3U, g_formats[2], 2, tid, seq); break;
+        case 3: Log_Write(seq & 3U, g_formats[3], 3, tid, seq, p[2]); break;
+        case 4: Log_Write(seq & 3U, g_formats[4], 4, tid, seq, p[2], p[3]); break;
+        case 5: Log_Write(seq & 3U, g_formats[5], 5, tid, seq, p[2], p[3], p[4]); break;
+        case 6: Log_Write(seq & 3U, g_formats[6], 6, tid, seq, p[2], p[3], p[4], p[5]); break;
+        case 7: Log_Write(seq & 3U, g_formats[7], 7, tid, seq, p[2], p[3], p[4], p[5], p[6]); break;
+        default: Log_Write(seq & 3U, g_formats[8], 8, tid, seq, p[2], p[3], p[4], p[5], p[6], p[7]); break;
+        }
+        if (g_yield_every && seq % g_yield_every == g_yield_every - 1)
+        {
+            sched_yield();
+        }
+        // 限速: 每64条检查一次，超前于计划时让出CPU
+        while (g_rate_per_producer > 0 && seq % 64 == 63 && Elapsed(&g_t0) < (seq + 1) / g_rate_per_producer)
+        {
+            sched_yield();
+        }
+    }
+    atomic_fetch_add(&g_producers_done, 1);
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t producers = (argc >= 2) ? (uint32_t)atoi(argv[1]) : 4;
+    pthread_t th[MAX_PRODUCERS];
+    int64_t last_seq[MAX_PRODUCERS];
+    uint64_t received = 0, torn = 0, dup = 0, gaps = 0, dropped = 0;
+    double secs;
+    LogRecord rec;
+
+    g_messages = (argc >= 3) ? (uint32_t)strtoul(argv[2], NULL, 0) : 500000;
+    g_yield_every = (argc >= 4) ? (uint32_t)strtoul(argv[3], NULL, 0) : 4;
+    double rate = (argc >= 5) ? atof(argv[4]) : 1000000.0;
+    double min_verified_pct = (argc >= 6) ? atof(argv[5]) : 90.0;
+    if (producers < 1 || producers > MAX_PRODUCERS || g_messages == 0)
+    {
+        fprintf(stderr, "producers must be 1..%d, messages must be > 0\n", MAX_PRODUCERS);
+        return 1;
+    }
+    g_rate_per_producer = rate / producers;
+    for (uint32_t t = 0; t < producers; t++)
+    {
+        last_seq[t] = -1;
+    }
+
+    Log_Init();
+    clock_gettime(CLOCK_MONOTONIC, &g_t0);
+    for (uint32_t t = 0; t < producers; t++)
+    {
+        pthread_create(&th[t], NULL, Producer, (void *)(uintptr_t)t);
+    }
+
+    // 消费者: 在本线程中校验; 生产者全部结束且队列为空时退出
+    for (;;)
+    {
+        if (!Log_Pop(&rec))
+        {
+            // 先读完成标志再试一次: 此时所有记录都已提交，取不到即为空
+            if (atomic_load(&g_producers_done) != (int)producers)
+            {
+                if (g_yield_every)
+                {
+                    sched_yield();
+                }
+                continue;
+            }
+            if (!Log_Pop(&rec))
+            {
+                break;
+            }
+        }
+        received++;
+
+        uint32_t tid = rec.args[0], seq = rec.args[1];
+        int bad = rec.plain || rec.nargs < 2 || rec.nargs > LOG_MAX_ARGS ||
+                  rec.format != g_formats[rec.nargs] || tid >= producers ||
+                  rec.nargs != 2 + seq % (LOG_MAX_ARGS - 1) || rec.level != (seq & 3U);
+        for (uint32_t i = 2; !bad && i < rec.nargs; i++)
+        {
+            bad = (rec.args[i] != Pattern(tid, seq, i));
+        }
+        if (bad)
+        {
+            if (torn++ < 5)
+            {
+                fprintf(stderr, "torn record: nargs=%u tid=%u seq=%u\n", rec.nargs, tid, seq);
+            }
+            continue;
+        }
+        if ((int64_t)seq <= last_seq[tid])
+        {
+            dup++;
+        }
+        else
+        {
+            gaps += (uint64_t)((int64_t)seq - last_seq[tid] - 1);
+            last_seq[tid] = seq;
+        }
+    }
+    secs = Elapsed(&g_t0);
+
+    for (uint32_t t = 0; t < producers; t++)
+    {
+        pthread_join(th[t], NULL);
+        gaps += (uint64_t)(g_messages - 1 - last_seq[t]);
+    }
+    for (uint32_t l = 0; l < LOG_LEVEL_COUNT; l++)
+    {
+        dropped += Log_GetDropped(l);
+    }
+
+    uint64_t sent = (uint64_t)producers * g_messages;
+    uint64_t verified = received - torn - dup;
+    double verified_pct = 100.0 * (double)verified / (double)sent;
+    printf("producers=%u sent=%llu received=%llu dropped=%llu (E=%u W=%u I=%u D=%u)\n",
+           producers, (unsigned long long)sent, (unsigned long long)received,
+           (unsigned long long)dropped, Log_GetDropped(LOG_LEVEL_ERROR), Log_GetDropped(LOG_LEVEL_WARN),
+           Log_GetDropped(LOG_LEVEL_INFO), Log_GetDropped(LOG_LEVEL_DEBUG));
+    printf("torn=%llu duplicated=%llu gaps=%llu  %.2f M msg/s offered, %.2f M msg/s delivered\n",
+           (unsigned long long)torn, (unsigned long long)dup, (unsigned long long)gaps,
+           sent / secs / 1e6, received / secs / 1e6);
+    printf("verified=%llu (%.1f%% of sent, minimum %.1f%%)\n",
+           (unsigned long long)verified, verified_pct, min_verified_pct);
+
+    int ok = (torn == 0 && dup == 0 && gaps == dropped && received + dropped == sent &&
+              verified_pct >= min_verified_pct);
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,664 @@
+/**
+ ******************************************************************************
+ * @file    lwip_bench.c
+ * @brief   发送路径的主机基准: 固件经 LwIP (pbuf_alloc/udp_sendto) 或快速通道发送，数据由本机UDP套接字接收
+ *          (LwIP 为 hostsim 中的 pbuf/udp 模型，不是 Middlewares 下的 lwIP core)
+ *
+ * @details
+ * 编译 (在 Tools/ 下; USE_ETH_FASTPATH=0 时数据面始终走 LwIP 标准路径, =1 时目的MAC解析后
+ * 走 eth_fastpath.c 直接填写发送描述符):
+ *   gcc -O2 -Wall -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast -no-pie -Ihostsim -I../Inc \
+ *       -DUSE_PROFILING=1 -DUSE_ETH_FASTPATH=0 -o lwip_bench lwip_bench.c hostsim/hostsim.c \
+ *       ../Src/adc_processing.c ../Src/ads8688.c ../Src/stm32f4xx_it.c ../Src/stream_ctrl.c \
+ *       ../Src/stream_governor.c ../Src/eth_txring.c ../Src/eth_fastpath.c ../Src/profile.c \
+ *       ../Src/spi.c ../Src/tim.c ../Src/dma.c -lm
+ *   gcc ... -DUSE_PROFILING=1 -DUSE_ETH_FASTPATH=1 -o lwip_bench_fast ...
+ * 净荷大小和描述符环深度是编译时参数 (-DUDP_PAYLOAD_SIZE=1024, -DETH_TXBUFNB=4U,
+ * -DETH_RXBUFNB=8U)，扫描净荷时每个取值编译一次，例如:
+ *   for u in 512 1024 1440; do gcc ... -DUDP_PAYLOAD_SIZE=$u -o lwip_bench_$u ...; \
+ *       ./lwip_bench_$u -m 1600,3200,6400 -p 4,16; done
+ * 扫描发送环深度时同样每个深度编译一次，用 -r 让每个二进制输出一行 (-q 省略表头)，加订阅者
+ * (-s) 和主循环停顿 (-w) 使环深度起作用，-i 关闭发送完成中断对比主循环轮询续发，例如:
+ *   for d in 2 4 8 16 32; do gcc ... -DUSE_STREAM_GOVERNOR=0 -DETH_TXBUFNB=${d}U \
+ *       -DETH_DMA_BUF_BUDGET=65536 -o lwip_bench_tx$d ...; done
+ *   for i in "" -i; do q=; for d in 2 4 8 16 32; do ./lwip_bench_tx$d -r $q -s 3 -w 40:840000 $i; q=-q; done; done
+ * ETH_TXBUFNB 超过9时须同时放大 ETH_DMA_BUF_BUDGET (编译期检查收发缓冲区总大小)。
+ * 调速器只在发送完成中断里得知发送环已排空，-i 时每块都被判为拥塞，因此 -i 的对比用
+ * -DUSE_STREAM_GOVERNOR=0 编译，丢块直接表现为采集端整块丢弃 (blkdrp)。
+ *
+ * 用法:
+ *   lwip_bench [选项]
+ * 选项:
+ *   -t <s>          每个配置的仿真时长 (默认1秒)
+ *   -a <arr>        覆盖TIM2的自动重装值 (默认用 tim.c 的400, 即209.5kHz)
+ *   -m <列表>       MEM_SIZE, 逗号分隔 (默认1600)
+ *   -p <列表>       PBUF_POOL_SIZE, 逗号分隔 (默认16)
+ *   -b <字节>       PBUF_POOL_BUFSIZE (默认592)
+ *   -x <帧/s[:长度]> 背景广播流量, 占用接收描述符和 PBUF_POOL (长度默认590)
+ *   -c <ms>         每隔 ms 从默认PC向控制端口发一个 LIST 请求 (默认0: 不发)
+ *   -l <cyc>        主循环一轮中未仿真部分的开销 (默认200)
+ *   -n <cyc>        一次LwIP发送的协议栈开销 (默认2500)
+ *   -s <n>          另加 n 个全速率带包头订阅者 (192.168.0.101 起, 端口6000; 最多3个)
+ *   -w <ms:cyc>     每隔 ms 主循环停顿 cyc 个周期 (模拟阻塞的Flash写入、日志等; 中断照常)
+ *   -i              关闭发送完成中断 (ETH_DMA_IT_T)，只由主循环续发
+ *   -u <block|dma>  串口控制台模型: 日志记录经 Log_Process 以文本输出到115200波特率的串口，
+ *                   block 为 USE_UART_DMA_CONSOLE 0 的逐字节阻塞发送，dma 为 1 的环形缓冲区 (默认不建模)
+ *   -k <ms:bytes>   每隔 ms 主循环经 printf 输出 bytes 字节 (TELEMETRY_UART_STATUS 的状态块, 如 5000:400; 须 -u)
+ *   -r              单个配置也只输出一行 (用于按深度编译的多个二进制)
+ *   -q              不输出表头
+ *   -v <级别>       打印不高于该级别的固件日志 (只在输出完整报告时有效)
+ *
+ * 每个 MEM_SIZE x PBUF_POOL_SIZE 组合在 fork 出的子进程中从上电开始运行 (固件的静态状态
+ * 无法复位)。主循环与 main.c 相同。线路上发往默认PC (DEST_IP:DEST_PORT) 和订阅者的每个UDP
+ * 数据负载经回环接口发给绑定在 127.0.0.1 上的接收套接字，按仿真时间报告接收端的包/秒和
+ * 字节/秒，即目标板上能达到的速率。重试统计:
+ *   ERR_MEM  pbuf_alloc 失败，SendWaveformDataViaUDP 退出并在下一轮重试 (固件的 pbuf_failures)
+ *   ERR_USE  发送描述符环满，同样下一轮重试 (eth_txring.c 的 ring_full_events)
+ *   refused  low_level_output 因发送环满拒绝的帧 (数据面已预先检查, 通常是控制应答, 不重发)
+ *   ARPrep   目的MAC解析前 etharp 只保留最后一个包，被替换的包丢失
+ * 另外报告堆和池的高水位、分配失败、接收描述符环溢出、控制端口的应答数，以及发送环的
+ * 最大占用 (inflt) 和发送完成中断次数。
+ * 这里没有编译 lwIP core/: pbuf_alloc、udp_sendto、etharp 和 mem_malloc 都是 hostsim.c 中按
+ * lwIP 2.1 语义手写的模型 (PBUF_RAM 按 mem.c 首次适配、struct pbuf/块头尺寸取32位目标的值,
+ * PBUF_POOL 只计数)。因此堆和池的高水位与失败次数是该模型给出的估计，报告中标为 "model"，
+ * 选定的 MEM_SIZE/PBUF_POOL_SIZE 须在目标板上核对 (lwIP 的 MEM_STATS/MEMP_STATS)。
+ * 发送路径的开销取自固件的 PROF_SEND_UDP 统计 (DWT->CYCCNT 即虚拟时间): 总周期数除以
+ * 发出的包数得到每包周期数 (与目标板上的 USE_PROFILING 报告一样包含抢占它的TIM2/DMA中断和
+ * 发送环满时的空转调用)，168MHz 除以它为只做发送时的包速率上限。
+ * 注意虚拟时间只由 HostSim_Costs 中的固定开销推进: LwIP 路径每次发送记 lwip_send 周期
+ * (默认2500, -n 设置)，快速通道记 fast_send 加按长度的 copy_per_kb。两条路径每包周期数之差
+ * 直接来自这些模型输入，不是测得的加速比; 实际开销须在目标板上用 USE_PROFILING 测量。
+ * 报告和表头都会打印所用的开销输入。
+ * 完整报告还给出主循环单轮耗时直方图 (与遥测的 loop_hist 相同的2的幂微秒分格; HostSim_Idle
+ * 整段跳过的空转轮不计入)，用 -u block 和 -u dma 各运行一次即为 USE_UART_DMA_CONSOLE 改动前后的
+ * 主机仿真对照，例如:
+ *   for u in block dma; do ./lwip_bench -t 20 -u $u -k 5000:400; done
+ * 只有一个配置时打印完整报告，多个配置时每个配置一行。
+ ******************************************************************************
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hostsim.h"
+#include "main.h"
+#include "adc_processing.h"
+#include "debug_log.h"
+#include "dma.h"
+#include "eth_txring.h"
+#include "profile.h"
+#include "spi.h"
+#include "stream_ctrl.h"
+#include "stream_governor.h"
+#include "stream_proto.h"
+#include "tim.h"
+#include "uart_console.h"
+
+#define MAX_LIST            16
+#define CTRL_SRC_PORT       6001    // 控制请求的源端口 (默认PC)
+#define SUB_IP3             101     // 第一个订阅者 192.168.0.101:SUB_PORT
+#define SUB_PORT            6000
+#define MAX_SUBS            (STREAM_MAX_SUBSCRIBERS - 1)    // 表项0是默认PC
+#define RX_SOCKET_BUF       (4 * 1024 * 1024)
+
+#if USE_ETH_FASTPATH
+#define SEND_PATH           "fast path"
+#else
+#define SEND_PATH           "lwIP"
+#endif
+
+extern StreamGov g_stream_gov;      // adc_processing.c
+extern ETH_HandleTypeDef heth;      // hostsim.c (固件中在 ethernetif.c)
+
+// 一个配置的结果 (子进程经管道交给父进程)
+typedef struct {
+    uint32_t mem_size;
+    uint16_t pool_size;
+    double   sim_s;
+    double   host_s;
+    uint64_t rx_packets;            // 接收套接字收到的
+    uint64_t rx_bytes;
+    uint64_t loop_errors;           // 回环 sendto 失败
+    uint64_t wire_packets;          // 线路上发往默认PC和订阅者的数据包
+    uint32_t sent;                  // 固件计数的已发送包 (g_udp_packets_sent_count)
+    uint32_t pbuf_failures;
+    uint32_t ring_full;             // 发送前发现发送环满 (ERR_USE, 下一轮重试)
+    uint32_t send_errors;
+    uint32_t blocks_acquired;
+    uint32_t blocks_dropped;
+    uint32_t tim2_skips;
+    uint8_t  gov_level;
+    uint32_t tx_complete_irqs;
+    uint8_t  max_in_flight;         // 发送环的最大占用
+    uint32_t stalls;                // 主循环停顿次数 (-w)
+    uint32_t send_calls;            // SendWaveformDataViaUDP 的调用次数 (PROF_SEND_UDP)
+    uint64_t send_cycles;           // 其总周期数
+    uint64_t ctrl_requests;
+    uint64_t ctrl_replies;
+    HostSim_Stats st;
+    uint32_t heap_used_end;
+    uint16_t pool_used_end;
+    uint32_t loop_hist[STREAM_TELEM_LOOP_BINS];    // 主循环单轮耗时 (us) 直方图, 分格同 Telemetry_LoopTick
+    uint32_t loop_max_us;
+} BenchResult;
+
+static struct {
+    int tx_fd;                      // 模拟的线路 -> 回环
+    int rx_fd;                      // PC端接收套接字
+    struct sockaddr_in rx_addr;
+    uint8_t buf[2048];
+} g_loop;
+
+// 附加负载 (-s/-w/-i/-u/-k)
+static struct {
+    int      subscribers;
+    double   stall_ms;
+    uint32_t stall_cycles;
+    int      no_tx_complete;
+    HostSim_ConsoleMode console;
+    double   status_ms;
+    uint32_t status_bytes;
+} g_load;
+
+static BenchResult g_res;
+
+/**
+ * @brief 线路上发完的每个帧: 默认PC和订阅者的数据经回环交给接收套接字，控制应答只计数
+ */
+static void Sink(uint16_t ethertype, const ip4_addr_t *dst, uint16_t dst_port, const uint8_t *payload, uint16_t len)
+{
+    ssize_t n;
+
+    if (ethertype != 0x0800 || dst == NULL)
+    {
+        return;
+    }
+    if (dst_port == SUB_PORT && ip4_addr4(dst) >= SUB_IP3 && ip4_addr4(dst) < SUB_IP3 + g_load.subscribers)
+    {
+        if (len == sizeof(StreamCtrlReply) && payload[0] == (STREAM_CMD_SUBSCRIBE | STREAM_CMD_REPLY))
+        {
+            g_res.ctrl_replies++;
+            return;
+        }
+    }
+    else if (ip4_addr4(dst) != DEST_IP_ADDR3)
+    {
+        return;
+    }
+    else if (dst_port == CTRL_SRC_PORT)
+    {
+        g_res.ctrl_replies++;
+        return;
+    }
+    else if (dst_port != DEST_PORT)
+    {
+        return;
+    }
+    g_res.wire_packets++;
+    if (sendto(g_loop.tx_fd, payload, len, 0, (const struct sockaddr *)&g_loop.rx_addr, sizeof(g_loop.rx_addr)) < 0)
+    {
+        g_res.loop_errors++;
+    }
+    // 回环发送在 sendto 返回前已放进接收队列, 就地取走
+    while ((n = recv(g_loop.rx_fd, g_loop.buf, sizeof(g_loop.buf), MSG_DONTWAIT)) > 0)
+    {
+        g_res.rx_packets++;
+        g_res.rx_bytes += (uint64_t)n;
+    }
+}
+
+static int OpenLoopback(void)
+{
+    socklen_t alen = sizeof(g_loop.rx_addr);
+    int size = RX_SOCKET_BUF;
+
+    g_loop.rx_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    g_loop.tx_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (g_loop.rx_fd < 0 || g_loop.tx_fd < 0)
+    {
+        perror("socket");
+        return 0;
+    }
+    setsockopt(g_loop.rx_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    memset(&g_loop.rx_addr, 0, sizeof(g_loop.rx_addr));
+    g_loop.rx_addr.sin_family = AF_INET;
+    g_loop.rx_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    g_loop.rx_addr.sin_port = 0;
+    if (bind(g_loop.rx_fd, (struct sockaddr *)&g_loop.rx_addr, sizeof(g_loop.rx_addr)) < 0 ||
+        getsockname(g_loop.rx_fd, (struct sockaddr *)&g_loop.rx_addr, &alen) < 0)
+    {
+        perror("bind");
+        return 0;
+    }
+    return 1;
+}
+
+static void SendList(void)
+{
+    StreamCtrlRequest req;
+    ip4_addr_t src;
+
+    memset(&req, 0, sizeof(req));
+    req.cmd = STREAM_CMD_LIST;
+    IP4_ADDR(&src, DEST_IP_ADDR0, DEST_IP_ADDR1, DEST_IP_ADDR2, DEST_IP_ADDR3);
+    HostSim_Inject(&src, CTRL_SRC_PORT, STREAM_CTRL_PORT, &req, sizeof(req));
+    g_res.ctrl_requests++;
+}
+
+/**
+ * @brief 订阅者 i 请求全部通道的全速率带包头流 (目的地址为0: 发往请求的源地址)
+ */
+static void Subscribe(int i)
+{
+    StreamCtrlRequest req;
+    ip4_addr_t src;
+
+    memset(&req, 0, sizeof(req));
+    req.cmd = STREAM_CMD_SUBSCRIBE;
+    req.channel_mask = (uint8_t)((1U << CHANNELS_PER_SAMPLE) - 1U);
+    req.decimation = 1;
+    IP4_ADDR(&src, DEST_IP_ADDR0, DEST_IP_ADDR1, DEST_IP_ADDR2, SUB_IP3 + i);
+    HostSim_Inject(&src, SUB_PORT, STREAM_CTRL_PORT, &req, sizeof(req));
+    g_res.ctrl_requests++;
+}
+
+static double HostSeconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief 记录一轮主循环的耗时 (与 Telemetry_LoopTick 相同的分格)
+ */
+static void RecordPass(uint64_t cycles)
+{
+    uint32_t us = (uint32_t)(cycles / (HOSTSIM_CPU_HZ / 1000000U));
+    uint32_t bin = 0;
+
+    while ((us >> (bin + 1)) != 0 && bin < STREAM_TELEM_LOOP_BINS - 1)
+    {
+        bin++;
+    }
+    g_res.loop_hist[bin]++;
+    if (us > g_res.loop_max_us)
+    {
+        g_res.loop_max_us = us;
+    }
+}
+
+/**
+ * @brief 在子进程中从上电开始运行一个配置
+ */
+static void RunOne(double seconds, long arr, uint32_t loop_other, double ctrl_ms, double bg_fps, uint16_t bg_len,
+                   int log_level)
+{
+    uint64_t end, next_ctrl, ctrl_period, next_stall, stall_period, next_status, status_period;
+    StreamProfile prof;
+    double t0;
+    int i;
+
+    HostSim_Init();
+    HostSim_SetSink(Sink);
+    HostSim_SetLogLevel(log_level);
+    if (!OpenLoopback())
+    {
+        exit(2);
+    }
+
+    // main.c 的初始化顺序
+    NVIC_SetPriority(SysTick_IRQn, 15);
+    MX_LWIP_Init();
+    MX_DMA_Init();
+    MX_SPI1_Init();
+    MX_TIM2_Init();
+    if (arr > 0)
+    {
+        LL_TIM_SetAutoReload(TIM2, (uint32_t)arr);
+    }
+    ADC_Processing_Init();
+    for (i = 0; i < g_load.subscribers; i++)
+    {
+        Subscribe(i);
+    }
+    if (g_load.no_tx_complete)
+    {
+        __HAL_ETH_DMA_DISABLE_IT(&heth, ETH_DMA_IT_T);
+    }
+    HostSim_ResetStats();
+    HostSim_SetConsole(g_load.console);
+    HostSim_SetRxLoad(bg_fps, bg_len);
+    Profile_Init();
+    ADC_Processing_Start();
+
+    ctrl_period = (uint64_t)(ctrl_ms * (HOSTSIM_CPU_HZ / 1000.0));
+    next_ctrl = HostSim_Now() + ctrl_period;
+    stall_period = (uint64_t)(g_load.stall_ms * (HOSTSIM_CPU_HZ / 1000.0));
+    next_stall = HostSim_Now() + stall_period;
+    status_period = (uint64_t)(g_load.status_ms * (HOSTSIM_CPU_HZ / 1000.0));
+    next_status = HostSim_Now() + status_period;
+    end = HostSim_Now() + (uint64_t)(seconds * HOSTSIM_CPU_HZ);
+    t0 = HostSeconds();
+    while (HostSim_Now() < end)
+    {
+        uint64_t pass_start = HostSim_Now();
+
+        if (ctrl_period != 0 && pass_start >= next_ctrl)
+        {
+            SendList();
+            next_ctrl += ctrl_period;
+        }
+        if (stall_period != 0 && pass_start >= next_stall)
+        {
+            HostSim_Spend(g_load.stall_cycles);
+            next_stall += stall_period;
+            g_res.stalls++;
+        }
+        HostSim_Spend(loop_other);
+        ETH_TX_LOCK();
+        MX_LWIP_Process();
+        ETH_TX_UNLOCK();
+        ADC_Processing_Task();
+        if (status_period != 0 && pass_start >= next_status)
+        {
+            HostSim_ConsoleWrite(g_load.status_bytes);
+            next_status += status_period;
+        }
+        HostSim_LogProcess();
+        RecordPass(HostSim_Now() - pass_start);
+        if (!ADC_Processing_Pending() && !HostSim_LogPending())
+        {
+            HostSim_Idle((uint32_t)(HostSim_Now() - pass_start));
+        }
+    }
+
+    g_res.sim_s = (double)HostSim_Now() / HOSTSIM_CPU_HZ;
+    g_res.host_s = HostSeconds() - t0;
+    g_res.sent = g_udp_packets_sent_count;
+    g_res.pbuf_failures = g_adc_stats.pbuf_failures;
+    g_res.ring_full = g_eth_tx_stats.ring_full_events;
+    g_res.send_errors = g_adc_stats.send_errors;
+    g_res.blocks_acquired = g_adc_stats.blocks_acquired;
+    g_res.blocks_dropped = g_stream_gov.blocks_dropped;
+    g_res.tim2_skips = g_adc_stats.tim2_skips;
+    g_res.gov_level = g_stream_gov.level;
+    g_res.tx_complete_irqs = g_eth_tx_stats.tx_complete_irqs;
+    g_res.max_in_flight = g_eth_tx_stats.max_in_flight;
+    g_res.st = g_hostsim_stats;
+    g_res.heap_used_end = HostSim_HeapUsed();
+    g_res.pool_used_end = HostSim_PoolUsed();
+    Profile_Snapshot(&prof);
+    g_res.send_calls = prof.region[PROF_SEND_UDP].count;
+    g_res.send_cycles = prof.region[PROF_SEND_UDP].total_cycles;
+}
+
+/**
+ * @brief 每个发出的包在发送路径上的平均周期数
+ */
+static double CyclesPerPacket(const BenchResult *r)
+{
+    return (r->sent != 0) ? (double)r->send_cycles / r->sent : 0.0;
+}
+
+static void PrintReport(const BenchResult *r)
+{
+    const HostSim_Stats *st = &r->st;
+    int i;
+
+    printf("MEM_SIZE %u, PBUF_POOL_SIZE %u x %u, ETH_TXBUFNB %u, ETH_RXBUFNB %u, UDP_PAYLOAD_SIZE %u\n",
+           (unsigned)r->mem_size, (unsigned)r->pool_size, (unsigned)g_hostsim_lwip.pbuf_pool_bufsize,
+           (unsigned)ETH_TXBUFNB, (unsigned)ETH_RXBUFNB, (unsigned)UDP_PAYLOAD_SIZE);
+    printf("sim %.3f s in %.3f s host (%.0fx realtime)\n", r->sim_s, r->host_s, r->sim_s / r->host_s);
+    printf("receiver: %llu packets, %llu bytes, %.0f pkt/s, %.3f MB/s (%.0f pkt/s host), loopback errors %llu\n",
+           (unsigned long long)r->rx_packets, (unsigned long long)r->rx_bytes,
+           (double)r->rx_packets / r->sim_s, (double)r->rx_bytes / r->sim_s / 1e6,
+           (double)r->rx_packets / r->host_s, (unsigned long long)r->loop_errors);
+    printf("firmware: %u packets sent, %llu on the wire, %u blocks acquired, %u dropped, %u TIM2 skips, "
+           "governor level %u\n",
+           (unsigned)r->sent, (unsigned long long)r->wire_packets, (unsigned)r->blocks_acquired,
+           (unsigned)r->blocks_dropped, (unsigned)r->tim2_skips, (unsigned)r->gov_level);
+    printf("send path: %s, %u calls (mean %.0f cycles), %.0f cycles/packet (%.2f%% CPU), ceiling %.0f pkt/s\n",
+           SEND_PATH, (unsigned)r->send_calls,
+           (r->send_calls != 0) ? (double)r->send_cycles / r->send_calls : 0.0, CyclesPerPacket(r),
+           100.0 * (double)r->send_cycles / (r->sim_s * HOSTSIM_CPU_HZ),
+           (CyclesPerPacket(r) > 0.0) ? HOSTSIM_CPU_HZ / CyclesPerPacket(r) : 0.0);
+    printf("send cost: hostsim model inputs lwip_send %u, fast_send %u + %u/KB copy cycles; "
+           "cycles/packet follows from them, not measured\n",
+           (unsigned)g_hostsim_costs.lwip_send, (unsigned)g_hostsim_costs.fast_send,
+           (unsigned)g_hostsim_costs.copy_per_kb);
+    printf("retries: ERR_MEM (pbuf) %u, ERR_USE (Tx ring full) %u; send errors %u; "
+           "frames refused by low_level_output %llu; ARP held %llu, replaced %llu\n",
+           (unsigned)r->pbuf_failures, (unsigned)r->ring_full, (unsigned)r->send_errors,
+           (unsigned long long)st->eth_ring_full, (unsigned long long)st->arp_queued,
+           (unsigned long long)st->arp_queue_drops);
+    printf("heap (hostsim model): peak %u/%u, %llu allocation failures, %u in use at end\n",
+           (unsigned)st->heap_peak, (unsigned)r->mem_size, (unsigned long long)st->heap_errors,
+           (unsigned)r->heap_used_end);
+    printf("pbuf pool (hostsim model): min free %u/%u, %llu allocation failures, %u in use at end\n",
+           (unsigned)st->pool_min_free, (unsigned)r->pool_size, (unsigned long long)st->pool_errors,
+           (unsigned)r->pool_used_end);
+    printf("rx: %llu frames to the stack, %llu lost to a full Rx ring; control %llu requests, %llu replies\n",
+           (unsigned long long)st->rx_frames, (unsigned long long)st->rx_ring_drops,
+           (unsigned long long)r->ctrl_requests, (unsigned long long)r->ctrl_replies);
+    printf("ethernet: %llu frames, %.1f%% wire busy; Tx ring max %u/%u in flight, %u Tx complete interrupts%s\n",
+           (unsigned long long)st->wire_frames, 100.0 * (double)st->wire_busy / (r->sim_s * HOSTSIM_CPU_HZ),
+           (unsigned)r->max_in_flight, (unsigned)ETH_TXBUFNB, (unsigned)r->tx_complete_irqs,
+           g_load.no_tx_complete ? " (disabled)" : "");
+    printf("load: %d subscriber(s), %u main loop stalls of %u cycles\n",
+           g_load.subscribers, (unsigned)r->stalls, (unsigned)g_load.stall_cycles);
+    printf("loop: max %u us, passes by length (us:count)", (unsigned)r->loop_max_us);
+    for (i = 0; i < STREAM_TELEM_LOOP_BINS; i++)
+    {
+        if (r->loop_hist[i] != 0)
+        {
+            printf(" %lu:%u", 1UL << i, (unsigned)r->loop_hist[i]);
+        }
+    }
+    printf("\n");
+    if (g_load.console != HOSTSIM_CONSOLE_OFF)
+    {
+        printf("console: %s, %llu bytes, %llu dropped, ring max %u/%u; log %llu records, %llu dropped\n",
+               (g_load.console == HOSTSIM_CONSOLE_DMA) ? "DMA ring" : "blocking",
+               (unsigned long long)st->console_bytes, (unsigned long long)st->console_dropped,
+               (unsigned)st->console_max_used, (unsigned)UART_CONSOLE_BUF_SIZE,
+               (unsigned long long)st->log_records, (unsigned long long)st->log_dropped);
+    }
+}
+
+static void PrintHeader(void)
+{
+    printf("%s, UDP_PAYLOAD_SIZE %u, ETH_RXBUFNB %u, PBUF_POOL_BUFSIZE %u, %d subscriber(s), "
+           "Tx complete interrupt %s\n",
+           SEND_PATH, (unsigned)UDP_PAYLOAD_SIZE, (unsigned)ETH_RXBUFNB,
+           (unsigned)g_hostsim_lwip.pbuf_pool_bufsize, g_load.subscribers, g_load.no_tx_complete ? "off" : "on");
+    printf("cyc/pkt from hostsim model inputs (lwip_send %u, fast_send %u + %u/KB copy cycles), not measured; "
+           "heap/pool columns from hostsim's pbuf/udp model, not lwIP core\n",
+           (unsigned)g_hostsim_costs.lwip_send, (unsigned)g_hostsim_costs.fast_send,
+           (unsigned)g_hostsim_costs.copy_per_kb);
+    printf("%5s %8s %5s %9s %7s %7s %8s %8s %8s %6s %6s %6s %10s %6s %8s %6s %6s %4s %5s %7s\n",
+           "txbuf", "MEM_SIZE", "pool", "pkt/s", "MB/s", "cyc/pkt", "ERR_MEM", "ERR_USE", "refused", "ARPrep",
+           "blkdrp", "skips", "heap_peak", "heaperr", "pool_min", "poolerr", "rxdrop", "gov", "inflt", "ctrl");
+}
+
+static void PrintRow(const BenchResult *r)
+{
+    const HostSim_Stats *st = &r->st;
+
+    printf("%5u %8u %5u %9.0f %7.3f %7.0f %8u %8u %8llu %6llu %6u %6u %10u %6llu %8u %6llu %6llu %4u %5u %3llu/%-3llu\n",
+           (unsigned)ETH_TXBUFNB, (unsigned)r->mem_size, (unsigned)r->pool_size,
+           (double)r->rx_packets / r->sim_s, (double)r->rx_bytes / r->sim_s / 1e6, CyclesPerPacket(r),
+           (unsigned)r->pbuf_failures, (unsigned)r->ring_full, (unsigned long long)st->eth_ring_full,
+           (unsigned long long)st->arp_queue_drops, (unsigned)r->blocks_dropped, (unsigned)r->tim2_skips,
+           (unsigned)st->heap_peak, (unsigned long long)st->heap_errors,
+           (unsigned)st->pool_min_free, (unsigned long long)st->pool_errors,
+           (unsigned long long)st->rx_ring_drops, (unsigned)r->gov_level, (unsigned)r->max_in_flight,
+           (unsigned long long)r->ctrl_replies, (unsigned long long)r->ctrl_requests);
+}
+
+static int ParseList(const char *s, uint32_t *out, int max)
+{
+    int n = 0;
+
+    while (*s != '\0' && n < max)
+    {
+        char *end;
+        unsigned long v = strtoul(s, &end, 0);
+
+        if (end == s || v == 0)
+        {
+            return 0;
+        }
+        out[n++] = (uint32_t)v;
+        s = (*end == ',') ? end + 1 : end;
+    }
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t mem_sizes[MAX_LIST] = { 1600 };
+    uint32_t pool_sizes[MAX_LIST] = { 16 };
+    int n_mem = 1, n_pool = 1;
+    double seconds = 1.0;
+    long arr = -1;
+    uint32_t loop_other = 200;
+    double ctrl_ms = 0.0;
+    double bg_fps = 0.0;
+    unsigned bg_len = 590;
+    int log_level = -1;
+    int rows = 0, header = 1;
+    int fail = 0;
+    int opt;
+    int i, j;
+
+    while ((opt = getopt(argc, argv, "t:a:m:p:b:x:c:l:n:s:w:iu:k:rqv:")) != -1)
+    {
+        switch (opt)
+        {
+        case 't': seconds = atof(optarg); break;
+        case 'a': arr = atol(optarg); break;
+        case 'm': n_mem = ParseList(optarg, mem_sizes, MAX_LIST); break;
+        case 'p': n_pool = ParseList(optarg, pool_sizes, MAX_LIST); break;
+        case 'b': g_hostsim_lwip.pbuf_pool_bufsize = (uint16_t)atoi(optarg); break;
+        case 'x':
+            if (sscanf(optarg, "%lf:%u", &bg_fps, &bg_len) < 1)
+            {
+                fprintf(stderr, "bad load: %s (frames_per_s[:len])\n", optarg);
+                return 2;
+            }
+            break;
+        case 'c': ctrl_ms = atof(optarg); break;
+        case 'l': loop_other = (uint32_t)atol(optarg); break;
+        case 'n': g_hostsim_costs.lwip_send = (uint32_t)atol(optarg); break;
+        case 's': g_load.subscribers = atoi(optarg); break;
+        case 'w':
+            if (sscanf(optarg, "%lf:%u", &g_load.stall_ms, &g_load.stall_cycles) != 2)
+            {
+                fprintf(stderr, "bad stall: %s (ms:cycles)\n", optarg);
+                return 2;
+            }
+            break;
+        case 'i': g_load.no_tx_complete = 1; break;
+        case 'u':
+            g_load.console = (strcmp(optarg, "block") == 0) ? HOSTSIM_CONSOLE_BLOCKING :
+                             (strcmp(optarg, "dma") == 0) ? HOSTSIM_CONSOLE_DMA : HOSTSIM_CONSOLE_OFF;
+            if (g_load.console == HOSTSIM_CONSOLE_OFF)
+            {
+                fprintf(stderr, "bad console: %s (block|dma)\n", optarg);
+                return 2;
+            }
+            break;
+        case 'k':
+            if (sscanf(optarg, "%lf:%u", &g_load.status_ms, &g_load.status_bytes) != 2)
+            {
+                fprintf(stderr, "bad status: %s (ms:bytes)\n", optarg);
+                return 2;
+            }
+            break;
+        case 'r': rows = 1; break;
+        case 'q': header = 0; break;
+        case 'v': log_level = atoi(optarg); break;
+        default:
+            n_mem = 0;
+            break;
+        }
+    }
+    if (n_mem == 0 || n_pool == 0 || g_hostsim_lwip.pbuf_pool_bufsize == 0 ||
+        g_load.subscribers < 0 || g_load.subscribers > MAX_SUBS)
+    {
+        fprintf(stderr, "usage: %s [-t s] [-a arr] [-m mem_size,...] [-p pool_size,...] [-b pool_bufsize] "
+                        "[-x fps[:len]] [-c ms] [-l cyc] [-n cyc] [-s subscribers] [-w ms:cyc] [-i] "
+                        "[-u block|dma] [-k ms:bytes] [-r] [-q] [-v level]\n", argv[0]);
+        return 2;
+    }
+
+    if (n_mem * n_pool > 1)
+    {
+        rows = 1;
+    }
+    if (rows && header)
+    {
+        PrintHeader();
+    }
+    for (i = 0; i < n_mem; i++)
+    {
+        for (j = 0; j < n_pool; j++)
+        {
+            BenchResult r;
+            int fds[2];
+            pid_t pid;
+            int status;
+
+            fflush(stdout);
+            if (pipe(fds) < 0 || (pid = fork()) < 0)
+            {
+                perror("fork");
+                return 2;
+            }
+            if (pid == 0)
+            {
+                close(fds[0]);
+                g_hostsim_lwip.mem_size = mem_sizes[i];
+                g_hostsim_lwip.pbuf_pool_size = (uint16_t)pool_sizes[j];
+                memset(&g_res, 0, sizeof(g_res));
+                g_res.mem_size = mem_sizes[i];
+                g_res.pool_size = (uint16_t)pool_sizes[j];
+                RunOne(seconds, arr, loop_other, ctrl_ms, bg_fps, (uint16_t)bg_len,
+                       rows ? -1 : log_level);
+                if (write(fds[1], &g_res, sizeof(g_res)) != (ssize_t)sizeof(g_res))
+                {
+                    _exit(2);
+                }
+                _exit(0);
+            }
+            close(fds[1]);
+            if (read(fds[0], &r, sizeof(r)) != (ssize_t)sizeof(r))
+            {
+                fprintf(stderr, "MEM_SIZE %u, PBUF_POOL_SIZE %u: run failed\n",
+                        (unsigned)mem_sizes[i], (unsigned)pool_sizes[j]);
+                fail = 1;
+            }
+            else if (rows)
+            {
+                PrintRow(&r);
+            }
+            else
+            {
+                PrintReport(&r);
+            }
+            close(fds[0]);
+            waitpid(pid, &status, 0);
+        }
+    }
+    return fail;
+}
@@ -0,0 +1,488 @@
+/**
+ ******************************************************************************
+ * @file    map_report.c
+ * @brief   链接map分析: 各存储区域的用量、最大的RAM对象，以及与遥测内存高水位的对照
+ *
+ * @details
+ * 编译: gcc -O2 -Wall -I../Inc -o map_report map_report.c
+ *
+ * 用法:
+ *   map_report [-n N] <firmware.map> [board-ip]
+ *
+ * 解析 GNU ld 生成的map文件 (-Wl,-Map=firmware.map):
+ * - "Memory Configuration" 中的区域 (FLASH/RAM/CCMRAM)，按地址把各输出段的大小计入所在区域;
+ *   带 load address 的段 (.data 等) 同时计入装载地址所在的区域。
+ * - 位于RAM区域中最大的 N 个输入段 (默认15)，编译时使用 -fdata-sections 则每个对象单独成段。
+ *
+ * 给出 board-ip 时向板子的遥测端口发一个 StreamTelemRegister (须从默认PC运行，或固件放开
+ * TELEMETRY_REG_POLICY)，等待一个 StreamTelemetry (版本3起带内存高水位)，
+ * 把主栈、LwIP堆、PBUF池、日志环和乒乓缓冲的峰值与map中为它们保留的大小对照，给出余量。
+ * 各对象按段名查找: LwIP堆 .bss.ram_heap, PBUF池 .bss.memp_memory_PBUF_POOL_base,
+ * 日志环 .bss.log_queue, 乒乓缓冲为 adc_processing.o 的 .ccmram 段。
+ ******************************************************************************
+ */
+
+#include <arpa/inet.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stream_proto.h"
+
+#define MAX_REGIONS         8
+#define MAX_OUT_SECTIONS    64
+#define MAX_IN_SECTIONS     8192
+#define MAX_SYMBOLS         256
+#define WAIT_TELEMETRY_S    10
+
+typedef struct {
+    char     name[128];
+    uint64_t origin, length, used;
+} Region;
+
+typedef struct {
+    char     name[128];
+    uint64_t addr, size, lma;   // lma 为0表示没有单独的装载地址
+} OutSection;
+
+typedef struct {
+    char     name[128];
+    char     obj[128];
+    uint64_t addr, size;
+} InSection;
+
+typedef struct {
+    char     name[128];
+    uint64_t value;
+} Symbol;
+
+static Region     g_regions[MAX_REGIONS];
+static int        g_n_regions;
+static OutSection g_out[MAX_OUT_SECTIONS];
+static int        g_n_out;
+static InSection  g_in[MAX_IN_SECTIONS];
+static int        g_n_in;
+static Symbol     g_syms[MAX_SYMBOLS];
+static int        g_n_syms;
+
+static int IsHex(const char *s)
+{
+    return s[0] == '0' && s[1] == 'x';
+}
+
+static Region *FindRegion(uint64_t addr)
+{
+    for (int i = 0; i < g_n_regions; i++)
+    {
+        if (addr >= g_regions[i].origin && addr < g_regions[i].origin + g_regions[i].length)
+        {
+            return &g_regions[i];
+        }
+    }
+    return NULL;
+}
+
+static int IsRam(const Region *r)
+{
+    return r && strstr(r->name, "FLASH") == NULL;
+}
+
+/**
+ * @brief 解析map文件
+ * @details 段名过长时 ld 把地址和大小写在下一行; 输出段从第0列开始，输入段从第1列开始
+ */
+static int ParseMap(FILE *f)
+{
+    enum { SKIP, MEMORY, LAYOUT } state = SKIP;
+    char line[1024];
+    char pending[128] = "";
+    int  pending_out = 0;
+
+    while (fgets(line, sizeof(line), f))
+    {
+        char tok[6][128];
+        int  n;
+
+        line[strcspn(line, "\r\n")] = '\0';
+        if (strncmp(line, "Memory Configuration", 20) == 0)
+        {
+            state = MEMORY;
+            continue;
+        }
+        if (strncmp(line, "Linker script and memory map", 28) == 0)
+        {
+            state = LAYOUT;
+            continue;
+        }
+        n = sscanf(line, "%127s %127s %127s %127s %127s %127s", tok[0], tok[1], tok[2], tok[3], tok[4], tok[5]);
+        if (state == MEMORY)
+        {
+            if (n >= 3 && IsHex(tok[1]) && IsHex(tok[2]) && tok[0][0] != '*' && g_n_regions < MAX_REGIONS)
+            {
+                Region *r = &g_regions[g_n_regions++];
+                snprintf(r->name, sizeof(r->name), "%s", tok[0]);
+                r->origin = strtoull(tok[1], NULL, 16);
+                r->length = strtoull(tok[2], NULL, 16);
+            }
+            continue;
+        }
+        if (state != LAYOUT || n <= 0)
+        {
+            continue;
+        }
+
+        // 符号赋值: "  0x... name = expr"
+        if (n >= 3 && IsHex(tok[0]) && strcmp(tok[2], "=") == 0)
+        {
+            if (g_n_syms < MAX_SYMBOLS)
+            {
+                snprintf(g_syms[g_n_syms].name, sizeof(g_syms[0].name), "%s", tok[1]);
+                g_syms[g_n_syms].value = strtoull(tok[0], NULL, 16);
+                g_n_syms++;
+            }
+            continue;
+        }
+
+        // 段名独占一行
+        if (n == 1 && line[0] != ' ' && tok[0][0] == '.')
+        {
+            snprintf(pending, sizeof(pending), "%s", tok[0]);
+            pending_out = 1;
+            continue;
+        }
+        if (n == 1 && line[0] == ' ' && line[1] != ' ' && (tok[0][0] == '.' || strcmp(tok[0], "COMMON") == 0))
+        {
+            snprintf(pending, sizeof(pending), "%s", tok[0]);
+            pending_out = 0;
+            continue;
+        }
+
+        {
+            const char *name;
+            int is_out, first;
+
+            if (line[0] != ' ' && tok[0][0] == '.' && n >= 3 && IsHex(tok[1]))
+            {
+                name = tok[0];
+                is_out = 1;
+                first = 1;
+            }
+            else if (line[0] == ' ' && line[1] != ' ' && n >= 3 && IsHex(tok[1]) &&
+                     (tok[0][0] == '.' || strcmp(tok[0], "COMMON") == 0))
+            {
+                name = tok[0];
+                is_out = 0;
+                first = 1;
+            }
+            else if (pending[0] && n >= 2 && IsHex(tok[0]) && IsHex(tok[1]))
+            {
+                name = pending;
+                is_out = pending_out;
+                first = 0;
+            }
+            else
+            {
+                pending[0] = '\0';
+                continue;
+            }
+
+            if (is_out && g_n_out < MAX_OUT_SECTIONS)
+            {
+                OutSection *o = &g_out[g_n_out++];
+                snprintf(o->name, sizeof(o->name), "%s", name);
+                o->addr = strtoull(tok[first], NULL, 16);
+                o->size = strtoull(tok[first + 1], NULL, 16);
+                o->lma = 0;
+                if (n >= first + 5 && strcmp(tok[first + 2], "load") == 0 && IsHex(tok[first + 4]))
+                {
+                    o->lma = strtoull(tok[first + 4], NULL, 16);
+                }
+            }
+            else if (!is_out && n >= first + 3 && g_n_in < MAX_IN_SECTIONS)
+            {
+                InSection *s = &g_in[g_n_in++];
+                snprintf(s->name, sizeof(s->name), "%s", name);
+                snprintf(s->obj, sizeof(s->obj), "%s", tok[first + 2]);
+                s->addr = strtoull(tok[first], NULL, 16);
+                s->size = strtoull(tok[first + 1], NULL, 16);
+            }
+            pending[0] = '\0';
+        }
+    }
+    return g_n_regions > 0 ? 0 : -1;
+}
+
+static int FindSymbol(const char *name, uint64_t *value)
+{
+    for (int i = 0; i < g_n_syms; i++)
+    {
+        if (strcmp(g_syms[i].name, name) == 0)
+        {
+            *value = g_syms[i].value;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 按段名 (及目标文件名的一部分) 查找已分配的输入段，返回其大小
+ */
+static uint64_t FindInput(const char *name, const char *obj)
+{
+    for (int i = 0; i < g_n_in; i++)
+    {
+        if (g_in[i].size != 0 && g_in[i].addr != 0 && strcmp(g_in[i].name, name) == 0 &&
+            (obj == NULL || strstr(g_in[i].obj, obj) != NULL))
+        {
+            return g_in[i].size;
+        }
+    }
+    return 0;
+}
+
+static int CompareSize(const void *a, const void *b)
+{
+    const InSection *x = *(const InSection *const *)a;
+    const InSection *y = *(const InSection *const *)b;
+    return (x->size < y->size) - (x->size > y->size);
+}
+
+static void ReportRegions(int top_n)
+{
+    static const InSection *sorted[MAX_IN_SECTIONS];
+    int n = 0;
+
+    for (int i = 0; i < g_n_out; i++)
+    {
+        Region *r = FindRegion(g_out[i].addr);
+        Region *l = g_out[i].lma ? FindRegion(g_out[i].lma) : NULL;
+
+        if (g_out[i].size == 0 || r == NULL)
+        {
+            continue;
+        }
+        r->used += g_out[i].size;
+        if (l && l != r)
+        {
+            l->used += g_out[i].size;
+        }
+    }
+
+    printf("%-10s %10s %10s %10s %7s\n", "region", "origin", "size", "used", "used%");
+    for (int i = 0; i < g_n_regions; i++)
+    {
+        const Region *r = &g_regions[i];
+        printf("%-10s 0x%08llx %10llu %10llu %6.1f%%\n", r->name, (unsigned long long)r->origin,
+               (unsigned long long)r->length, (unsigned long long)r->used,
+               r->length ? 100.0 * r->used / r->length : 0.0);
+        for (int j = 0; j < g_n_out; j++)
+        {
+            const OutSection *o = &g_out[j];
+            if (o->size != 0 && (FindRegion(o->addr) == r || (o->lma && FindRegion(o->lma) == r)))
+            {
+                printf("    %-24s %10llu%s\n", o->name, (unsigned long long)o->size,
+                       (o->lma && FindRegion(o->lma) == r && FindRegion(o->addr) != r) ? "  (load image)" : "");
+            }
+        }
+    }
+
+    for (int i = 0; i < g_n_in; i++)
+    {
+        if (g_in[i].size != 0 && IsRam(FindRegion(g_in[i].addr)))
+        {
+            sorted[n++] = &g_in[i];
+        }
+    }
+    qsort(sorted, n, sizeof(sorted[0]), CompareSize);
+    printf("\nlargest RAM objects:\n");
+    for (int i = 0; i < n && i < top_n; i++)
+    {
+        const char *obj = strrchr(sorted[i]->obj, '/');
+        printf("  %-8s %8llu  %-40s %s\n", FindRegion(sorted[i]->addr)->name,
+               (unsigned long long)sorted[i]->size, sorted[i]->name, obj ? obj + 1 : sorted[i]->obj);
+    }
+}
+
+static double NowSec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief 向板子注册并等待一个遥测包
+ */
+static int ReceiveTelemetry(const char *board, StreamTelemetry *t)
+{
+    struct sockaddr_in addr, board_addr;
+    double start = NowSec(), last_hello = 0;
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(STREAM_TELEM_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    memset(&board_addr, 0, sizeof(board_addr));
+    board_addr.sin_family = AF_INET;
+    board_addr.sin_port = htons(STREAM_TELEM_PORT);
+    if (fd < 0 || inet_pton(AF_INET, board, &board_addr.sin_addr) != 1 ||
+        bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("telemetry socket");
+        return -1;
+    }
+
+    while (NowSec() - start < WAIT_TELEMETRY_S)
+    {
+        fd_set rfds;
+        struct timeval tv = { 0, 200000 };
+        uint8_t buf[2048];
+        ssize_t n;
+
+        if (NowSec() - last_hello >= 2.0)
+        {
+            StreamTelemRegister reg = { STREAM_TELEM_REG_MAGIC, STREAM_TELEM_VERSION, 0 };
+            sendto(fd, &reg, sizeof(reg), 0, (struct sockaddr *)&board_addr, sizeof(board_addr));
+            last_hello = NowSec();
+        }
+        FD_ZERO(&rfds);
+        FD_SET(fd, &rfds);
+        if (select(fd + 1, &rfds, NULL, NULL, &tv) <= 0)
+        {
+            continue;
+        }
+        n = recv(fd, buf, sizeof(buf), 0);
+        if (n >= (ssize_t)sizeof(*t))
+        {
+            memcpy(t, buf, sizeof(*t));
+            if (t->magic == STREAM_TELEM_MAGIC && t->version == STREAM_TELEM_VERSION)
+            {
+                close(fd);
+                return 0;
+            }
+        }
+    }
+    close(fd);
+    fprintf(stderr, "no version %d telemetry from %s within %ds\n", STREAM_TELEM_VERSION, board, WAIT_TELEMETRY_S);
+    return -1;
+}
+
+static void PeakRow(const char *what, uint64_t reserved, uint64_t peak, const char *note)
+{
+    if (reserved == 0)
+    {
+        printf("  %-14s %10s %10llu  %s\n", what, "?", (unsigned long long)peak, note);
+        return;
+    }
+    printf("  %-14s %10llu %10llu %6.1f%% %10lld  %s\n", what, (unsigned long long)reserved,
+           (unsigned long long)peak, 100.0 * peak / reserved, (long long)reserved - (long long)peak, note);
+}
+
+static void ReportPeaks(const StreamTelemetry *t)
+{
+    uint64_t stack = 0, heap, pool, log_ring, pp;
+
+    if (!FindSymbol("_Min_Stack_Size", &stack))
+    {
+        stack = t->stack_size;
+    }
+    heap = FindInput(".bss.ram_heap", NULL);
+    pool = FindInput(".bss.memp_memory_PBUF_POOL_base", NULL);
+    log_ring = FindInput(".bss.log_queue", NULL);
+    pp = FindInput(".ccmram", "adc_processing");
+
+    printf("\npeaks from telemetry #%u (uptime %.1fs), bytes:\n", t->seq, t->uptime_ms / 1000.0);
+    printf("  %-14s %10s %10s %7s %10s\n", "object", "reserved", "peak", "peak%", "headroom");
+    PeakRow("MSP stack", stack, t->stack_peak,
+            t->stack_peak >= t->stack_size ? "painted area exhausted, stack may have overflowed" : "");
+    if (t->lwip_heap_size != 0)
+    {
+        PeakRow("LwIP heap", heap ? heap : t->lwip_heap_size, t->lwip_heap_peak, "MEM_SIZE");
+    }
+    else
+    {
+        printf("  %-14s MEM_STATS disabled in lwipopts.h\n", "LwIP heap");
+    }
+    if (t->pbuf_pool_size != STREAM_TELEM_MEM_UNKNOWN && t->pbuf_pool_size != 0)
+    {
+        uint64_t used = pool * (uint64_t)(t->pbuf_pool_size - t->pbuf_pool_min_free) / t->pbuf_pool_size;
+        char note[64];
+        snprintf(note, sizeof(note), "%u of %u pbufs at peak", t->pbuf_pool_size - t->pbuf_pool_min_free,
+                 t->pbuf_pool_size);
+        PeakRow("PBUF pool", pool, used, note);
+        printf("  %-14s lowest other pool: %u free (memp_t #%u)\n", "memp", t->memp_min_free, t->memp_min_pool);
+    }
+    else
+    {
+        printf("  %-14s MEMP_STATS disabled in lwipopts.h\n", "PBUF pool");
+    }
+    PeakRow("log ring", log_ring ? log_ring : t->log_ring_words * 4U, t->log_ring_max * 4U, "log_queue");
+    {
+        // 一块发送期间另一块最多采到的位置; 等于块长时发生过丢块
+        uint64_t block = pp ? pp / 2 : (uint64_t)t->pp_block_samples * 2U;
+        uint64_t used = block * t->pp_fill_peak / (t->pp_block_samples ? t->pp_block_samples : 1);
+        PeakRow("ping-pong", block, used,
+                t->pp_fill_peak >= t->pp_block_samples ? "second buffer filled, blocks were dropped"
+                                                        : "fill of the second buffer while sending");
+    }
+    if (t->mem_errors != 0)
+    {
+        printf("  LwIP allocation failures: %u\n", t->mem_errors);
+    }
+}
+
+static void Usage(void)
+{
+    fprintf(stderr, "usage: map_report [-n N] <firmware.map> [board-ip]\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    int top_n = 15, opt;
+    FILE *f;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n': top_n = atoi(optarg); break;
+        default: Usage();
+        }
+    }
+    if (optind >= argc)
+    {
+        Usage();
+    }
+    f = fopen(argv[optind], "r");
+    if (f == NULL)
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+    if (ParseMap(f) != 0)
+    {
+        fprintf(stderr, "%s: no Memory Configuration found\n", argv[optind]);
+        return 1;
+    }
+    fclose(f);
+    ReportRegions(top_n);
+
+    if (optind + 1 < argc)
+    {
+        StreamTelemetry t;
+        if (ReceiveTelemetry(argv[optind + 1], &t) != 0)
+        {
+            return 1;
+        }
+        ReportPeaks(&t);
+    }
+    return 0;
+}
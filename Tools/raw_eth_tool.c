@@ -0,0 +1,434 @@
+/**
+ ******************************************************************************
+ * @file    raw_eth_tool.c
+ * @brief   二层(自定义EtherType)波形数据流的Linux端接收器与发送替身
+ *
+ * @details
+ * 编译: gcc -O2 -Wall -I../Inc -o raw_eth_tool raw_eth_tool.c
+ * (AF_PACKET需要root或CAP_NET_RAW权限)
+ *
+ * 用法:
+ *   raw_eth_tool rx  <ifname>                  接收二层数据流，重组16KB数据块
+ *   raw_eth_tool udp [port]                    以同样的统计方式接收UDP数据流(默认5001)，用于对比
+ *   raw_eth_tool tx  <ifname> <dst-mac> [pps]  发送替身: 按固件格式发送锯齿波 (pps=0表示不限速)
+ *
+ * 无板卡测试 (veth对):
+ *   ip link add veth0 type veth peer name veth1
+ *   ip link set veth0 up; ip link set veth1 up
+ *   ./raw_eth_tool rx veth1 &
+ *   ./raw_eth_tool tx veth0 ff:ff:ff:ff:ff:ff
+ *
+ * 每2秒输出一次: 包速率、吞吐量、丢包数、完整数据块数，以及每包消耗的CPU时间
+ * (getrusage统计的用户态+内核态时间 / 包数)，二层模式与UDP模式可直接对比。
+ ******************************************************************************
+ */
+
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/if_packet.h>
+#include <net/ethernet.h>
+#include <net/if.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stream_proto.h"
+
+// 与 adc_processing.h 保持一致
+#define DEFAULT_UDP_PORT    5001            // DEST_PORT
+
+#define ETH_HDR_LEN         14
+#define REPORT_INTERVAL_S   2.0
+
+// --- 统计 ---
+typedef struct {
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t lost;
+    uint64_t blocks_ok;
+    uint64_t blocks_bad;
+    double   t_last;
+    double   cpu_last;
+    uint64_t packets_last;
+    uint64_t bytes_last;
+} Stats;
+
+static double NowSec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double CpuSec(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 +
+           ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+}
+
+static void StatsReport(Stats *st, const char *tag)
+{
+    double now = NowSec();
+    double dt = now - st->t_last;
+    if (dt < REPORT_INTERVAL_S)
+    {
+        return;
+    }
+    double cpu = CpuSec();
+    uint64_t dp = st->packets - st->packets_last;
+    uint64_t db = st->bytes - st->bytes_last;
+
+    printf("[%s] %9.0f pkt/s  %7.2f MB/s  lost=%llu  blocks ok=%llu bad=%llu  cpu=%.0f ns/pkt\n",
+           tag, dp / dt, db / dt / 1e6,
+           (unsigned long long)st->lost,
+           (unsigned long long)st->blocks_ok, (unsigned long long)st->blocks_bad,
+           dp ? (cpu - st->cpu_last) * 1e9 / dp : 0.0);
+    fflush(stdout);
+
+    st->t_last = now;
+    st->cpu_last = cpu;
+    st->packets_last = st->packets;
+    st->bytes_last = st->bytes;
+}
+
+static void StatsInit(Stats *st)
+{
+    memset(st, 0, sizeof(*st));
+    st->t_last = NowSec();
+    st->cpu_last = CpuSec();
+}
+
+static int OpenPacketSocket(const char *ifname, struct sockaddr_ll *sll)
+{
+    int fd = socket(AF_PACKET, SOCK_RAW, htons(STREAM_ETHERTYPE));
+    if (fd < 0)
+    {
+        perror("socket(AF_PACKET)");
+        return -1;
+    }
+
+    memset(sll, 0, sizeof(*sll));
+    sll->sll_family   = AF_PACKET;
+    sll->sll_protocol = htons(STREAM_ETHERTYPE);
+    sll->sll_ifindex  = if_nametoindex(ifname);
+    if (sll->sll_ifindex == 0)
+    {
+        fprintf(stderr, "unknown interface %s\n", ifname);
+        close(fd);
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr *)sll, sizeof(*sll)) < 0)
+    {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+
+    struct timeval tv = { 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+// ============================ 二层接收 ============================
+static int RunRawRx(const char *ifname)
+{
+    struct sockaddr_ll sll;
+    int fd = OpenPacketSocket(ifname, &sll);
+    if (fd < 0)
+    {
+        return 1;
+    }
+
+    static uint8_t frame[2048];
+    static uint8_t block[STREAM_BLOCK_BYTES];
+    uint32_t block_fill = 0;
+    uint16_t expect_seq = 0;
+    int have_seq = 0;
+    Stats st;
+    StatsInit(&st);
+
+    printf("Listening for EtherType 0x%04X on %s...\n", STREAM_ETHERTYPE, ifname);
+    for (;;)
+    {
+        ssize_t n = recv(fd, frame, sizeof(frame), 0);
+        if (n < 0)
+        {
+            if (errno != EAGAIN && errno != EINTR)
+            {
+                perror("recv");
+                break;
+            }
+            StatsReport(&st, "raw");
+            continue;
+        }
+        if (n < ETH_HDR_LEN + (ssize_t)sizeof(StreamL2Header))
+        {
+            continue;
+        }
+
+        StreamL2Header hdr;
+        memcpy(&hdr, frame + ETH_HDR_LEN, sizeof(hdr));
+        if (hdr.version != STREAM_PROTO_VERSION)
+        {
+            continue;
+        }
+
+        const uint8_t *payload = frame + ETH_HDR_LEN + sizeof(hdr);
+        uint32_t len = (uint32_t)n - ETH_HDR_LEN - sizeof(hdr);
+
+        if (have_seq && hdr.seq != expect_seq)
+        {
+            st.lost += (uint16_t)(hdr.seq - expect_seq);
+        }
+        expect_seq = hdr.seq + 1;
+        have_seq = 1;
+
+        st.packets++;
+        st.bytes += len;
+
+        // 以块内偏移重组; 偏移为0表示新块开始
+        if (hdr.offset == 0)
+        {
+            block_fill = 0;
+        }
+        if ((uint32_t)hdr.offset + len <= STREAM_BLOCK_BYTES)
+        {
+            memcpy(block + hdr.offset, payload, len);
+            block_fill += len;
+        }
+        if (hdr.flags & STREAM_FLAG_BLOCK_END)
+        {
+            if (block_fill == STREAM_BLOCK_BYTES)
+            {
+                st.blocks_ok++;
+            }
+            else
+            {
+                st.blocks_bad++;
+            }
+            block_fill = 0;
+        }
+
+        StatsReport(&st, "raw");
+    }
+    close(fd);
+    return 0;
+}
+
+// ============================ UDP接收 (对比基准) ============================
+static int RunUdpRx(int port)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return 1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("bind");
+        close(fd);
+        return 1;
+    }
+    struct timeval tv = { 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    static uint8_t pkt[2048];
+    static uint8_t block[STREAM_BLOCK_BYTES];
+    uint32_t block_fill = 0;
+    Stats st;
+    StatsInit(&st);
+
+    printf("Listening for UDP on port %d...\n", port);
+    for (;;)
+    {
+        ssize_t n = recv(fd, pkt, sizeof(pkt), 0);
+        if (n < 0)
+        {
+            if (errno != EAGAIN && errno != EINTR)
+            {
+                perror("recv");
+                break;
+            }
+            StatsReport(&st, "udp");
+            continue;
+        }
+
+        st.packets++;
+        st.bytes += n;
+
+        // UDP流没有包头，只能按到达顺序拼接
+        uint32_t take = (uint32_t)n;
+        if (block_fill + take > STREAM_BLOCK_BYTES)
+        {
+            take = STREAM_BLOCK_BYTES - block_fill;
+        }
+        memcpy(block + block_fill, pkt, take);
+        block_fill += take;
+        if (block_fill == STREAM_BLOCK_BYTES)
+        {
+            st.blocks_ok++;
+            block_fill = 0;
+        }
+
+        StatsReport(&st, "udp");
+    }
+    close(fd);
+    return 0;
+}
+
+// ============================ 发送替身 ============================
+static int ParseMac(const char *s, uint8_t *mac)
+{
+    unsigned int m[6];
+    if (sscanf(s, "%x:%x:%x:%x:%x:%x", &m[0], &m[1], &m[2], &m[3], &m[4], &m[5]) != 6)
+    {
+        return -1;
+    }
+    for (int i = 0; i < 6; i++)
+    {
+        mac[i] = (uint8_t)m[i];
+    }
+    return 0;
+}
+
+static int RunRawTx(const char *ifname, const char *dst, long pps)
+{
+    struct sockaddr_ll sll;
+    uint8_t dst_mac[6];
+    uint8_t src_mac[6] = { 0x02, 0, 0, 0, 0, 0x01 };
+
+    if (ParseMac(dst, dst_mac) < 0)
+    {
+        fprintf(stderr, "bad MAC address: %s\n", dst);
+        return 1;
+    }
+    int fd = OpenPacketSocket(ifname, &sll);
+    if (fd < 0)
+    {
+        return 1;
+    }
+
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    if (ioctl(fd, SIOCGIFHWADDR, &ifr) == 0)
+    {
+        memcpy(src_mac, ifr.ifr_hwaddr.sa_data, 6);
+    }
+    sll.sll_halen = 6;
+    memcpy(sll.sll_addr, dst_mac, 6);
+
+    // 8通道交织的锯齿波，通道n的相位偏移 n*4096
+    static uint16_t block[STREAM_BLOCK_BYTES / 2];
+    static uint8_t frame[ETH_HDR_LEN + sizeof(StreamL2Header) + STREAM_L2_CHUNK_SIZE];
+    uint16_t seq = 0;
+    uint16_t block_no = 0;
+    uint32_t phase = 0;
+    Stats st;
+    StatsInit(&st);
+
+    memcpy(frame, dst_mac, 6);
+    memcpy(frame + 6, src_mac, 6);
+    frame[12] = STREAM_ETHERTYPE >> 8;
+    frame[13] = STREAM_ETHERTYPE & 0xFF;
+
+    double interval = pps > 0 ? 1.0 / pps : 0.0;
+    double next = NowSec();
+
+    for (;;)
+    {
+        for (uint32_t i = 0; i < STREAM_BLOCK_BYTES / 2; i++)
+        {
+            block[i] = (uint16_t)(phase + (i % 8) * 4096);
+            if (i % 8 == 7)
+            {
+                phase += 16;
+            }
+        }
+
+        for (uint32_t off = 0; off < STREAM_BLOCK_BYTES; off += STREAM_L2_CHUNK_SIZE)
+        {
+            uint32_t len = STREAM_BLOCK_BYTES - off;
+            if (len > STREAM_L2_CHUNK_SIZE)
+            {
+                len = STREAM_L2_CHUNK_SIZE;
+            }
+
+            StreamL2Header hdr;
+            hdr.version = STREAM_PROTO_VERSION;
+            hdr.flags   = (off + len >= STREAM_BLOCK_BYTES) ? STREAM_FLAG_BLOCK_END : 0;
+            hdr.seq     = seq;
+            hdr.block   = block_no;
+            hdr.offset  = (uint16_t)off;
+            memcpy(frame + ETH_HDR_LEN, &hdr, sizeof(hdr));
+            memcpy(frame + ETH_HDR_LEN + sizeof(hdr), (uint8_t *)block + off, len);
+
+            if (interval > 0.0)
+            {
+                while (NowSec() < next)
+                {
+                }
+                next += interval;
+            }
+
+            ssize_t n;
+            do
+            {
+                // 内核发送队列满时重发本包
+                n = sendto(fd, frame, ETH_HDR_LEN + sizeof(hdr) + len, 0,
+                           (struct sockaddr *)&sll, sizeof(sll));
+            } while (n < 0 && (errno == ENOBUFS || errno == EAGAIN));
+            if (n < 0)
+            {
+                perror("sendto");
+                close(fd);
+                return 1;
+            }
+            seq++;
+            st.packets++;
+            st.bytes += len;
+            StatsReport(&st, "tx ");
+        }
+        st.blocks_ok++;
+        block_no++;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 3 && strcmp(argv[1], "rx") == 0)
+    {
+        return RunRawRx(argv[2]);
+    }
+    if (argc >= 2 && strcmp(argv[1], "udp") == 0)
+    {
+        return RunUdpRx(argc >= 3 ? atoi(argv[2]) : DEFAULT_UDP_PORT);
+    }
+    if (argc >= 4 && strcmp(argv[1], "tx") == 0)
+    {
+        return RunRawTx(argv[2], argv[3], argc >= 5 ? atol(argv[4]) : 0);
+    }
+
+    fprintf(stderr,
+            "usage: %s rx  <ifname>\n"
+            "       %s udp [port]\n"
+            "       %s tx  <ifname> <dst-mac> [pps]\n",
+            argv[0], argv[0], argv[0]);
+    return 2;
+}
@@ -0,0 +1,575 @@
+/**
+ ******************************************************************************
+ * @file    stream_gen.c
+ * @brief   板子替身: 按固件的线上格式生成波形UDP流, 用于在没有板子时给PC端接收程序加压
+ *
+ * @details
+ * 编译: gcc -O2 -Wall -I../Inc -o stream_gen stream_gen.c -lm
+ *
+ * 用法:
+ *   stream_gen [选项]
+ * 选项:
+ *   -d <ip[:port]>  目的地址 (默认 127.0.0.1:5001, 即 DEST_PORT)
+ *   -b <n>          模拟的板子数 (默认1, 最多 MAX_BOARDS)
+ *   -S <ip>         第一块板子的源地址, 其余依次加1 (如 127.0.0.10; 默认不绑定, 各板子只有源端口不同)
+ *   -r <倍数>       块速率相对标称值 (209.5kHz采样, 约25.6块/秒) 的倍数, 0 为不限速 (默认1)
+ *   -g <波形>       tagged|sine|square|ramp|noise|dc (默认tagged)
+ *   -f <Hz>         波形频率 (默认1000, 按标称采样率计)
+ *   -t <s>          运行时长, 0 运行到 Ctrl-C (默认10)
+ *   -B <n>          每次 sendmmsg 的最大包数 (默认64)
+ *   -l <p>          丢包概率 (不发送)
+ *   -o <p>          乱序概率 (与同一板子的下一个包交换顺序)
+ *   -u <p>          重复概率 (同一个包紧接着再发一次)
+ *   -s <seed>       注入和噪声波形的随机数种子
+ *   -G              每块作为一个 UDP_SEGMENT (GSO) 数据报交给内核, 段长1440, 线上仍是 11x1440 + 544;
+ *                   不能与 -l/-o/-u 同用。在 lo 上启用了 UDP_GRO 的接收端收到的是整块
+ *
+ * 线上格式与 SendWaveformDataViaUDP 发给默认PC的原始流相同: 每块 PING_PONG_BUFFER_SIZE 个
+ * 小端uint16样本, 按帧交织 (通道0~7), 共16384字节, 切成 UDP_PAYLOAD_SIZE(1440) 字节的包,
+ * 最后一包544字节; 没有包头。限速时各板子每个块周期连续发出一块的12个包 (与固件相同),
+ * 各板子的块相位错开。
+ *
+ * tagged 波形与 Tools/hostsim 的相同: 高3位为通道号, 低13位为该通道的样本序号 (按8192取模),
+ * 接收端可逐样本校验丢包、乱序和重复。样本序号在注入丢包时照常前进。
+ *
+ * 包直接指向块缓冲区 (iovec), 不拷贝; 一次 sendmmsg 发出同一板子的多块。
+ * 每秒打印一次发送速率, 退出时打印总计。
+ ******************************************************************************
+ */
+
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <endian.h>
+#include <errno.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stream_proto.h"
+
+// 与 adc_processing.h 保持一致
+#define DEFAULT_DEST_PORT   5001            // DEST_PORT
+#define SAMPLE_RATE         209476.0        // TIM2: 84MHz / (400 + 1)
+#define BLOCK_RATE          (SAMPLE_RATE / STREAM_BLOCK_SAMPLES)
+
+#define MAX_BOARDS          256
+#define MAX_BATCH           1024
+#define WAVE_TABLE_SIZE     4096
+#define TAG_MOD             0x2000U         // HOSTSIM_TAG_MOD
+#define MAX_LAG_BLOCKS      64              // 限速时落后超过这么多块就跳过 (计入 late)
+#define REPORT_INTERVAL_S   1.0
+
+typedef enum { WAVE_TAGGED = 0, WAVE_SINE, WAVE_SQUARE, WAVE_RAMP, WAVE_NOISE, WAVE_DC } WaveType;
+
+// --- 每块板子 ---
+typedef struct {
+    int      fd;
+    uint64_t frame;                         // 下一块第一帧的序号
+    double   next_at;                       // 下一块的发送时刻 (限速时)
+    uint32_t phase;                         // 波形表相位 (32位定点)
+    uint32_t rng;
+    uint16_t *blocks;                       // 块缓冲区环 (每次 sendmmsg 用到的块)
+} Board;
+
+static struct {
+    WaveType wave;
+    double   freq;
+    double   rate;                          // 块速率倍数, 0 不限速
+    double   p_loss, p_reorder, p_dup;
+    int      gso;                           // 每块一个 UDP_SEGMENT 数据报
+    uint32_t batch;
+    uint32_t ring_blocks;                   // 每块板子的块缓冲区数
+    uint32_t phase_step;                    // 每帧的相位增量
+    int16_t  table[WAVE_TABLE_SIZE];
+} g_cfg;
+
+static struct {
+    uint64_t blocks, packets, bytes;
+    uint64_t calls, dropped, reordered, duplicated, late, errors;
+} g_tot;
+
+static Board g_boards[MAX_BOARDS];
+static struct mmsghdr g_msgs[MAX_BATCH];
+static struct iovec   g_iov[MAX_BATCH];
+static volatile sig_atomic_t g_stop = 0;
+
+static double NowSec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double CpuSec(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 +
+           ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+}
+
+static void OnSignal(int sig)
+{
+    (void)sig;
+    g_stop = 1;
+}
+
+static uint32_t Rand(uint32_t *s)
+{
+    *s ^= *s << 13;
+    *s ^= *s >> 17;
+    *s ^= *s << 5;
+    return *s;
+}
+
+static int Chance(uint32_t *s, double p)
+{
+    return p > 0.0 && (double)Rand(s) < p * 4294967296.0;
+}
+
+static int ParseWave(const char *s, WaveType *type)
+{
+    static const char *names[] = { "tagged", "sine", "square", "ramp", "noise", "dc" };
+    int i;
+
+    for (i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++)
+    {
+        if (strcmp(s, names[i]) == 0)
+        {
+            *type = (WaveType)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 一个周期的波形表 (相对零点 0x8000 的偏移); 各通道用同一张表, 相位错开
+ */
+static void BuildTable(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < WAVE_TABLE_SIZE; i++)
+    {
+        double x = (double)i / WAVE_TABLE_SIZE;
+        double v;
+
+        switch (g_cfg.wave)
+        {
+        case WAVE_SINE:   v = sin(2.0 * M_PI * x); break;
+        case WAVE_SQUARE: v = (x < 0.5) ? 1.0 : -1.0; break;
+        case WAVE_RAMP:   v = 2.0 * x - 1.0; break;
+        default:          v = 0.0; break;
+        }
+        g_cfg.table[i] = (int16_t)lrint(20000.0 * v);
+    }
+    // 每帧 (8个采样时钟) 前进 freq / 帧率 个周期
+    g_cfg.phase_step = (uint32_t)llrint(g_cfg.freq / (SAMPLE_RATE / STREAM_CHANNELS) * 4294967296.0);
+}
+
+/**
+ * @brief 生成一块 (小端, 帧交织)
+ */
+static void FillBlock(Board *b, uint16_t *dst)
+{
+    uint32_t f, c;
+
+    for (f = 0; f < STREAM_FRAMES_PER_BLOCK; f++)
+    {
+        uint16_t *frame = dst + f * STREAM_CHANNELS;
+
+        for (c = 0; c < STREAM_CHANNELS; c++)
+        {
+            uint16_t v;
+
+            switch (g_cfg.wave)
+            {
+            case WAVE_TAGGED:
+                v = (uint16_t)((c << 13) | ((b->frame + f) & (TAG_MOD - 1U)));
+                break;
+            case WAVE_NOISE:
+                v = (uint16_t)(0x8000 + (int32_t)(Rand(&b->rng) % 40001U) - 20000);
+                break;
+            case WAVE_DC:
+                v = (uint16_t)(0x8000 + 1000 * c);
+                break;
+            default:
+            {
+                uint32_t ph = b->phase + c * (0x100000000ULL / STREAM_CHANNELS);
+
+                v = (uint16_t)(0x8000 + g_cfg.table[ph >> (32 - 12)]);
+                break;
+            }
+            }
+            frame[c] = htole16(v);
+        }
+        b->phase += g_cfg.phase_step;
+    }
+    b->frame += STREAM_FRAMES_PER_BLOCK;
+}
+
+/**
+ * @brief 按 -S 绑定源地址 (其余板子依次加1), 连接目的地址
+ */
+static int OpenBoard(Board *b, uint32_t idx, const struct sockaddr_in *dst, const char *src_ip)
+{
+    int sndbuf = 4 << 20;
+
+    b->fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (b->fd < 0)
+    {
+        perror("socket");
+        return 0;
+    }
+    setsockopt(b->fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    if (g_cfg.gso)
+    {
+        int seg = STREAM_UDP_CHUNK_SIZE;
+
+        if (setsockopt(b->fd, SOL_UDP, UDP_SEGMENT, &seg, sizeof(seg)) < 0)
+        {
+            perror("UDP_SEGMENT");
+            return 0;
+        }
+    }
+    if (src_ip != NULL)
+    {
+        struct sockaddr_in src;
+
+        memset(&src, 0, sizeof(src));
+        src.sin_family = AF_INET;
+        if (inet_pton(AF_INET, src_ip, &src.sin_addr) != 1)
+        {
+            fprintf(stderr, "bad source address: %s\n", src_ip);
+            return 0;
+        }
+        src.sin_addr.s_addr = htonl(ntohl(src.sin_addr.s_addr) + idx);
+        if (bind(b->fd, (const struct sockaddr *)&src, sizeof(src)) < 0)
+        {
+            perror("bind (source address must be local, e.g. 127.0.0.x)");
+            return 0;
+        }
+    }
+    if (connect(b->fd, (const struct sockaddr *)dst, sizeof(*dst)) < 0)
+    {
+        perror("connect");
+        return 0;
+    }
+    b->blocks = aligned_alloc(64, (size_t)g_cfg.ring_blocks * STREAM_BLOCK_BYTES);
+    if (b->blocks == NULL)
+    {
+        perror("aligned_alloc");
+        return 0;
+    }
+    b->rng = 0x9E3779B9U * (idx + 1U);
+    b->phase = (uint32_t)(idx * 0x10000000ULL);
+    return 1;
+}
+
+/**
+ * @brief 把 nblocks 块排成包 (含丢包、乱序、重复注入) 并用 sendmmsg 发出
+ */
+static void SendBlocks(Board *b, uint32_t nblocks, uint32_t *rng)
+{
+    uint32_t n = 0;
+    uint32_t i, k, sent = 0;
+
+    for (k = 0; k < nblocks; k++)
+    {
+        uint8_t *blk = (uint8_t *)(b->blocks + (size_t)k * STREAM_BLOCK_SAMPLES);
+
+        FillBlock(b, (uint16_t *)blk);
+        if (g_cfg.gso)
+        {
+            g_iov[n].iov_base = blk;
+            g_iov[n].iov_len = STREAM_BLOCK_BYTES;
+            n++;
+            continue;
+        }
+        for (i = 0; i < STREAM_UDP_PACKETS_PER_BLOCK; i++)
+        {
+            uint32_t off = i * STREAM_UDP_CHUNK_SIZE;
+            uint32_t len = (STREAM_BLOCK_BYTES - off < STREAM_UDP_CHUNK_SIZE) ? STREAM_BLOCK_BYTES - off : STREAM_UDP_CHUNK_SIZE;
+
+            if (Chance(rng, g_cfg.p_loss))
+            {
+                g_tot.dropped++;
+                continue;
+            }
+            g_iov[n].iov_base = blk + off;
+            g_iov[n].iov_len = len;
+            n++;
+            if (Chance(rng, g_cfg.p_dup) && n < MAX_BATCH)
+            {
+                g_iov[n] = g_iov[n - 1];
+                n++;
+                g_tot.duplicated++;
+            }
+        }
+    }
+    for (i = 0; i + 1 < n; i++)
+    {
+        if (Chance(rng, g_cfg.p_reorder))
+        {
+            struct iovec t = g_iov[i];
+
+            g_iov[i] = g_iov[i + 1];
+            g_iov[i + 1] = t;
+            g_tot.reordered++;
+            i++;                            // 换到后面的包不再参与交换
+        }
+    }
+    for (i = 0; i < n; i++)
+    {
+        memset(&g_msgs[i].msg_hdr, 0, sizeof(g_msgs[i].msg_hdr));
+        g_msgs[i].msg_hdr.msg_iov = &g_iov[i];
+        g_msgs[i].msg_hdr.msg_iovlen = 1;
+        g_tot.bytes += g_iov[i].iov_len;
+    }
+
+    // 阻塞套接字: 发送缓冲区满时等待; 部分发送时续发其余的包
+    while (sent < n && !g_stop)
+    {
+        int r = sendmmsg(b->fd, g_msgs + sent, n - sent, 0);
+
+        g_tot.calls++;
+        if (r < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno != ENOBUFS && errno != ECONNREFUSED && errno != EAGAIN)
+            {
+                perror("sendmmsg");
+                g_stop = 1;
+            }
+            g_tot.errors++;                 // 本包丢弃 (ECONNREFUSED: 接收端尚未启动)
+            r = 1;
+        }
+        sent += (uint32_t)r;
+    }
+    g_tot.packets += g_cfg.gso ? sent * STREAM_UDP_PACKETS_PER_BLOCK : sent;
+    g_tot.blocks += nblocks;
+}
+
+static void Report(const char *tag, double dt, uint64_t packets, uint64_t bytes, double cpu)
+{
+    printf("%s %.1f s: %.0f pkt/s, %.2f MB/s (%.3f Gbit/s payload), %.1f%% CPU, "
+           "dropped %llu, reordered %llu, duplicated %llu, late %llu, errors %llu, %.1f pkt/call\n",
+           tag, dt, packets / dt, bytes / dt / 1e6, bytes * 8.0 / dt / 1e9, 100.0 * cpu / dt,
+           (unsigned long long)g_tot.dropped, (unsigned long long)g_tot.reordered,
+           (unsigned long long)g_tot.duplicated, (unsigned long long)g_tot.late,
+           (unsigned long long)g_tot.errors,
+           g_tot.calls ? (double)g_tot.packets / g_tot.calls : 0.0);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    struct sockaddr_in dst;
+    char dst_ip[64] = "127.0.0.1";
+    const char *src_ip = NULL;
+    uint16_t dst_port = DEFAULT_DEST_PORT;
+    uint32_t nboards = 1;
+    double seconds = 10.0;
+    uint32_t seed = 1;
+    double t0, t_end, t_report, cpu0, cpu_report;
+    uint64_t pk_report = 0, by_report = 0;
+    uint32_t rng;
+    uint32_t i;
+    int opt;
+
+    g_cfg.wave = WAVE_TAGGED;
+    g_cfg.freq = 1000.0;
+    g_cfg.rate = 1.0;
+    g_cfg.batch = 64;
+    while ((opt = getopt(argc, argv, "d:b:S:r:g:f:t:B:l:o:u:s:G")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+        {
+            char *colon;
+
+            snprintf(dst_ip, sizeof(dst_ip), "%s", optarg);
+            colon = strchr(dst_ip, ':');
+            if (colon != NULL)
+            {
+                *colon = '\0';
+                dst_port = (uint16_t)atoi(colon + 1);
+            }
+            break;
+        }
+        case 'b': nboards = (uint32_t)atoi(optarg); break;
+        case 'S': src_ip = optarg; break;
+        case 'r': g_cfg.rate = atof(optarg); break;
+        case 'g':
+            if (!ParseWave(optarg, &g_cfg.wave))
+            {
+                fprintf(stderr, "unknown waveform: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'f': g_cfg.freq = atof(optarg); break;
+        case 't': seconds = atof(optarg); break;
+        case 'B': g_cfg.batch = (uint32_t)atoi(optarg); break;
+        case 'l': g_cfg.p_loss = atof(optarg); break;
+        case 'o': g_cfg.p_reorder = atof(optarg); break;
+        case 'u': g_cfg.p_dup = atof(optarg); break;
+        case 'G': g_cfg.gso = 1; break;
+        case 's': seed = (uint32_t)strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-d ip[:port]] [-b boards] [-S src-ip] [-r rate|0] [-g wave] [-f Hz] "
+                            "[-t s] [-B batch] [-l p] [-o p] [-u p] [-s seed] [-G]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (nboards == 0 || nboards > MAX_BOARDS || g_cfg.batch == 0 || g_cfg.rate < 0.0)
+    {
+        fprintf(stderr, "bad options: 1..%d boards, batch > 0, rate >= 0\n", MAX_BOARDS);
+        return 2;
+    }
+    if (g_cfg.gso && (g_cfg.p_loss > 0.0 || g_cfg.p_reorder > 0.0 || g_cfg.p_dup > 0.0))
+    {
+        fprintf(stderr, "-G sends whole blocks: packet loss/reorder/duplicate injection is not available\n");
+        return 2;
+    }
+    // 一次 sendmmsg 至多发出这么多块; 重复的包占用额外的位置
+    g_cfg.ring_blocks = g_cfg.batch / STREAM_UDP_PACKETS_PER_BLOCK;
+    if (g_cfg.ring_blocks == 0)
+    {
+        g_cfg.ring_blocks = 1;
+    }
+    if (g_cfg.ring_blocks * STREAM_UDP_PACKETS_PER_BLOCK * 2 > MAX_BATCH)
+    {
+        g_cfg.ring_blocks = MAX_BATCH / (STREAM_UDP_PACKETS_PER_BLOCK * 2);
+    }
+    BuildTable();
+
+    memset(&dst, 0, sizeof(dst));
+    dst.sin_family = AF_INET;
+    dst.sin_port = htons(dst_port);
+    if (inet_pton(AF_INET, dst_ip, &dst.sin_addr) != 1)
+    {
+        fprintf(stderr, "bad destination: %s\n", dst_ip);
+        return 2;
+    }
+    for (i = 0; i < nboards; i++)
+    {
+        if (!OpenBoard(&g_boards[i], i, &dst, src_ip))
+        {
+            return 1;
+        }
+    }
+
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+    printf("%u board(s) -> %s:%u, %s, %.3g x nominal (%.1f blocks/s, %.0f pkt/s per board), "
+           "up to %u blocks per sendmmsg\n",
+           nboards, dst_ip, dst_port, src_ip ? src_ip : "unbound source",
+           g_cfg.rate, g_cfg.rate * BLOCK_RATE, g_cfg.rate * BLOCK_RATE * STREAM_UDP_PACKETS_PER_BLOCK, g_cfg.ring_blocks);
+
+    rng = seed;
+    t0 = NowSec();
+    cpu0 = cpu_report = CpuSec();
+    t_end = (seconds > 0.0) ? t0 + seconds : 1e300;
+    t_report = t0;
+    for (i = 0; i < nboards; i++)
+    {
+        // 各板子的块相位在一个块周期内错开
+        g_boards[i].next_at = (g_cfg.rate > 0.0) ? t0 + (double)i / nboards / (g_cfg.rate * BLOCK_RATE) : t0;
+    }
+
+    while (!g_stop)
+    {
+        double now = NowSec();
+        double next = 1e300;
+
+        if (now >= t_end)
+        {
+            break;
+        }
+        if (now - t_report >= REPORT_INTERVAL_S)
+        {
+            double cpu = CpuSec();
+
+            Report("tx", now - t_report, g_tot.packets - pk_report, g_tot.bytes - by_report, cpu - cpu_report);
+            t_report = now;
+            cpu_report = cpu;
+            pk_report = g_tot.packets;
+            by_report = g_tot.bytes;
+        }
+
+        for (i = 0; i < nboards && !g_stop; i++)
+        {
+            Board *b = &g_boards[i];
+            uint32_t due = g_cfg.ring_blocks;
+
+            if (g_cfg.rate > 0.0)
+            {
+                double period = 1.0 / (g_cfg.rate * BLOCK_RATE);
+                double behind = (now - b->next_at) / period;
+
+                if (behind < 0.0)
+                {
+                    next = (b->next_at < next) ? b->next_at : next;
+                    continue;
+                }
+                if (behind > MAX_LAG_BLOCKS)
+                {
+                    // 跟不上: 跳过落后的块 (样本序号照常前进, 接收端看到整块丢失)
+                    uint64_t skip = (uint64_t)behind;
+
+                    g_tot.late += skip;
+                    b->frame += skip * STREAM_FRAMES_PER_BLOCK;
+                    b->next_at += skip * period;
+                    behind -= (double)skip;
+                }
+                due = (uint32_t)behind + 1U;
+                due = (due > g_cfg.ring_blocks) ? g_cfg.ring_blocks : due;
+                b->next_at += due * period;
+                next = (b->next_at < next) ? b->next_at : next;
+            }
+            SendBlocks(b, due, &rng);
+        }
+
+        if (g_cfg.rate > 0.0 && next < 1e300)
+        {
+            double wait = next - NowSec();
+
+            if (wait > 0.0)
+            {
+                struct timespec ts;
+
+                ts.tv_sec = (time_t)wait;
+                ts.tv_nsec = (long)((wait - (double)ts.tv_sec) * 1e9);
+                nanosleep(&ts, NULL);
+            }
+        }
+    }
+
+    {
+        double dt = NowSec() - t0;
+
+        Report("total", dt, g_tot.packets, g_tot.bytes, CpuSec() - cpu0);
+        printf("%llu blocks, %llu packets in %llu sendmmsg calls\n", (unsigned long long)g_tot.blocks,
+               (unsigned long long)g_tot.packets, (unsigned long long)g_tot.calls);
+    }
+    for (i = 0; i < nboards; i++)
+    {
+        close(g_boards[i].fd);
+        free(g_boards[i].blocks);
+    }
+    return 0;
+}
@@ -0,0 +1,488 @@
+/**
+ ******************************************************************************
+ * @file    stream_sub_tool.c
+ * @brief   订阅流的Linux端控制客户端、校验接收器与扇出开销基准
+ *
+ * @details
+ * 编译: gcc -O2 -Wall -I../Inc -o stream_sub_tool stream_sub_tool.c
+ *
+ * 用法:
+ *   stream_sub_tool list  <board-ip>
+ *   stream_sub_tool sub   <board-ip> <mask> <decim> [dest-ip] [dest-port]
+ *   stream_sub_tool unsub <board-ip> [dest-ip] [dest-port]
+ *   stream_sub_tool rx    <board-ip> <mask> <decim> [port] [mcast-group]
+ *   stream_sub_tool bench [max-subscribers]
+ *
+ * rx: 绑定本地端口(默认5003)，可选加入组播组，订阅后逐包校验:
+ *     包头magic/版本、通道掩码和抽取因子与订阅一致、负载为整数帧、
+ *     块内帧序号连续、每块帧数 = 1024/decim、包序号无跳变。Ctrl-C时退订。
+ *     带 STREAM_FLAG_GAP 的包跳过缺口表后校验负载，并统计采样时钟缺口数和缺失的时钟数。
+ * dest-ip 不是本机地址 (代他人订阅) 或 mcast-group 时，固件须以相应的 STREAM_DEST_POLICY
+ *     编译 (见 stream_ctrl.h)，默认固件只接受请求方自己的地址，否则回复 denied。
+ * bench: 在主机上按固件的组装方式模拟一个乒乓块的扇出
+ *     (每组组装一次 + 每个订阅者拷贝一次到发送缓冲区)，
+ *     分别给出"各订阅者子集互不相同"和"全部相同"两种情况下每块的CPU时间。
+ ******************************************************************************
+ */
+
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stream_proto.h"
+
+#define DEFAULT_RX_PORT     5003
+
+#define REPORT_INTERVAL_S   2.0
+
+static volatile sig_atomic_t g_stop = 0;
+
+static double NowSec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double CpuSec(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 +
+           ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+}
+
+static void OnSignal(int sig)
+{
+    (void)sig;
+    g_stop = 1;
+}
+
+// ============================ 控制端口 ============================
+static int ParseIp(const char *s, uint8_t *ip)
+{
+    struct in_addr a;
+    if (inet_pton(AF_INET, s, &a) != 1)
+    {
+        fprintf(stderr, "bad IP address: %s\n", s);
+        return -1;
+    }
+    memcpy(ip, &a.s_addr, 4);
+    return 0;
+}
+
+static const char *StatusName(uint8_t status)
+{
+    switch (status)
+    {
+    case STREAM_STATUS_OK:          return "ok";
+    case STREAM_STATUS_BAD_ARG:     return "bad argument";
+    case STREAM_STATUS_FULL:        return "subscriber table full";
+    case STREAM_STATUS_NOT_FOUND:   return "not found";
+    case STREAM_STATUS_UNSUPPORTED: return "unsupported";
+    case STREAM_STATUS_DENIED:      return "destination denied (STREAM_DEST_POLICY)";
+    default:                        return "?";
+    }
+}
+
+/**
+ * @brief 发送一个控制请求并等待应答 (超时重试3次)
+ * @param fd 已bind的UDP套接字; 目的地址为0时板端以该套接字的地址作为订阅目的地址
+ * @retval 应答长度; 失败返回-1
+ */
+static int CtrlTransact(int fd, const char *board, const StreamCtrlRequest *req,
+                        uint8_t *reply, size_t reply_size)
+{
+    struct sockaddr_in to;
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons(STREAM_CTRL_PORT);
+    if (inet_pton(AF_INET, board, &to.sin_addr) != 1)
+    {
+        fprintf(stderr, "bad board address: %s\n", board);
+        return -1;
+    }
+
+    struct timeval tv = { 1, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    for (int attempt = 0; attempt < 3; attempt++)
+    {
+        if (sendto(fd, req, sizeof(*req), 0, (struct sockaddr *)&to, sizeof(to)) < 0)
+        {
+            perror("sendto");
+            return -1;
+        }
+        // 数据包可能先于应答到达同一个套接字，跳过非应答包
+        for (;;)
+        {
+            ssize_t n = recv(fd, reply, reply_size, 0);
+            if (n < 0)
+            {
+                break;
+            }
+            if ((size_t)n >= sizeof(StreamCtrlReply) && reply[0] == (req->cmd | STREAM_CMD_REPLY))
+            {
+                return (int)n;
+            }
+        }
+    }
+    fprintf(stderr, "no reply from %s:%d\n", board, STREAM_CTRL_PORT);
+    return -1;
+}
+
+static int OpenUdp(int port)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int RunCtrl(const char *board, uint8_t cmd, uint8_t mask, uint8_t decim,
+                   const char *dest_ip, int dest_port)
+{
+    StreamCtrlRequest req;
+    uint8_t reply[512];
+
+    memset(&req, 0, sizeof(req));
+    req.cmd = cmd;
+    req.channel_mask = mask;
+    req.decimation = decim;
+    req.dest_port = (uint16_t)dest_port;
+    if (dest_ip != NULL && ParseIp(dest_ip, req.dest_ip) < 0)
+    {
+        return 2;
+    }
+
+    int fd = OpenUdp(0);
+    if (fd < 0)
+    {
+        return 1;
+    }
+    int n = CtrlTransact(fd, board, &req, reply, sizeof(reply));
+    close(fd);
+    if (n < 0)
+    {
+        return 1;
+    }
+
+    const StreamCtrlReply *rep = (const StreamCtrlReply *)reply;
+    printf("status: %s\n", StatusName(rep->status));
+    for (int i = 0; i < rep->count && sizeof(*rep) + (i + 1) * sizeof(StreamSubInfo) <= (size_t)n; i++)
+    {
+        const StreamSubInfo *info = (const StreamSubInfo *)(reply + sizeof(*rep) + i * sizeof(StreamSubInfo));
+        printf("  %u.%u.%u.%u:%u  mask=0x%02X  decim=%u%s%s\n",
+               info->dest_ip[0], info->dest_ip[1], info->dest_ip[2], info->dest_ip[3],
+               info->dest_port, info->channel_mask, info->decimation,
+               (info->flags & STREAM_SUB_FLAG_RAW) ? "  (raw)" : "",
+               (info->flags & STREAM_SUB_FLAG_TIME) ? "  (timestamps)" : "");
+    }
+    return rep->status == STREAM_STATUS_OK ? 0 : 1;
+}
+
+// ============================ 校验接收 ============================
+static int RunRx(const char *board, uint8_t mask, uint8_t decim, int port, const char *group)
+{
+    int fd = OpenUdp(port);
+    if (fd < 0)
+    {
+        return 1;
+    }
+
+    StreamCtrlRequest req;
+    memset(&req, 0, sizeof(req));
+    req.cmd = STREAM_CMD_SUBSCRIBE;
+    req.channel_mask = mask;
+    req.decimation = decim;
+    if (group != NULL)
+    {
+        struct ip_mreq mreq;
+        if (ParseIp(group, req.dest_ip) < 0)
+        {
+            close(fd);
+            return 2;
+        }
+        memcpy(&mreq.imr_multiaddr.s_addr, req.dest_ip, 4);
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0)
+        {
+            perror("IP_ADD_MEMBERSHIP");
+            close(fd);
+            return 1;
+        }
+        req.dest_port = (uint16_t)port;
+    }
+
+    uint8_t reply[512];
+    if (CtrlTransact(fd, board, &req, reply, sizeof(reply)) < 0)
+    {
+        close(fd);
+        return 1;
+    }
+    if (reply[1] != STREAM_STATUS_OK)
+    {
+        fprintf(stderr, "subscribe failed: %s\n", StatusName(reply[1]));
+        close(fd);
+        return 1;
+    }
+
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+
+    const uint32_t frame_bytes = (uint32_t)__builtin_popcount(mask) * 2;
+    const uint32_t frames_per_block = STREAM_FRAMES_PER_BLOCK / decim;
+    uint64_t packets = 0, bytes = 0, lost = 0, bad = 0, blocks_ok = 0, blocks_bad = 0;
+    uint64_t gaps = 0, gap_ticks = 0;
+    uint64_t packets_last = 0, bytes_last = 0;
+    uint32_t next_seq = 0, next_frame = 0, cur_block = 0;
+    int have_seq = 0, block_valid = 0;
+    double t_last = NowSec(), cpu_last = CpuSec();
+    static uint8_t pkt[2048];
+
+    printf("Subscribed mask=0x%02X decim=%u on port %d%s%s\n", mask, decim, port,
+           group ? " group " : "", group ? group : "");
+    while (!g_stop)
+    {
+        ssize_t n = recv(fd, pkt, sizeof(pkt), 0);
+        if (n >= (ssize_t)sizeof(StreamUdpHeader))
+        {
+            const StreamUdpHeader *h = (const StreamUdpHeader *)pkt;
+            uint32_t hdr_len = sizeof(*h) + ((h->flags & STREAM_FLAG_GAP) ? sizeof(StreamGapExt) : 0)
+                             + ((h->flags & STREAM_FLAG_TIME) ? sizeof(StreamTimeExt) : 0);
+            uint32_t payload = ((uint32_t)n > hdr_len) ? (uint32_t)n - hdr_len : 0;
+            uint32_t frames = payload / frame_bytes;
+
+            if (h->magic != STREAM_UDP_MAGIC || h->version != STREAM_PROTO_VERSION ||
+                h->channel_mask != mask || h->decimation != decim ||
+                payload % frame_bytes != 0 || frames == 0)
+            {
+                bad++;  // 含控制应答等非数据包
+                continue;
+            }
+            packets++;
+            bytes += n;
+
+            if (h->flags & STREAM_FLAG_GAP)
+            {
+                StreamGapExt ext;
+                memcpy(&ext, pkt + sizeof(*h), sizeof(ext));
+                gaps += ext.count;
+                gap_ticks += ext.missed_total;
+                for (uint32_t i = 0; i < ext.count && i < STREAM_GAP_MAX; i++)
+                {
+                    printf("[sub] block %u: %u sample clock(s) missing before sample %u\n",
+                           h->block, ext.gap[i].missed, ext.gap[i].sample);
+                }
+            }
+
+            if (have_seq && h->seq != next_seq)
+            {
+                lost += (uint32_t)(h->seq - next_seq);
+            }
+            next_seq = h->seq + 1;
+            have_seq = 1;
+
+            // 块内帧序号必须从0开始连续，最后一包正好结束于 frames_per_block
+            if (h->frame_offset == 0)
+            {
+                cur_block = h->block;
+                next_frame = 0;
+                block_valid = 1;
+            }
+            if (h->block != cur_block || h->frame_offset != next_frame)
+            {
+                block_valid = 0;
+            }
+            next_frame = h->frame_offset + frames;
+            if (h->flags & STREAM_FLAG_BLOCK_END)
+            {
+                if (block_valid && next_frame == frames_per_block)
+                {
+                    blocks_ok++;
+                }
+                else
+                {
+                    blocks_bad++;
+                }
+                block_valid = 0;
+            }
+        }
+        else if (n < 0 && errno != EAGAIN && errno != EINTR)
+        {
+            perror("recv");
+            break;
+        }
+
+        double now = NowSec();
+        if (now - t_last >= REPORT_INTERVAL_S)
+        {
+            double cpu = CpuSec();
+            uint64_t dp = packets - packets_last;
+            printf("[sub] %8.0f pkt/s  %7.3f MB/s  lost=%llu  bad=%llu  blocks ok=%llu bad=%llu  gaps=%llu (%llu clk)"
+                   "  cpu=%.0f ns/pkt\n",
+                   dp / (now - t_last), (bytes - bytes_last) / (now - t_last) / 1e6,
+                   (unsigned long long)lost, (unsigned long long)bad,
+                   (unsigned long long)blocks_ok, (unsigned long long)blocks_bad,
+                   (unsigned long long)gaps, (unsigned long long)gap_ticks,
+                   dp ? (cpu - cpu_last) * 1e9 / dp : 0.0);
+            fflush(stdout);
+            t_last = now;
+            cpu_last = cpu;
+            packets_last = packets;
+            bytes_last = bytes;
+        }
+    }
+
+    // 退订 (组播订阅的目的地址是组地址)
+    req.cmd = STREAM_CMD_UNSUBSCRIBE;
+    CtrlTransact(fd, board, &req, reply, sizeof(reply));
+    printf("Unsubscribed.\n");
+    close(fd);
+    return 0;
+}
+
+// ============================ 扇出开销基准 ============================
+// 与 StreamCtrl_Assemble 相同的组装方式
+static uint32_t Assemble(const uint16_t *block, uint8_t mask, uint8_t decim, uint32_t first,
+                         uint32_t count, uint16_t *dst)
+{
+    uint8_t channels[STREAM_CHANNELS];
+    uint32_t n_ch = 0;
+    for (uint32_t ch = 0; ch < STREAM_CHANNELS; ch++)
+    {
+        if (mask & (1U << ch))
+        {
+            channels[n_ch++] = (uint8_t)ch;
+        }
+    }
+    const uint16_t *src = &block[first * decim * STREAM_CHANNELS];
+    for (uint32_t f = 0; f < count; f++)
+    {
+        for (uint32_t c = 0; c < n_ch; c++)
+        {
+            *dst++ = src[channels[c]];
+        }
+        src += decim * STREAM_CHANNELS;
+    }
+    return count * n_ch * 2;
+}
+
+/**
+ * @brief 模拟一个块发给 n_subs 个订阅者的CPU时间
+ * @param distinct 1: 每个订阅者子集不同(每人一组); 0: 全部相同(一组)
+ * @retval 每块纳秒数
+ */
+static double BenchFanout(const uint16_t *block, int n_subs, int distinct, uint32_t iterations)
+{
+    static uint16_t assembly[STREAM_UDP_CHUNK_SIZE / 2];
+    static uint8_t  tx_buf[1536];
+    volatile uint8_t sink = 0;
+    int n_groups = distinct ? n_subs : 1;
+    int members = distinct ? 1 : n_subs;
+
+    double t0 = NowSec();
+    for (uint32_t it = 0; it < iterations; it++)
+    {
+        for (int g = 0; g < n_groups; g++)
+        {
+            uint8_t mask = distinct ? (uint8_t)(0xFF >> (g % STREAM_CHANNELS)) : 0x0F;
+            uint8_t decim = (uint8_t)(1U << (g % 4));
+            uint32_t frame_bytes = (uint32_t)__builtin_popcount(mask) * 2;
+            uint32_t frames = STREAM_FRAMES_PER_BLOCK / decim;
+            uint32_t per_pkt = STREAM_UDP_CHUNK_SIZE / frame_bytes;
+
+            for (uint32_t first = 0; first < frames; first += per_pkt)
+            {
+                uint32_t count = frames - first < per_pkt ? frames - first : per_pkt;
+                uint32_t len = Assemble(block, mask, decim, first, count, assembly);
+                for (int m = 0; m < members; m++)
+                {
+                    memcpy(tx_buf + 16, assembly, len);  // 快速通道拷贝进描述符缓冲区
+                    sink ^= tx_buf[16 + (m & 7)];
+                }
+            }
+        }
+    }
+    (void)sink;
+    return (NowSec() - t0) * 1e9 / iterations;
+}
+
+static int RunBench(int max_subs)
+{
+    static uint16_t block[STREAM_FRAMES_PER_BLOCK * STREAM_CHANNELS];
+    for (uint32_t i = 0; i < STREAM_FRAMES_PER_BLOCK * STREAM_CHANNELS; i++)
+    {
+        block[i] = (uint16_t)(i * 7);
+    }
+
+    printf("subs   distinct(ns/block)   shared(ns/block)\n");
+    for (int n = 1; n <= max_subs; n++)
+    {
+        printf("%4d   %18.0f   %16.0f\n", n,
+               BenchFanout(block, n, 1, 2000), BenchFanout(block, n, 0, 2000));
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 3 && strcmp(argv[1], "list") == 0)
+    {
+        return RunCtrl(argv[2], STREAM_CMD_LIST, 0, 0, NULL, 0);
+    }
+    if (argc >= 5 && strcmp(argv[1], "sub") == 0)
+    {
+        return RunCtrl(argv[2], STREAM_CMD_SUBSCRIBE, (uint8_t)strtoul(argv[3], NULL, 0),
+                       (uint8_t)atoi(argv[4]), argc >= 6 ? argv[5] : NULL, argc >= 7 ? atoi(argv[6]) : 0);
+    }
+    if (argc >= 3 && strcmp(argv[1], "unsub") == 0)
+    {
+        return RunCtrl(argv[2], STREAM_CMD_UNSUBSCRIBE, 0, 0,
+                       argc >= 4 ? argv[3] : NULL, argc >= 5 ? atoi(argv[4]) : 0);
+    }
+    if (argc >= 5 && strcmp(argv[1], "rx") == 0)
+    {
+        return RunRx(argv[2], (uint8_t)strtoul(argv[3], NULL, 0), (uint8_t)atoi(argv[4]),
+                     argc >= 6 ? atoi(argv[5]) : DEFAULT_RX_PORT, argc >= 7 ? argv[6] : NULL);
+    }
+    if (argc >= 2 && strcmp(argv[1], "bench") == 0)
+    {
+        return RunBench(argc >= 3 ? atoi(argv[2]) : 8);
+    }
+
+    fprintf(stderr,
+            "usage: %s list  <board-ip>\n"
+            "       %s sub   <board-ip> <mask> <decim> [dest-ip] [dest-port]\n"
+            "       %s unsub <board-ip> [dest-ip] [dest-port]\n"
+            "       %s rx    <board-ip> <mask> <decim> [port] [mcast-group]\n"
+            "       %s bench [max-subscribers]\n",
+            argv[0], argv[0], argv[0], argv[0], argv[0]);
+    return 2;
+}
@@ -0,0 +1,290 @@
+/**
+ ******************************************************************************
+ * @file    telemetry_mon.c
+ * @brief   遥测包的PC端解码/监视程序
+ *
+ * @details
+ * 编译: gcc -O2 -Wall -I../Inc -o telemetry_mon telemetry_mon.c
+ *
+ * 用法:
+ *   telemetry_mon [board-ip] [port]
+ *
+ * 在 port (默认 STREAM_TELEM_PORT) 上接收 StreamTelemetry 并逐包显示。
+ * 给出 board-ip 时每2秒向板子的遥测端口发一个 StreamTelemRegister，把遥测目的地址改为本机，
+ * 否则只能收到发往默认PC的遥测。固件默认只接受默认PC的登记 (TELEMETRY_REG_POLICY)，
+ * 其他主机登记时须用 -DTELEMETRY_REG_POLICY=TELEMETRY_REG_ANY 编译固件。
+ * 计数器为累计值，显示的速率和增量由相邻两包的差值算出; 遥测包序号跳变时提示丢包。
+ * CPU负载为固件 cpu_load 模块的滑动平均值 (总负载及 LwIP/ADC/遥测/日志 各段)，
+ * 空转轮占比为本周期内各段都只是空转查询的主循环轮数比例。
+ * 内存为上电以来的高水位 (峰值/容量)，LwIP统计未启用的项不显示。
+ * 固件启用 USE_PROFILING 时还会收到 StreamProfile，显示各代码段本周期的平均/最小/最大周期数、
+ * 占CPU的比例，以及每个样本的中断开销占周期预算 (cpu_hz / sample_rate_hz) 的比例。
+ ******************************************************************************
+ */
+
+#include <arpa/inet.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stream_proto.h"
+
+#define TIM2_CLOCK_MHZ      84.0            // TIM2计数时钟, 延迟直方图的单位
+#define HELLO_INTERVAL_S    2.0
+
+static double NowSec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void PrintHist(const char *title, const uint32_t *cur, const uint32_t *prev, int bins,
+                      const char *const *labels)
+{
+    printf("  %-14s", title);
+    for (int i = 0; i < bins; i++)
+    {
+        uint32_t d = prev ? cur[i] - prev[i] : cur[i];
+        if (d != 0)
+        {
+            printf(" %s:%u", labels[i], d);
+        }
+    }
+    printf("\n");
+}
+
+static void Show(const StreamTelemetry *t, const StreamTelemetry *prev)
+{
+    static const char *const lat_labels[STREAM_TELEM_LAT_BINS] = {
+        "<8", "8", "16", "32", "64", "128", "256", ">=512",
+    };
+    static const char *const loop_labels[STREAM_TELEM_LOOP_BINS] = {
+        "<2", "2", "4", "8", "16", "32", "64", "128", "256", "512",
+        "1k", "2k", "4k", "8k", "16k", ">=32k",
+    };
+    uint32_t lat[STREAM_TELEM_LAT_BINS], lat_prev[STREAM_TELEM_LAT_BINS];
+    uint32_t loop[STREAM_TELEM_LOOP_BINS], loop_prev[STREAM_TELEM_LOOP_BINS];
+    double dt = prev ? (double)(t->uptime_ms - prev->uptime_ms) / 1000.0 : 0.0;
+
+#define DELTA(f) (prev ? (uint32_t)(t->f - prev->f) : 0U)
+#define RATE(f)  (dt > 0 ? DELTA(f) / dt : 0.0)
+
+    printf("--- telemetry #%u  uptime %.1fs ---\n", t->seq, t->uptime_ms / 1000.0);
+    printf("  acquisition    %.0f samples/s  blocks=%u dropped=%u(+%u)  tim2_skips=%u(+%u)"
+           "  spi_ovr=%u spi_dma_err=%u\n",
+           RATE(samples), t->blocks_acquired, t->blocks_dropped, DELTA(blocks_dropped),
+           t->tim2_skips, DELTA(tim2_skips), t->spi_overruns, t->spi_dma_errors);
+    printf("  network        %.0f pkt/s  pbuf_fail=%u(+%u) send_err=%u(+%u)  ring_full=%u(+%u) tx_irq=%.0f/s\n",
+           RATE(packets_sent), t->pbuf_failures, DELTA(pbuf_failures), t->send_errors, DELTA(send_errors),
+           t->eth_ring_full, DELTA(eth_ring_full), RATE(eth_tx_irqs));
+    printf("  queues         eth_ring=%u/%u  log_ring=%u words  console=%u bytes"
+           "  log_dropped=%u console_dropped=%u\n",
+           t->eth_ring_max, t->eth_ring_depth, t->log_ring_max, t->console_max,
+           t->log_dropped, t->console_dropped);
+    printf("  load           cpu=");
+    if (t->cpu_load_permille == STREAM_TELEM_CPU_UNKNOWN)
+    {
+        printf("n/a");
+    }
+    else
+    {
+        uint16_t sub[STREAM_TELEM_CPU_SUBS];
+        uint32_t passes = DELTA(loop_passes);
+
+        memcpy(sub, t->cpu_sub_permille, sizeof(sub));
+        printf("%.1f%% (lwip %.1f adc %.1f telem %.1f log %.1f)  idle_passes=%.1f%% of %.0f/s",
+               t->cpu_load_permille / 10.0, sub[0] / 10.0, sub[1] / 10.0, sub[2] / 10.0, sub[3] / 10.0,
+               passes ? 100.0 * DELTA(loop_idle_passes) / passes : 0.0, RATE(loop_passes));
+    }
+    printf("  governor level=%u util=%u%% raw_skipped=%u(+%u)  loop_max=%uus  tim2_lat_max=%.2fus\n",
+           t->gov_level, t->gov_util_pct, t->raw_blocks_skipped, DELTA(raw_blocks_skipped),
+           t->loop_max_us, t->tim2_lat_max / TIM2_CLOCK_MHZ);
+    printf("  memory         stack=%u/%u", t->stack_peak, t->stack_size);
+    if (t->lwip_heap_size != 0)
+    {
+        printf(" lwip_heap=%u/%u", t->lwip_heap_peak, t->lwip_heap_size);
+    }
+    if (t->pbuf_pool_size != STREAM_TELEM_MEM_UNKNOWN)
+    {
+        printf(" pbuf_free_min=%u/%u memp_free_min=%u(pool %u)", t->pbuf_pool_min_free, t->pbuf_pool_size,
+               t->memp_min_free, t->memp_min_pool);
+    }
+    printf(" mem_err=%u(+%u)  log_ring=%u/%u  pp_fill=%u/%u%s\n", t->mem_errors, DELTA(mem_errors),
+           t->log_ring_max, t->log_ring_words, t->pp_fill_peak, t->pp_block_samples,
+           t->stack_peak >= t->stack_size ? "  STACK OVERFLOW?" : "");
+    // 包结构是packed的，先复制到对齐的局部数组
+    memcpy(lat, t->tim2_lat_hist, sizeof(lat));
+    memcpy(loop, t->loop_hist, sizeof(loop));
+    if (prev)
+    {
+        memcpy(lat_prev, prev->tim2_lat_hist, sizeof(lat_prev));
+        memcpy(loop_prev, prev->loop_hist, sizeof(loop_prev));
+    }
+    PrintHist("tim2 lat(tck)", lat, prev ? lat_prev : NULL, STREAM_TELEM_LAT_BINS, lat_labels);
+    PrintHist("loop (us)", loop, prev ? loop_prev : NULL, STREAM_TELEM_LOOP_BINS, loop_labels);
+    fflush(stdout);
+
+#undef DELTA
+#undef RATE
+}
+
+static void ShowProfile(const StreamProfile *r, const StreamProfile *prev, double dt)
+{
+    static const char *const names[STREAM_PROF_REGIONS] = {
+        "TIM2_IRQ", "SPI_RX_CB", "ADC_Task", "SendUDP",
+    };
+    double budget = (double)r->cpu_hz / r->sample_rate_hz;
+    double per_sample = 0;
+
+    printf("  profile        budget %.0f cycles/sample\n", budget);
+    for (int i = 0; i < STREAM_PROF_REGIONS && i < r->n_regions; i++)
+    {
+        StreamProfileRegion cur, old;
+        uint32_t n;
+        uint64_t cycles;
+        double mean;
+
+        memcpy(&cur, &r->region[i], sizeof(cur));
+        if (prev)
+        {
+            memcpy(&old, &prev->region[i], sizeof(old));
+        }
+        else
+        {
+            memset(&old, 0, sizeof(old));
+        }
+        n = cur.count - old.count;
+        cycles = cur.total_cycles - old.total_cycles;
+        mean = n ? (double)cycles / n : 0.0;
+        if (i == 0 || i == 1)
+        {
+            per_sample += mean; // TIM2中断和SPI回调每个样本各执行一次
+        }
+        printf("    %-10s n=%-8u mean=%-8.1f min=%-8u max=%-8u cpu=%5.1f%%  hist:",
+               names[i], n, mean, n ? cur.min_cycles : 0, cur.max_cycles,
+               dt > 0 ? 100.0 * cycles / (dt * r->cpu_hz) : 0.0);
+        for (int b = 0; b < STREAM_PROF_BINS; b++)
+        {
+            uint32_t d = cur.hist[b] - old.hist[b];
+            if (d != 0)
+            {
+                printf(" %u:%u", b ? 16U << b : 0U, d);
+            }
+        }
+        printf("\n");
+    }
+    printf("    per-sample IRQ cost %.1f cycles (%.1f%% of budget)\n", per_sample, 100.0 * per_sample / budget);
+    fflush(stdout);
+}
+
+int main(int argc, char **argv)
+{
+    const char *board = (argc >= 2) ? argv[1] : NULL;
+    int port = (argc >= 3) ? atoi(argv[2]) : STREAM_TELEM_PORT;
+    struct sockaddr_in local, board_addr;
+    StreamTelemetry cur, prev;
+    StreamProfile prof, prof_prev;
+    uint32_t prof_prev_ms = 0;
+    int have_prev = 0, have_prof = 0;
+    double last_hello = 0;
+    int fd;
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        perror("socket");
+        return 1;
+    }
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons((uint16_t)port);
+    if (bind(fd, (struct sockaddr *)&local, sizeof(local)) < 0)
+    {
+        perror("bind");
+        return 1;
+    }
+    if (board)
+    {
+        memset(&board_addr, 0, sizeof(board_addr));
+        board_addr.sin_family = AF_INET;
+        board_addr.sin_port = htons(STREAM_TELEM_PORT);
+        if (inet_pton(AF_INET, board, &board_addr.sin_addr) != 1)
+        {
+            fprintf(stderr, "bad board ip: %s\n", board);
+            return 1;
+        }
+    }
+    printf("listening for telemetry on port %d%s%s\n", port, board ? ", registering with " : "",
+           board ? board : "");
+
+    for (;;)
+    {
+        fd_set rfds;
+        struct timeval tv = { 0, 200000 };
+        uint8_t buf[2048];
+        ssize_t n;
+
+        if (board && NowSec() - last_hello >= HELLO_INTERVAL_S)
+        {
+            StreamTelemRegister reg = { STREAM_TELEM_REG_MAGIC, STREAM_TELEM_VERSION, 0 };
+            sendto(fd, &reg, sizeof(reg), 0, (struct sockaddr *)&board_addr, sizeof(board_addr));
+            last_hello = NowSec();
+        }
+
+        FD_ZERO(&rfds);
+        FD_SET(fd, &rfds);
+        if (select(fd + 1, &rfds, NULL, NULL, &tv) <= 0)
+        {
+            continue;
+        }
+        n = recv(fd, buf, sizeof(buf), 0);
+        if (n >= (ssize_t)sizeof(prof) && buf[0] == (STREAM_PROF_MAGIC & 0xFF) && buf[1] == (STREAM_PROF_MAGIC >> 8))
+        {
+            // 紧跟在同序号的遥测包之后, 用遥测包的 uptime 计算周期长度
+            memcpy(&prof, buf, sizeof(prof));
+            if (prof.version != STREAM_PROF_VERSION || !have_prev || prof.seq != cur.seq)
+            {
+                continue;
+            }
+            ShowProfile(&prof, have_prof ? &prof_prev : NULL,
+                        have_prof ? (cur.uptime_ms - prof_prev_ms) / 1000.0 : 0.0);
+            prof_prev = prof;
+            prof_prev_ms = cur.uptime_ms;
+            have_prof = 1;
+            continue;
+        }
+        if (n < (ssize_t)sizeof(cur))
+        {
+            continue;
+        }
+        memcpy(&cur, buf, sizeof(cur));
+        if (cur.magic != STREAM_TELEM_MAGIC || cur.version != STREAM_TELEM_VERSION)
+        {
+            fprintf(stderr, "ignoring packet: magic=0x%04X version=%u\n", cur.magic, cur.version);
+            continue;
+        }
+        if (have_prev && cur.seq != prev.seq + 1)
+        {
+            if (cur.seq <= prev.seq)
+            {
+                printf("(board restarted)\n");
+                have_prev = 0;
+                have_prof = 0;
+            }
+            else
+            {
+                printf("(%u telemetry packet(s) lost)\n", cur.seq - prev.seq - 1);
+            }
+        }
+        Show(&cur, have_prev ? &prev : NULL);
+        prev = cur;
+        have_prev = 1;
+    }
+}
@@ -0,0 +1,545 @@
+/**
+ ******************************************************************************
+ * @file    tick_sim.c
+ * @brief   采集链路的离散事件时序模型: TIM2触发 -> 主循环启动SPI/DMA -> DMA完成回调 -> 以太网发送
+ *
+ * @details
+ * 编译: gcc -O2 -Wall -I../Inc -o tick_sim tick_sim.c
+ *
+ * 用法:
+ *   tick_sim [选项] rate <Hz>            以固定采样率运行 (取整到TIM2的自动重装值)
+ *   tick_sim [选项] search [lo] [hi]     二分查找不出现缺口的最小自动重装值 (默认 5k ~ 400k Hz)
+ *   tick_sim [选项] sweep                对每种 SPI分频 x 通道数 x UDP负载 组合执行 search
+ * 选项 (周期数按168MHz计，可取自 USE_PROFILING 的报告):
+ *   -t <s>      每个采样率仿真的时长 (默认2秒)
+ *   -l <cyc>    主循环一轮中 LwIP/遥测/日志等固定开销 (默认300)
+ *   -j <cyc>    每轮随机抖动的上限 (默认100)
+ *   -S <cyc>    启动一次SPI/DMA传输的开销 (默认250)
+ *   -b <cyc>    组装并交出一个数据包的开销 (快速通道, 默认1000; 报告中 SendWaveformDataViaUDP / 包数)
+ *   -i <cyc>    TIM2中断开销 (默认80)
+ *   -c <cyc>    SPI接收回调开销 (默认150)
+ *   -e <cyc>    每次中断的入口+出口开销 (默认24)
+ *   -E <cyc>    发送完成中断除续发之外的开销 (默认60)
+ * 配置 (sweep 时给出则只取该值):
+ *   -p <n>      SPI1 波特率分频 2~256 (默认4, 即21MHz; sweep: 4 8 16)
+ *   -n <n>      CHANNELS_PER_SAMPLE (默认8; sweep: 4 8)
+ *   -u <bytes>  UDP_PAYLOAD_SIZE (默认1440; sweep: 512 1024 1440)
+ *   -r <n>      以太网发送环深度 ETH_TXBUFNB (默认8)
+ *   -w <n>      主循环每轮最多交出的包数 (默认0: 与固件相同, 直到发送环满)
+ *
+ * 固件中每个样本都要经过: TIM2中断置请求标志 -> 主循环在 ADC_Processing_Task 中配置并启动
+ * SPI/DMA -> 4字节传输 (32位 * SPI分频 * 2 个CPU周期) -> DMA完成中断存样本并清忙标志。
+ * 忙标志清除之前到来的TIM2周期被跳过，因此主循环单轮耗时决定了不出现缺口的最高采样率。
+ * 每块 (通道数 * 1024 个样本) 采满后主循环逐包交给发送环直到环满 (期间不启动采集，
+ * 一轮交出多包时即使采样率很低也会跳过TIM2周期, 可用 -w 评估限制每轮包数的效果)，线路以100Mbit/s
+ * 逐帧发出 (含首部、前导码和帧间隔)，每发完一帧发送完成中断续发下一包。
+ * 仿真按事件推进，中断打断主循环并推迟其完成时间 (中断之间不嵌套)。
+ * 不出现缺口指既没有被跳过的TIM2周期，也没有因发送未完成而整块丢弃。
+ *
+ * 延迟: 样本延迟为TIM2更新到该样本存入缓冲区; 块延迟为一块采满到最后一包离开线路。
+ *
+ * 缺口记录规则与固件相同: TIM2接受触发时记下已缺失的时钟数，样本存入时把与上一个样本的差值
+ * 记为该样本之前的缺口，每块最多 GAP_TABLE_SIZE 个。仿真同时校验: 接收端按
+ * 样本序号 + 之前各缺口的缺失数 还原的时钟序号必须等于该样本实际对应的TIM2周期。
+ ******************************************************************************
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "stream_proto.h"
+
+// 与 adc_processing.h / spi.c / tim.c 保持一致
+#define GAP_TABLE_SIZE      16              // ADC_GAP_TABLE_SIZE
+#define CPU_HZ              168000000.0
+#define TIM_HZ              84000000.0      // APB1定时器时钟
+#define SPI_BITS            32              // 每个样本4字节
+#define ADS_SCLK_MAX_HZ     17000000.0      // ADS8688 数据手册的SCLK上限
+#define FRAME_OVERHEAD      (14 + 20 + 8 + 4 + 8 + 12)  // 以太网/IP/UDP首部 + FCS + 前导码 + 帧间隔
+#define WIRE_CYCLES_PER_BYTE (8.0 * CPU_HZ / 100e6)     // 100Mbit/s
+
+typedef struct {
+    double   seconds;
+    int64_t  loop_fixed, jitter, setup, pkt_send, tim2_isr, spi_cb, isr_overhead, eth_isr;
+    uint32_t spi_presc, channels, payload, ring, burst;
+} SimParams;
+
+typedef struct {
+    uint64_t ticks, samples, skips, gaps, unlocated, mismatches, blocks, blocks_dropped, packets;
+    double   max_loop_us;
+    double   max_sample_lat_us;
+    double   max_block_lat_ms;
+    double   wire_busy;         // 线路忙的比例
+} SimResult;
+
+// 仿真状态
+static struct {
+    const SimParams *p;
+    int64_t  now;           // 主循环的当前时间 (周期)
+    int64_t  tick_period;   // TIM2周期 (周期)
+    int64_t  next_tick;
+    uint64_t tick_index;
+    int64_t  dma_done;      // DMA完成时刻, -1 表示没有传输
+    int64_t  dma_tick_time; // 当前传输对应的TIM2更新时刻
+    uint64_t dma_tick;      // 当前传输对应的TIM2周期序号
+    uint64_t lost_at_trigger;
+    int      busy, flag;
+
+    // 与固件相同的缺口记录
+    uint64_t lost_seen;
+    uint32_t sample_count, gap_count, gap_overflow;
+    uint32_t block_samples;
+
+    // 发送: 待交出的包、发送环占用、线路
+    int      block_pending;     // 乒乓缓冲区待发送 (直到最后一包交给发送环)
+    uint32_t to_post;
+    uint32_t packets_per_block;
+    uint32_t last_len;          // 每块最后一包的负载字节数
+    uint32_t in_flight;
+    int64_t  wire_done;         // 线路上当前帧发完的时刻, -1 表示空闲
+    int64_t  wire_cycles, wire_cycles_last;
+    int64_t  wire_busy;
+    uint64_t posted, wired;     // 累计交出/发完的包数
+    uint64_t block_last_pkt;    // 当前块最后一包的累计序号 (1起), 0表示没有
+    int64_t  block_ready_time;
+
+    // 接收端还原
+    uint64_t rx_samples, rx_missed;
+    SimResult r;
+    uint32_t rng;
+} g;
+
+static uint32_t Rand(void)
+{
+    g.rng ^= g.rng << 13;
+    g.rng ^= g.rng >> 17;
+    g.rng ^= g.rng << 5;
+    return g.rng;
+}
+
+// 线路按交出顺序发送; 包号 n (1起) 是否为某块的最后一包
+static int IsLastOfBlock(uint64_t n)
+{
+    return (n % g.packets_per_block) == 0;
+}
+
+static void WireStart(int64_t t)
+{
+    int64_t cycles = IsLastOfBlock(g.wired + 1) ? g.wire_cycles_last : g.wire_cycles;
+
+    g.wire_done = t + cycles;
+    g.wire_busy += cycles;
+}
+
+// 把一个包交给发送环 (主循环或发送完成中断中调用)
+static void Post(int64_t t)
+{
+    g.posted++;
+    g.in_flight++;
+    g.to_post--;
+    if (g.to_post == 0)
+    {
+        g.block_pending = 0;    // 缓冲区可以再次使用
+        g.block_last_pkt = g.posted;
+    }
+    if (g.wire_done < 0)
+    {
+        WireStart(t);
+    }
+}
+
+// SPI1_DMA_RX_Callback
+static void StoreSample(int64_t t)
+{
+    uint64_t lost = g.lost_at_trigger;
+    double lat = (t - g.dma_tick_time) / (CPU_HZ / 1e6);
+
+    if (lat > g.r.max_sample_lat_us)
+    {
+        g.r.max_sample_lat_us = lat;
+    }
+    if (lost != g.lost_seen)
+    {
+        if (g.gap_count < GAP_TABLE_SIZE)
+        {
+            // 接收端: 该样本之前缺失 lost - lost_seen 个时钟
+            g.rx_missed += lost - g.lost_seen;
+            g.gap_count++;
+            g.r.gaps++;
+        }
+        else
+        {
+            g.gap_overflow = 1;
+            g.r.unlocated++;
+            g.rx_missed += lost - g.lost_seen; // 位置未知, 只能按块内总数修正; 此后的样本不参与校验
+        }
+        g.lost_seen = lost;
+    }
+    if (!g.gap_overflow && g.rx_samples + g.rx_missed != g.dma_tick)
+    {
+        g.r.mismatches++;
+    }
+    g.rx_samples++;
+    g.r.samples++;
+
+    if (++g.sample_count >= g.block_samples)
+    {
+        if (!g.block_pending)
+        {
+            g.block_pending = 1;
+            g.to_post = g.packets_per_block;
+            g.block_ready_time = t;
+        }
+        else
+        {
+            g.r.blocks_dropped++;
+        }
+        g.r.blocks++;
+        g.sample_count = 0;
+        g.gap_count = 0;
+        g.gap_overflow = 0;
+    }
+    g.busy = 0;
+}
+
+/**
+ * @brief 主循环执行 work 个周期的工作，期间到来的中断推迟其完成时间
+ * @note  中断按到达顺序串行执行 (各中断都远短于采样周期，忽略嵌套)
+ */
+static void RunMain(int64_t work)
+{
+    int64_t end = g.now + work;
+
+    for (;;)
+    {
+        int64_t t_tick = g.next_tick;
+        int64_t t_dma = (g.dma_done >= 0) ? g.dma_done : INT64_MAX;
+        int64_t t_wire = (g.wire_done >= 0) ? g.wire_done : INT64_MAX;
+        int64_t t = t_tick;
+
+        if (t_dma < t)
+        {
+            t = t_dma;
+        }
+        if (t_wire < t)
+        {
+            t = t_wire;
+        }
+        if (t > end)
+        {
+            break;
+        }
+        end += g.p->isr_overhead;
+        if (t == t_tick)
+        {
+            // TIM2_IRQHandler
+            g.r.ticks++;
+            if (!g.busy)
+            {
+                g.busy = 1;
+                g.flag = 1;
+                g.dma_tick = g.tick_index;
+                g.dma_tick_time = t;
+                g.lost_at_trigger = g.r.skips;
+            }
+            else
+            {
+                g.r.skips++;
+            }
+            g.tick_index++;
+            g.next_tick += g.tick_period;
+            end += g.p->tim2_isr;
+        }
+        else if (t == t_dma)
+        {
+            g.dma_done = -1;
+            StoreSample(t);
+            end += g.p->spi_cb;
+        }
+        else
+        {
+            // ETH_IRQHandler: 一帧发完, 释放描述符并续发当前块
+            g.wired++;
+            g.in_flight--;
+            g.r.packets++;
+            if (g.wired == g.block_last_pkt)
+            {
+                double lat = (t - g.block_ready_time) / (CPU_HZ / 1e3);
+                if (lat > g.r.max_block_lat_ms)
+                {
+                    g.r.max_block_lat_ms = lat;
+                }
+            }
+            g.wire_done = -1;
+            if (g.in_flight > 0)
+            {
+                WireStart(t);
+            }
+            end += g.p->eth_isr;
+            if (g.block_pending)
+            {
+                Post(t);
+                end += g.p->pkt_send;
+            }
+        }
+    }
+    g.now = end;
+}
+
+static SimResult Run(const SimParams *p, uint32_t arr)
+{
+    uint32_t block_bytes = p->channels * STREAM_FRAMES_PER_BLOCK * 2U;
+    int64_t stop;
+    uint32_t n;
+
+    memset(&g, 0, sizeof(g));
+    g.p = p;
+    g.rng = 12345;
+    // TIM2 以84MHz计数, 周期为 ARR+1 个定时器时钟
+    g.tick_period = (int64_t)(arr + 1U) * 2;
+    g.next_tick = g.tick_period;
+    g.dma_done = -1;
+    g.wire_done = -1;
+    g.block_samples = p->channels * STREAM_FRAMES_PER_BLOCK;
+    g.packets_per_block = (block_bytes + p->payload - 1U) / p->payload;
+    g.last_len = block_bytes - (g.packets_per_block - 1U) * p->payload;
+    g.wire_cycles = (int64_t)((p->payload + FRAME_OVERHEAD) * WIRE_CYCLES_PER_BYTE + 0.5);
+    g.wire_cycles_last = (int64_t)(((g.last_len < 18U ? 18U : g.last_len) + FRAME_OVERHEAD) * WIRE_CYCLES_PER_BYTE + 0.5);
+    stop = (int64_t)(p->seconds * CPU_HZ);
+
+    while (g.now < stop)
+    {
+        int64_t start = g.now;
+
+        // MX_LWIP_Process, Telemetry_Poll, Log_Process 等
+        RunMain(p->loop_fixed + (p->jitter ? (int64_t)(Rand() % (uint32_t)p->jitter) : 0));
+
+        // ADC_Processing_Task: 任务1 启动一次采集
+        if (g.flag)
+        {
+            g.flag = 0;
+            RunMain(p->setup);
+            g.dma_done = g.now + (int64_t)SPI_BITS * p->spi_presc * 2;
+        }
+        // 任务2 发送, 发送环满时返回
+        for (n = 0; g.block_pending && g.in_flight < p->ring && (p->burst == 0 || n < p->burst); n++)
+        {
+            RunMain(p->pkt_send);
+            if (g.block_pending && g.in_flight < p->ring)
+            {
+                Post(g.now);
+            }
+        }
+
+        if ((g.now - start) / (CPU_HZ / 1e6) > g.r.max_loop_us)
+        {
+            g.r.max_loop_us = (g.now - start) / (CPU_HZ / 1e6);
+        }
+    }
+    g.r.wire_busy = (double)g.wire_busy / (double)g.now;
+    return g.r;
+}
+
+static double ArrToRate(uint32_t arr)
+{
+    return TIM_HZ / (arr + 1.0);
+}
+
+static uint32_t RateToArr(double rate_hz)
+{
+    return (uint32_t)(TIM_HZ / rate_hz + 0.5) - 1U;
+}
+
+static int GapFree(const SimResult *r)
+{
+    return r->skips == 0 && r->blocks_dropped == 0;
+}
+
+static void Print(uint32_t arr, const SimResult *r)
+{
+    printf("ARR=%-5u %9.0f Hz  ticks=%-8llu samples=%-8llu skipped=%-7llu gaps=%-6llu unlocated=%-4llu "
+           "mismatch=%llu  blocks=%llu dropped=%llu  loop_max=%.1fus  lat=%.2fus block_lat=%.2fms wire=%.0f%%\n",
+           arr, ArrToRate(arr), (unsigned long long)r->ticks, (unsigned long long)r->samples,
+           (unsigned long long)r->skips, (unsigned long long)r->gaps,
+           (unsigned long long)r->unlocated, (unsigned long long)r->mismatches,
+           (unsigned long long)r->blocks, (unsigned long long)r->blocks_dropped, r->max_loop_us,
+           r->max_sample_lat_us, r->max_block_lat_ms, 100.0 * r->wire_busy);
+}
+
+/**
+ * @brief 二分查找 [arr_lo, arr_hi] 内不出现缺口的最小自动重装值 (缺口数随采样率单调增加)
+ * @retval 0: arr_hi 处已有缺口; -1: 时间戳还原校验失败
+ */
+static int Search(const SimParams *p, uint32_t arr_lo, uint32_t arr_hi, int verbose,
+                  uint32_t *best_arr, SimResult *best)
+{
+    SimResult r = Run(p, arr_hi);
+
+    if (verbose)
+    {
+        Print(arr_hi, &r);
+    }
+    if (r.mismatches)
+    {
+        return -1;
+    }
+    if (!GapFree(&r))
+    {
+        return 0;
+    }
+    *best_arr = arr_hi;
+    *best = r;
+    while (arr_lo < *best_arr)
+    {
+        uint32_t mid = arr_lo + (*best_arr - arr_lo) / 2;
+
+        r = Run(p, mid);
+        if (verbose)
+        {
+            Print(mid, &r);
+        }
+        if (r.mismatches)
+        {
+            return -1;
+        }
+        if (GapFree(&r))
+        {
+            *best_arr = mid;
+            *best = r;
+        }
+        else
+        {
+            arr_lo = mid + 1;
+        }
+    }
+    return 1;
+}
+
+static void Usage(void)
+{
+    fprintf(stderr, "usage: tick_sim [-t s] [-l cyc] [-j cyc] [-S cyc] [-b cyc] [-i cyc] [-c cyc] [-e cyc] [-E cyc]\n"
+                    "                [-p presc] [-n channels] [-u payload] [-r ring] [-w packets]\n"
+                    "                rate <Hz> | search [lo] [hi] | sweep\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    SimParams p = { 2.0, 300, 100, 250, 1000, 80, 150, 24, 60, 4, STREAM_CHANNELS, STREAM_UDP_CHUNK_SIZE, 8, 0 };
+    static const uint32_t sweep_presc[] = { 4, 8, 16 };
+    static const uint32_t sweep_channels[] = { 4, 8 };
+    static const uint32_t sweep_payload[] = { 512, 1024, 1440 };
+    int fixed_presc = 0, fixed_channels = 0, fixed_payload = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:l:j:S:b:i:c:e:E:p:n:u:r:w:")) != -1)
+    {
+        switch (opt)
+        {
+        case 't': p.seconds = atof(optarg); break;
+        case 'l': p.loop_fixed = atoll(optarg); break;
+        case 'j': p.jitter = atoll(optarg); break;
+        case 'S': p.setup = atoll(optarg); break;
+        case 'b': p.pkt_send = atoll(optarg); break;
+        case 'i': p.tim2_isr = atoll(optarg); break;
+        case 'c': p.spi_cb = atoll(optarg); break;
+        case 'e': p.isr_overhead = atoll(optarg); break;
+        case 'E': p.eth_isr = atoll(optarg); break;
+        case 'p': p.spi_presc = (uint32_t)atoi(optarg); fixed_presc = 1; break;
+        case 'n': p.channels = (uint32_t)atoi(optarg); fixed_channels = 1; break;
+        case 'u': p.payload = (uint32_t)atoi(optarg); fixed_payload = 1; break;
+        case 'r': p.ring = (uint32_t)atoi(optarg); break;
+        case 'w': p.burst = (uint32_t)atoi(optarg); break;
+        default: Usage();
+        }
+    }
+    if (optind >= argc || p.spi_presc < 2 || (p.spi_presc & (p.spi_presc - 1)) || p.spi_presc > 256 ||
+        p.channels < 1 || p.channels > 8 || p.payload < 16 || p.payload > 1472 || p.ring < 1)
+    {
+        Usage();
+    }
+    printf("loop=%lld+rand(%lld) setup=%lld packet=%lld isr=%lld cb=%lld eth_isr=%lld entry/exit=%lld cycles, "
+           "ring=%u burst=%u, %.1fs per rate\n",
+           (long long)p.loop_fixed, (long long)p.jitter, (long long)p.setup, (long long)p.pkt_send,
+           (long long)p.tim2_isr, (long long)p.spi_cb, (long long)p.eth_isr, (long long)p.isr_overhead,
+           p.ring, p.burst, p.seconds);
+
+    if (strcmp(argv[optind], "rate") == 0 && optind + 1 < argc)
+    {
+        uint32_t arr = RateToArr(atof(argv[optind + 1]));
+        SimResult r = Run(&p, arr);
+        Print(arr, &r);
+        return r.mismatches ? 1 : 0;
+    }
+    if (strcmp(argv[optind], "search") == 0)
+    {
+        double lo = (optind + 1 < argc) ? atof(argv[optind + 1]) : 5000.0;
+        double hi = (optind + 2 < argc) ? atof(argv[optind + 2]) : 400000.0;
+        uint32_t best_arr;
+        SimResult best;
+        int ret = Search(&p, RateToArr(hi), RateToArr(lo), 1, &best_arr, &best);
+
+        if (ret < 0)
+        {
+            printf("timestamp reconstruction mismatch\n");
+            return 1;
+        }
+        if (ret == 0)
+        {
+            printf("gaps already at the lower bound\n");
+            return 1;
+        }
+        printf("max gap-free rate: ARR=%u, %.0f Hz (%.2f us/sample), sample latency max %.2f us, "
+               "block latency max %.2f ms\n",
+               best_arr, ArrToRate(best_arr), 1e6 / ArrToRate(best_arr), best.max_sample_lat_us,
+               best.max_block_lat_ms);
+        return 0;
+    }
+    if (strcmp(argv[optind], "sweep") == 0)
+    {
+        size_t i, j, k;
+        int fail = 0;
+
+        printf("presc  SCLK(MHz)  ch  payload  pkts/blk   ARR    rate(Hz)  per-ch(Hz)  lat(us)  blk_lat(ms)  "
+               "loop_max(us)  wire\n");
+        for (i = 0; i < (fixed_presc ? 1 : sizeof(sweep_presc) / sizeof(sweep_presc[0])); i++)
+        {
+            for (j = 0; j < (fixed_channels ? 1 : sizeof(sweep_channels) / sizeof(sweep_channels[0])); j++)
+            {
+                for (k = 0; k < (fixed_payload ? 1 : sizeof(sweep_payload) / sizeof(sweep_payload[0])); k++)
+                {
+                    SimParams q = p;
+                    uint32_t best_arr;
+                    SimResult best;
+                    double sclk;
+                    int ret;
+
+                    q.spi_presc = fixed_presc ? p.spi_presc : sweep_presc[i];
+                    q.channels = fixed_channels ? p.channels : sweep_channels[j];
+                    q.payload = fixed_payload ? p.payload : sweep_payload[k];
+                    sclk = TIM_HZ / q.spi_presc;
+                    ret = Search(&q, RateToArr(400000.0), RateToArr(5000.0), 0, &best_arr, &best);
+                    printf("%5u  %9.2f%s %3u  %7u  %8u  ",
+                           q.spi_presc, sclk / 1e6, (sclk > ADS_SCLK_MAX_HZ) ? "!" : " ", q.channels, q.payload,
+                           (q.channels * STREAM_FRAMES_PER_BLOCK * 2U + q.payload - 1U) / q.payload);
+                    if (ret <= 0)
+                    {
+                        printf("%s\n", (ret < 0) ? "timestamp reconstruction mismatch" : "gaps at 5 kHz");
+                        fail |= (ret < 0);
+                        continue;
+                    }
+                    printf("%5u  %9.0f  %10.0f  %7.2f  %11.2f  %12.1f  %3.0f%%\n",
+                           best_arr, ArrToRate(best_arr), ArrToRate(best_arr) / q.channels,
+                           best.max_sample_lat_us, best.max_block_lat_ms, best.max_loop_us, 100.0 * best.wire_busy);
+                }
+            }
+        }
+        printf("(!: SCLK above the ADS8688 limit of %.0f MHz)\n", ADS_SCLK_MAX_HZ / 1e6);
+        return fail;
+    }
+    Usage();
+    return 2;
+}
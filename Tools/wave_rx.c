@@ -0,0 +1,1830 @@
+/**
+ ******************************************************************************
+ * @file    wave_rx.c
+ * @brief   PC端波形流的高吞吐接收程序: recvmmsg 批量收包, 在帧缓冲区内原地重组, 经无锁环交给校验/转换和写盘线程
+ *
+ * @details
+ * 编译: gcc -O2 -Wall -pthread -I../Inc -o wave_rx wave_rx.c
+ * (统计堆分配次数时替换了 malloc 等函数, 转调 glibc 的 __libc_malloc 等, 只支持 glibc)
+ *
+ * 用法:
+ *   wave_rx [选项]
+ * 选项:
+ *   -p <port>       接收端口 (默认 5001, 即 DEST_PORT)
+ *   -B <n>          每次 recvmmsg 的最大包数 (默认64)
+ *   -w <n>          收包线程数 (默认1, socket 后端), 各自一个 SO_REUSEPORT 套接字, 绑定到同一端口
+ *   -a <cpu>        收包线程 i 固定在 CPU (cpu + i) % 核数 上 (默认0), -1 不固定
+ *   -s <mode>       多个收包线程时的分流: addr 按源IP取模 (SO_ATTACH_REUSEPORT_CBPF, 默认),
+ *                   hash 内核默认的四元组哈希
+ *   -c <n>          消费线程数 (默认1), 各板子按编号分给消费线程, 同一板子的帧保持顺序
+ *   -n <n>          帧缓冲区个数 (默认1024)
+ *   -v <mode>       消费线程的处理: tagged 逐样本校验 stream_gen/hostsim 的 tagged 波形 (默认),
+ *                   none 不读数据 (只测接收路径)
+ *   -o <file>       消费线程把每块转换为毫伏 (按通道排列的float), 由写盘线程写入 file (可为 /dev/null);
+ *                   不给出时流水线止于消费线程
+ *   -N <n>          转换缓冲区个数 (默认256)
+ *   -A              稳态 (启动 ALLOC_WARMUP_S 秒之后到退出) 有堆分配时返回非0
+ *   -g              socket 后端启用 UDP_GRO (内核把同一流的连续数据报合并成一个大缓冲区交付)
+ *   -b <backend>    socket: UDP套接字 + recvmmsg (默认); ring: AF_PACKET TPACKET_V3 内存映射环 (需要 CAP_NET_RAW)
+ *   -i <ifname>     ring 后端抓包的网口 (默认 lo)
+ *   -R <MB>         socket: SO_RCVBUF; ring: 环的大小 (默认16, socket 有权限时用 SO_RCVBUFFORCE 突破 rmem_max)
+ *   -t <s>          运行时长, 0 运行到 Ctrl-C (默认0)
+ *
+ * 取代 README 第5节的Python接收端 (每包一次 recvfrom, frame_buffer += packet 拼接)。
+ * 线上格式见 stream_gen.c: 每块 16384 字节切成 11 个 1440 字节的包和一个 544 字节的包, 没有包头,
+ * 按源地址和端口区分板子, 按到达顺序确定包在块内的位置。544 字节的包标志一块结束;
+ * 块内有包丢失时整块丢弃 (dropped), 乱序和重复只能由消费线程的 tagged 校验发现。
+ *
+ * - **帧缓冲区**: 启动时一次分配, 每个帧缓冲区占 12 x 1440 字节 (64字节对齐), 第 i 个包的位置
+ *   正好是块内偏移 i*1440, 前16384字节即为完整的一块。空闲的帧缓冲区放在无锁MPMC环中。
+ * - **原地重组**: 收包前按 "下一个包来自上一个包的板子且按顺序到达" 预测每个包的位置,
+ *   recvmmsg 的 iovec 直接指向该板子当前帧缓冲区的剩余位置, 之后是预留的空帧缓冲区。
+ *   预测命中的包不拷贝 (inplace); 多块板子交错到达等预测不中的包拷贝一次到所属板子的帧缓冲区 (copied)。
+ * - **交付**: 完整的块通过每个消费线程一个的SPSC无锁环交出; 消费线程处理完把帧缓冲区放回空闲环。
+ *   空闲环为空或消费线程跟不上时丢弃新块 (pool_empty / queue_full), 不阻塞收包。
+ *
+ * - **流水线** (-o): 收包 --SPSC--> 校验/转换 (消费线程) --MPMC--> 写盘线程。帧缓冲区在转换后即放回
+ *   空闲环; 转换结果放在另一组启动时分配的对齐缓冲区 (每块 8 x 1024 个 float, 与 README 的
+ *   convert_raw_to_mv 相同: ADS8688 默认量程 ±2.5 x VREF, 直接二进制码, 1 LSB = 0.3125 mV) 中,
+ *   写盘线程写完放回它的空闲MPMC环。没有空闲转换缓冲区或写盘跟不上时丢弃该块 (cvt_drops)。
+ *   文件中每块为 uint32 板子编号、uint32 块序号和 float[8][1024] (本机字节序)。
+ *   整个程序的 malloc/calloc/realloc/aligned_alloc/posix_memalign 调用都被计数, 退出时打印稳态
+ *   (启动 ALLOC_WARMUP_S 秒之后) 的次数; 所有缓冲区、环和统计都在启动时分配, 稳态应为0。
+ * - **多收包线程**: -w N 时每个线程有自己的套接字、板子表和落点, 同一块板子的包总由同一个线程收取
+ *   (addr: 内核按 reuseport 组里挂的经典BPF程序 "源IP % N" 选择套接字; hash: 源地址和端口的哈希),
+ *   各线程之间不共享可写状态, 只有新板子编号的分配是一次原子加。每个 (收包线程, 消费线程) 之间
+ *   一个SPSC环。socket 后端用 SO_RXQ_OVFL 读出套接字队列满时内核丢弃的包数 (kdrops)。
+ *   stream_gen -S 127.0.0.10 让每块模拟板子有自己的源IP, addr 分流才能把它们分开。
+ * - **UDP_GRO** (-g): 每个 recvmmsg 消息的落点是一整个帧缓冲区的剩余部分 (按1440字节段的间距正好
+ *   对上块内位置), 之后接一个64KB的溢出区; 上一批没有收到合并的缓冲区时仍按包准备落点 (加溢出区)。
+ *   控制消息 UDP_GRO 给出段长, 大缓冲区按段长切开后逐段交给重组, 落在预测位置上的段同样不拷贝;
+ *   没有该控制消息的是单个数据报。内核不支持 UDP_GRO 时
+ *   打印提示并退回逐个数据报接收。固件逐包发送, 只有经过网卡/veth 的 NAPI GRO 才会合并;
+ *   在 lo 上可用 stream_gen -G (UDP_SEGMENT) 发送, 内核把整块原样交给启用了 GRO 的套接字,
+ *   未启用时在交付前切成12个数据报。
+ * - **ring 后端**: PACKET_RX_RING (TPACKET_V3, 1MB的块) 映射到用户空间, 经典BPF过滤器只放行
+ *   "IPv4、非分片、UDP目的端口为 port" 的帧。收包线程在环块内原地解析以太网/IP/UDP头,
+ *   负载直接从环块拷进板子的帧缓冲区 (取代 recvmmsg 中内核到用户的那次拷贝, 没有每批一次的系统调用),
+ *   一块处理完即交还内核; 环中没有就绪的块时 poll 等待。同一端口另开一个挂着 "全部丢弃"
+ *   过滤器的UDP套接字, 使内核不回 ICMP 端口不可达, 也不在套接字队列里多存一份。
+ *   内核在环满时丢弃的包来自 PACKET_STATISTICS (kdrops)。
+ *
+ * 主线程每秒打印一次接收速率; 退出时打印总计和 "每核包率" (收包线程的包数 / 收包线程的CPU时间)。
+ * 同时给出每Gbit负载所用的CPU: 收包线程的CPU时间, 以及整机软中断的CPU时间 (/proc/stat,
+ * 内核协议栈和写 TPACKET 环都在软中断中完成, 两种后端的这部分开销不在收包线程上)。
+ *
+ * 板子数与收包线程数的扩展性 (块速率为标称值的 r 倍, 丢包率 = kdrops / (收到 + kdrops)):
+ *   for w in 1 2 4; do for b in 1 2 4 8 16 32 64; do
+ *     ./wave_rx -w $w -t 6 | grep total & sleep 0.3
+ *     ./stream_gen -b $b -S 127.0.0.10 -r 4 -t 5 > /dev/null; wait
+ *   done; done
+ *
+ * veth 对上测试 ring 后端 (发送端在另一个网络命名空间):
+ *   ip netns add gen
+ *   ip link add wrx0 type veth peer name wrx1 && ip link set wrx1 netns gen
+ *   ip addr add 10.99.0.1/24 dev wrx0 && ip link set wrx0 up
+ *   ip netns exec gen sh -c "ip addr add 10.99.0.2/24 dev wrx1 && ip link set wrx1 up && ip link set lo up"
+ *   ./wave_rx -b ring -i wrx0 -t 12 &
+ *   ip netns exec gen ./stream_gen -d 10.99.0.1 -r 0 -t 10
+ ******************************************************************************
+ */
+
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/filter.h>
+#include <linux/if_packet.h>
+#include <net/ethernet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stream_proto.h"
+
+// 与 adc_processing.h 保持一致
+#define DEFAULT_RX_PORT     5001            // DEST_PORT
+#define TAG_MOD             0x2000U         // HOSTSIM_TAG_MOD
+
+#define FRAME_STRIDE        (STREAM_UDP_PACKETS_PER_BLOCK * STREAM_UDP_CHUNK_SIZE)
+#define MAX_BATCH           1024
+#define MAX_SPARES          (MAX_BATCH / STREAM_UDP_PACKETS_PER_BLOCK + 2)
+#define MAX_BOARDS          1024
+#define MAX_CONSUMERS       16
+#define MAX_WORKERS         64
+#define GRO_MAX_BYTES       65536           // 一个GRO缓冲区的上限
+#define CONSUMER_RING_SIZE  256             // 2的幂
+#define NO_FRAME            0xFFFFFFFFU
+#define REPORT_INTERVAL_S   1.0
+#define ALLOC_WARMUP_S      1.0             // 之后的堆分配计入稳态
+#define ADS_LSB_MV          0.3125          // ±10.24V / 65536
+#define RING_BLOCK_SIZE     (1U << 20)      // TPACKET_V3 块的大小
+#define RING_FRAME_SIZE     2048            // 每个包的最大占用 (tpacket3_hdr + sockaddr_ll + 以太网帧)
+#define RING_BLOCK_TOV_MS   2               // 块未满时交给用户的超时
+
+#ifndef PACKET_IGNORE_OUTGOING
+#define PACKET_IGNORE_OUTGOING  23
+#endif
+
+typedef char frame_stride_check[(FRAME_STRIDE % 64 == 0 && FRAME_STRIDE >= STREAM_BLOCK_BYTES) ? 1 : -1];
+typedef char last_chunk_check[(STREAM_UDP_LAST_CHUNK_SIZE > 0 && STREAM_UDP_LAST_CHUNK_SIZE < STREAM_UDP_CHUNK_SIZE) ? 1 : -1];
+
+typedef enum { VERIFY_TAGGED = 0, VERIFY_NONE } VerifyMode;
+typedef enum { BACKEND_SOCKET = 0, BACKEND_RING } Backend;
+
+// ============================ 堆分配计数 ============================
+// 替换 glibc 的分配函数 (glibc 内部也经由这些符号分配), 统计调用次数后转调原实现
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t align, size_t size);
+extern void  __libc_free(void *ptr);
+
+static _Atomic uint64_t g_heap_allocs;
+
+void *malloc(size_t size)
+{
+    atomic_fetch_add_explicit(&g_heap_allocs, 1, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    atomic_fetch_add_explicit(&g_heap_allocs, 1, memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    atomic_fetch_add_explicit(&g_heap_allocs, 1, memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+void *aligned_alloc(size_t align, size_t size)
+{
+    atomic_fetch_add_explicit(&g_heap_allocs, 1, memory_order_relaxed);
+    return __libc_memalign(align, size);
+}
+
+void *memalign(size_t align, size_t size)
+{
+    atomic_fetch_add_explicit(&g_heap_allocs, 1, memory_order_relaxed);
+    return __libc_memalign(align, size);
+}
+
+int posix_memalign(void **out, size_t align, size_t size)
+{
+    atomic_fetch_add_explicit(&g_heap_allocs, 1, memory_order_relaxed);
+    *out = __libc_memalign(align, size);
+    return (*out != NULL) ? 0 : ENOMEM;
+}
+
+void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+
+// ============================ 无锁环 ============================
+// MPMC: 有界环, 每个单元带序号 (D. Vyukov); 容量为2的幂
+typedef struct {
+    _Atomic uint64_t seq;
+    uint32_t val;
+} MpmcCell;
+
+typedef struct {
+    MpmcCell *cells;
+    uint64_t mask;
+    _Alignas(64) _Atomic uint64_t head;     // 下一个写入位置
+    _Alignas(64) _Atomic uint64_t tail;     // 下一个读出位置
+} MpmcRing;
+
+static int Mpmc_Init(MpmcRing *r, uint32_t size)
+{
+    uint32_t i;
+
+    r->cells = aligned_alloc(64, ((size_t)size * sizeof(MpmcCell) + 63) & ~(size_t)63);
+    if (r->cells == NULL)
+    {
+        return 0;
+    }
+    for (i = 0; i < size; i++)
+    {
+        atomic_init(&r->cells[i].seq, i);
+    }
+    r->mask = size - 1U;
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    return 1;
+}
+
+static int Mpmc_Push(MpmcRing *r, uint32_t val)
+{
+    uint64_t pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+
+    for (;;)
+    {
+        MpmcCell *c = &r->cells[pos & r->mask];
+        uint64_t seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+        int64_t diff = (int64_t)(seq - pos);
+
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&r->head, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed))
+            {
+                c->val = val;
+                atomic_store_explicit(&c->seq, pos + 1, memory_order_release);
+                return 1;
+            }
+        }
+        else if (diff < 0)
+        {
+            return 0;                       // 满
+        }
+        else
+        {
+            pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+        }
+    }
+}
+
+static int Mpmc_Pop(MpmcRing *r, uint32_t *val)
+{
+    uint64_t pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+
+    for (;;)
+    {
+        MpmcCell *c = &r->cells[pos & r->mask];
+        uint64_t seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+        int64_t diff = (int64_t)(seq - (pos + 1));
+
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&r->tail, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed))
+            {
+                *val = c->val;
+                atomic_store_explicit(&c->seq, pos + r->mask + 1, memory_order_release);
+                return 1;
+            }
+        }
+        else if (diff < 0)
+        {
+            return 0;                       // 空
+        }
+        else
+        {
+            pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        }
+    }
+}
+
+// SPSC: 收包线程 -> 一个消费线程
+typedef struct {
+    uint32_t buf[CONSUMER_RING_SIZE];
+    _Alignas(64) _Atomic uint32_t head;
+    _Alignas(64) _Atomic uint32_t tail;
+} SpscRing;
+
+static int Spsc_Push(SpscRing *r, uint32_t val)
+{
+    uint32_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+
+    if (head - atomic_load_explicit(&r->tail, memory_order_acquire) == CONSUMER_RING_SIZE)
+    {
+        return 0;
+    }
+    r->buf[head & (CONSUMER_RING_SIZE - 1)] = val;
+    atomic_store_explicit(&r->head, head + 1, memory_order_release);
+    return 1;
+}
+
+static int Spsc_Pop(SpscRing *r, uint32_t *val)
+{
+    uint32_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+
+    if (atomic_load_explicit(&r->head, memory_order_acquire) == tail)
+    {
+        return 0;
+    }
+    *val = r->buf[tail & (CONSUMER_RING_SIZE - 1)];
+    atomic_store_explicit(&r->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+// ============================ 帧缓冲区池 ============================
+typedef struct {
+    uint32_t board;
+    uint32_t seq;                           // 该板子的第几块 (收包线程计数, 含丢弃的块)
+} FrameMeta;
+
+static struct {
+    uint8_t  *slab;
+    FrameMeta *meta;
+    uint32_t count;
+    MpmcRing free;
+} g_pool;
+
+static inline uint8_t *FrameData(uint32_t f)
+{
+    return g_pool.slab + (size_t)f * FRAME_STRIDE;
+}
+
+static int Pool_Init(uint32_t count)
+{
+    uint32_t size = 1, i;
+
+    while (size < count)
+    {
+        size <<= 1;
+    }
+    g_pool.count = count;
+    g_pool.slab = aligned_alloc(64, (size_t)count * FRAME_STRIDE);
+    g_pool.meta = calloc(count, sizeof(FrameMeta));
+    if (g_pool.slab == NULL || g_pool.meta == NULL || !Mpmc_Init(&g_pool.free, size))
+    {
+        return 0;
+    }
+    // 先把每页碰一遍, 避免运行中的缺页
+    memset(g_pool.slab, 0, (size_t)count * FRAME_STRIDE);
+    for (i = 0; i < count; i++)
+    {
+        Mpmc_Push(&g_pool.free, i);
+    }
+    return 1;
+}
+
+// ============================ 统计 ============================
+// 各线程在本地累加, 每批结束后以 relaxed 原子写发布给主线程
+typedef struct {
+    uint64_t packets, bytes, batches;
+    uint64_t frames, dropped, bad_len, inplace, copied, pool_empty, queue_full;
+    uint64_t kdrops;                        // 内核因套接字队列或环满丢弃的包
+    uint64_t gro_bufs, gro_segs;            // 带 UDP_GRO 控制消息的缓冲区及其中的段数
+    uint64_t boards, cpu_ns;
+} RxStats;
+
+typedef struct {
+    _Atomic uint64_t v[sizeof(RxStats) / sizeof(uint64_t)];
+} RxStatsPub;
+
+static void Stats_Publish(RxStatsPub *pub, const RxStats *s)
+{
+    const uint64_t *src = (const uint64_t *)s;
+    size_t i;
+
+    for (i = 0; i < sizeof(RxStats) / sizeof(uint64_t); i++)
+    {
+        atomic_store_explicit(&pub->v[i], src[i], memory_order_relaxed);
+    }
+}
+
+static void Stats_Read(RxStatsPub *pub, RxStats *s)
+{
+    uint64_t *dst = (uint64_t *)s;
+    size_t i;
+
+    for (i = 0; i < sizeof(RxStats) / sizeof(uint64_t); i++)
+    {
+        dst[i] = atomic_load_explicit(&pub->v[i], memory_order_relaxed);
+    }
+}
+
+static uint64_t ThreadCpuNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static double NowSec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// ============================ 转换与写盘 ============================
+typedef struct {
+    uint32_t board;
+    uint32_t seq;
+    float    mv[STREAM_CHANNELS][STREAM_FRAMES_PER_BLOCK];
+} CvtBlock;                                 // 也是写入文件的格式
+
+static struct {
+    int      enabled;
+    CvtBlock *blocks;
+    uint32_t count;
+    MpmcRing free;                          // 写盘线程 -> 消费线程
+    MpmcRing out;                           // 消费线程 -> 写盘线程
+    int      fd;
+    pthread_t th;
+    _Atomic uint64_t written, bytes, write_errors, cpu_ns;
+    _Atomic int producers_done;
+} g_cvt;
+
+static int Cvt_Init(uint32_t count, const char *path)
+{
+    uint32_t size = 1, i;
+
+    while (size < count)
+    {
+        size <<= 1;
+    }
+    g_cvt.count = count;
+    g_cvt.blocks = aligned_alloc(64, (size_t)count * sizeof(CvtBlock));
+    if (g_cvt.blocks == NULL || !Mpmc_Init(&g_cvt.free, size) || !Mpmc_Init(&g_cvt.out, size))
+    {
+        return 0;
+    }
+    memset(g_cvt.blocks, 0, (size_t)count * sizeof(CvtBlock));
+    for (i = 0; i < count; i++)
+    {
+        Mpmc_Push(&g_cvt.free, i);
+    }
+    g_cvt.fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (g_cvt.fd < 0)
+    {
+        perror(path);
+        return 0;
+    }
+    g_cvt.enabled = 1;
+    return 1;
+}
+
+/**
+ * @brief 帧交织的原始码 -> 按通道排列的毫伏值
+ */
+static void Cvt_Block(CvtBlock *dst, const uint16_t *src)
+{
+    uint32_t f, c;
+
+    for (f = 0; f < STREAM_FRAMES_PER_BLOCK; f++)
+    {
+        for (c = 0; c < STREAM_CHANNELS; c++)
+        {
+            dst->mv[c][f] = (float)(((int32_t)le16toh(src[f * STREAM_CHANNELS + c]) - 32768) * ADS_LSB_MV);
+        }
+    }
+}
+
+static void *WriterThread(void *arg)
+{
+    uint64_t written = 0, bytes = 0, errors = 0;
+    uint32_t idle = 0;
+
+    (void)arg;
+    for (;;)
+    {
+        uint32_t k;
+        const uint8_t *p;
+        size_t left;
+
+        if (!Mpmc_Pop(&g_cvt.out, &k))
+        {
+            if (atomic_load_explicit(&g_cvt.producers_done, memory_order_acquire))
+            {
+                if (!Mpmc_Pop(&g_cvt.out, &k))
+                {
+                    break;
+                }
+            }
+            else
+            {
+                if (++idle > 64)
+                {
+                    struct timespec ts = { 0, 50000 };
+                    nanosleep(&ts, NULL);
+                }
+                else
+                {
+                    sched_yield();
+                }
+                continue;
+            }
+        }
+        idle = 0;
+        p = (const uint8_t *)&g_cvt.blocks[k];
+        left = sizeof(CvtBlock);
+        while (left > 0)
+        {
+            ssize_t r = write(g_cvt.fd, p, left);
+
+            if (r < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (r <= 0)
+            {
+                errors++;
+                break;
+            }
+            p += r;
+            left -= (size_t)r;
+            bytes += (uint64_t)r;
+        }
+        written++;
+        Mpmc_Push(&g_cvt.free, k);
+        atomic_store_explicit(&g_cvt.written, written, memory_order_relaxed);
+        atomic_store_explicit(&g_cvt.bytes, bytes, memory_order_relaxed);
+        atomic_store_explicit(&g_cvt.write_errors, errors, memory_order_relaxed);
+        if ((written & 63U) == 0)
+        {
+            atomic_store_explicit(&g_cvt.cpu_ns, ThreadCpuNs(), memory_order_relaxed);
+        }
+    }
+    atomic_store_explicit(&g_cvt.cpu_ns, ThreadCpuNs(), memory_order_relaxed);
+    return NULL;
+}
+
+// ============================ 消费线程 ============================
+typedef struct {
+    uint16_t next_tag;                      // 下一块通道0第一个样本的序号
+    uint8_t  seen;
+} TagState;
+
+typedef struct {
+    SpscRing rings[MAX_WORKERS];            // 每个收包线程一个
+    pthread_t th;
+    VerifyMode verify;
+    TagState tags[MAX_BOARDS];
+    _Atomic uint64_t frames, tag_errors, seq_gaps, cvt_drops, cpu_ns;
+} Consumer;
+
+static Consumer *g_consumers;
+static uint32_t  g_num_consumers = 1;
+static uint32_t  g_num_workers = 1;
+static _Atomic uint32_t g_next_board;       // 板子编号 (各收包线程共用)
+static volatile sig_atomic_t g_stop = 0;
+static _Atomic int g_rx_done;
+
+static void OnSignal(int sig)
+{
+    (void)sig;
+    g_stop = 1;
+}
+
+/**
+ * @brief 校验一块 tagged 波形: 样本 (f, c) 应为 (c<<13) | ((base + f) & 0x1FFF)
+ * @return 不符的样本数; *gap 为与上一块之间缺少的块数
+ */
+static uint32_t VerifyTagged(TagState *st, const uint16_t *s, uint32_t *gap)
+{
+    uint16_t base = (uint16_t)(le16toh(s[0]) & (TAG_MOD - 1U));
+    uint32_t bad = 0, f, c;
+
+    *gap = 0;
+    if (st->seen && base != st->next_tag)
+    {
+        *gap = ((base - st->next_tag) & (TAG_MOD - 1U)) / STREAM_FRAMES_PER_BLOCK;
+        if (*gap == 0)
+        {
+            bad++;                          // 不是整块的偏移: 块内乱序或重复
+        }
+    }
+    for (f = 0; f < STREAM_FRAMES_PER_BLOCK; f++)
+    {
+        uint16_t tag = (uint16_t)((base + f) & (TAG_MOD - 1U));
+
+        for (c = 0; c < STREAM_CHANNELS; c++)
+        {
+            bad += (le16toh(s[f * STREAM_CHANNELS + c]) != (uint16_t)((c << 13) | tag));
+        }
+    }
+    st->next_tag = (uint16_t)((base + STREAM_FRAMES_PER_BLOCK) & (TAG_MOD - 1U));
+    st->seen = 1;
+    return bad;
+}
+
+/**
+ * @brief 从 *w 开始轮流试各收包线程的环, 取到一个即返回 (同一板子只走一个环, 顺序不变)
+ */
+static int Consumer_Pop(Consumer *cs, uint32_t *w, uint32_t *f)
+{
+    uint32_t i;
+
+    for (i = 0; i < g_num_workers; i++)
+    {
+        uint32_t k = (*w + i) % g_num_workers;
+
+        if (Spsc_Pop(&cs->rings[k], f))
+        {
+            *w = (k + 1) % g_num_workers;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void *ConsumerThread(void *arg)
+{
+    Consumer *cs = arg;
+    uint64_t frames = 0, errors = 0, gaps = 0, cvt_drops = 0;
+    uint32_t idle = 0, w = 0;
+
+    for (;;)
+    {
+        uint32_t f;
+
+        if (!Consumer_Pop(cs, &w, &f))
+        {
+            if (atomic_load_explicit(&g_rx_done, memory_order_acquire))
+            {
+                // 收包线程都已退出: 再取一次, 仍为空即排空
+                if (!Consumer_Pop(cs, &w, &f))
+                {
+                    break;
+                }
+            }
+            else
+            {
+                if (++idle > 64)
+                {
+                    struct timespec ts = { 0, 50000 };
+                    nanosleep(&ts, NULL);
+                }
+                else
+                {
+                    sched_yield();
+                }
+                continue;
+            }
+        }
+        idle = 0;
+        if (cs->verify == VERIFY_TAGGED)
+        {
+            uint32_t gap;
+            uint32_t bad = VerifyTagged(&cs->tags[g_pool.meta[f].board],
+                                        (const uint16_t *)FrameData(f), &gap);
+
+            errors += (bad != 0);
+            gaps += gap;
+        }
+        if (g_cvt.enabled)
+        {
+            uint32_t k;
+
+            if (!Mpmc_Pop(&g_cvt.free, &k))
+            {
+                cvt_drops++;
+            }
+            else
+            {
+                g_cvt.blocks[k].board = g_pool.meta[f].board;
+                g_cvt.blocks[k].seq = g_pool.meta[f].seq;
+                Cvt_Block(&g_cvt.blocks[k], (const uint16_t *)FrameData(f));
+                Mpmc_Push(&g_cvt.out, k);   // 与空闲环同容量, 不会满
+            }
+            atomic_store_explicit(&cs->cvt_drops, cvt_drops, memory_order_relaxed);
+        }
+        frames++;
+        Mpmc_Push(&g_pool.free, f);
+        atomic_store_explicit(&cs->frames, frames, memory_order_relaxed);
+        atomic_store_explicit(&cs->tag_errors, errors, memory_order_relaxed);
+        atomic_store_explicit(&cs->seq_gaps, gaps, memory_order_relaxed);
+        if ((frames & 63U) == 0)
+        {
+            atomic_store_explicit(&cs->cpu_ns, ThreadCpuNs(), memory_order_relaxed);
+        }
+    }
+    atomic_store_explicit(&cs->cpu_ns, ThreadCpuNs(), memory_order_relaxed);
+    return NULL;
+}
+
+// ============================ 重组 ============================
+typedef struct {
+    uint64_t key;                           // (IPv4 << 16) | port, 0 为空位
+    uint32_t id;
+    uint32_t frame;                         // 正在重组的帧缓冲区, NO_FRAME: 无 (或本块已放弃)
+    uint32_t idx;                           // 下一个包在块内的序号
+    uint32_t seq;
+    uint8_t  discard;                       // 本块已放弃, 等544字节的包后重新开始
+} Board;
+
+typedef struct {
+    Board    boards[MAX_BOARDS * 2];        // 开放寻址哈希表
+    uint32_t nboards;
+    Board   *pred;                          // 上一个包的板子
+    uint32_t spares[MAX_SPARES];            // 预留给下一批落点的空帧缓冲区
+    uint8_t  adopted[MAX_SPARES];
+    uint32_t nspares;
+    uint32_t release[MAX_BATCH * (GRO_MAX_BYTES / FRAME_STRIDE + 3)];  // 本批放弃的帧缓冲区, 批结束后才放回
+                                            // (可能仍是本批的落点); 每个消息至多: GRO缓冲区内的块数+2, 搬移1
+    uint32_t nrelease;
+    uint32_t land_pred;                     // 本批落点用到的上一个板子的帧缓冲区, NO_FRAME: 无
+    uint8_t  land_gro;                      // 本批的落点按帧缓冲区划分 (Rx_Land 的 gro)
+    uint8_t  no_adopt;                      // 不接管预留帧缓冲区 (正在切开一个溢出落点的GRO缓冲区)
+    uint32_t worker;                        // 所属收包线程
+    RxStats  st;
+} RxCtx;
+
+static Board *Board_Lookup(RxCtx *ctx, uint64_t key)
+{
+    uint32_t h = (uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 40) & (MAX_BOARDS * 2 - 1);
+
+    for (;;)
+    {
+        Board *b = &ctx->boards[h];
+
+        if (b->key == key)
+        {
+            return (b->id < MAX_BOARDS) ? b : NULL;
+        }
+        if (b->key == 0)
+        {
+            // 编号用完后仍占一个表项 (id 无效), 之后它的包直接计入 bad
+            b->key = key;
+            b->id = atomic_fetch_add_explicit(&g_next_board, 1, memory_order_relaxed);
+            b->frame = NO_FRAME;
+            ctx->st.boards = ++ctx->nboards;
+            return (b->id < MAX_BOARDS) ? b : NULL;
+        }
+        h = (h + 1) & (MAX_BOARDS * 2 - 1);
+    }
+}
+
+static void Board_Abandon(RxCtx *ctx, Board *b)
+{
+    if (b->frame != NO_FRAME)
+    {
+        ctx->release[ctx->nrelease++] = b->frame;
+        b->frame = NO_FRAME;
+    }
+    ctx->st.dropped++;
+    b->seq++;
+}
+
+/**
+ * @brief 给板子的新块找帧缓冲区: 包正好落在某个未被占用的预留帧缓冲区的开头时直接接管, 否则从池中取
+ */
+static uint32_t Board_TakeFrame(RxCtx *ctx, const uint8_t *data)
+{
+    uint32_t i, f;
+
+    for (i = 0; !ctx->no_adopt && i < ctx->nspares; i++)
+    {
+        if (!ctx->adopted[i] && data == FrameData(ctx->spares[i]))
+        {
+            ctx->adopted[i] = 1;
+            return ctx->spares[i];
+        }
+    }
+    if (!Mpmc_Pop(&g_pool.free, &f))
+    {
+        ctx->st.pool_empty++;
+        return NO_FRAME;
+    }
+    return f;
+}
+
+static void Board_Complete(RxCtx *ctx, Board *b)
+{
+    uint32_t f = b->frame;
+    Consumer *cs = &g_consumers[b->id % g_num_consumers];
+
+    g_pool.meta[f].board = b->id;
+    g_pool.meta[f].seq = b->seq++;
+    b->frame = NO_FRAME;
+    if (!Spsc_Push(&cs->rings[ctx->worker], f))
+    {
+        ctx->st.queue_full++;
+        ctx->release[ctx->nrelease++] = f;
+        return;
+    }
+    ctx->st.frames++;
+}
+
+/**
+ * @brief 处理收到的一个包; data 为包当前所在的位置 (预测的落点或任意缓冲区)
+ */
+static void Rx_Packet(RxCtx *ctx, uint64_t key, const uint8_t *data, uint32_t len)
+{
+    Board *b;
+    uint32_t pos;
+
+    ctx->st.packets++;
+    ctx->st.bytes += len;
+    if ((len != STREAM_UDP_CHUNK_SIZE && len != STREAM_UDP_LAST_CHUNK_SIZE) || (b = Board_Lookup(ctx, key)) == NULL)
+    {
+        ctx->st.bad_len++;
+        return;
+    }
+    ctx->pred = b;
+    pos = b->idx;
+    if (len == STREAM_UDP_CHUNK_SIZE && pos == STREAM_UDP_PACKETS_PER_BLOCK - 1)
+    {
+        // 上一块的最后一个包丢了: 放弃上一块, 本包作为新块的第一个包
+        if (!b->discard)
+        {
+            Board_Abandon(ctx, b);
+        }
+        b->discard = 0;
+        pos = 0;
+    }
+    else if (len == STREAM_UDP_LAST_CHUNK_SIZE && pos != STREAM_UDP_PACKETS_PER_BLOCK - 1)
+    {
+        // 块内有包丢了
+        if (!b->discard)
+        {
+            Board_Abandon(ctx, b);
+        }
+        b->discard = 0;
+        b->idx = 0;
+        return;
+    }
+
+    if (pos == 0)
+    {
+        b->frame = Board_TakeFrame(ctx, data);
+        if (b->frame == NO_FRAME)
+        {
+            b->discard = 1;
+            ctx->st.dropped++;
+            b->seq++;
+        }
+    }
+    if (!b->discard)
+    {
+        uint8_t *dst = FrameData(b->frame) + pos * STREAM_UDP_CHUNK_SIZE;
+
+        if (dst == data)
+        {
+            ctx->st.inplace++;
+        }
+        else
+        {
+            memcpy(dst, data, len);
+            ctx->st.copied++;
+        }
+    }
+    if (pos == STREAM_UDP_PACKETS_PER_BLOCK - 1)
+    {
+        if (!b->discard)
+        {
+            Board_Complete(ctx, b);
+        }
+        b->discard = 0;
+        b->idx = 0;
+    }
+    else
+    {
+        b->idx = pos + 1;
+    }
+}
+
+/**
+ * @brief 一批包处理完: 放回本批放弃的帧缓冲区, 被接管的预留帧缓冲区移出预留表
+ */
+static void Rx_EndBatch(RxCtx *ctx)
+{
+    uint32_t i, s;
+
+    // 被接管的预留帧缓冲区已归板子所有; 未被接管的保留
+    for (i = 0, s = 0; i < ctx->nspares; i++)
+    {
+        if (!ctx->adopted[i])
+        {
+            ctx->spares[s] = ctx->spares[i];
+            ctx->adopted[s++] = 0;
+        }
+    }
+    ctx->nspares = s;
+    for (i = 0; i < ctx->nrelease; i++)
+    {
+        Mpmc_Push(&g_pool.free, ctx->release[i]);
+    }
+    ctx->nrelease = 0;
+}
+
+/**
+ * @brief 准备下一批的落点: 先是上一个包的板子当前帧缓冲区的剩余位置, 然后依次是预留的空帧缓冲区
+ * @param gro 非0时一个落点是一个帧缓冲区的剩余部分 (容纳一个GRO缓冲区), 否则是一个包的位置
+ * @return 落点数 (<= max)
+ */
+static uint32_t Rx_Land(RxCtx *ctx, struct iovec *iov, uint32_t max, int gro)
+{
+    uint32_t n = 0, i, s, f;
+    Board *p = ctx->pred;
+
+    Rx_EndBatch(ctx);
+    ctx->land_pred = NO_FRAME;
+    ctx->land_gro = (uint8_t)gro;
+    if (p != NULL && p->frame != NO_FRAME && !p->discard)
+    {
+        ctx->land_pred = p->frame;
+        if (gro)
+        {
+            iov[n].iov_base = FrameData(p->frame) + p->idx * STREAM_UDP_CHUNK_SIZE;
+            iov[n].iov_len = (STREAM_UDP_PACKETS_PER_BLOCK - p->idx) * STREAM_UDP_CHUNK_SIZE;
+            n++;
+        }
+        for (s = p->idx; !gro && s < STREAM_UDP_PACKETS_PER_BLOCK && n < max; s++, n++)
+        {
+            iov[n].iov_base = FrameData(p->frame) + s * STREAM_UDP_CHUNK_SIZE;
+            iov[n].iov_len = STREAM_UDP_CHUNK_SIZE;
+        }
+    }
+    for (i = 0; n < max; i++)
+    {
+        if (i == ctx->nspares)
+        {
+            if (i == MAX_SPARES || !Mpmc_Pop(&g_pool.free, &f))
+            {
+                break;
+            }
+            ctx->spares[i] = f;
+            ctx->adopted[i] = 0;
+            ctx->nspares++;
+        }
+        if (gro)
+        {
+            iov[n].iov_base = FrameData(ctx->spares[i]);
+            iov[n].iov_len = FRAME_STRIDE;
+            n++;
+        }
+        for (s = 0; !gro && s < STREAM_UDP_PACKETS_PER_BLOCK && n < max; s++, n++)
+        {
+            iov[n].iov_base = FrameData(ctx->spares[i]) + s * STREAM_UDP_CHUNK_SIZE;
+            iov[n].iov_len = STREAM_UDP_CHUNK_SIZE;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief 按包划分落点时, 一个GRO缓冲区在重组中占多个位置, 而板子当前帧缓冲区后面的位置是本批其它包
+ *        尚未处理的落点; 切开之前把板子已重组的部分搬到池中的帧缓冲区
+ */
+static void Rx_Relocate(RxCtx *ctx, uint64_t key)
+{
+    Board *b = Board_Lookup(ctx, key);
+    uint32_t i, f;
+    int landing;
+
+    if (b == NULL || b->frame == NO_FRAME || b->discard)
+    {
+        return;
+    }
+    landing = (b->frame == ctx->land_pred);
+    for (i = 0; !landing && i < ctx->nspares; i++)
+    {
+        landing = (ctx->adopted[i] && b->frame == ctx->spares[i]);
+    }
+    if (!landing)
+    {
+        return;
+    }
+    if (!Mpmc_Pop(&g_pool.free, &f))
+    {
+        ctx->st.pool_empty++;
+        Board_Abandon(ctx, b);
+        b->discard = 1;
+        return;
+    }
+    memcpy(FrameData(f), FrameData(b->frame), (size_t)b->idx * STREAM_UDP_CHUNK_SIZE);
+    ctx->st.copied += b->idx;
+    ctx->release[ctx->nrelease++] = b->frame;
+    b->frame = f;
+}
+
+// ============================ recvmmsg 收包 ============================
+typedef struct {
+    int fd;
+    uint32_t batch;
+    int cpu;                                // 固定的CPU, -1 不固定
+    pthread_t th;
+    RxCtx ctx;
+    RxStatsPub pub;
+    // socket 后端
+    struct mmsghdr msgs[MAX_BATCH];
+    struct iovec iov[MAX_BATCH];
+    struct sockaddr_in from[MAX_BATCH];
+    uint8_t ctrl[MAX_BATCH][CMSG_SPACE(sizeof(uint32_t)) + CMSG_SPACE(sizeof(int))];
+    uint8_t scratch[STREAM_UDP_CHUNK_SIZE];            // 没有空帧缓冲区时仍要把包收走 (计入丢弃); 跨两段iovec的GRO段
+    // UDP_GRO
+    int gro;
+    int gro_active;                         // 上一批收到过GRO缓冲区: 按整帧落点, 否则按包落点
+    struct iovec gro_iov[MAX_BATCH][2];     // 落点 + 溢出区
+    uint8_t *overflow;                      // 每个消息 GRO_MAX_BYTES
+    // ring 后端
+    uint8_t *ring;
+    uint32_t ring_blocks;
+    int drain_fd;
+} Worker;
+
+static Worker *g_workers;
+
+static int OpenSocket(uint16_t port, int rcvbuf_mb, int reuseport)
+{
+    struct sockaddr_in addr;
+    struct timeval tv = { 0, 100000 };
+    int rcvbuf = rcvbuf_mb << 20;
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+    if (reuseport && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0)
+    {
+        perror("SO_REUSEPORT");
+        close(fd);
+        return -1;
+    }
+    setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &one, sizeof(one));
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) < 0)
+    {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));   // 定期检查退出标志
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(fd, (const struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief reuseport 组按源IP分流: 内核对组内第一个套接字挂的经典BPF程序取返回值作为套接字序号
+ */
+static int AttachReuseportShard(int fd, uint32_t nworkers)
+{
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, (uint32_t)SKF_NET_OFF + 12),    // IPv4 源地址
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, nworkers),
+        BPF_STMT(BPF_RET | BPF_A, 0),
+    };
+    struct sock_fprog prog = { (unsigned short)(sizeof(code) / sizeof(code[0])), code };
+
+    return setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog));
+}
+
+/**
+ * @brief 取 SO_RXQ_OVFL 控制消息: 该套接字累计丢弃的包数
+ */
+static int RxqOverflow(const struct msghdr *mh, uint64_t *drops)
+{
+    const struct cmsghdr *cm;
+
+    for (cm = CMSG_FIRSTHDR(mh); cm != NULL; cm = CMSG_NXTHDR((struct msghdr *)mh, (struct cmsghdr *)cm))
+    {
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_RXQ_OVFL)
+        {
+            uint32_t v;
+
+            memcpy(&v, CMSG_DATA(cm), sizeof(v));
+            *drops = v;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 取 UDP_GRO 控制消息中的段长; 没有时返回0 (单个数据报)
+ */
+static uint32_t GroSegmentSize(const struct msghdr *mh)
+{
+    const struct cmsghdr *cm;
+
+    for (cm = CMSG_FIRSTHDR(mh); cm != NULL; cm = CMSG_NXTHDR((struct msghdr *)mh, (struct cmsghdr *)cm))
+    {
+        if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO)
+        {
+            int v;
+
+            memcpy(&v, CMSG_DATA(cm), sizeof(v));
+            return (v > 0) ? (uint32_t)v : 0;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 把一个 (可能是GRO合并的) 消息按段长切开交给重组; 段在落点或溢出区中原地处理
+ */
+static void Rx_Message(Worker *ra, uint32_t i, uint64_t key, uint32_t len)
+{
+    const struct msghdr *mh = &ra->msgs[i].msg_hdr;
+    const uint8_t *land = mh->msg_iov[0].iov_base;
+    uint32_t l0 = (uint32_t)mh->msg_iov[0].iov_len;
+    uint32_t gso = ra->gro ? GroSegmentSize(mh) : 0;
+    uint32_t off;
+
+    if (gso == 0 || gso >= len)
+    {
+        Rx_Packet(&ra->ctx, key, land, len);
+        return;
+    }
+    ra->ctx.st.gro_bufs++;
+    if (len > l0 && !ra->ctx.land_gro)
+    {
+        Rx_Relocate(&ra->ctx, key);
+        ra->ctx.no_adopt = 1;
+    }
+    for (off = 0; off < len; off += gso)
+    {
+        uint32_t seg = (len - off < gso) ? len - off : gso;
+        const uint8_t *data;
+
+        ra->ctx.st.gro_segs++;
+        if (off + seg <= l0)
+        {
+            data = land + off;
+        }
+        else if (off >= l0)
+        {
+            data = (const uint8_t *)mh->msg_iov[1].iov_base + (off - l0);
+        }
+        else if (seg <= sizeof(ra->scratch))
+        {
+            // 段跨过落点末尾 (段长不是1440时)
+            memcpy(ra->scratch, land + off, l0 - off);
+            memcpy(ra->scratch + (l0 - off), mh->msg_iov[1].iov_base, seg - (l0 - off));
+            data = ra->scratch;
+        }
+        else
+        {
+            Rx_Packet(&ra->ctx, key, NULL, 0);
+            continue;
+        }
+        Rx_Packet(&ra->ctx, key, data, seg);
+    }
+    ra->ctx.no_adopt = 0;
+}
+
+static void PinThread(int cpu)
+{
+    cpu_set_t set;
+
+    if (cpu < 0)
+    {
+        return;
+    }
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+    {
+        fprintf(stderr, "cannot pin to CPU %d\n", cpu);
+    }
+}
+
+static void *RxThread(void *arg)
+{
+    Worker *ra = arg;
+    RxCtx *ctx = &ra->ctx;
+    struct mmsghdr *msgs = ra->msgs;
+    struct iovec *iov = ra->iov;
+    uint32_t i;
+
+    PinThread(ra->cpu);
+
+    while (!g_stop)
+    {
+        uint32_t n = Rx_Land(ctx, iov, ra->batch, ra->gro_active);
+        uint64_t gro_bufs = ctx->st.gro_bufs;
+        int r;
+
+        if (n == 0)
+        {
+            iov[0].iov_base = ra->scratch;
+            iov[0].iov_len = sizeof(ra->scratch);
+            n = 1;
+        }
+        for (i = 0; i < n; i++)
+        {
+            memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+            if (ra->gro)
+            {
+                ra->gro_iov[i][0] = iov[i];
+                ra->gro_iov[i][1].iov_base = ra->overflow + (size_t)i * GRO_MAX_BYTES;
+                ra->gro_iov[i][1].iov_len = GRO_MAX_BYTES;
+                msgs[i].msg_hdr.msg_iov = ra->gro_iov[i];
+                msgs[i].msg_hdr.msg_iovlen = 2;
+            }
+            else
+            {
+                msgs[i].msg_hdr.msg_iov = &iov[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            msgs[i].msg_hdr.msg_name = &ra->from[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(ra->from[i]);
+            msgs[i].msg_hdr.msg_control = ra->ctrl[i];
+            msgs[i].msg_hdr.msg_controllen = sizeof(ra->ctrl[i]);
+        }
+        r = recvmmsg(ra->fd, msgs, n, MSG_WAITFORONE, NULL);
+        if (r < 0)
+        {
+            if (errno != EAGAIN && errno != EINTR)
+            {
+                perror("recvmmsg");
+                break;
+            }
+            r = 0;
+        }
+        else
+        {
+            ctx->st.batches++;
+        }
+        for (i = 0; i < (uint32_t)r; i++)
+        {
+            const struct sockaddr_in *from = &ra->from[i];
+            uint64_t key = ((uint64_t)ntohl(from->sin_addr.s_addr) << 16) | ntohs(from->sin_port);
+            uint32_t len = (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) ? 0 : msgs[i].msg_len;
+
+            Rx_Message(ra, i, key, len);
+        }
+        ra->gro_active = ra->gro && (r == 0 ? ra->gro_active : ctx->st.gro_bufs != gro_bufs);
+        if (r > 0)
+        {
+            RxqOverflow(&msgs[r - 1].msg_hdr, &ctx->st.kdrops);
+        }
+        ctx->st.cpu_ns = ThreadCpuNs();
+        Stats_Publish(&ra->pub, &ctx->st);
+    }
+    return NULL;
+}
+
+// ============================ TPACKET_V3 收包 ============================
+/**
+ * @brief 经典BPF: IPv4、非分片、UDP、目的端口为 port 的以太网帧放行, 其余丢弃
+ */
+static int AttachUdpPortFilter(int fd, uint16_t port)
+{
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),                 // 以太网类型
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETHERTYPE_IP, 0, 8),
+        BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 23),                 // IP协议
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, 6),
+        BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 20),                 // 分片偏移
+        BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1FFF, 4, 0),
+        BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 14),                // X = IP头长度
+        BPF_STMT(BPF_LD | BPF_H | BPF_IND, 16),                 // UDP目的端口
+        BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, port, 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, 0x40000),
+        BPF_STMT(BPF_RET | BPF_K, 0),
+    };
+    struct sock_fprog prog = { (unsigned short)(sizeof(code) / sizeof(code[0])), code };
+
+    return setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog));
+}
+
+/**
+ * @brief 打开 TPACKET_V3 环并映射; 另开一个丢弃一切的UDP套接字占住端口
+ */
+static int OpenRing(Worker *ra, const char *ifname, uint16_t port, int ring_mb)
+{
+    struct sock_filter drop_all[] = { BPF_STMT(BPF_RET | BPF_K, 0) };
+    struct sock_fprog drop_prog = { 1, drop_all };
+    struct tpacket_req3 req;
+    struct sockaddr_ll ll;
+    int version = TPACKET_V3;
+    int one = 1;
+    int fd;
+
+    ra->drain_fd = OpenSocket(port, 0, 0);
+    if (ra->drain_fd < 0)
+    {
+        return -1;
+    }
+    setsockopt(ra->drain_fd, SOL_SOCKET, SO_ATTACH_FILTER, &drop_prog, sizeof(drop_prog));
+
+    fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if (fd < 0)
+    {
+        perror("socket(AF_PACKET) (needs CAP_NET_RAW)");
+        return -1;
+    }
+    // 先挂过滤器再绑定网口, 不让其它流量进环
+    if (AttachUdpPortFilter(fd, port) < 0 ||
+        setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0)
+    {
+        perror("setsockopt(AF_PACKET)");
+        return -1;
+    }
+    setsockopt(fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &one, sizeof(one));   // lo 上每帧出入各一次
+
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = RING_BLOCK_SIZE;
+    req.tp_block_nr = (uint32_t)((ring_mb > 0) ? ring_mb : 1) * ((1U << 20) / RING_BLOCK_SIZE);
+    req.tp_frame_size = RING_FRAME_SIZE;
+    req.tp_frame_nr = req.tp_block_nr * (RING_BLOCK_SIZE / RING_FRAME_SIZE);
+    req.tp_retire_blk_tov = RING_BLOCK_TOV_MS;
+    if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0)
+    {
+        perror("PACKET_RX_RING");
+        return -1;
+    }
+    ra->ring = mmap(NULL, (size_t)req.tp_block_nr * RING_BLOCK_SIZE, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_LOCKED | MAP_POPULATE, fd, 0);
+    if (ra->ring == MAP_FAILED)
+    {
+        ra->ring = mmap(NULL, (size_t)req.tp_block_nr * RING_BLOCK_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, 0);
+    }
+    if (ra->ring == MAP_FAILED)
+    {
+        perror("mmap");
+        return -1;
+    }
+    ra->ring_blocks = req.tp_block_nr;
+
+    memset(&ll, 0, sizeof(ll));
+    ll.sll_family = AF_PACKET;
+    ll.sll_protocol = htons(ETH_P_ALL);
+    ll.sll_ifindex = (int)if_nametoindex(ifname);
+    if (ll.sll_ifindex == 0 || bind(fd, (const struct sockaddr *)&ll, sizeof(ll)) < 0)
+    {
+        fprintf(stderr, "cannot bind to interface %s: %s\n", ifname, strerror(errno));
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief 原地解析一个帧 (过滤器已保证 IPv4/UDP/端口), 交给重组
+ */
+static void RingPacket(RxCtx *ctx, const struct tpacket3_hdr *ph)
+{
+    const struct sockaddr_ll *ll =
+        (const struct sockaddr_ll *)((const uint8_t *)ph + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+    const uint8_t *eth = (const uint8_t *)ph + ph->tp_mac;
+    const uint8_t *ip = eth + 14;
+    uint32_t ihl = (ip[0] & 0x0FU) * 4U;
+    const uint8_t *udp = ip + ihl;
+    uint32_t udp_len = ((uint32_t)udp[4] << 8) | udp[5];
+    uint64_t key;
+
+    if (ll->sll_pkttype == PACKET_OUTGOING)
+    {
+        return;
+    }
+    if (ph->tp_snaplen < 14 + ihl + 8 || udp_len < 8 || ph->tp_snaplen < 14 + ihl + udp_len)
+    {
+        Rx_Packet(ctx, 0, NULL, 0);         // 截断 (帧大于 RING_FRAME_SIZE)
+        return;
+    }
+    // 源地址和端口按主机字节序, 与 socket 后端的键相同
+    key = ((uint64_t)(((uint32_t)ip[12] << 24) | ((uint32_t)ip[13] << 16) | ((uint32_t)ip[14] << 8) | ip[15]) << 16) |
+          (((uint32_t)udp[0] << 8) | udp[1]);
+    Rx_Packet(ctx, key, udp + 8, udp_len - 8);
+}
+
+static void *RingThread(void *arg)
+{
+    Worker *ra = arg;
+    RxCtx *ctx = &ra->ctx;
+    uint32_t blk = 0;
+
+    PinThread(ra->cpu);
+    while (!g_stop)
+    {
+        struct tpacket_block_desc *bd = (struct tpacket_block_desc *)(ra->ring + (size_t)blk * RING_BLOCK_SIZE);
+        const uint8_t *p;
+        uint32_t i;
+
+        if ((__atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) == 0)
+        {
+            struct pollfd pfd = { ra->fd, POLLIN | POLLERR, 0 };
+
+            poll(&pfd, 1, 100);
+            continue;
+        }
+        p = (const uint8_t *)bd + bd->hdr.bh1.offset_to_first_pkt;
+        for (i = 0; i < bd->hdr.bh1.num_pkts; i++)
+        {
+            const struct tpacket3_hdr *ph = (const struct tpacket3_hdr *)p;
+
+            RingPacket(ctx, ph);
+            p += ph->tp_next_offset;
+        }
+        // 负载已拷进帧缓冲区, 环块交还内核
+        __atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        blk = (blk + 1 == ra->ring_blocks) ? 0 : blk + 1;
+        Rx_EndBatch(ctx);
+        ctx->st.batches++;
+
+        {
+            struct tpacket_stats_v3 ts;
+            socklen_t len = sizeof(ts);
+
+            // 读取即清零, 累加
+            if (getsockopt(ra->fd, SOL_PACKET, PACKET_STATISTICS, &ts, &len) == 0)
+            {
+                ctx->st.kdrops += ts.tp_drops;
+            }
+        }
+        ctx->st.cpu_ns = ThreadCpuNs();
+        Stats_Publish(&ra->pub, &ctx->st);
+    }
+    return NULL;
+}
+
+// ============================ 主程序 ============================
+/**
+ * @brief 整机软中断的累计CPU时间 (秒), 读不到时为0
+ */
+static double HostSoftirqSec(void)
+{
+    unsigned long long v[7] = { 0 };
+    char buf[256];
+    ssize_t n;
+    int fd = open("/proc/stat", O_RDONLY);     // 不用 fopen: 稳态中不分配堆
+
+    if (fd < 0)
+    {
+        return 0.0;
+    }
+    n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0)
+    {
+        return 0.0;
+    }
+    buf[n] = '\0';
+    if (sscanf(buf, "cpu %llu %llu %llu %llu %llu %llu %llu", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6]) != 7)
+    {
+        v[6] = 0;
+    }
+    return (double)v[6] / (double)sysconf(_SC_CLK_TCK);
+}
+
+static void Report(const char *tag, double dt, const RxStats *cur, const RxStats *prev, uint64_t cons_frames,
+                   uint64_t tag_errors, uint64_t seq_gaps, double softirq_s)
+{
+    uint64_t pk = cur->packets - prev->packets;
+    uint64_t cpu = cur->cpu_ns - prev->cpu_ns;
+    uint64_t placed = cur->inplace + cur->copied;
+    uint64_t kd = cur->kdrops - prev->kdrops;
+    double gbit = (cur->bytes - prev->bytes) * 8.0 / 1e9;
+
+    printf("%s %.1f s: %.0f pkt/s, %.2f MB/s, %.0f frames/s, rx CPU %.1f%% (%.0f pkt/s per core), "
+           "CPU-s/Gbit rx %.3f softirq %.3f, %.1f pkt/batch, %.1f seg/GRO buf (%llu bufs), inplace %.1f%%, boards %llu, dropped %llu, "
+           "kdrops %llu (loss %.3f%%), pool_empty %llu, queue_full %llu, bad %llu, consumed %llu, tag_errors %llu, seq_gaps %llu\n",
+           tag, dt, pk / dt, (cur->bytes - prev->bytes) / dt / 1e6, (cur->frames - prev->frames) / dt,
+           100.0 * cpu / 1e9 / dt, cpu ? pk / (cpu / 1e9) : 0.0,
+           gbit > 0.0 ? cpu / 1e9 / gbit : 0.0, gbit > 0.0 ? softirq_s / gbit : 0.0,
+           (cur->batches - prev->batches) ? (double)pk / (cur->batches - prev->batches) : 0.0,
+           (cur->gro_bufs - prev->gro_bufs) ? (double)(cur->gro_segs - prev->gro_segs) /
+                                                  (cur->gro_bufs - prev->gro_bufs) : 0.0,
+           (unsigned long long)(cur->gro_bufs - prev->gro_bufs),
+           placed ? 100.0 * cur->inplace / placed : 0.0, (unsigned long long)cur->boards,
+           (unsigned long long)cur->dropped, (unsigned long long)cur->kdrops,
+           (pk + kd) ? 100.0 * kd / (pk + kd) : 0.0, (unsigned long long)cur->pool_empty,
+           (unsigned long long)cur->queue_full, (unsigned long long)cur->bad_len,
+           (unsigned long long)cons_frames, (unsigned long long)tag_errors, (unsigned long long)seq_gaps);
+    fflush(stdout);
+}
+
+static void ConsumerTotals(uint64_t *frames, uint64_t *errors, uint64_t *gaps, uint64_t *cpu_ns)
+{
+    uint32_t i;
+
+    *frames = *errors = *gaps = *cpu_ns = 0;
+    for (i = 0; i < g_num_consumers; i++)
+    {
+        *frames += atomic_load_explicit(&g_consumers[i].frames, memory_order_relaxed);
+        *errors += atomic_load_explicit(&g_consumers[i].tag_errors, memory_order_relaxed);
+        *gaps += atomic_load_explicit(&g_consumers[i].seq_gaps, memory_order_relaxed);
+        *cpu_ns += atomic_load_explicit(&g_consumers[i].cpu_ns, memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief 各收包线程的统计之和 (cpu_ns 为各线程CPU时间之和)
+ */
+static void WorkerTotals(RxStats *sum)
+{
+    uint32_t w;
+    size_t i;
+
+    memset(sum, 0, sizeof(*sum));
+    for (w = 0; w < g_num_workers; w++)
+    {
+        RxStats st;
+
+        Stats_Read(&g_workers[w].pub, &st);
+        for (i = 0; i < sizeof(RxStats) / sizeof(uint64_t); i++)
+        {
+            ((uint64_t *)sum)[i] += ((const uint64_t *)&st)[i];
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    uint16_t port = DEFAULT_RX_PORT;
+    uint32_t nframes = 1024;
+    uint32_t batch = 64;
+    int rcvbuf_mb = 16;
+    int first_cpu = 0;
+    int shard_addr = 1;
+    int gro = 0;
+    int alloc_strict = 0;
+    const char *out_path = NULL;
+    uint32_t ncvt = 256;
+    uint64_t allocs_warm = 0, allocs_end = 0;
+    double t_warm = 0.0;
+    double seconds = 0.0;
+    VerifyMode verify = VERIFY_TAGGED;
+    Backend backend = BACKEND_SOCKET;
+    const char *ifname = "lo";
+    RxStats prev, cur;
+    uint64_t cf, ce, cg, ccpu;
+    double t0, t_last, sirq0, sirq_last;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t i;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:B:w:a:s:gc:n:v:o:N:Ab:i:R:t:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p': port = (uint16_t)atoi(optarg); break;
+        case 'B': batch = (uint32_t)atoi(optarg); break;
+        case 'w': g_num_workers = (uint32_t)atoi(optarg); break;
+        case 'a': first_cpu = atoi(optarg); break;
+        case 'c': g_num_consumers = (uint32_t)atoi(optarg); break;
+        case 'n': nframes = (uint32_t)atoi(optarg); break;
+        case 'R': rcvbuf_mb = atoi(optarg); break;
+        case 't': seconds = atof(optarg); break;
+        case 'i': ifname = optarg; break;
+        case 'g': gro = 1; break;
+        case 'o': out_path = optarg; break;
+        case 'N': ncvt = (uint32_t)atoi(optarg); break;
+        case 'A': alloc_strict = 1; break;
+        case 's':
+            if (strcmp(optarg, "addr") == 0 || strcmp(optarg, "hash") == 0)
+            {
+                shard_addr = (optarg[0] == 'a');
+            }
+            else
+            {
+                fprintf(stderr, "unknown shard mode: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'b':
+            if (strcmp(optarg, "socket") == 0)
+            {
+                backend = BACKEND_SOCKET;
+            }
+            else if (strcmp(optarg, "ring") == 0)
+            {
+                backend = BACKEND_RING;
+            }
+            else
+            {
+                fprintf(stderr, "unknown backend: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'v':
+            if (strcmp(optarg, "tagged") == 0)
+            {
+                verify = VERIFY_TAGGED;
+            }
+            else if (strcmp(optarg, "none") == 0)
+            {
+                verify = VERIFY_NONE;
+            }
+            else
+            {
+                fprintf(stderr, "unknown verify mode: %s\n", optarg);
+                return 2;
+            }
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-p port] [-B batch] [-w workers] [-a first-cpu|-1] [-s addr|hash] "
+                            "[-g] [-c consumers] [-n frames] [-v tagged|none] [-o file] [-N n] [-A] "
+                            "[-b socket|ring] [-i ifname] [-R MB] "
+                            "[-t s]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (batch == 0 || batch > MAX_BATCH || g_num_consumers == 0 || g_num_consumers > MAX_CONSUMERS ||
+        g_num_workers == 0 || g_num_workers > MAX_WORKERS || nframes < (MAX_SPARES + 1) * g_num_workers ||
+        (backend == BACKEND_RING && g_num_workers != 1) || ncvt == 0)
+    {
+        fprintf(stderr, "bad options: batch 1..%d, workers 1..%d (ring: 1), consumers 1..%d, "
+                        "frames >= %d per worker\n", MAX_BATCH, MAX_WORKERS, MAX_CONSUMERS, MAX_SPARES + 1);
+        return 2;
+    }
+
+    if (!Pool_Init(nframes))
+    {
+        fprintf(stderr, "cannot allocate %u frame buffers\n", nframes);
+        return 1;
+    }
+    if (out_path != NULL && !Cvt_Init(ncvt, out_path))
+    {
+        fprintf(stderr, "cannot set up the conversion/writer stage\n");
+        return 1;
+    }
+    g_consumers = aligned_alloc(64, (sizeof(Consumer) * g_num_consumers + 63) & ~(size_t)63);
+    g_workers = aligned_alloc(64, (sizeof(Worker) * g_num_workers + 63) & ~(size_t)63);
+    if (g_consumers == NULL || g_workers == NULL)
+    {
+        perror("aligned_alloc");
+        return 1;
+    }
+    memset(g_consumers, 0, sizeof(Consumer) * g_num_consumers);
+    memset(g_workers, 0, sizeof(Worker) * g_num_workers);
+    for (i = 0; i < g_num_workers; i++)
+    {
+        Worker *wk = &g_workers[i];
+
+        wk->batch = batch;
+        wk->ctx.worker = i;
+        wk->cpu = (first_cpu < 0 || ncpu <= 0) ? -1 : (int)((first_cpu + i) % (uint32_t)ncpu);
+        wk->drain_fd = -1;
+        wk->fd = (backend == BACKEND_RING) ? OpenRing(wk, ifname, port, rcvbuf_mb)
+                                           : OpenSocket(port, rcvbuf_mb, g_num_workers > 1);
+        if (wk->fd < 0)
+        {
+            return 1;
+        }
+        if (gro && backend == BACKEND_SOCKET)
+        {
+            int one = 1;
+
+            if (setsockopt(wk->fd, SOL_UDP, UDP_GRO, &one, sizeof(one)) < 0)
+            {
+                fprintf(stderr, "UDP_GRO not available (%s), receiving datagrams one by one\n", strerror(errno));
+                gro = 0;
+            }
+            else
+            {
+                wk->gro = 1;
+                wk->overflow = malloc((size_t)batch * GRO_MAX_BYTES);
+                if (wk->overflow == NULL)
+                {
+                    perror("malloc");
+                    return 1;
+                }
+            }
+        }
+    }
+    if (g_num_workers > 1 && shard_addr && AttachReuseportShard(g_workers[0].fd, g_num_workers) < 0)
+    {
+        perror("SO_ATTACH_REUSEPORT_CBPF (falling back to the kernel hash)");
+        shard_addr = 0;
+    }
+
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+    if (backend == BACKEND_RING)
+    {
+        printf("capturing UDP %u on %s, TPACKET_V3 ring %u x %u KB", port, ifname, g_workers[0].ring_blocks,
+               RING_BLOCK_SIZE >> 10);
+    }
+    else
+    {
+        printf("listening on UDP %u, recvmmsg batch %u%s, %u worker(s)%s", port, batch, gro ? " with UDP_GRO" : "",
+               g_num_workers, g_num_workers == 1 ? "" : (shard_addr ? " sharded by source IP" : " sharded by 4-tuple hash"));
+    }
+    printf(", %u consumer(s), %u frame buffers (%.1f MB), verify %s\n", g_num_consumers, nframes,
+           (double)nframes * FRAME_STRIDE / 1e6, verify == VERIFY_TAGGED ? "tagged" : "none");
+    if (g_cvt.enabled)
+    {
+        printf("converting to mV into %u buffers (%.1f MB), writing to %s\n", ncvt,
+               (double)ncvt * sizeof(CvtBlock) / 1e6, out_path);
+    }
+    fflush(stdout);
+
+    if (g_cvt.enabled)
+    {
+        pthread_create(&g_cvt.th, NULL, WriterThread, NULL);
+    }
+    for (i = 0; i < g_num_consumers; i++)
+    {
+        g_consumers[i].verify = verify;
+        pthread_create(&g_consumers[i].th, NULL, ConsumerThread, &g_consumers[i]);
+    }
+    for (i = 0; i < g_num_workers; i++)
+    {
+        pthread_create(&g_workers[i].th, NULL, (backend == BACKEND_RING) ? RingThread : RxThread, &g_workers[i]);
+    }
+
+    memset(&prev, 0, sizeof(prev));
+    t0 = t_last = NowSec();
+    sirq0 = sirq_last = HostSoftirqSec();
+    while (!g_stop)
+    {
+        struct timespec ts = { 0, 50000000 };
+        double now;
+
+        nanosleep(&ts, NULL);
+        now = NowSec();
+        if (t_warm == 0.0 && now - t0 >= ALLOC_WARMUP_S)
+        {
+            t_warm = now;
+            allocs_warm = atomic_load(&g_heap_allocs);
+        }
+        if (seconds > 0.0 && now - t0 >= seconds)
+        {
+            g_stop = 1;
+            break;
+        }
+        if (now - t_last >= REPORT_INTERVAL_S)
+        {
+            double sirq = HostSoftirqSec();
+
+            WorkerTotals(&cur);
+            ConsumerTotals(&cf, &ce, &cg, &ccpu);
+            Report("rx", now - t_last, &cur, &prev, cf, ce, cg, sirq - sirq_last);
+            prev = cur;
+            t_last = now;
+            sirq_last = sirq;
+        }
+    }
+
+    allocs_end = atomic_load(&g_heap_allocs);
+    for (i = 0; i < g_num_workers; i++)
+    {
+        pthread_join(g_workers[i].th, NULL);
+    }
+    atomic_store_explicit(&g_rx_done, 1, memory_order_release);
+    for (i = 0; i < g_num_consumers; i++)
+    {
+        pthread_join(g_consumers[i].th, NULL);
+    }
+    if (g_cvt.enabled)
+    {
+        atomic_store_explicit(&g_cvt.producers_done, 1, memory_order_release);
+        pthread_join(g_cvt.th, NULL);
+    }
+    WorkerTotals(&cur);
+    ConsumerTotals(&cf, &ce, &cg, &ccpu);
+    memset(&prev, 0, sizeof(prev));
+    Report("total", NowSec() - t0, &cur, &prev, cf, ce, cg, HostSoftirqSec() - sirq0);
+    if (g_num_workers > 1)
+    {
+        for (i = 0; i < g_num_workers; i++)
+        {
+            RxStats st;
+
+            Stats_Read(&g_workers[i].pub, &st);
+            printf("worker %u (CPU %d): %llu boards, %llu packets, %llu frames, dropped %llu, kdrops %llu, "
+                   "CPU %.2f s\n", i, g_workers[i].cpu, (unsigned long long)st.boards,
+                   (unsigned long long)st.packets, (unsigned long long)st.frames, (unsigned long long)st.dropped,
+                   (unsigned long long)st.kdrops, st.cpu_ns / 1e9);
+        }
+    }
+    printf("consumer CPU %.2f s for %llu frames (%.1f us/frame)\n", ccpu / 1e9, (unsigned long long)cf,
+           cf ? ccpu / 1e3 / cf : 0.0);
+    if (g_cvt.enabled)
+    {
+        uint64_t drops = 0;
+
+        for (i = 0; i < g_num_consumers; i++)
+        {
+            drops += atomic_load_explicit(&g_consumers[i].cvt_drops, memory_order_relaxed);
+        }
+        printf("writer: %llu blocks, %.1f MB, write errors %llu, cvt_drops %llu, CPU %.2f s\n",
+               (unsigned long long)atomic_load(&g_cvt.written), atomic_load(&g_cvt.bytes) / 1e6,
+               (unsigned long long)atomic_load(&g_cvt.write_errors), (unsigned long long)drops,
+               atomic_load(&g_cvt.cpu_ns) / 1e9);
+        close(g_cvt.fd);
+    }
+    if (t_warm != 0.0)
+    {
+        printf("heap allocations: %llu during startup, %llu in steady state (%.1f s)\n",
+               (unsigned long long)allocs_warm, (unsigned long long)(allocs_end - allocs_warm), NowSec() - t_warm);
+    }
+    for (i = 0; i < g_num_workers; i++)
+    {
+        close(g_workers[i].fd);
+        if (g_workers[i].drain_fd >= 0)
+        {
+            close(g_workers[i].drain_fd);
+        }
+        free(g_workers[i].overflow);
+    }
+    if (ce != 0)
+    {
+        return 1;
+    }
+    return (alloc_strict && (t_warm == 0.0 || allocs_end != allocs_warm)) ? 3 : 0;
+}